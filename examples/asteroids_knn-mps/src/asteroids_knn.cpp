@@ -1,9 +1,17 @@
 #include <ccenergy/EnergyTracker.hpp>
+#include <gpecs/BulkSpawn.hpp>
+#include <gpecs/FrameArena.hpp>
+#include <gpecs/MemoryReport.hpp>
+#include <gpecs/PerfCounters.hpp>
+#include <gpecs/Profiler.hpp>
+#include <gpecs/Threads.hpp>
+#include <gpecs/WorkStealing.hpp>
 
 #include <flecs.h>
 #include <cmath>
 #include <iostream>
 #include <vector>
+#include <memory_resource>
 #include <random>
 #include <thread>
 #include <chrono>
@@ -89,6 +97,11 @@ static void render_ascii(const Viewport& vp, const std::vector<flecs::entity>& a
 
 int main(int argc, char* argv[]) {
     flecs::world world(argc, argv);
+    gpecs::use_threads(world, argc, argv); // --threads N, removed from argv before K is read
+    auto profiler = gpecs::profile_from_args(world, argc, argv); // --profile PATH
+    auto perf = gpecs::perf_from_args(world, argc, argv); // --perf PATH
+    auto memory = gpecs::memory_from_args(world, argc, argv); // --memory PATH
+    auto arena = gpecs::arena_from_args(world, argc, argv); // --arena PATH, scratch memory per thread
 
     // Create the energy tracker
     ccenergy::EnergyTracker energy_tracker {{ .label = "OnUpdate",
@@ -101,10 +114,11 @@ int main(int argc, char* argv[]) {
         catch (...) { std::cerr << "Invalid K; using default 10\n"; K = 10; }
     }
 
-    world.component<Position>();
-    world.component<Velocity>();
-    world.component<Accel>();
-    world.component<Mass>();
+    // Members described so --memory can show padding
+    world.component<Position>().member("x", &Position::x).member("y", &Position::y);
+    world.component<Velocity>().member("dx", &Velocity::dx).member("dy", &Velocity::dy);
+    world.component<Accel>().member("ddx", &Accel::ddx).member("ddy", &Accel::ddy);
+    world.component<Mass>().member("m", &Mass::m);
     world.component<AsteroidTag>();
 
     // ------- Create a random swarm -------
@@ -120,18 +134,14 @@ int main(int argc, char* argv[]) {
     std::uniform_real_distribution<double> Uvel(-0.4, 0.4);
     std::uniform_real_distribution<double> Umass(0.5, 2.0);
 
-    std::vector<flecs::entity> asteroids;
-    asteroids.reserve(N);
-
-    for (int i = 0; i < N; ++i) {
-        asteroids.push_back(
-            world.entity()
-                .add<AsteroidTag>()
-                .set<Position>({UposX(rng), UposY(rng)})
-                .set<Velocity>({Uvel(rng), Uvel(rng)})
-                .set<Accel>({0.0, 0.0})
-                .set<Mass>({Umass(rng)}));
-    }
+    std::vector<flecs::entity> asteroids = gpecs::BulkSpawner<Position, Velocity, Accel, Mass>(world)
+        .add<AsteroidTag>()
+        .spawn(N, [&](int32_t, Position& p, Velocity& v, Accel& a, Mass& m) {
+            p = {UposX(rng), UposY(rng)};
+            v = {Uvel(rng), Uvel(rng)};
+            a = {0.0, 0.0};
+            m = {Umass(rng)};
+        });
 
     // Clamp K
     K = std::min(K, std::max(1, N - 1));
@@ -153,10 +163,15 @@ int main(int argc, char* argv[]) {
     };
 
     // ------- Systems -------
+    // The three physics systems only write to their own asteroid, so they can
+    // be split between threads. bins is rebuilt outside of progress() and is
+    // only read here.
+
     // 0) Clear accelerations
     world.system<Accel>()
         .with<AsteroidTag>()
         .kind(flecs::PreUpdate)
+        .multi_threaded()
         .each([](Accel& a){ a.ddx = 0.0; a.ddy = 0.0; });
 
     // Start the energy tracker just before the simulation code starts
@@ -169,15 +184,21 @@ int main(int argc, char* argv[]) {
 
 
     // 1) Update the accelerations - KNN gravity using only current cell + 8 neighbours
+    // An asteroid costs as much as it has candidates, so a crowded cell can
+    // make one worker's share much longer than the rest; idle workers steal
+    // from it.
+    gpecs::WorkStealing stealing(world);
     world.system<const Position, Accel, const Mass>()
         .with<AsteroidTag>()
         .kind(flecs::OnUpdate)
-        .each([&](flecs::entity self, const Position& pi, Accel& ai, const Mass& /*mi*/){
+        .multi_threaded()
+        .run(stealing.each([&](flecs::entity self, const Position& pi, Accel& ai, const Mass& /*mi*/){
             // Find my cell
             auto [cx, cy] = pos_to_cell(pi);
 
             // Gather candidate indices from surrounding neighbourhood (with cell wrap)
-            std::vector<int> candidates;
+            // Both lists come from this thread's arena, so the pass does not malloc
+            std::pmr::vector<int> candidates(arena->local());
             candidates.reserve(40); // heuristic
             for (int dy = -1; dy <= 1; ++dy) {
                 for (int dx = -1; dx <= 1; ++dx) {
@@ -189,7 +210,7 @@ int main(int argc, char* argv[]) {
             }
 
             // Build distances to candidates using minimum-image
-            std::vector<std::pair<double,int>> dlist;
+            std::pmr::vector<std::pair<double,int>> dlist(arena->local());
             dlist.reserve(candidates.size());
             for (int idx : candidates) {
                 if (asteroids[idx] == self) continue;
@@ -225,7 +246,7 @@ int main(int argc, char* argv[]) {
                 ai.ddx += rx * s;
                 ai.ddy += ry * s;
             }
-        });
+        }));
 
     // Stop the energy tracker just after the simulation code stops
     // We do it this way to enable the systems being monitored to be changed without needing to be changed.
@@ -235,10 +256,14 @@ int main(int argc, char* argv[]) {
             auto r = energy_tracker.stop();
         });
 
+    // Every worker must finish reading positions before any of them move
+    gpecs::sync_point(world, flecs::PostUpdate);
+
     // 2) Apply the accelerations
     world.system<Position, Velocity, const Accel>()
         .with<AsteroidTag>()
         .kind(flecs::PostUpdate)
+        .multi_threaded()
         .each([](Position& p, Velocity& v, const Accel& a){
             v.dx += a.ddx * DT;
             v.dy += a.ddy * DT;
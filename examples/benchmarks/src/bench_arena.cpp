@@ -0,0 +1,155 @@
+/*
+Per entity scratch vectors from the heap, and from a gpecs::FrameArena.
+
+asteroids_knn's gravity system: every asteroid gathers the candidates in
+the 9 cells around it into one vector, their distances into another, and
+keeps the K nearest. From the heap that is two or three malloc() and
+free() calls per asteroid per frame, from every worker at once; from the
+thread's arena it is none after the first frame. Both use the same
+std::pmr::vector, on a resource that counts its calls to the heap.
+
+Runs 10^3 .. 10^5 asteroids on 1 and 2 threads, and prints ns per asteroid
+frame both ways, the heap allocations per frame after the first, the
+arena's high-water mark, and whether the accelerations are the same.
+*/
+
+#include "benchmarks.hpp"
+#include <gpecs/FrameArena.hpp>
+#include <flecs.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+namespace {
+
+const int STEPS = 20;
+const int K = 10;
+const int CELLS = 64;           // per side
+const double SIDE = 1.0;
+
+struct Position { double x, y; };
+struct Accel { double ddx, ddy; };
+
+struct Run {
+    double ns_per_asteroid_frame;
+    double heap_per_frame;
+    std::size_t high_water;
+    std::vector<double> accelerations;
+};
+
+int cell_of(double v) { return std::clamp(int(v / SIDE * CELLS), 0, CELLS - 1); }
+
+// The heap, counting the allocations made through it
+class CountingHeap final : public std::pmr::memory_resource {
+  public:
+    std::atomic<long> allocations {0};
+
+  private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+void gravity(const std::vector<std::vector<int>>& bins, const std::vector<Position>& positions,
+             int self, const Position& p, Accel& a, std::pmr::memory_resource* scratch) {
+    const int cx = cell_of(p.x), cy = cell_of(p.y);
+    std::pmr::vector<int> candidates(scratch);
+    candidates.reserve(64);
+    for (int dy = -1; dy <= 1; ++dy)
+        for (int dx = -1; dx <= 1; ++dx) {
+            const auto& bucket = bins[((cy + dy + CELLS) % CELLS) * CELLS + (cx + dx + CELLS) % CELLS];
+            candidates.insert(candidates.end(), bucket.begin(), bucket.end());
+        }
+    std::pmr::vector<std::pair<double, int>> dlist(scratch);
+    dlist.reserve(candidates.size());
+    for (int idx : candidates) {
+        if (idx == self) continue;
+        const double dx = positions[idx].x - p.x, dy = positions[idx].y - p.y;
+        dlist.emplace_back(dx * dx + dy * dy, idx);
+    }
+    if ((int)dlist.size() > K) {
+        std::nth_element(dlist.begin(), dlist.begin() + K, dlist.end(),
+                         [](const auto& l, const auto& r) { return l.first < r.first; });
+        dlist.resize(K);
+    }
+    a = {0.0, 0.0};
+    for (auto& [d2, idx] : dlist) {
+        const double s = 1e-6 / ((d2 + 1e-4) * std::sqrt(d2 + 1e-4));
+        a.ddx += (positions[idx].x - p.x) * s;
+        a.ddy += (positions[idx].y - p.y) * s;
+    }
+}
+
+Run run(long asteroids, int threads, bool arena_vectors) {
+    flecs::world world;
+    if (threads > 1)
+        world.set_threads(threads);
+    std::vector<Position> positions;
+    std::vector<std::vector<int>> bins(CELLS * CELLS);
+    for (long i = 0; i < asteroids; ++i) {
+        const Position p {std::fmod(0.7548776662 * double(i), SIDE), std::fmod(0.5698402910 * double(i), SIDE)};
+        positions.push_back(p);
+        bins[cell_of(p.y) * CELLS + cell_of(p.x)].push_back(int(i));
+        world.entity().set<Position>(p).set<Accel>({0.0, 0.0});
+    }
+    // The index of each asteroid in `positions` is its entity's order
+    std::vector<flecs::entity_t> order;
+    world.each([&order](flecs::entity e, const Position&) { order.push_back(e); });
+    std::sort(order.begin(), order.end());
+    gpecs::FrameArena arena(world);
+
+    CountingHeap heap;
+    auto index_of = [&order](flecs::entity_t e) {
+        return int(std::lower_bound(order.begin(), order.end(), e) - order.begin());
+    };
+    world.system<const Position, Accel>()
+        .multi_threaded()
+        .each([&](flecs::entity e, const Position& p, Accel& a) {
+            gravity(bins, positions, index_of(e), p, a, arena_vectors ? arena.local() : &heap);
+        });
+
+    world.progress();
+    auto from_heap = [&]() { return arena_vectors ? long(arena.heap_blocks()) : heap.allocations.load(); };
+    const long before = from_heap();
+    Stopwatch timer;
+    for (int step = 1; step < STEPS; ++step)
+        world.progress();
+    Run result {1e9 * timer.seconds() / (double(asteroids) * (STEPS - 1)),
+                double(from_heap() - before) / (STEPS - 1), arena.high_water(), {}};
+    world.each([&result](const Accel& a) {
+        result.accelerations.push_back(a.ddx);
+        result.accelerations.push_back(a.ddy);
+    });
+    return result;
+}
+
+}
+
+int bench_arena(int argc, char* argv[]) {
+    bool all_same = true;
+    for (long n : decades(3, 5, argc, argv)) {
+        for (int threads : {1, 2}) {
+            Run heap = run(n, threads, false);
+            Run arena = run(n, threads, true);
+            bool same = heap.accelerations == arena.accelerations;
+            all_same = all_same && same;
+            std::printf("[bench-arena] asteroids=%ld threads=%d heap_ns_per_asteroid_frame=%.1f "
+                        "arena_ns_per_asteroid_frame=%.1f heap_mallocs_per_frame=%.0f "
+                        "arena_mallocs_per_frame=%.0f arena_high_water_kb=%.1f same=%d\n",
+                        n, threads, heap.ns_per_asteroid_frame, arena.ns_per_asteroid_frame,
+                        heap.heap_per_frame, arena.heap_per_frame, arena.high_water / 1024.0, same ? 1 : 0);
+        }
+    }
+    return all_same ? 0 : 1;
+}
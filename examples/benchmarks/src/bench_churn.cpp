@@ -0,0 +1,150 @@
+/*
+Cost of archetype churn, and what gpecs::ChurnMonitor reports for it.
+
+Walkers on a lattice shaped like Sketches/ME/2DrandomWalk. In the "tags"
+version one system adds one of nine boundary tags to every walker each step
+and a move system per tag removes it again, so every walker changes table
+twice per step. In the "field" version the same classification is stored
+in a component field and nothing changes table.
+
+Prints the time per walker step for both, for 10^3 .. 10^5 walkers, then
+the churn monitor's report for a short run of each.
+*/
+
+#include "benchmarks.hpp"
+#include <gpecs/ChurnMonitor.hpp>
+#include <flecs.h>
+#include <cstdio>
+#include <memory>
+#include <random>
+
+namespace {
+
+const int L = 50;   // lattice extent
+
+struct Position { int x, y; };
+struct Boundary { int side; };
+
+struct BulkTag {};
+struct LeftTag {};
+struct UpTag {};
+struct RightTag {};
+struct DownTag {};
+struct UpperLeftTag {};
+struct UpperRightTag {};
+struct LowerLeftTag {};
+struct LowerRightTag {};
+
+// 0 = bulk, 1..4 = walls, 5..8 = corners, as the sketch's if/else chain
+int side_of(const Position& p) {
+    if (p.x == 0 && p.y == 0) return 5;
+    if (p.x == L && p.y == 0) return 6;
+    if (p.x == 0 && p.y == L) return 7;
+    if (p.x == L && p.y == L) return 8;
+    if (p.x == 0) return 1;
+    if (p.y == 0) return 2;
+    if (p.x == L) return 3;
+    if (p.y == L) return 4;
+    return 0;
+}
+
+// One random step that stays on the lattice
+void step(Position& p, std::mt19937& gen) {
+    static const int dx[4] = {1, -1, 0, 0};
+    static const int dy[4] = {0, 0, 1, -1};
+    int d = static_cast<int>(gen() % 5);
+    if (d == 4) return;
+    int x = p.x + dx[d], y = p.y + dy[d];
+    if (x >= 0 && x <= L && y >= 0 && y <= L) p = {x, y};
+}
+
+template <typename Tag>
+void move_system(flecs::world& world, flecs::entity phase, std::mt19937& gen) {
+    world.system<Position>()
+        .with<Tag>()
+        .kind(phase)
+        .each([&gen](flecs::entity e, Position& p) {
+            step(p, gen);
+            e.remove<Tag>();
+        });
+}
+
+void build_tags(flecs::world& world, std::mt19937& gen) {
+    flecs::entity classify = world.entity("Classify").add(flecs::Phase);
+    flecs::entity move = world.entity("Move").add(flecs::Phase).depends_on(classify);
+    world.system<const Position>()
+        .kind(classify)
+        .each([](flecs::entity e, const Position& p) {
+            switch (side_of(p)) {
+                case 0: e.add<BulkTag>(); break;
+                case 1: e.add<LeftTag>(); break;
+                case 2: e.add<UpTag>(); break;
+                case 3: e.add<RightTag>(); break;
+                case 4: e.add<DownTag>(); break;
+                case 5: e.add<UpperLeftTag>(); break;
+                case 6: e.add<UpperRightTag>(); break;
+                case 7: e.add<LowerLeftTag>(); break;
+                default: e.add<LowerRightTag>(); break;
+            }
+        });
+    move_system<BulkTag>(world, move, gen);
+    move_system<LeftTag>(world, move, gen);
+    move_system<UpTag>(world, move, gen);
+    move_system<RightTag>(world, move, gen);
+    move_system<DownTag>(world, move, gen);
+    move_system<UpperLeftTag>(world, move, gen);
+    move_system<UpperRightTag>(world, move, gen);
+    move_system<LowerLeftTag>(world, move, gen);
+    move_system<LowerRightTag>(world, move, gen);
+}
+
+void build_field(flecs::world& world, std::mt19937& gen) {
+    flecs::entity classify = world.entity("Classify").add(flecs::Phase);
+    flecs::entity move = world.entity("Move").add(flecs::Phase).depends_on(classify);
+    world.system<const Position, Boundary>()
+        .kind(classify)
+        .each([](const Position& p, Boundary& b) {
+            b.side = side_of(p);
+        });
+    world.system<Position, const Boundary>()
+        .kind(move)
+        .each([&gen](Position& p, const Boundary&) {
+            step(p, gen);
+        });
+}
+
+// Seconds per walker step; prints the churn report if `monitor` is set
+double walk(long walkers, int steps, bool tags, bool monitor) {
+    flecs::world world;
+    std::mt19937 gen(42);
+    for (long i = 0; i < walkers; ++i) {
+        flecs::entity e = world.entity().set<Position>({int(gen() % (L + 1)), int(gen() % (L + 1))});
+        if (!tags) e.set<Boundary>({0});
+    }
+    if (tags) build_tags(world, gen); else build_field(world, gen);
+
+    std::unique_ptr<gpecs::ChurnMonitor> churn;
+    if (monitor) churn = std::make_unique<gpecs::ChurnMonitor>(world);
+    world.progress();   // first frame builds the pipeline and tables
+
+    Stopwatch timer;
+    for (int s = 0; s < steps; ++s) world.progress();
+    double seconds = timer.seconds();
+    if (monitor) std::printf("[bench-churn] report pattern=%s\n", tags ? "tags" : "field");
+    return seconds / (double(walkers) * steps);
+}
+
+}
+
+int bench_churn(int argc, char* argv[]) {
+    const int steps = 100;
+    for (long n : decades(3, 5, argc, argv)) {
+        double tags = walk(n, steps, true, false);
+        double field = walk(n, steps, false, false);
+        std::printf("[bench-churn] walkers=%ld steps=%d tags_ns_per_step=%.1f field_ns_per_step=%.1f "
+                    "speedup=%.2f\n", n, steps, 1e9 * tags, 1e9 * field, tags / field);
+    }
+    walk(1000, 20, true, true);
+    walk(1000, 20, false, true);
+    return 0;
+}
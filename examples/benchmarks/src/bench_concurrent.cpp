@@ -0,0 +1,168 @@
+/*
+Independent systems one after the other, and at the same time with
+gpecs::ConcurrentSystems.
+
+The walkers of Sketches/ME/2DrandomWalk: a system tags every walker with
+its wall, corner or the bulk, then nine systems in nine chained phases
+move the walkers with one tag each and remove it. The nine tags are
+disjoint, so only the tagging has to come first.
+
+Runs 10^3 .. 10^5 walkers for 1, 2 and 4 threads with the phases as
+declared and with the ten systems handed to ConcurrentSystems, each move
+drawing `work` random numbers per walker (1 as the sketch, and 64 for a
+heavier update), and prints the time per walker step for both and whether
+both leave every walker in the same place. Then prints the plan for 4
+threads.
+*/
+
+#include "benchmarks.hpp"
+#include <gpecs/ConcurrentSystems.hpp>
+#include <gpecs/CounterRng.hpp>
+#include <flecs.h>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+const int L = 50;   // lattice extent, as the sketch
+const uint64_t SEED = 42;
+const int STEPS = 20;
+
+struct Position { int x, y; };
+
+struct BulkTag {};
+struct LeftTag {};
+struct UpTag {};
+struct RightTag {};
+struct DownTag {};
+struct UpperLeftTag {};
+struct UpperRightTag {};
+struct LowerLeftTag {};
+struct LowerRightTag {};
+
+// One step in a random direction out of those allowed, or none
+void step(flecs::entity e, Position& p, int work) {
+    gpecs::CounterRng rng(SEED, e.id(), uint64_t(e.world().get_info()->frame_count_total));
+    double u = 0;
+    for (int i = 0; i < work; ++i)
+        u += rng.uniform();
+    static const int dx[4] = {1, -1, 0, 0};
+    static const int dy[4] = {0, 0, 1, -1};
+    int d = int(u / work * 5);
+    if (d >= 4) return;
+    int x = p.x + dx[d], y = p.y + dy[d];
+    if (x >= 0 && x <= L && y >= 0 && y <= L) p = {x, y};
+}
+
+template <typename Tag>
+void move_system(flecs::world& world, flecs::entity phase, int work) {
+    world.system<Position>()
+        .with<Tag>()
+        .template write<Tag>()
+        .kind(phase)
+        .each([work](flecs::entity e, Position& p) {
+            step(e, p, work);
+            e.remove<Tag>();
+        });
+}
+
+// The sketch's phases; returns them in order
+std::vector<flecs::entity> build(flecs::world& world, int work) {
+    std::vector<flecs::entity> phases;
+    for (int i = 0; i < 10; ++i) {
+        flecs::entity phase = world.entity().add(flecs::Phase);
+        if (i > 0) phase.depends_on(phases.back());
+        phases.push_back(phase);
+    }
+    world.system<const Position>()
+        .write<BulkTag>().write<LeftTag>().write<UpTag>().write<RightTag>().write<DownTag>()
+        .write<UpperLeftTag>().write<UpperRightTag>().write<LowerLeftTag>().write<LowerRightTag>()
+        .kind(phases[0])
+        .each([](flecs::entity e, const Position& p) {
+            if (p.x == 0 && p.y == 0) e.add<UpperLeftTag>();
+            else if (p.x == L && p.y == 0) e.add<UpperRightTag>();
+            else if (p.x == 0 && p.y == L) e.add<LowerLeftTag>();
+            else if (p.x == L && p.y == L) e.add<LowerRightTag>();
+            else if (p.x == 0) e.add<LeftTag>();
+            else if (p.x == L) e.add<RightTag>();
+            else if (p.y == 0) e.add<UpTag>();
+            else if (p.y == L) e.add<DownTag>();
+            else e.add<BulkTag>();
+        });
+    move_system<LeftTag>(world, phases[1], work);
+    move_system<UpTag>(world, phases[2], work);
+    move_system<RightTag>(world, phases[3], work);
+    move_system<DownTag>(world, phases[4], work);
+    move_system<UpperLeftTag>(world, phases[5], work);
+    move_system<UpperRightTag>(world, phases[6], work);
+    move_system<LowerLeftTag>(world, phases[7], work);
+    move_system<LowerRightTag>(world, phases[8], work);
+    move_system<BulkTag>(world, phases[9], work);
+    return phases;
+}
+
+struct Walk {
+    double ns_per_walker_step;
+    std::vector<Position> positions;
+};
+
+Walk walk(long walkers, int work, int threads, bool concurrent, bool report) {
+    flecs::world world;
+    if (threads > 1)
+        world.set_threads(threads);
+    std::vector<flecs::entity> people;
+    for (long i = 0; i < walkers; ++i) {
+        gpecs::CounterRng rng(SEED, flecs::entity_t(i), 0);
+        people.push_back(world.entity().set<Position>({int(rng.uniform() * (L + 1)), int(rng.uniform() * (L + 1))}));
+    }
+    std::vector<flecs::entity> phases = build(world, work);
+    std::unique_ptr<gpecs::ConcurrentSystems> systems;
+    if (concurrent)
+        systems = std::make_unique<gpecs::ConcurrentSystems>(world, std::initializer_list<flecs::entity>{
+            phases[0], phases[1], phases[2], phases[3], phases[4],
+            phases[5], phases[6], phases[7], phases[8], phases[9]});
+
+    world.progress();   // first frame builds the pipeline and tables
+    Stopwatch timer;
+    for (int s = 0; s < STEPS; ++s)
+        world.progress();
+    Walk result {1e9 * timer.seconds() / (double(walkers) * STEPS), {}};
+    for (flecs::entity e : people)
+        result.positions.push_back(e.get<Position>());
+    if (report && systems)
+        std::cout << systems->report();
+    return result;
+}
+
+bool same(const std::vector<Position>& a, const std::vector<Position>& b) {
+    if (a.size() != b.size()) return false;
+    for (std::size_t i = 0; i < a.size(); ++i)
+        if (a[i].x != b[i].x || a[i].y != b[i].y) return false;
+    return true;
+}
+
+}
+
+int bench_concurrent(int argc, char* argv[]) {
+    bool all_same = true;
+    for (int work : {1, 64}) {
+        for (long n : decades(3, 5, argc, argv)) {
+            Walk reference = walk(n, work, 1, false, false);
+            for (int threads : {1, 2, 4}) {
+                Walk declared = threads == 1 ? reference : walk(n, work, threads, false, false);
+                Walk concurrent = walk(n, work, threads, true, false);
+                bool ok = same(reference.positions, declared.positions) &&
+                          same(reference.positions, concurrent.positions);
+                all_same = all_same && ok;
+                std::printf("[bench-concurrent] work=%d walkers=%ld threads=%d declared_ns_per_walker_step=%.1f "
+                            "concurrent_ns_per_walker_step=%.1f speedup=%.2f same=%d\n",
+                            work, n, threads, declared.ns_per_walker_step, concurrent.ns_per_walker_step,
+                            declared.ns_per_walker_step / concurrent.ns_per_walker_step, ok ? 1 : 0);
+            }
+        }
+    }
+    std::printf("[bench-concurrent] plan walkers=1000 threads=4\n");
+    walk(1000, 1, 4, true, true);
+    return all_same ? 0 : 1;
+}
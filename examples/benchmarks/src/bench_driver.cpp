@@ -0,0 +1,132 @@
+/*
+A step loop that writes out a density grid every step, in turn and with
+the grid run in the background by gpecs::Driver.
+
+sph_runge's loop: a step moves the particles, then the density on a grid
+of points is summed over every particle and written to a file. In turn,
+the step waits for the grid; with the driver the particles are copied,
+and the grid is worked out and written on a background thread while the
+next step runs.
+
+Runs 10^2 .. 10^3 particles on a 64 x 32 grid, and prints ms/step both
+ways, how much of the background work overlapped with the steps, the time
+spawn() waited, and whether both files are the same.
+*/
+
+#include "benchmarks.hpp"
+#include <gpecs/Driver.hpp>
+#include <gpecs/TextWriter.hpp>
+#include <flecs.h>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+const int STEPS = 40;
+const int GX = 64, GY = 32;
+const double H = 0.5;
+
+struct Position { double x, y; };
+struct Velocity { double dx, dy; };
+
+// A step with about as much work as the grid
+void build(flecs::world& world, long particles) {
+    for (long i = 0; i < particles; ++i)
+        world.entity()
+            .set<Position>({std::fmod(0.37 * double(i), double(GX)), std::fmod(0.61 * double(i), double(GY))})
+            .set<Velocity>({std::sin(double(i)), std::cos(double(i))});
+    world.system<Position, Velocity>()
+        .each([](Position& p, Velocity& v) {
+            double ax = 0, ay = 0;
+            for (int k = 0; k < GX * GY / 2; ++k) {
+                ax += std::sin(p.y + double(k));
+                ay += std::cos(p.x + double(k));
+            }
+            v.dx = 0.99 * v.dx + 1e-3 * ax;
+            v.dy = 0.99 * v.dy + 1e-3 * ay;
+            p.x = std::fmod(p.x + 1e-2 * v.dx + GX, double(GX));
+            p.y = std::fmod(p.y + 1e-2 * v.dy + GY, double(GY));
+        });
+}
+
+std::vector<Position> copy(flecs::world& world) {
+    std::vector<Position> positions;
+    world.each([&positions](const Position& p) { positions.push_back(p); });
+    return positions;
+}
+
+void grid(const std::vector<Position>& positions, gpecs::TextWriter& out) {
+    for (int y = GY - 1; y >= 0; --y) {
+        for (int x = 0; x < GX; ++x) {
+            double rho = 0;
+            for (const Position& p : positions) {
+                const double r2 = (x - p.x) * (x - p.x) + (y - p.y) * (y - p.y);
+                rho += std::exp(-r2 / (H * H));
+            }
+            out << rho << (x + 1 < GX ? "," : "\n");
+        }
+    }
+}
+
+gpecs::Task grid_task(gpecs::Driver& driver, gpecs::Strand strand, flecs::world& world, gpecs::TextWriter& out) {
+    std::vector<Position> positions = copy(world);
+    co_await driver.on(strand);
+    grid(positions, out);
+}
+
+std::string contents(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+}
+
+int bench_driver(int argc, char* argv[]) {
+    const std::string a = "bench_driver_in_turn.csv", b = "bench_driver_overlapped.csv";
+    bool all_same = true;
+    for (long n : decades(2, 3, argc, argv)) {
+        double in_turn_ms = 0;
+        {
+            flecs::world world;
+            build(world, n);
+            gpecs::TextWriter out(a);
+            Stopwatch timer;
+            for (int step = 0; step < STEPS; ++step) {
+                world.progress();
+                grid(copy(world), out);
+            }
+            out.close();
+            in_turn_ms = 1e3 * timer.seconds() / STEPS;
+        }
+        double overlapped_ms = 0, overlap = 0, waited = 0;
+        {
+            flecs::world world;
+            build(world, n);
+            gpecs::TextWriter out(b);
+            gpecs::Driver driver;
+            gpecs::Strand strand = driver.strand("density grid");
+            Stopwatch timer;
+            for (int step = 0; step < STEPS; ++step) {
+                driver.progress(world);
+                driver.spawn(step, grid_task(driver, strand, world, out));
+            }
+            driver.flush();
+            out.close();
+            overlapped_ms = 1e3 * timer.seconds() / STEPS;
+            waited = driver.waited();
+            overlap = 100.0 * driver.overlapped();
+        }
+        bool same = contents(a) == contents(b);
+        all_same = all_same && same;
+        std::printf("[bench-driver] particles=%ld in_turn_ms_per_step=%.3f overlapped_ms_per_step=%.3f "
+                    "speedup=%.2f overlap_pct=%.1f waited_s=%.3f same=%d\n",
+                    n, in_turn_ms, overlapped_ms, in_turn_ms / overlapped_ms, overlap, waited, same ? 1 : 0);
+    }
+    std::remove(a.c_str());
+    std::remove(b.c_str());
+    return all_same ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+/*
+Side effects on shared counters from a single threaded system, and posted
+to a gpecs::EventQueue from a multi-threaded one.
+
+The 3-state Markov chain of Sketches/OD: every person is susceptible,
+infected or recovered, a susceptible one is infected with probability
+beta * I and an infected one recovers with probability alpha. The sketch
+moves its noS/noI/noR counters from inside .each(), which only works single
+threaded. Here the same update posts a transition instead, and a single
+threaded system applies them to the counters, and to a log of who moved.
+
+Runs 10^4 .. 10^6 people with the counters updated in place (1 thread) and
+through the queue on 1, 2 and 4 threads, and prints the time per person
+step for both, the transitions per step, and whether the queue gives the
+same counts every step and the same log whatever the thread count.
+*/
+
+#include "benchmarks.hpp"
+#include <gpecs/CounterRng.hpp>
+#include <gpecs/EventQueue.hpp>
+#include <flecs.h>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+const uint64_t SEED = 42;
+const int STEPS = 50;
+const double ALPHA = 0.05;
+
+struct State { int s; };   // 0 susceptible, 1 infected, 2 recovered
+struct Transition { int from, to; };
+
+// The state `s` moves to this step, given the infected count at its start
+int next_state(flecs::entity_t person, int64_t frame, int s, double beta_i) {
+    if (s == 2) return 2;
+    const double u = gpecs::CounterRng(SEED, person, uint64_t(frame)).uniform();
+    if (s == 0) return u < beta_i ? 1 : 0;
+    return u < ALPHA ? 2 : 1;
+}
+
+struct Run {
+    double ns_per_person_step;
+    long transitions;
+    std::vector<long> counts;       // S, I, R after every step
+    uint64_t log_hash;              // of who moved, in the order applied
+};
+
+Run run(long people, int threads, bool queued) {
+    flecs::world world;
+    if (threads > 1)
+        world.set_threads(threads);
+    const double beta = 1.0 / double(people);
+    for (long i = 0; i < people; ++i)
+        world.entity().set<State>({i < 2 ? 1 : 0});
+
+    long count[3] = {people - 2, 2, 0};
+    double beta_i = 0.0;    // beta times the infected at the start of the step
+    Run result {0.0, 0, {}, 14695981039346656037ull};
+    auto log = [&](flecs::entity_t person, const Transition& t) {
+        count[t.from] -= 1;
+        count[t.to] += 1;
+        result.transitions += 1;
+        result.log_hash = (result.log_hash ^ (person * 3 + uint64_t(t.to))) * 1099511628211ull;
+    };
+
+    gpecs::EventQueue<Transition> transitions(world);
+    if (queued) {
+        world.system<State>()
+            .multi_threaded()
+            .each([&](flecs::iter& it, size_t row, State& state) {
+                const int next = next_state(it.entity(row), it.world().get_info()->frame_count_total,
+                                            state.s, beta_i);
+                if (next != state.s) {
+                    transitions.emit(it, row, {state.s, next});
+                    state.s = next;
+                }
+            });
+        transitions.drain(world, flecs::PostUpdate, log);
+    } else {
+        world.system<State>()
+            .each([&](flecs::entity person, State& state) {
+                const int next = next_state(person, person.world().get_info()->frame_count_total,
+                                            state.s, beta_i);
+                if (next != state.s) {
+                    log(person, {state.s, next});
+                    state.s = next;
+                }
+            });
+    }
+
+    Stopwatch timer;
+    for (int step = 0; step < STEPS; ++step) {
+        beta_i = beta * double(count[1]);
+        world.progress();
+        result.counts.insert(result.counts.end(), {count[0], count[1], count[2]});
+    }
+    result.ns_per_person_step = 1e9 * timer.seconds() / (double(people) * STEPS);
+    return result;
+}
+
+}
+
+int bench_events(int argc, char* argv[]) {
+    bool all_same = true;
+    for (long n : decades(4, 6, argc, argv)) {
+        Run direct = run(n, 1, false);
+        Run reference {};
+        for (int threads : {1, 2, 4}) {
+            Run queued = run(n, threads, true);
+            if (threads == 1)
+                reference = queued;
+            bool same = queued.counts == direct.counts && queued.log_hash == reference.log_hash;
+            all_same = all_same && same;
+            std::printf("[bench-events] people=%ld threads=%d direct_ns_per_person_step=%.2f "
+                        "queued_ns_per_person_step=%.2f transitions_per_step=%.1f same=%d\n",
+                        n, threads, direct.ns_per_person_step, queued.ns_per_person_step,
+                        double(queued.transitions) / STEPS, same ? 1 : 0);
+        }
+    }
+    return all_same ? 0 : 1;
+}
@@ -0,0 +1,387 @@
+/*
+Whole-example benchmarks: how fast the examples themselves run as the
+problem grows.
+
+Every example with a problem size to vary (nodes, particles) is built at
+each size with a fixed number of steps and a fixed random seed, then run
+headless with --profile: in a scratch directory of its own, its files and
+stdout going there. Sizes run over decades, 10^lo .. 10^hi per example, hi
+overridable as for the other benchmarks. One line is printed per run and
+all of them go to one JSON report:
+  steps_per_s           - from the profiler's "ms/step wall"
+  ns_per_entity_update  - wall time per step per node or particle
+  peak_rss_MB           - maximum resident set size of the run
+  J_per_step            - package energy per step, null when the RAPL
+                          counters cannot be read (often root only)
+
+The examples fix their sizes in constants, so the sources are patched on
+the way to the compiler with the regular expressions below; the examples
+themselves do not change. A patch that no longer matches fails that
+example rather than silently benchmarking the default size.
+
+asteroids_knn-mps measures itself with include/ccenergy/EnergyTracker.hpp,
+which needs <format> (g++ 13 or later) to build and /sys/class/powercap to
+run. Where either is missing it is reported as skipped, and why, rather
+than failed.
+
+Options: [max decade] [--repo DIR] [--build DIR] [--json FILE] [--only NAME]
+The compilers are $CXX and $CC (g++ and gcc if unset). flecs.c is compiled
+once into the build directory and reused.
+*/
+
+#include "benchmarks.hpp"
+#include <gpecs/Args.hpp>
+#include <gpecs/Sweep.hpp>
+#include <gpecs/TextWriter.hpp>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Patch {
+    std::string pattern;
+    std::string replacement;
+};
+
+struct Example {
+    const char* name;       // directory under examples/
+    const char* source;     // its one translation unit, under src/
+    const char* counts;     // what the size counts
+    int lo, hi;             // decades
+    // Patches for a size of about n; sets `size` to the size they give
+    std::vector<Patch> (*patches)(long n, long& size);
+    bool ccenergy;          // built with the energy tracker
+};
+
+// The random seed and the absolute output paths some sketches carry
+const Patch SEED = { R"(std::random_device\{\}\(\))", "42" };
+const Patch PATHS = { R"("/Users/[^"]*/)", "\"./" };
+
+std::vector<Patch> fluid(long n, long& size) {
+    // Keeps the default 100:40:20 shape, 2*Nx*(2*Ny + Nh) nodes
+    const long nx = std::max(2L, std::lround(std::sqrt(n / 2.0)));
+    const long ny = std::max(1L, std::lround(0.4 * nx));
+    const long nh = std::max(1L, std::lround(0.2 * nx));
+    size = 2 * nx * (2 * ny + nh);
+    return {
+        { R"(const int Nx = \d+;)", "const int Nx = " + std::to_string(nx) + ";" },
+        { R"(const int Ny = \d+;)", "const int Ny = " + std::to_string(ny) + ";" },
+        { R"(const int Nh = \d+;)", "const int Nh = " + std::to_string(nh) + ";" },
+        { R"(const int NUMBERSTEPS = \d+;)", "const int NUMBERSTEPS = 50;" },
+    };
+}
+
+std::vector<Patch> sph(long n, long& size) {
+    size = n;
+    return {
+        { R"(int NO_PARTICLES = \d+;)", "int NO_PARTICLES = " + std::to_string(n) + ";" },
+        { R"(const int STEPS = \d+;)", "const int STEPS = 5;" },
+        // Shorter Markov chains for the initial positions
+        { R"(int stationary_time = \d+;)", "int stationary_time = 1000;" },
+        { R"(int sample_interval = \d+;)", "int sample_interval = 100;" },
+        // Some output files are named only for 20, 50 and 100 particles
+        { R"(std::string (file\w+)="";)", R"(std::string $1="$1.txt";)" },
+        SEED, PATHS,
+    };
+}
+
+std::vector<Patch> unsteady(long n, long& size) {
+    size = n;
+    // The time step follows from N, so the end time is set to give 100 steps
+    return {
+        { R"(const int N = \d+;)", "const int N = " + std::to_string(n) + ";" },
+        { R"(double TIME = [0-9.]+;)",
+          "double TIME = 100.5 / (2.0 * static_cast<int>((2 * ((RHO * U * L) / PE) * (N-1) * (N-1)) / RHO));" },
+    };
+}
+
+std::vector<Patch> asteroids(long n, long& size) {
+    size = n;
+    return {
+        { R"(const int N = \d+;)", "const int N = " + std::to_string(n) + ";" },
+        { R"(const int STEPS = \d+;)", "const int STEPS = 50;" },
+        // No terminal to draw the swarm on
+        { R"(render_ascii\(vp, asteroids\);)", "" },
+        SEED,
+    };
+}
+
+const Example EXAMPLES[] = {
+    { "fluid-me",               "main.cpp",          "nodes",     3, 6, fluid,     false },
+    { "unsteady_scalar-ecs-me", "main.cpp",          "nodes",     2, 5, unsteady,  false },
+    { "sph_euler-od",           "sph_dust.cpp",      "particles", 1, 2, sph,       false },
+    { "sph_runge-od",           "sph_dust.cpp",      "particles", 1, 2, sph,       false },
+    { "asteroids_knn-mps",      "asteroids_knn.cpp", "asteroids", 2, 3, asteroids, true },
+};
+
+// Examples left out, and why
+const std::pair<const char*, const char*> SKIPPED[] = {
+    { "basic-ccenergy-use-mps",      "times a busy wait with the energy tracker, no simulation" },
+    { "oscillator-od",               "two particles, no problem size to vary" },
+    { "starter-euler-me",            "two particles, no problem size to vary" },
+    { "first_fluid-od",              "steady state solve, no time steps" },
+    { "steady_state-ecs-me",         "steady state solve, no time steps" },
+    { "steady_state-oop-me",         "steady state solve, no time steps" },
+    { "steady_state-procedural-me",  "steady state solve, no time steps" },
+    { "steady_state-temperature-me", "steady state solve, no time steps" },
+};
+
+struct Result {
+    std::string example;
+    const char* counts;
+    long size {0};
+    std::string status {"ok"};
+    long long steps {0};
+    double seconds {0};
+    double ms_per_step {0};
+    double peak_rss_mb {0};
+    double joules {std::numeric_limits<double>::quiet_NaN()};
+};
+
+std::string contents(const fs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+std::string quoted(const fs::path& path) {
+    return "'" + path.string() + "'";
+}
+
+// First line of a command's output
+std::string first_line(const std::string& command) {
+    std::string line;
+    if (FILE* p = popen((command + " 2>/dev/null").c_str(), "r")) {
+        char buffer[256];
+        if (std::fgets(buffer, sizeof(buffer), p))
+            line = buffer;
+        pclose(p);
+    }
+    while (!line.empty() && (line.back() == '\n' || line.back() == '\r'))
+        line.pop_back();
+    return line;
+}
+
+std::string cpu_model() {
+    std::ifstream in("/proc/cpuinfo");
+    for (std::string line; std::getline(in, line);)
+        if (line.rfind("model name", 0) == 0)
+            return line.substr(line.find(':') + 2);
+    return "";
+}
+
+const char* tool(const char* variable, const char* fallback) {
+    const char* value = std::getenv(variable);
+    return value && *value ? value : fallback;
+}
+
+// Why the energy tracker cannot be built or run here, or "" if it can
+std::string ccenergy_missing(const fs::path& repo) {
+    const std::string command = "echo '#include <ccenergy/EnergyTracker.hpp>' | " + std::string(tool("CXX", "g++"))
+        + " -std=gnu++23 -I" + quoted(repo / "include") + " -fsyntax-only -x c++ - > /dev/null 2>&1";
+    if (std::system(command.c_str()) != 0)
+        return std::string("skipped: ") + tool("CXX", "g++") + " cannot build ccenergy/EnergyTracker.hpp (it needs <format>)";
+    if (!fs::is_directory("/sys/class/powercap"))
+        return "skipped: the energy tracker needs /sys/class/powercap, which this machine does not have";
+    return "";
+}
+
+// Builds one size of an example into `dir`; returns "ok" or what went wrong
+std::string build(const Example& example, const fs::path& repo, const fs::path& flecs,
+                  const std::vector<Patch>& patches, const fs::path& dir) {
+    const fs::path home = repo / "examples" / example.name;
+    std::string source = contents(home / "src" / example.source);
+    if (source.empty())
+        return "cannot read " + (home / "src" / example.source).string();
+    for (const Patch& patch : patches) {
+        const std::regex pattern(patch.pattern);
+        if (!std::regex_search(source, pattern))
+            return "patch no longer matches: " + patch.pattern;
+        source = std::regex_replace(source, pattern, patch.replacement);
+    }
+    fs::create_directories(dir);
+    std::ofstream(dir / example.source) << source;
+    const std::string command = std::string(tool("CXX", "g++")) + " -std=gnu++23 -O2"
+        + " -I" + quoted(repo / "include") + " -I" + quoted(home / "include") + " -I" + quoted(home / "src")
+        + " " + quoted(dir / example.source) + " " + quoted(flecs) + " -pthread"
+        + " -o " + quoted(dir / "ecs_application") + " > " + quoted(dir / "build.log") + " 2>&1";
+    if (std::system(command.c_str()) != 0)
+        return "build failed, see " + (dir / "build.log").string();
+    return "ok";
+}
+
+// Runs the build in `dir` with --profile and fills in the measurements
+void measure(const fs::path& dir, Result& result) {
+    const fs::path run = dir / "run";
+    fs::remove_all(run);
+    fs::create_directories(run);
+    const std::string binary = fs::absolute(dir / "ecs_application").string();
+
+    gpecs::sweep::Rapl rapl;
+    Stopwatch timer;
+    const pid_t pid = fork();
+    if (pid == 0) {
+        const int fd = (chdir(run.c_str()) == 0) ? open("stdout.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644) : -1;
+        if (fd < 0 || dup2(fd, 1) < 0 || dup2(fd, 2) < 0)
+            _exit(127);
+        execl(binary.c_str(), binary.c_str(), "--profile", "-", static_cast<char*>(nullptr));
+        _exit(127);
+    }
+    int status = 0;
+    rusage usage {};
+    if (pid < 0 || wait4(pid, &status, 0, &usage) != pid) {
+        result.status = "cannot run " + binary;
+        return;
+    }
+    result.seconds = timer.seconds();
+    result.peak_rss_mb = usage.ru_maxrss / 1024.0;
+    if (rapl.available())
+        result.joules = rapl.joules();
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        result.status = "run failed, see " + (run / "stdout.txt").string();
+        return;
+    }
+
+    // The profiler's summary is the last line of its kind in the output
+    std::ifstream out(run / "stdout.txt");
+    for (std::string line; std::getline(out, line);) {
+        long long frames;
+        double system, step;
+        if (std::sscanf(line.c_str(), "gpecs profile: %lld frames, %lf ms/frame in systems, %lf ms/step wall",
+                        &frames, &system, &step) == 3) {
+            result.steps = frames;
+            result.ms_per_step = step;
+        }
+    }
+    if (result.steps == 0)
+        result.status = "no profiler summary in " + (run / "stdout.txt").string();
+}
+
+std::string json_string(const std::string& text) {
+    std::string r = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            r += '\\';
+        r += (c == '\n' || c == '\t') ? ' ' : c;
+    }
+    return r + "\"";
+}
+
+// A number, or null when there is none
+void json_number(gpecs::TextWriter& out, double value) {
+    if (std::isfinite(value))
+        out << value;
+    else
+        out << "null";
+}
+
+double steps_per_s(const Result& r) { return r.ms_per_step > 0 ? 1e3 / r.ms_per_step : NAN; }
+double ns_per_update(const Result& r) { return r.size > 0 ? 1e6 * r.ms_per_step / r.size : NAN; }
+double joules_per_step(const Result& r) { return r.steps > 0 ? r.joules / r.steps : NAN; }
+
+bool report(const std::string& path, const fs::path& repo, const std::vector<Result>& results, bool energy) {
+    gpecs::TextWriter out(path);
+    out << "{\n  \"benchmark\": \"examples\",\n"
+        << "  \"commit\": " << json_string(first_line("git -C " + quoted(repo) + " rev-parse --short HEAD")) << ",\n"
+        << "  \"compiler\": " << json_string(first_line(std::string(tool("CXX", "g++")) + " --version")) << ",\n"
+        << "  \"cpu\": " << json_string(cpu_model()) << ",\n"
+        << "  \"cores\": " << std::thread::hardware_concurrency() << ",\n"
+        << "  \"energy\": " << (energy ? "true" : "false") << ",\n"
+        << "  \"results\": [";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        out << (i ? ",\n" : "\n") << "    {\"example\": " << json_string(r.example)
+            << ", \"counts\": " << json_string(r.counts) << ", \"size\": " << r.size
+            << ", \"steps\": " << r.steps << ", \"seconds\": ";
+        json_number(out, r.seconds);
+        out << ", \"steps_per_s\": ";
+        json_number(out, steps_per_s(r));
+        out << ", \"ns_per_entity_update\": ";
+        json_number(out, ns_per_update(r));
+        out << ", \"peak_rss_MB\": ";
+        json_number(out, r.peak_rss_mb);
+        out << ", \"J_per_step\": ";
+        json_number(out, joules_per_step(r));
+        out << ", \"status\": " << json_string(r.status) << "}";
+    }
+    out << "\n  ],\n  \"skipped\": [";
+    for (std::size_t i = 0; i < std::size(SKIPPED); ++i)
+        out << (i ? ",\n" : "\n") << "    {\"example\": " << json_string(SKIPPED[i].first)
+            << ", \"reason\": " << json_string(SKIPPED[i].second) << "}";
+    out << "\n  ]\n}\n";
+    return out.close();
+}
+
+}
+
+int bench_examples(int argc, char* argv[]) {
+    std::string repo = "../../..", root = "bench-examples", json = "bench.json", only;
+    gpecs::take_option(argc, argv, "--repo", repo);
+    gpecs::take_option(argc, argv, "--build", root);
+    gpecs::take_option(argc, argv, "--json", json);
+    gpecs::take_option(argc, argv, "--only", only);
+    const fs::path build_dir = fs::absolute(root);
+    fs::create_directories(build_dir);
+
+    // flecs is the same for every build
+    const fs::path flecs_c = fs::path(repo) / "src" / "flecs.c";
+    const fs::path flecs = build_dir / "flecs.o";
+    if (!fs::exists(flecs) || fs::last_write_time(flecs) < fs::last_write_time(flecs_c)) {
+        const std::string command = std::string(tool("CC", "gcc")) + " -std=gnu99 -O2"
+            + " -I" + quoted(fs::path(repo) / "include") + " -c " + quoted(flecs_c) + " -o " + quoted(flecs);
+        if (std::system(command.c_str()) != 0) {
+            std::printf("[bench-examples] cannot build %s\n", flecs_c.c_str());
+            return 1;
+        }
+    }
+
+    std::vector<Result> results;
+    bool failed = false;
+    for (const Example& example : EXAMPLES) {
+        if (!only.empty() && only != example.name)
+            continue;
+        const std::string missing = example.ccenergy ? ccenergy_missing(repo) : "";
+        for (long n : decades(example.lo, example.hi, argc, argv)) {
+            Result result;
+            result.example = example.name;
+            result.counts = example.counts;
+            const std::vector<Patch> patches = example.patches(n, result.size);
+            const fs::path dir = build_dir / example.name / std::to_string(result.size);
+            if (!missing.empty()) {
+                result.status = missing;
+            } else {
+                result.status = build(example, repo, flecs, patches, dir);
+                if (result.status == "ok")
+                    measure(dir, result);
+                failed = failed || result.status != "ok";
+            }
+            std::printf("[bench-examples] example=%s %s=%ld steps=%lld seconds=%.3f steps_per_s=%.2f "
+                        "ns_per_entity_update=%.2f peak_rss_MB=%.1f J_per_step=%.4g status=%s\n",
+                        example.name, example.counts, result.size, result.steps, result.seconds,
+                        steps_per_s(result), ns_per_update(result), result.peak_rss_mb,
+                        joules_per_step(result), result.status.c_str());
+            std::fflush(stdout);
+            results.push_back(std::move(result));
+        }
+    }
+
+    if (!report(json, repo, results, gpecs::sweep::Rapl().available())) {
+        std::printf("[bench-examples] cannot write %s\n", json.c_str());
+        return 1;
+    }
+    std::printf("[bench-examples] report=%s\n", json.c_str());
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,121 @@
+/*
+Back-to-back systems over the same entities, one after the other and fused
+into one pass with gpecs::SystemFusion.
+
+fluid-me's last Runge-Kutta stage and its update: one system works out the
+fourth stage's functions from the end predicted values, the next reads them
+back with the three earlier stages' to advance the start values. Both run
+over every node, so unfused the second streams FunctionsFourth, and the
+columns it shares with nothing, through the cache a second time.
+
+Runs 10^4 .. 10^6 nodes (past the last level cache at the top) on 1 and 2
+threads, and prints ms/frame both ways, the kB per frame the memory
+report estimates both ways, and whether both give the same values.
+*/
+
+#include "benchmarks.hpp"
+#include <gpecs/MemoryReport.hpp>
+#include <gpecs/SystemFusion.hpp>
+#include <flecs.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+namespace {
+
+const int FRAMES = 10;
+const double TIMESTEP = 1e-3;
+
+struct Index { long i; };
+struct VelocityStart { double x, y; };
+struct DensityStart { double rho; };
+struct VelocityEndPredict { double x, y; };
+struct DensityEndPredict { double rho; };
+struct Functions { double u, v, rho; };
+struct FunctionsFirst : Functions {};
+struct FunctionsSecond : Functions {};
+struct FunctionsThird : Functions {};
+struct FunctionsFourth : Functions {};
+
+struct Run {
+    double ms_per_frame;
+    double kb_per_frame;
+    std::vector<double> values;
+};
+
+Run run(long nodes, int threads, bool fused) {
+    flecs::world world;
+    if (threads > 1)
+        world.set_threads(threads);
+    for (long i = 0; i < nodes; ++i) {
+        const double s = std::sin(0.001 * double(i));
+        world.entity()
+            .set<Index>({i})
+            .set<VelocityStart>({s, 1.0 - s}).set<DensityStart>({1.0 + 0.1 * s})
+            .set<VelocityEndPredict>({0.5 * s, s}).set<DensityEndPredict>({1.0})
+            .set<FunctionsFirst>({{s, s, s}}).set<FunctionsSecond>({{s, -s, s}})
+            .set<FunctionsThird>({{-s, s, s}}).set<FunctionsFourth>({{0.0, 0.0, 0.0}});
+    }
+
+    flecs::entity stage = world.entity().add(flecs::Phase);
+    flecs::entity update = world.entity().add(flecs::Phase).depends_on(stage);
+    world.system<const VelocityEndPredict, const DensityEndPredict, FunctionsFourth>()
+        .kind(stage)
+        .multi_threaded()
+        .each([](const VelocityEndPredict& v, const DensityEndPredict& d, FunctionsFourth& f) {
+            f.u = -v.x * v.y / d.rho;
+            f.v = -v.y * v.x / d.rho;
+            f.rho = -d.rho * (v.x + v.y);
+        }).add<gpecs::Fusable>();
+    world.system<VelocityStart, DensityStart, const FunctionsFirst, const FunctionsSecond,
+                 const FunctionsThird, const FunctionsFourth>()
+        .kind(update)
+        .multi_threaded()
+        .each([](VelocityStart& v, DensityStart& d, const FunctionsFirst& f1, const FunctionsSecond& f2,
+                 const FunctionsThird& f3, const FunctionsFourth& f4) {
+            v.x += TIMESTEP * (f1.u + 2 * f2.u + 2 * f3.u + f4.u) / 6;
+            v.y += TIMESTEP * (f1.v + 2 * f2.v + 2 * f3.v + f4.v) / 6;
+            d.rho += TIMESTEP * (f1.rho + 2 * f2.rho + 2 * f3.rho + f4.rho) / 6;
+        }).add<gpecs::Fusable>();
+
+    std::unique_ptr<gpecs::SystemFusion> fusion;
+    if (fused)
+        fusion = std::make_unique<gpecs::SystemFusion>(world, std::initializer_list<flecs::entity>{stage, update});
+
+    world.progress();   // warm up
+    Stopwatch timer;
+    for (int f = 0; f < FRAMES; ++f)
+        world.progress();
+    Run result {1e3 * timer.seconds() / FRAMES, 0.0, std::vector<double>(3 * nodes)};
+    for (const gpecs::SystemTraffic& s : gpecs::memory_footprint(world).systems)
+        result.kb_per_frame += (s.read + s.written) / 1e3;
+    world.each([&result](const Index& index, const VelocityStart& v, const DensityStart& d) {
+        result.values[3 * index.i] = v.x;
+        result.values[3 * index.i + 1] = v.y;
+        result.values[3 * index.i + 2] = d.rho;
+    });
+    return result;
+}
+
+}
+
+int bench_fusion(int argc, char* argv[]) {
+    bool all_same = true;
+    for (long n : decades(4, 6, argc, argv)) {
+        for (int threads : {1, 2}) {
+            Run apart = run(n, threads, false);
+            Run fused = run(n, threads, true);
+            bool same = std::memcmp(apart.values.data(), fused.values.data(),
+                                    apart.values.size() * sizeof(double)) == 0;
+            all_same = all_same && same;
+            std::printf("[bench-fusion] nodes=%ld threads=%d apart_ms_per_frame=%.3f fused_ms_per_frame=%.3f "
+                        "speedup=%.2f apart_kb_per_frame=%.0f fused_kb_per_frame=%.0f same=%d\n",
+                        n, threads, apart.ms_per_frame, fused.ms_per_frame, apart.ms_per_frame / fused.ms_per_frame,
+                        apart.kb_per_frame, fused.kb_per_frame, same ? 1 : 0);
+        }
+    }
+    return all_same ? 0 : 1;
+}
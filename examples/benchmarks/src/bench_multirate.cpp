@@ -0,0 +1,110 @@
+/*
+A step with an expensive check run every step, and every k steps with
+gpecs::Multirate.
+
+The SPH sketches' time step check: every step, the force on each particle
+is summed over all the others, only to find the smallest time step the
+forces allow and print a warning if the step is larger. Here the step
+itself is cheap, so the check is most of its cost, and running it every
+k steps should take the time per step down to about 1/k of that.
+
+Runs 10^2 .. 10^3 particles for k = 1, 10 and 100, and prints ms/step, the
+steps the check ran on, and whether the particles end in the same places
+and the check ran on exactly the steps 0, k, 2k, ...
+*/
+
+#include "benchmarks.hpp"
+#include <gpecs/Multirate.hpp>
+#include <flecs.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <vector>
+
+namespace {
+
+const int STEPS = 200;
+
+struct Position { double x, y; };
+struct Velocity { double dx, dy; };
+
+struct Run {
+    double ms_per_step;
+    std::vector<int64_t> checked;       // the steps the check ran on
+    std::vector<double> positions;
+};
+
+Run run(long particles, int32_t k) {
+    flecs::world world;
+    for (long i = 0; i < particles; ++i)
+        world.entity()
+            .set<Position>({std::fmod(0.37 * double(i), 40.0), std::fmod(0.61 * double(i), 20.0)})
+            .set<Velocity>({std::sin(double(i)), std::cos(double(i))});
+
+    gpecs::Multirate rates(world);
+    flecs::entity check = rates.every(k);
+    Run result {0.0, {}, {}};
+
+    std::vector<Position> others;
+    double smallest = std::numeric_limits<double>::max();
+    world.system<const Position>()
+        .kind(flecs::PreUpdate)
+        .tick_source(check)
+        .run([&](flecs::iter& it) {
+            others.clear();
+            while (it.next()) {
+                auto p = it.field<const Position>(0);
+                for (auto row : it)
+                    others.push_back(p[row]);
+            }
+            for (const Position& a : others) {
+                double fx = 0, fy = 0;
+                for (const Position& b : others) {
+                    const double rx = a.x - b.x, ry = a.y - b.y;
+                    const double r2 = rx * rx + ry * ry + 1e-2;
+                    fx += rx / (r2 * std::sqrt(r2));
+                    fy += ry / (r2 * std::sqrt(r2));
+                }
+                smallest = std::min(smallest, 1.0 / std::sqrt(std::sqrt(fx * fx + fy * fy) + 1e-9));
+            }
+            result.checked.push_back(it.world().get_info()->frame_count_total);
+        });
+    world.system<Position, Velocity>()
+        .each([](Position& p, Velocity& v) {
+            v.dx = 0.99 * v.dx + 1e-3 * std::sin(p.y);
+            v.dy = 0.99 * v.dy + 1e-3 * std::cos(p.x);
+            p.x = std::fmod(p.x + 1e-2 * v.dx + 40.0, 40.0);
+            p.y = std::fmod(p.y + 1e-2 * v.dy + 20.0, 20.0);
+        });
+
+    Stopwatch timer;
+    for (int step = 0; step < STEPS; ++step)
+        world.progress();
+    result.ms_per_step = 1e3 * timer.seconds() / STEPS;
+    world.each([&result](const Position& p) { result.positions.push_back(p.x); result.positions.push_back(p.y); });
+    return result;
+}
+
+}
+
+int bench_multirate(int argc, char* argv[]) {
+    bool all_same = true;
+    for (long n : decades(2, 3, argc, argv)) {
+        Run every_step = run(n, 1);
+        for (int32_t k : {1, 10, 100}) {
+            Run multirate = run(n, k);
+            std::vector<int64_t> expected;
+            for (int64_t step = 0; step < STEPS; step += k)
+                expected.push_back(step);
+            bool same = multirate.positions == every_step.positions && multirate.checked == expected;
+            all_same = all_same && same;
+            std::printf("[bench-multirate] particles=%ld k=%d every_step_ms=%.3f multirate_ms=%.3f "
+                        "speedup=%.2f checks=%zu same=%d\n",
+                        n, k, every_step.ms_per_step, multirate.ms_per_step,
+                        every_step.ms_per_step / multirate.ms_per_step, multirate.checked.size(), same ? 1 : 0);
+        }
+    }
+    return all_same ? 0 : 1;
+}
@@ -0,0 +1,119 @@
+/*
+Cost of drawing random numbers in a system, and whether the results
+depend on the number of threads.
+
+Compares, per uniform number:
+  device   - a std::random_device and std::mt19937 built for every number, as
+             generateProbability() in Sketches/ME/2DrandomWalk
+  shared   - one std::mt19937 shared by everything, as the SIR sketches
+  counter  - a gpecs::CounterRng per entity and step
+  batch    - gpecs::uniform_batch over an array of entities
+
+Then runs a multi-threaded flecs system drawing exponential waiting times
+with gpecs::CounterRng on 1 and 4 threads, and checks both give the same
+numbers bit for bit.
+*/
+
+#include "benchmarks.hpp"
+#include <gpecs/CounterRng.hpp>
+#include <flecs.h>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+const uint64_t SEED = 42;
+
+volatile double sink;   // keeps the timed loops from being optimised away
+
+struct Waiting { double tau; };
+
+double device_ns(long n) {
+    double sum = 0;
+    Stopwatch timer;
+    for (long i = 0; i < n; ++i) {
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_real_distribution<double> distrib(0, 1);
+        sum += distrib(gen);
+    }
+    double s = timer.seconds();
+    sink = sum;
+    return 1e9 * s / double(n);
+}
+
+double shared_ns(long n) {
+    std::mt19937 gen(SEED);
+    std::uniform_real_distribution<double> distrib(0, 1);
+    double sum = 0;
+    Stopwatch timer;
+    for (long i = 0; i < n; ++i)
+        sum += distrib(gen);
+    double s = timer.seconds();
+    sink = sum;
+    return 1e9 * s / double(n);
+}
+
+double counter_ns(const std::vector<flecs::entity_t>& entities, std::vector<double>& out) {
+    Stopwatch timer;
+    for (std::size_t i = 0; i < entities.size(); ++i)
+        out[i] = gpecs::CounterRng(SEED, entities[i], 1).uniform();
+    return 1e9 * timer.seconds() / double(entities.size());
+}
+
+double batch_ns(const std::vector<flecs::entity_t>& entities, std::vector<double>& out) {
+    Stopwatch timer;
+    gpecs::uniform_batch(SEED, 1, 0, entities.data(), entities.size(), out.data());
+    return 1e9 * timer.seconds() / double(entities.size());
+}
+
+// Waiting times after `steps` frames on `threads` threads
+std::vector<double> waiting_times(long n, int steps, int threads) {
+    flecs::world world;
+    world.set_threads(threads);
+    for (long i = 0; i < n; ++i)
+        world.entity().set<Waiting>({0.0});
+    world.system<Waiting>()
+        .multi_threaded()
+        .each([](flecs::iter& it, size_t row, Waiting& w) {
+            gpecs::CounterRng rng(SEED, it.entity(row), gpecs::step_of(it));
+            w.tau += rng.exponential(0.5) + 1e-3 * rng.normal();
+        });
+    for (int s = 0; s < steps; ++s)
+        world.progress();
+    std::vector<double> taus;
+    world.each([&taus](const Waiting& w) { taus.push_back(w.tau); });
+    return taus;
+}
+
+}
+
+int bench_rng(int argc, char* argv[]) {
+    // Known answer for Philox4x32-10 with a zero counter and key (Random123)
+    const gpecs::philox::Block kat = gpecs::philox::block({0, 0, 0, 0}, 0, 0);
+    const bool kat_ok = kat == gpecs::philox::Block{0x6627e8d5u, 0xe169c58du, 0xbc57ac4cu, 0x9b00dbd8u};
+    std::printf("[bench-rng] philox_known_answer=%s\n", kat_ok ? "ok" : "FAILED");
+
+    std::printf("[bench-rng] n=10000 device_ns_per_number=%.1f\n", device_ns(10000));
+    for (long n : decades(4, 6, argc, argv)) {
+        std::vector<flecs::entity_t> entities(n);
+        for (long i = 0; i < n; ++i)
+            entities[i] = flecs::entity_t(i + 1000);
+        std::vector<double> scalar(n), batch(n);
+        double counter = counter_ns(entities, scalar);
+        double batched = batch_ns(entities, batch);
+        bool same = std::memcmp(scalar.data(), batch.data(), n * sizeof(double)) == 0;
+        std::printf("[bench-rng] n=%ld shared_ns_per_number=%.2f counter_ns_per_number=%.2f "
+                    "batch_ns_per_number=%.2f batch_matches_scalar=%d\n",
+                    n, shared_ns(n), counter, batched, same ? 1 : 0);
+    }
+
+    std::vector<double> one = waiting_times(100000, 10, 1);
+    std::vector<double> four = waiting_times(100000, 10, 4);
+    bool reproducible = one.size() == four.size() &&
+        std::memcmp(one.data(), four.data(), one.size() * sizeof(double)) == 0;
+    std::printf("[bench-rng] entities=100000 steps=10 threads=1,4 reproducible=%d\n", reproducible ? 1 : 0);
+    return kat_ok && reproducible ? 0 : 1;
+}
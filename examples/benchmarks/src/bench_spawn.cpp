@@ -0,0 +1,62 @@
+/*
+Startup time for building a population of entities.
+
+Compares the way the sketches build populations today (one set<>() per
+component, so every entity moves through a new table on each call) with
+gpecs::BulkSpawner, for 10^4 .. 10^7 entities shaped like the asteroids
+example.
+*/
+
+#include "benchmarks.hpp"
+#include <gpecs/BulkSpawn.hpp>
+#include <flecs.h>
+#include <cstdio>
+
+namespace {
+
+struct Position { double x, y; };
+struct Velocity { double dx, dy; };
+struct Accel    { double ddx, ddy; };
+struct Mass     { double m; };
+struct AsteroidTag {};
+
+double spawn_with_set(long n) {
+    flecs::world world;
+    Stopwatch timer;
+    for (long i = 0; i < n; ++i) {
+        world.entity()
+            .add<AsteroidTag>()
+            .set<Position>({double(i), 0.0})
+            .set<Velocity>({0.0, 0.0})
+            .set<Accel>({0.0, 0.0})
+            .set<Mass>({1.0});
+    }
+    return timer.seconds();
+}
+
+double spawn_with_bulk(long n) {
+    flecs::world world;
+    Stopwatch timer;
+    gpecs::BulkSpawner<Position, Velocity, Accel, Mass>(world)
+        .add<AsteroidTag>()
+        .spawn(n, [](int32_t i, Position& p, Velocity& v, Accel& a, Mass& m) {
+            p = {double(i), 0.0};
+            v = {0.0, 0.0};
+            a = {0.0, 0.0};
+            m = {1.0};
+        });
+    return timer.seconds();
+}
+
+}
+
+int bench_spawn(int argc, char* argv[]) {
+    for (long n : decades(4, 7, argc, argv)) {
+        double set = spawn_with_set(n);
+        double bulk = spawn_with_bulk(n);
+        std::printf("[bench-spawn] n=%ld set_seconds=%.4f bulk_seconds=%.4f "
+                    "set_ns_per_entity=%.1f bulk_ns_per_entity=%.1f speedup=%.2f\n",
+                    n, set, bulk, 1e9 * set / n, 1e9 * bulk / n, set / bulk);
+    }
+    return 0;
+}
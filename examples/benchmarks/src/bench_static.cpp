@@ -0,0 +1,141 @@
+/*
+starter-runge's Runge-Kutta step run as flecs systems and as a
+gpecs::StaticPipeline.
+
+Every oscillator is a mass on a spring, moved by the same four Runge-Kutta
+stages as starter-runge, each followed by a stage working out the
+acceleration, with a once-a-frame function either side like its energy
+tracker: 10 systems, with every stage's components in their own columns.
+flecs' cost per system per frame does not depend on the number of
+entities, so for a few of them it is most of the frame.
+
+Runs 2 .. 2 x 10^6 oscillators, and prints ns/frame both ways, ns per
+oscillator frame and whether the two end in the same places.
+*/
+
+#include "benchmarks.hpp"
+#include <gpecs/StaticPipeline.hpp>
+#include <flecs.h>
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+const double DT = 0.01;
+const long WORK = 2000000;      // oscillator frames per run
+
+struct X0 { double x; };
+struct V0 { double v; };
+struct A0 { double a; };
+struct X1 { double x; };
+struct V1 { double v; };
+struct A1 { double a; };
+struct X2 { double x; };
+struct V2 { double v; };
+struct A2 { double a; };
+struct X3 { double x; };
+struct V3 { double v; };
+struct A3 { double a; };
+struct Spring { double k_over_m; };
+
+struct Run {
+    double ns_per_frame;
+    std::vector<double> positions;
+};
+
+Run run(long oscillators, bool static_pipeline) {
+    flecs::world world;
+    for (long i = 0; i < oscillators; ++i)
+        world.entity()
+            .set<X0>({1.0 + 1e-3 * double(i)}).set<V0>({0.0}).set<A0>({0.0})
+            .set<X1>({0.0}).set<V1>({0.0}).set<A1>({0.0})
+            .set<X2>({0.0}).set<V2>({0.0}).set<A2>({0.0})
+            .set<X3>({0.0}).set<V3>({0.0}).set<A3>({0.0})
+            .set<Spring>({1.0 + 1e-4 * double(i)});
+
+    long frames_started = 0, frames_ended = 0;
+    auto start = [&]() { frames_started += 1; };
+    auto accel0 = [](const X0& x, A0& a, const Spring& s) { a.a = -s.k_over_m * x.x; };
+    auto rk1 = [](const X0& x0, const V0& v0, const A0& a0, X1& x1, V1& v1) {
+        x1.x = x0.x + 0.5 * DT * v0.v;
+        v1.v = v0.v + 0.5 * DT * a0.a;
+    };
+    auto accel1 = [](const X1& x, A1& a, const Spring& s) { a.a = -s.k_over_m * x.x; };
+    auto rk2 = [](const X0& x0, const V0& v0, const V1& v1, const A1& a1, X2& x2, V2& v2) {
+        x2.x = x0.x + 0.5 * DT * v1.v;
+        v2.v = v0.v + 0.5 * DT * a1.a;
+    };
+    auto accel2 = [](const X2& x, A2& a, const Spring& s) { a.a = -s.k_over_m * x.x; };
+    auto rk3 = [](const X0& x0, const V0& v0, const V2& v2, const A2& a2, X3& x3, V3& v3) {
+        x3.x = x0.x + DT * v2.v;
+        v3.v = v0.v + DT * a2.a;
+    };
+    auto accel3 = [](const X3& x, A3& a, const Spring& s) { a.a = -s.k_over_m * x.x; };
+    auto update = [](X0& x0, V0& v0, const A0& a0, const V1& v1, const A1& a1,
+                     const V2& v2, const A2& a2, const V3& v3, const A3& a3) {
+        x0.x += DT / 6 * (v0.v + 2 * v1.v + 2 * v2.v + v3.v);
+        v0.v += DT / 6 * (a0.a + 2 * a1.a + 2 * a2.a + a3.a);
+    };
+    auto end = [&]() { frames_ended += 1; };
+
+    const long frames = std::max(100L, WORK / oscillators);
+    Stopwatch timer;
+    if (static_pipeline) {
+        gpecs::StaticPipeline pipeline(world,
+            gpecs::stage(start),
+            gpecs::stage<const X0, A0, const Spring>(accel0),
+            gpecs::stage<const X0, const V0, const A0, X1, V1>(rk1),
+            gpecs::stage<const X1, A1, const Spring>(accel1),
+            gpecs::stage<const X0, const V0, const V1, const A1, X2, V2>(rk2),
+            gpecs::stage<const X2, A2, const Spring>(accel2),
+            gpecs::stage<const X0, const V0, const V2, const A2, X3, V3>(rk3),
+            gpecs::stage<const X3, A3, const Spring>(accel3),
+            gpecs::stage<X0, V0, const A0, const V1, const A1, const V2, const A2,
+                         const V3, const A3>(update),
+            gpecs::stage(end));
+        timer = Stopwatch();
+        for (long f = 0; f < frames; ++f)
+            pipeline.progress();
+    } else {
+        world.system<>().run([&](flecs::iter&) { start(); });
+        world.system<const X0, A0, const Spring>().each(accel0);
+        world.system<const X0, const V0, const A0, X1, V1>().each(rk1);
+        world.system<const X1, A1, const Spring>().each(accel1);
+        world.system<const X0, const V0, const V1, const A1, X2, V2>().each(rk2);
+        world.system<const X2, A2, const Spring>().each(accel2);
+        world.system<const X0, const V0, const V2, const A2, X3, V3>().each(rk3);
+        world.system<const X3, A3, const Spring>().each(accel3);
+        world.system<X0, V0, const A0, const V1, const A1, const V2, const A2,
+                     const V3, const A3>().each(update);
+        world.system<>().run([&](flecs::iter&) { end(); });
+        timer = Stopwatch();
+        for (long f = 0; f < frames; ++f)
+            world.progress();
+    }
+    Run result { 1e9 * timer.seconds() / double(frames), {} };
+    if (frames_started != frames || frames_ended != frames)
+        return result;
+    world.each([&result](const X0& x) { result.positions.push_back(x.x); });
+    return result;
+}
+
+}
+
+int bench_static(int argc, char* argv[]) {
+    bool all_same = true;
+    for (long decade : decades(0, 6, argc, argv)) {
+        const long n = 2 * decade;
+        Run flecs_run = run(n, false);
+        Run static_run = run(n, true);
+        bool same = !flecs_run.positions.empty() && flecs_run.positions == static_run.positions;
+        all_same = all_same && same;
+        std::printf("[bench-static] oscillators=%ld flecs_ns_per_frame=%.0f static_ns_per_frame=%.0f "
+                    "flecs_ns_per_oscillator_frame=%.2f static_ns_per_oscillator_frame=%.2f "
+                    "speedup=%.2f same=%d\n",
+                    n, flecs_run.ns_per_frame, static_run.ns_per_frame,
+                    flecs_run.ns_per_frame / double(n), static_run.ns_per_frame / double(n),
+                    flecs_run.ns_per_frame / static_run.ns_per_frame, same ? 1 : 0);
+    }
+    return all_same ? 0 : 1;
+}
@@ -0,0 +1,216 @@
+/*
+Uneven systems on flecs' even split, and with gpecs::WorkStealing.
+
+Two neighbour searches whose cost per entity follows the local density,
+with the dense entities spawned first so they land in the first workers'
+slices:
+  knn  - asteroids_knn's force: the K nearest of the asteroids in the 3x3
+         cells around each one, half of the asteroids in one tight cluster
+  sph  - an SPH density sum over the particles within 2h, on a dam break:
+         half of the particles in a water column in the left fifth of the
+         box, the other half vapour spread over the rest
+
+Each runs on 1, 2 and 4 threads with .multi_threaded().each() and with
+WorkStealing, and prints ms/frame for both, the share of the work the most
+loaded worker gets from the even split (1 = balanced, 4 = all of it on
+4 threads), the ranges stolen, and whether both give the same numbers.
+*/
+
+#include "benchmarks.hpp"
+#include <gpecs/WorkStealing.hpp>
+#include <flecs.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+const int FRAMES = 5;
+
+struct Position { double x, y; };
+struct Result { double x, y; };
+
+// Positions in spawn order, binned in a uniform grid
+struct Cloud {
+    double width, height;
+    int gx, gy;
+    std::vector<Position> positions;
+    std::vector<std::vector<int>> bins;
+
+    int cell(const Position& p) const {
+        int cx = std::clamp(int(p.x / width * gx), 0, gx - 1);
+        int cy = std::clamp(int(p.y / height * gy), 0, gy - 1);
+        return cy * gx + cx;
+    }
+    void bin() {
+        bins.assign(gx * gy, {});
+        for (int i = 0; i < (int)positions.size(); ++i)
+            bins[cell(positions[i])].push_back(i);
+    }
+    // Indices of the points in the 3x3 cells around p (no wrap)
+    template <typename Visit>
+    void around(const Position& p, Visit&& visit) const {
+        int c = cell(p), cx = c % gx, cy = c / gx;
+        for (int y = std::max(0, cy - 1); y <= std::min(gy - 1, cy + 1); ++y)
+            for (int x = std::max(0, cx - 1); x <= std::min(gx - 1, cx + 1); ++x)
+                for (int j : bins[y * gx + x])
+                    visit(j);
+    }
+};
+
+Cloud knn_cloud(long n) {
+    Cloud cloud {80.0, 40.0, 5, 5, {}, {}};
+    std::mt19937 rng(42);
+    std::normal_distribution<double> cluster(0.0, 1.5);
+    std::uniform_real_distribution<double> ux(0.0, cloud.width), uy(0.0, cloud.height);
+    for (long i = 0; i < n; ++i) {
+        if (i < n / 2)
+            cloud.positions.push_back({std::clamp(20.0 + cluster(rng), 0.0, cloud.width),
+                                       std::clamp(20.0 + cluster(rng), 0.0, cloud.height)});
+        else
+            cloud.positions.push_back({ux(rng), uy(rng)});
+    }
+    cloud.bin();
+    return cloud;
+}
+
+const double SPH_H = 0.5;
+
+Cloud sph_cloud(long n) {
+    // Cells of 2h so the 3x3 around a particle hold all of its neighbours
+    Cloud cloud {50.0, 10.0, int(50.0 / (2 * SPH_H)), int(10.0 / (2 * SPH_H)), {}, {}};
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> water(0.0, cloud.width / 5), vapour(cloud.width / 5, cloud.width);
+    std::uniform_real_distribution<double> uy(0.0, cloud.height);
+    for (long i = 0; i < n; ++i)
+        cloud.positions.push_back({i < n / 2 ? water(rng) : vapour(rng), uy(rng)});
+    std::sort(cloud.positions.begin(), cloud.positions.end(),
+              [](const Position& a, const Position& b) { return a.x < b.x; });
+    cloud.bin();
+    return cloud;
+}
+
+const int K = 10;
+
+// Sum of the pull of the K nearest neighbours, and how many were looked at
+Result knn_force(const Cloud& cloud, int self, const Position& p, long& visited) {
+    std::vector<std::pair<double, int>> near;
+    cloud.around(p, [&](int j) {
+        if (j == self) return;
+        double dx = cloud.positions[j].x - p.x, dy = cloud.positions[j].y - p.y;
+        near.emplace_back(dx * dx + dy * dy, j);
+    });
+    visited += long(near.size());
+    if ((int)near.size() > K) {
+        std::nth_element(near.begin(), near.begin() + K, near.end());
+        near.resize(K);
+    }
+    Result f {0.0, 0.0};
+    for (auto& [d2, j] : near) {
+        double inv_r = 1.0 / std::sqrt(d2 + 1e-4);
+        f.x += (cloud.positions[j].x - p.x) * inv_r * inv_r * inv_r;
+        f.y += (cloud.positions[j].y - p.y) * inv_r * inv_r * inv_r;
+    }
+    return f;
+}
+
+// Cubic spline density, and how many were looked at
+Result sph_density(const Cloud& cloud, int, const Position& p, long& visited) {
+    Result rho {0.0, 0.0};
+    cloud.around(p, [&](int j) {
+        ++visited;
+        double dx = cloud.positions[j].x - p.x, dy = cloud.positions[j].y - p.y;
+        double q = std::sqrt(dx * dx + dy * dy) / SPH_H;
+        if (q < 1.0) rho.x += 1.0 - 1.5 * q * q + 0.75 * q * q * q;
+        else if (q < 2.0) rho.x += 0.25 * (2.0 - q) * (2.0 - q) * (2.0 - q);
+        rho.y += 1.0;
+    });
+    return rho;
+}
+
+using Kernel = Result (*)(const Cloud&, int, const Position&, long&);
+
+struct Index { int i; };
+
+struct Run {
+    double ms_per_frame;
+    long steals;
+    std::vector<Result> results;
+};
+
+Run run(const Cloud& cloud, Kernel kernel, int threads, bool stealing) {
+    flecs::world world;
+    if (threads > 1)
+        world.set_threads(threads);
+    for (int i = 0; i < (int)cloud.positions.size(); ++i)
+        world.entity().set<Position>(cloud.positions[i]).set<Index>({i}).set<Result>({0.0, 0.0});
+
+    gpecs::WorkStealing steal(world);
+    auto update = [&cloud, kernel](const Position& p, const Index& index, Result& r) {
+        long visited = 0;
+        r = kernel(cloud, index.i, p, visited);
+    };
+    auto system = world.system<const Position, const Index, Result>().multi_threaded();
+    if (stealing)
+        system.run(steal.each(update));
+    else
+        system.each(update);
+
+    world.progress();   // warm up
+    Stopwatch timer;
+    for (int f = 0; f < FRAMES; ++f)
+        world.progress();
+    Run result {1e3 * timer.seconds() / FRAMES, 0, std::vector<Result>(cloud.positions.size())};
+    for (int w = 0; w < steal.workers(); ++w)
+        result.steals += steal.stats(w).steals;
+    world.each([&result](const Index& index, const Result& r) { result.results[index.i] = r; });
+    return result;
+}
+
+// The most loaded worker's share of the work under flecs' even split, times
+// the number of workers (all entities are in one table)
+double split_imbalance(const Cloud& cloud, Kernel kernel, int threads) {
+    std::vector<long> cost(cloud.positions.size());
+    for (int i = 0; i < (int)cost.size(); ++i)
+        kernel(cloud, i, cloud.positions[i], cost[i]);
+    long n = long(cost.size()), per = n / threads, extra = n % threads, first = 0, total = 0, most = 0;
+    for (int t = 0; t < threads; ++t) {
+        long count = per + (t < extra), work = 0;
+        for (long i = first; i < first + count; ++i)
+            work += cost[i];
+        first += count;
+        total += work;
+        most = std::max(most, work);
+    }
+    return total ? double(most) * threads / double(total) : 1.0;
+}
+
+}
+
+int bench_steal(int argc, char* argv[]) {
+    struct Workload { const char* name; Cloud (*cloud)(long); Kernel kernel; };
+    const Workload workloads[] = { { "knn", knn_cloud, knn_force }, { "sph", sph_cloud, sph_density } };
+    bool all_same = true;
+    for (const Workload& workload : workloads) {
+        for (long n : decades(3, 3, argc, argv)) {
+            const Cloud cloud = workload.cloud(n);
+            for (int threads : {1, 2, 4}) {
+                Run even = run(cloud, workload.kernel, threads, false);
+                Run stolen = run(cloud, workload.kernel, threads, true);
+                bool same = std::memcmp(even.results.data(), stolen.results.data(),
+                                        even.results.size() * sizeof(Result)) == 0;
+                all_same = all_same && same;
+                std::printf("[bench-steal] workload=%s n=%ld threads=%d split_imbalance=%.2f "
+                            "even_ms_per_frame=%.3f stealing_ms_per_frame=%.3f speedup=%.2f "
+                            "steals_per_frame=%.1f same=%d\n",
+                            workload.name, n, threads, split_imbalance(cloud, workload.kernel, threads),
+                            even.ms_per_frame, stolen.ms_per_frame, even.ms_per_frame / stolen.ms_per_frame,
+                            double(stolen.steals) / (FRAMES + 1), same ? 1 : 0);
+            }
+        }
+    }
+    return all_same ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+/*
+Throughput of the examples' CSV output.
+
+Writes the same rows of doubles (values like the fluid example's fields,
+501 per row like unsteady_scalar) three ways:
+  ofstream  - std::ofstream << double, as the examples did
+  text      - gpecs::TextWriter, same 6 digit output
+  shortest  - gpecs::TextWriter with the shortest round trip digits
+
+Prints the output rate in MB/s and values per second for 10^4 .. 10^7
+values, and checks that the TextWriter's file is byte for byte the same as
+the ofstream's.
+*/
+
+#include "benchmarks.hpp"
+#include <gpecs/TextWriter.hpp>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+const int ROW = 501;
+
+std::vector<double> values(long n) {
+    std::mt19937 gen(42);
+    std::normal_distribution<double> dist(1.0, 0.05);
+    std::vector<double> v(n);
+    for (long i = 0; i < n; ++i)
+        v[i] = (i % 7 == 0) ? 0.0 : dist(gen) * ((i % 3 == 0) ? 1e-4 : 1.0);
+    return v;
+}
+
+template <typename Out>
+void rows(Out& out, const std::vector<double>& v) {
+    for (std::size_t i = 0; i < v.size(); ++i) {
+        out << v[i];
+        if ((i + 1) % ROW == 0 || i + 1 == v.size())
+            out << "\n";
+        else
+            out << ", ";
+    }
+}
+
+long file_size(const std::string& path) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    return static_cast<long>(in.tellg());
+}
+
+std::string contents(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// Seconds to write `v` to `path` with `how`
+double timed(const std::string& path, const std::vector<double>& v, const char* how) {
+    Stopwatch timer;
+    if (std::string(how) == "ofstream") {
+        std::ofstream out(path);
+        rows(out, v);
+    } else {
+        gpecs::TextWriter out(path);
+        if (std::string(how) == "shortest")
+            out.precision(gpecs::TextWriter::SHORTEST);
+        rows(out, v);
+    }
+    return timer.seconds();
+}
+
+}
+
+int bench_text(int argc, char* argv[]) {
+    const std::string a = "bench_text_ofstream.csv", b = "bench_text_writer.csv", c = "bench_text_shortest.csv";
+    bool identical = true;
+    for (long n : decades(4, 7, argc, argv)) {
+        const std::vector<double> v = values(n);
+        const double ofs = timed(a, v, "ofstream");
+        const double text = timed(b, v, "text");
+        const double shortest = timed(c, v, "shortest");
+        const bool same = contents(a) == contents(b);
+        identical = identical && same;
+        std::printf("[bench-text] values=%ld ofstream_MB_s=%.1f text_MB_s=%.1f shortest_MB_s=%.1f "
+                    "ofstream_Mvalues_s=%.2f text_Mvalues_s=%.2f shortest_Mvalues_s=%.2f "
+                    "speedup=%.2f identical=%d\n",
+                    n, file_size(a) / ofs / 1e6, file_size(b) / text / 1e6, file_size(c) / shortest / 1e6,
+                    n / ofs / 1e6, n / text / 1e6, n / shortest / 1e6, ofs / text, same ? 1 : 0);
+    }
+    std::remove(a.c_str());
+    std::remove(b.c_str());
+    std::remove(c.c_str());
+    return identical ? 0 : 1;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+// Each benchmark is a function taking the arguments that follow its name
+int bench_spawn(int argc, char* argv[]);
+int bench_churn(int argc, char* argv[]);
+int bench_rng(int argc, char* argv[]);
+int bench_text(int argc, char* argv[]);
+int bench_examples(int argc, char* argv[]);
+int bench_steal(int argc, char* argv[]);
+int bench_concurrent(int argc, char* argv[]);
+int bench_fusion(int argc, char* argv[]);
+int bench_events(int argc, char* argv[]);
+int bench_driver(int argc, char* argv[]);
+int bench_static(int argc, char* argv[]);
+int bench_multirate(int argc, char* argv[]);
+int bench_arena(int argc, char* argv[]);
+
+// Wall clock timing for benchmark sections
+class Stopwatch {
+  public:
+    Stopwatch() : start_(Clock::now()) { }
+    double seconds() const {
+        return std::chrono::duration<double>(Clock::now() - start_).count();
+    }
+  private:
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start_;
+};
+
+// Problem sizes 10^lo .. 10^hi, with hi overridable from the command line
+inline std::vector<long> decades(int lo, int hi, int argc, char* argv[]) {
+    if (argc > 0)
+        hi = std::atoi(argv[0]);
+    std::vector<long> sizes;
+    long n = 1;
+    for (int i = 0; i < lo; ++i)
+        n *= 10;
+    for (int i = lo; i <= hi; ++i, n *= 10)
+        sizes.push_back(n);
+    return sizes;
+}
@@ -0,0 +1,47 @@
+/*
+Micro-benchmarks for the gpecs helpers.
+
+Usage: ecs_application <benchmark> [options]
+*/
+
+#include "benchmarks.hpp"
+#include <cstdio>
+#include <cstring>
+
+struct Benchmark {
+    const char* name;
+    int (*run)(int argc, char* argv[]);
+    const char* help;
+};
+
+const Benchmark BENCHMARKS[] = {
+    { "spawn", bench_spawn, "[max decade] - startup time, set<>() chains vs bulk spawn" },
+    { "churn", bench_churn, "[max decade] - tag add/remove churn vs a field, with the churn report" },
+    { "rng",   bench_rng,   "[max decade] - mt19937 vs counter-based random numbers, and thread reproducibility" },
+    { "text",  bench_text,  "[max decade] - CSV output MB/s, std::ofstream vs gpecs::TextWriter" },
+    { "steal", bench_steal, "[max decade] - uneven kNN and SPH systems, flecs' even split vs gpecs::WorkStealing" },
+    { "concurrent", bench_concurrent, "[max decade] - 2DrandomWalk's nine move phases in order vs gpecs::ConcurrentSystems" },
+    { "fusion", bench_fusion, "[max decade] - fluid-me's last Runge-Kutta stage and update, apart vs fused by gpecs::SystemFusion" },
+    { "events", bench_events, "[max decade] - the Markov chain's counters updated in place vs through gpecs::EventQueue" },
+    { "driver", bench_driver, "[max decade] - a step loop writing a density grid in turn vs in the background with gpecs::Driver" },
+    { "static", bench_static, "[max decade] - starter-runge's Runge-Kutta step as flecs systems vs a gpecs::StaticPipeline" },
+    { "multirate", bench_multirate, "[max decade] - an O(N^2) time step check every step vs every k steps with gpecs::Multirate" },
+    { "arena", bench_arena, "[max decade] - asteroids_knn's per-asteroid scratch vectors from the heap vs a gpecs::FrameArena" },
+    { "examples", bench_examples, "[max decade] [--repo DIR] [--build DIR] [--json FILE] [--only NAME] - "
+                                  "steps/s, ns/entity update, peak RSS and J/step of the examples, to JSON" },
+};
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        for (const Benchmark& b : BENCHMARKS) {
+            if (std::strcmp(argv[1], b.name) == 0) {
+                return b.run(argc - 2, argv + 2);
+            }
+        }
+    }
+    std::printf("Usage: %s <benchmark> [options]\n\nBenchmarks:\n", argv[0]);
+    for (const Benchmark& b : BENCHMARKS) {
+        std::printf("  %-12s %s\n", b.name, b.help);
+    }
+    return 1;
+}
@@ -5,7 +5,7 @@ solved analytically.
 
 #include <iostream>
 #include <vector>
-#include <fstream> 
+#include <gpecs/TextWriter.hpp>
 #include <flecs.h>
 #include <systems.h>
 
@@ -84,7 +84,7 @@ void print_matrix(std::vector<std::vector<double>> matrix)
 
 int main(int argc, char* argv[]) {
     // Prepare Save File
-    std::ofstream MyFile; 
+    gpecs::TextWriter MyFile; 
     MyFile.open("starter_fluid.txt");
     if (!MyFile.is_open())
     {
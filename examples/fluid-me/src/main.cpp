@@ -4,8 +4,21 @@ This code looks at the dynamical evolution of a compressible
 */
 
 #include <custom_phases_no_builtin.h>
+#include <gpecs/BulkSpawn.hpp>
+#include <gpecs/Checkpoint.hpp>
+#include <gpecs/ColumnFile.hpp>
+#include <gpecs/MemoryReport.hpp>
+#include <gpecs/PerfCounters.hpp>
+#include <gpecs/Profiler.hpp>
+#include <gpecs/SnapshotWriter.hpp>
+#include <gpecs/StencilCache.hpp>
+#include <gpecs/SystemFusion.hpp>
+#include <gpecs/TextWriter.hpp>
+#include <gpecs/Threads.hpp>
 #include <iostream>
-#include <fstream> 
+#include <memory>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
 // Number of nodes in x-axis. Also equal to the length in unit of node distance
@@ -26,10 +39,15 @@ const double M = 0.0290; // Molar mass of air
 
 const double L = 2 * Nx; // Box length in units of node distance
 const double W = 2 * Ny + Nh; // Box width in units of node distance
+const int NodesY = 2 * Ny + Nh; // Number of nodes in a column
 
 const double RhoLeft = 1.292;
 const double RhoRight = 1; // Make density in right box less than left box
 
+// Saved in checkpoints, so a restart with different constants is refused
+struct Parameters { int nx, ny, nh; double timestep; int steps; double rhoLeft, rhoRight; };
+const Parameters PARAMETERS = {Nx, Ny, Nh, TIMESTEP, NUMBERSTEPS, RhoLeft, RhoRight};
+
 // Position Components
 struct Position {int x, y; }; // Node position in units of node distance and offset by + 1/2
 
@@ -57,6 +75,36 @@ struct UpperWall {}; // This component indicates the node has a wall above it
 struct LeftWall {};  // This component indicates the node has a wall left of it 
 struct RightWall {}; // This component indicates the node has a wall right of it 
 
+// Neighbour slots in the stencil cache
+enum Slot { UP, DOWN, RIGHT, LEFT, SLOTS };
+using Stencil = gpecs::StencilCache<SLOTS>;
+
+// Velocities and densities seen by a node in each neighbour slot. At a wall
+// the node sees itself with the velocity normal to the wall reversed.
+struct Neighbours {
+    double horizontal[SLOTS];
+    double vertical[SLOTS];
+    double density[SLOTS];
+};
+
+template <typename Velocity, typename Density>
+Neighbours gather_neighbours(const Stencil& stencil, const Stencil::Column<Velocity>& velocity,
+    const Stencil::Column<Density>& density, std::size_t node)
+{
+    Neighbours nb;
+    for (int slot : {UP, DOWN}) {
+        nb.horizontal[slot] = velocity(node, slot).x;
+        nb.vertical[slot] = stencil.sign(node, slot) * velocity(node, slot).y;
+        nb.density[slot] = density(node, slot).rho;
+    }
+    for (int slot : {RIGHT, LEFT}) {
+        nb.horizontal[slot] = stencil.sign(node, slot) * velocity(node, slot).x;
+        nb.vertical[slot] = velocity(node, slot).y;
+        nb.density[slot] = density(node, slot).rho;
+    }
+    return nb;
+}
+
 double u_function(double u, double u_right, double u_left, double u_up, 
     double u_down, double v, double rho, double rho_right, double rho_left)
 {
@@ -104,7 +152,7 @@ double rho_function(double rho_right, double rho_left, double rho_up, double rho
 int main(int argc, char *argv[]) {
     
     // Create specifactions file
-    std::ofstream Specs;
+    gpecs::TextWriter Specs;
     Specs.open("specs.txt");
     // Column titles
     Specs << "Box Length, Box Width, Hole Width, time step, number of files, Density 1, Density 2" << "\n";
@@ -115,79 +163,150 @@ int main(int argc, char *argv[]) {
 
     // Create World
     flecs::world world(argc, argv);
+    gpecs::use_threads(world, argc, argv);
+    auto profiler = gpecs::profile_from_args(world, argc, argv);
+    auto perf = gpecs::perf_from_args(world, argc, argv);
+    auto memory = gpecs::memory_from_args(world, argc, argv);
+
+    // `--checkpoint PATH --checkpoint-every K` saves the nodes every K steps
+    // and on SIGTERM; `--restart PATH` carries on from a saved step (see
+    // include/gpecs/Checkpoint.hpp)
+    const gpecs::CheckpointOptions checkpoints = gpecs::checkpoint_from_args(argc, argv);
+
+    // `--columns PATH` saves every snapshot to one column file (see
+    // include/gpecs/ColumnFile.hpp) instead of the .txt files
+    std::unique_ptr<gpecs::ColumnWriter> columns;
+    std::string columnsPath;
+    gpecs::take_option(argc, argv, "--columns", columnsPath);
 
     // Creates Phases which tell the program in which order to run the systems
-    flecs::entity RungeKutta_1 = world.entity()
+    flecs::entity RungeKutta_1 = world.entity("RungeKutta_1")
         .add(flecs::Phase); // This Phase calculates phihalf_predict
     
-    flecs::entity RungeKutta_2 = world.entity()
+    flecs::entity RungeKutta_2 = world.entity("RungeKutta_2")
         .add(flecs::Phase) // This Phase calculates phihalf_correct
         .depends_on(RungeKutta_1);
     
-    flecs::entity RungeKutta_3 = world.entity()
+    flecs::entity RungeKutta_3 = world.entity("RungeKutta_3")
         .add(flecs::Phase) // This Phase calculates phi_end_predict
         .depends_on(RungeKutta_2);
 
-    flecs::entity RungeKutta_4 = world.entity()
+    flecs::entity RungeKutta_4 = world.entity("RungeKutta_4")
         .add(flecs::Phase) // This Phase calculates phi_end_correct
         .depends_on(RungeKutta_3);
     
-    flecs::entity Update = world.entity()
+    flecs::entity Update = world.entity("Update")
         .add(flecs::Phase) // This phase replaces phi_start with phi_end_correct
         .depends_on(RungeKutta_4);
     
-    // Create components inside the world
-    world.component<Position>();
+    // Create components inside the world, with their members so --memory
+    // can show padding
+    world.component<Position>().member("x", &Position::x).member("y", &Position::y);
 
     // Velocity Components
-    world.component<VelocityStart>();
-    world.component<VelocityHalfPredict>();
-    world.component<VelocityHalfCorrect>();
-    world.component<VelocityEndPredict>();
+    world.component<VelocityStart>().member("x", &VelocityStart::x).member("y", &VelocityStart::y);
+    world.component<VelocityHalfPredict>().member("x", &VelocityHalfPredict::x).member("y", &VelocityHalfPredict::y);
+    world.component<VelocityHalfCorrect>().member("x", &VelocityHalfCorrect::x).member("y", &VelocityHalfCorrect::y);
+    world.component<VelocityEndPredict>().member("x", &VelocityEndPredict::x).member("y", &VelocityEndPredict::y);
 
     // Density Components
-    world.component<DensityStart>();
-    world.component<DensityHalfPredict>();
-    world.component<DensityHalfCorrect>();
-    world.component<DensityEndPredict>();
+    world.component<DensityStart>().member("rho", &DensityStart::rho);
+    world.component<DensityHalfPredict>().member("rho", &DensityHalfPredict::rho);
+    world.component<DensityHalfCorrect>().member("rho", &DensityHalfCorrect::rho);
+    world.component<DensityEndPredict>().member("rho", &DensityEndPredict::rho);
 
     // Wall Tags
     struct LowerWall {}; // This component indicates the node has a wall below it
     struct UpperWall {}; // This component indicates the node has a wall above it 
     struct LeftWall {};  // This component indicates the node has a wall left of it 
     struct RightWall {}; // This component indicates the node has a wall right of it 
+    world.component<LowerWall>();
+    world.component<UpperWall>();
+    world.component<LeftWall>();
+    world.component<RightWall>();
 
     // Runge-Kutta Components
-    world.component<FunctionsFirst>();
-    world.component<FunctionsSecond>();
-    world.component<FunctionsThird>();
-    world.component<FunctionsFourth>();
+    world.component<FunctionsFirst>().member("u", &FunctionsFirst::u).member("v", &FunctionsFirst::v).member("rho", &FunctionsFirst::rho);
+    world.component<FunctionsSecond>().member("u", &FunctionsSecond::u).member("v", &FunctionsSecond::v).member("rho", &FunctionsSecond::rho);
+    world.component<FunctionsThird>().member("u", &FunctionsThird::u).member("v", &FunctionsThird::v).member("rho", &FunctionsThird::rho);
+    world.component<FunctionsFourth>().member("u", &FunctionsFourth::u).member("v", &FunctionsFourth::v).member("rho", &FunctionsFourth::rho);
 
     std::vector<std::vector<flecs::entity>> nodes; // place to store nodes
     nodes.reserve(Nx*Ny); // Create the space
     
-    // Create non-boundary Nodes
+    std::vector<flecs::entity> flatNodes;
+    int firstStep = 0;
+    if (checkpoints.restarting()) {
+        // Load the nodes, walls and all, and put them back in grid order
+        try {
+            const gpecs::Checkpoint cp = gpecs::load_checkpoint(world, checkpoints.restart);
+            if (!cp.same("parameters", PARAMETERS))
+                throw std::runtime_error(checkpoints.restart + " was saved with different parameters");
+            firstStep = cp.step + 1;
+        } catch (const std::exception& e) {
+            std::cout << e.what() << std::endl;
+            return 1;
+        }
+        flatNodes.resize(2*Nx*NodesY);
+        world.each([&](flecs::entity node, const Position& pos) {
+            flatNodes[pos.x*NodesY + pos.y] = node;
+        });
+    } else {
+        // Create every node straight into its final table, then tag the walls
+        flatNodes = gpecs::BulkSpawner<Position,
+                VelocityStart, VelocityHalfPredict, VelocityHalfCorrect, VelocityEndPredict,
+                DensityStart, DensityHalfPredict, DensityHalfCorrect, DensityEndPredict,
+                FunctionsFirst, FunctionsSecond, FunctionsThird, FunctionsFourth>(world)
+            .spawn(2*Nx*NodesY, [](int32_t i, Position& pos, VelocityStart& velocityStart,
+                    VelocityHalfPredict& velocityHalfPredict, VelocityHalfCorrect& velocityHalfCorrect,
+                    VelocityEndPredict& velocityEndPredict, DensityStart& densityStart,
+                    DensityHalfPredict& densityHalfPredict, DensityHalfCorrect& densityHalfCorrect,
+                    DensityEndPredict& densityEndPredict, FunctionsFirst& f1, FunctionsSecond& f2,
+                    FunctionsThird& f3, FunctionsFourth& f4) {
+                pos = {i / NodesY, i % NodesY};
+                velocityStart = {0, 0};
+                velocityHalfPredict = {0, 0};
+                velocityHalfCorrect = {0, 0};
+                velocityEndPredict = {0, 0};
+                densityStart = {pos.x < Nx ? RhoLeft : RhoRight};
+                densityHalfPredict = {0};
+                densityHalfCorrect = {0};
+                densityEndPredict = {0};
+                f1 = {0, 0, 0};
+                f2 = {0, 0, 0};
+                f3 = {0, 0, 0};
+                f4 = {0, 0, 0};
+            });
+    }
+
+    // A restarted run carries on the column file from the restored step,
+    // keeping the frames saved before it
+    if (!columnsPath.empty()) {
+        try {
+            std::vector<gpecs::ColumnSpec> schema{
+                gpecs::column_spec<double>("horizontal"),
+                gpecs::column_spec<double>("vertical"),
+                gpecs::column_spec<double>("density")};
+            if (checkpoints.restarting()) {
+                columns = std::make_unique<gpecs::ColumnWriter>(columnsPath, std::move(schema), firstStep);
+            } else {
+                columns = std::make_unique<gpecs::ColumnWriter>(columnsPath, std::move(schema));
+            }
+        } catch (const std::exception& e) {
+            std::cout << e.what() << std::endl;
+            return 1;
+        }
+    }
+
     for (int n = 0; n < 2*Nx; ++n) {
         nodes.push_back({});
         for (int m = 0; m < (2*Ny + Nh); ++m) {
-            nodes[n].push_back(
-                world.entity()
-                    .set<Position>({n, m})
-                    .set<VelocityStart>({0, 0})
-                    .set<VelocityHalfPredict>({0, 0})
-                    .set<VelocityHalfCorrect>({0, 0})
-                    .set<VelocityEndPredict>({0, 0})
-                    .set<DensityHalfPredict>({0})
-                    .set<DensityHalfCorrect>({0})
-                    .set<DensityEndPredict>({0})
-                    .set<FunctionsFirst>({0, 0, 0})
-                    .set<FunctionsSecond>({0, 0, 0})
-                    .set<FunctionsThird>({0, 0, 0})
-                    .set<FunctionsFourth>({0, 0, 0})
-            );
+            nodes[n].push_back(flatNodes[n*NodesY + m]);
+            if (checkpoints.restarting()) {
+                continue; // The walls were restored with the nodes
+            }
 
             if (n < Nx) {
-                nodes[n][m].set<DensityStart>({RhoLeft});
                 if (n == 0) {
                     nodes[n][m].add<LeftWall>();
                 }
@@ -204,7 +323,6 @@ int main(int argc, char *argv[]) {
                     nodes[n][m].add<RightWall>();
                 }
             } else {
-                nodes[n][m].set<DensityStart>({RhoRight});
                 if (n == L-1) {
                     nodes[n][m].add<RightWall>();
                 }
@@ -223,380 +341,231 @@ int main(int argc, char *argv[]) {
             }  
         }
     }
+
+    // With --pin, moves each worker's share of the nodes to its NUMA node
+    gpecs::place_tables(world);
     
+    // Resolve each node's neighbours once, rather than checking wall tags and
+    // looking neighbours up on every stage of every step
+    Stencil stencil(world, flatNodes, [&](std::size_t node, int slot) -> std::ptrdiff_t {
+        const int n = node / NodesY;
+        const int m = node % NodesY;
+        switch (slot) {
+            case UP:    return nodes[n][m].has<UpperWall>() ? Stencil::WALL : node + 1;
+            case DOWN:  return nodes[n][m].has<LowerWall>() ? Stencil::WALL : node - 1;
+            case RIGHT: return nodes[n][m].has<RightWall>() ? Stencil::WALL : node + NodesY;
+            default:    return nodes[n][m].has<LeftWall>()  ? Stencil::WALL : node - NodesY;
+        }
+    });
+    auto velocityStartNb = stencil.column<VelocityStart>();
+    auto velocityHalfPredictNb = stencil.column<VelocityHalfPredict>();
+    auto velocityHalfCorrectNb = stencil.column<VelocityHalfCorrect>();
+    auto velocityEndPredictNb = stencil.column<VelocityEndPredict>();
+    auto densityStartNb = stencil.column<DensityStart>();
+    auto densityHalfPredictNb = stencil.column<DensityHalfPredict>();
+    auto densityHalfCorrectNb = stencil.column<DensityHalfCorrect>();
+    auto densityEndPredictNb = stencil.column<DensityEndPredict>();
+
+    // Each Runge-Kutta stage reads its neighbours' values from the stage
+    // before, so with --threads every worker has to finish a stage before
+    // any of them start the next one
+    gpecs::sync_point(world, RungeKutta_2);
+    gpecs::sync_point(world, RungeKutta_3);
+    gpecs::sync_point(world, RungeKutta_4);
+
+    // Rebuilds the neighbour cache if the node tables have changed
+    world.system<>()
+        .kind(RungeKutta_1)
+        .run([&](flecs::iter&){
+            stencil.refresh();
+        });
+
     // This system finds and updates VelocityHalfPredict and DensityHalfPredict
     world.system<Position, VelocityStart, VelocityHalfPredict, DensityStart, 
                  DensityHalfPredict, FunctionsFirst>()
         .kind(RungeKutta_1)
+        .multi_threaded()
         .each([&](Position& pos, VelocityStart& velocityStart, VelocityHalfPredict& velocityHalf, 
                   DensityStart& densityStart, DensityHalfPredict& densityHalf, 
                   FunctionsFirst& function){
             
-            // Initialise Neighbour Node Variables
-            double horizontalUp; // These are the neighbour horizontal velocities
-            double horizontalDown;
-            double horizontalRight;
-            double horizontalLeft;
-
-            double verticalUp; // These are the neighbour vertical velocities
-            double verticalDown;
-            double verticalRight;
-            double verticalLeft;
-
-            double densityUp; // These are the neighbour densities
-            double densityDown;
-            double densityRight;
-            double densityLeft;
-
-            // Ensure upper wall boundary conditions if necessary
-            if (nodes[pos.x][pos.y].has<UpperWall>()) {
-                horizontalUp = velocityStart.x;
-                verticalUp = -velocityStart.y;
-                densityUp = densityStart.rho;
-            } else {
-                const VelocityStart& velUp = nodes[pos.x][pos.y+1].get<VelocityStart>();
-                const DensityStart& denUp = nodes[pos.x][pos.y+1].get<DensityStart>();
-                horizontalUp = velUp.x;
-                verticalUp = velUp.y;
-                densityUp = denUp.rho;
-            }
-            // Ensure lower wall boundary conditions if necessary
-            if (nodes[pos.x][pos.y].has<LowerWall>()) {
-                horizontalDown = velocityStart.x;
-                verticalDown = -velocityStart.y;
-                densityDown = densityStart.rho;
-            } else {
-                const VelocityStart& velDown = nodes[pos.x][pos.y-1].get<VelocityStart>();
-                const DensityStart& denDown = nodes[pos.x][pos.y-1].get<DensityStart>();
-                horizontalDown = velDown.x;
-                verticalDown = velDown.y;
-                densityDown = denDown.rho;
-            }
-
-            // Ensure right wall boundary conditions if necessary
-            if (nodes[pos.x][pos.y].has<RightWall>()) {
-                horizontalRight = -velocityStart.x;
-                verticalRight = velocityStart.y;
-                densityRight = densityStart.rho;
-            } else {
-                const VelocityStart& velRight = nodes[pos.x+1][pos.y].get<VelocityStart>();
-                const DensityStart& denRight = nodes[pos.x+1][pos.y].get<DensityStart>();
-                horizontalRight = velRight.x;
-                verticalRight = velRight.y;
-                densityRight = denRight.rho;
-            }
-
-            // Ensure left wall boundary conditions if necessary
-            if (nodes[pos.x][pos.y].has<LeftWall>()) {
-                horizontalLeft = -velocityStart.x;
-                verticalLeft = velocityStart.y;
-                densityLeft = densityStart.rho;
-            } else {
-                const VelocityStart& velLeft = nodes[pos.x-1][pos.y].get<VelocityStart>();
-                const DensityStart& denLeft = nodes[pos.x-1][pos.y].get<DensityStart>();
-                horizontalLeft = velLeft.x;
-                verticalLeft = velLeft.y;
-                densityLeft = denLeft.rho;
-            }
+            const std::size_t node = pos.x*NodesY + pos.y;
+            const Neighbours nb = gather_neighbours(stencil, velocityStartNb, densityStartNb, node);
 
             // Find first Runge Kutta functions
-            function.u = u_function(velocityStart.x, horizontalRight, horizontalLeft, horizontalUp, 
-            horizontalDown, velocityStart.y, densityStart.rho, densityRight, densityLeft);  
+            function.u = u_function(velocityStart.x, nb.horizontal[RIGHT], nb.horizontal[LEFT], nb.horizontal[UP], 
+            nb.horizontal[DOWN], velocityStart.y, densityStart.rho, nb.density[RIGHT], nb.density[LEFT]);  
 
-            function.v = v_function(velocityStart.y, verticalRight, verticalLeft, verticalUp, 
-            verticalDown, velocityStart.x, densityStart.rho, densityUp, densityDown);
+            function.v = v_function(velocityStart.y, nb.vertical[RIGHT], nb.vertical[LEFT], nb.vertical[UP], 
+            nb.vertical[DOWN], velocityStart.x, densityStart.rho, nb.density[UP], nb.density[DOWN]);
 
-            function.rho = rho_function(densityRight, densityLeft, densityUp, densityDown, 
-            verticalUp, verticalDown, horizontalRight, horizontalLeft);
+            function.rho = rho_function(nb.density[RIGHT], nb.density[LEFT], nb.density[UP], nb.density[DOWN], 
+            nb.vertical[UP], nb.vertical[DOWN], nb.horizontal[RIGHT], nb.horizontal[LEFT]);
 
             // Update half predictor values
             velocityHalf.x = velocityStart.x + (TIMESTEP * function.u)/2;
             velocityHalf.y = velocityStart.y + (TIMESTEP * function.v)/2;
             densityHalf.rho = densityStart.rho + (TIMESTEP * function.rho)/2;
-        });
+        }).add<gpecs::Fusable>();
     
     // This system finds and updates VelocityHalfCorrect and DensityHalfCorrect
     world.system<Position, VelocityStart, VelocityHalfPredict, VelocityHalfCorrect, DensityStart, 
                  DensityHalfPredict, DensityHalfCorrect, FunctionsSecond>()
         .kind(RungeKutta_2)
+        .multi_threaded()
         .each([&](Position& pos, VelocityStart& velocityStart, VelocityHalfPredict& velocityPredict, 
                   VelocityHalfCorrect& velocityCorrect, DensityStart& densityStart, 
                   DensityHalfPredict& densityPredict, DensityHalfCorrect& densityCorrect, 
                   FunctionsSecond& function){
             
-            // Initialise Neighbour Node Variables
-            double horizontalUp; // These are the neighbour horizontal velocities
-            double horizontalDown;
-            double horizontalRight;
-            double horizontalLeft;
-
-            double verticalUp; // These are the neighbour vertical velocities
-            double verticalDown;
-            double verticalRight;
-            double verticalLeft;
-
-            double densityUp; // These are the neighbour densities
-            double densityDown;
-            double densityRight;
-            double densityLeft;
-
-            // Ensure upper wall boundary conditions if necessary
-            if (nodes[pos.x][pos.y].has<UpperWall>()) {
-                horizontalUp = velocityPredict.x;
-                verticalUp = -velocityPredict.y;
-                densityUp = densityPredict.rho;
-            } else {
-                const VelocityHalfPredict& velUp = nodes[pos.x][pos.y+1].get<VelocityHalfPredict>();
-                const DensityHalfPredict& denUp = nodes[pos.x][pos.y+1].get<DensityHalfPredict>();
-                horizontalUp = velUp.x;
-                verticalUp = velUp.y;
-                densityUp = denUp.rho;
-            }
-            // Ensure lower wall boundary conditions if necessary
-            if (nodes[pos.x][pos.y].has<LowerWall>()) {
-                horizontalDown = velocityPredict.x;
-                verticalDown = -velocityPredict.y;
-                densityDown = densityPredict.rho;
-            } else {
-                const VelocityHalfPredict& velDown = nodes[pos.x][pos.y-1].get<VelocityHalfPredict>();
-                const DensityHalfPredict& denDown = nodes[pos.x][pos.y-1].get<DensityHalfPredict>();
-                horizontalDown = velDown.x;
-                verticalDown = velDown.y;
-                densityDown = denDown.rho;
-            }
-
-            // Ensure right wall boundary conditions if necessary
-            if (nodes[pos.x][pos.y].has<RightWall>()) {
-                horizontalRight = -velocityPredict.x;
-                verticalRight = velocityPredict.y;
-                densityRight = densityPredict.rho;
-            } else {
-                const VelocityHalfPredict& velRight = nodes[pos.x+1][pos.y].get<VelocityHalfPredict>();
-                const DensityHalfPredict& denRight = nodes[pos.x+1][pos.y].get<DensityHalfPredict>();
-                horizontalRight = velRight.x;
-                verticalRight = velRight.y;
-                densityRight = denRight.rho;
-            }
-
-            // Ensure left wall boundary conditions if necessary
-            if (nodes[pos.x][pos.y].has<LeftWall>()) {
-                horizontalLeft = -velocityPredict.x;
-                verticalLeft = velocityPredict.y;
-                densityLeft = densityPredict.rho;
-            } else {
-                const VelocityHalfPredict& velLeft = nodes[pos.x-1][pos.y].get<VelocityHalfPredict>();
-                const DensityHalfPredict& denLeft = nodes[pos.x-1][pos.y].get<DensityHalfPredict>();
-                horizontalLeft = velLeft.x;
-                verticalLeft = velLeft.y;
-                densityLeft = denLeft.rho;
-            }
+            const std::size_t node = pos.x*NodesY + pos.y;
+            const Neighbours nb = gather_neighbours(stencil, velocityHalfPredictNb, densityHalfPredictNb, node);
 
             // Find second Runge Kutta functions
-            function.u = u_function(velocityPredict.x, horizontalRight, horizontalLeft, horizontalUp, 
-            horizontalDown, velocityPredict.y, densityPredict.rho, densityRight, densityLeft);
+            function.u = u_function(velocityPredict.x, nb.horizontal[RIGHT], nb.horizontal[LEFT], nb.horizontal[UP], 
+            nb.horizontal[DOWN], velocityPredict.y, densityPredict.rho, nb.density[RIGHT], nb.density[LEFT]);
 
-            function.v = v_function(velocityPredict.y, verticalRight, verticalLeft, verticalUp, 
-            verticalDown, velocityPredict.x, densityPredict.rho, densityUp, densityDown);
+            function.v = v_function(velocityPredict.y, nb.vertical[RIGHT], nb.vertical[LEFT], nb.vertical[UP], 
+            nb.vertical[DOWN], velocityPredict.x, densityPredict.rho, nb.density[UP], nb.density[DOWN]);
 
-            function.rho = rho_function(densityRight, densityLeft, densityUp, densityDown, 
-                verticalUp, verticalDown, horizontalRight, horizontalLeft);
+            function.rho = rho_function(nb.density[RIGHT], nb.density[LEFT], nb.density[UP], nb.density[DOWN], 
+                nb.vertical[UP], nb.vertical[DOWN], nb.horizontal[RIGHT], nb.horizontal[LEFT]);
 
             // Update half predictor values
             velocityCorrect.x = velocityStart.x + (TIMESTEP * function.u)/2;
             velocityCorrect.y = velocityStart.y + (TIMESTEP * function.v)/2;
             densityCorrect.rho = densityStart.rho + (TIMESTEP * function.rho)/2;
-        });
+        }).add<gpecs::Fusable>();
     
     // This system finds and updates VelocityEndPredict and DensityEndPredict
     world.system<Position, VelocityStart, VelocityHalfCorrect, VelocityEndPredict, DensityStart, 
                  DensityHalfCorrect, DensityEndPredict, FunctionsFirst>()
         .kind(RungeKutta_3)
+        .multi_threaded()
         .each([&](Position& pos, VelocityStart& velocityStart, VelocityHalfCorrect& velocityHalf, 
                   VelocityEndPredict& velocityEnd, DensityStart& densityStart, 
                   DensityHalfCorrect& densityHalf, DensityEndPredict& densityEnd,
                   FunctionsFirst& function){
             
-            // Initialise Neighbour Node Variables
-            double horizontalUp; // These are the neighbour horizontal velocities
-            double horizontalDown;
-            double horizontalRight;
-            double horizontalLeft;
-
-            double verticalUp; // These are the neighbour vertical velocities
-            double verticalDown;
-            double verticalRight;
-            double verticalLeft;
-
-            double densityUp; // These are the neighbour densities
-            double densityDown;
-            double densityRight;
-            double densityLeft;
-
-            // Ensure upper wall boundary conditions if necessary
-            if (nodes[pos.x][pos.y].has<UpperWall>()) {
-                horizontalUp = velocityHalf.x;
-                verticalUp = -velocityHalf.y;
-                densityUp = densityHalf.rho;
-            } else {
-                const VelocityHalfCorrect& velUp = nodes[pos.x][pos.y+1].get<VelocityHalfCorrect>();
-                const DensityHalfCorrect& denUp = nodes[pos.x][pos.y+1].get<DensityHalfCorrect>();
-                horizontalUp = velUp.x;
-                verticalUp = velUp.y;
-                densityUp = denUp.rho;
-            }
-            // Ensure lower wall boundary conditions if necessary
-            if (nodes[pos.x][pos.y].has<LowerWall>()) {
-                horizontalDown = velocityHalf.x;
-                verticalDown = -velocityHalf.y;
-                densityDown = densityHalf.rho;
-            } else {
-                const VelocityHalfCorrect& velDown = nodes[pos.x][pos.y-1].get<VelocityHalfCorrect>();
-                const DensityHalfCorrect& denDown = nodes[pos.x][pos.y-1].get<DensityHalfCorrect>();
-                horizontalDown = velDown.x;
-                verticalDown = velDown.y;
-                densityDown = denDown.rho;
-            }
-
-            // Ensure right wall boundary conditions if necessary
-            if (nodes[pos.x][pos.y].has<RightWall>()) {
-                horizontalRight = -velocityHalf.x;
-                verticalRight = velocityHalf.y;
-                densityRight = densityHalf.rho;
-            } else {
-                const VelocityHalfCorrect& velRight = nodes[pos.x+1][pos.y].get<VelocityHalfCorrect>();
-                const DensityHalfCorrect& denRight = nodes[pos.x+1][pos.y].get<DensityHalfCorrect>();
-                horizontalRight = velRight.x;
-                verticalRight = velRight.y;
-                densityRight = denRight.rho;
-            }
-
-            // Ensure left wall boundary conditions if necessary
-            if (nodes[pos.x][pos.y].has<LeftWall>()) {
-                horizontalLeft = -velocityHalf.x;
-                verticalLeft = velocityHalf.y;
-                densityLeft = densityHalf.rho;
-            } else {
-                const VelocityHalfCorrect& velLeft = nodes[pos.x-1][pos.y].get<VelocityHalfCorrect>();
-                const DensityHalfCorrect& denLeft = nodes[pos.x-1][pos.y].get<DensityHalfCorrect>();
-                horizontalLeft = velLeft.x;
-                verticalLeft = velLeft.y;
-                densityLeft = denLeft.rho;
-            }
+            const std::size_t node = pos.x*NodesY + pos.y;
+            const Neighbours nb = gather_neighbours(stencil, velocityHalfCorrectNb, densityHalfCorrectNb, node);
 
             // Find first Runge Kutta functions
-            function.u = u_function(velocityHalf.x, horizontalRight, horizontalLeft, horizontalUp, 
-            horizontalDown, velocityHalf.y, densityHalf.rho, densityRight, densityLeft);
+            function.u = u_function(velocityHalf.x, nb.horizontal[RIGHT], nb.horizontal[LEFT], nb.horizontal[UP], 
+            nb.horizontal[DOWN], velocityHalf.y, densityHalf.rho, nb.density[RIGHT], nb.density[LEFT]);
 
-            function.v = v_function(velocityHalf.y, verticalRight, verticalLeft, verticalUp, 
-            verticalDown, velocityHalf.x, densityHalf.rho, densityUp, densityDown);
+            function.v = v_function(velocityHalf.y, nb.vertical[RIGHT], nb.vertical[LEFT], nb.vertical[UP], 
+            nb.vertical[DOWN], velocityHalf.x, densityHalf.rho, nb.density[UP], nb.density[DOWN]);
 
-            function.rho = rho_function(densityRight, densityLeft, densityUp, densityDown, 
-            verticalUp, verticalDown, horizontalRight, horizontalLeft);
+            function.rho = rho_function(nb.density[RIGHT], nb.density[LEFT], nb.density[UP], nb.density[DOWN], 
+            nb.vertical[UP], nb.vertical[DOWN], nb.horizontal[RIGHT], nb.horizontal[LEFT]);
 
             // Update half predictor values
             velocityEnd.x = velocityStart.x + (TIMESTEP * function.u);
             velocityEnd.y = velocityStart.y + (TIMESTEP * function.v);
             densityEnd.rho = densityStart.rho + (TIMESTEP * function.rho);
-        });
+        }).add<gpecs::Fusable>();
 
     // This system finds and updates FunctionsFourth
     world.system<Position, VelocityEndPredict, DensityEndPredict, FunctionsFourth>()
         .kind(RungeKutta_4)
+        .multi_threaded()
         .each([&](Position& pos, VelocityEndPredict& velocity, DensityEndPredict& density, 
                   FunctionsFourth& function){
             
-            // Initialise Neighbour Node Variables
-            double horizontalUp; // These are the neighbour horizontal velocities
-            double horizontalDown;
-            double horizontalRight;
-            double horizontalLeft;
-
-            double verticalUp; // These are the neighbour vertical velocities
-            double verticalDown;
-            double verticalRight;
-            double verticalLeft;
-
-            double densityUp; // These are the neighbour densities
-            double densityDown;
-            double densityRight;
-            double densityLeft;
-
-            // Ensure upper wall boundary conditions if necessary
-            if (nodes[pos.x][pos.y].has<UpperWall>()) {
-                horizontalUp = velocity.x;
-                verticalUp = -velocity.y;
-                densityUp = density.rho;
-            } else {
-                const VelocityEndPredict& velUp = nodes[pos.x][pos.y+1].get<VelocityEndPredict>();
-                const DensityEndPredict& denUp = nodes[pos.x][pos.y+1].get<DensityEndPredict>();
-                horizontalUp = velUp.x;
-                verticalUp = velUp.y;
-                densityUp = denUp.rho;
-            }
-            // Ensure lower wall boundary conditions if necessary
-            if (nodes[pos.x][pos.y].has<LowerWall>()) {
-                horizontalDown = velocity.x;
-                verticalDown = -velocity.y;
-                densityDown = density.rho;
-            } else {
-                const VelocityEndPredict& velDown = nodes[pos.x][pos.y-1].get<VelocityEndPredict>();
-                const DensityEndPredict& denDown = nodes[pos.x][pos.y-1].get<DensityEndPredict>();
-                horizontalDown = velDown.x;
-                verticalDown = velDown.y;
-                densityDown = denDown.rho;
-            }
-
-            // Ensure right wall boundary conditions if necessary
-            if (nodes[pos.x][pos.y].has<RightWall>()) {
-                horizontalRight = -velocity.x;
-                verticalRight = velocity.y;
-                densityRight = density.rho;
-            } else {
-                const VelocityEndPredict& velRight = nodes[pos.x+1][pos.y].get<VelocityEndPredict>();
-                const DensityEndPredict& denRight = nodes[pos.x+1][pos.y].get<DensityEndPredict>();
-                horizontalRight = velRight.x;
-                verticalRight = velRight.y;
-                densityRight = denRight.rho;
-            }
-
-            // Ensure left wall boundary conditions if necessary
-            if (nodes[pos.x][pos.y].has<LeftWall>()) {
-                horizontalLeft = -velocity.x;
-                verticalLeft = velocity.y;
-                densityLeft = density.rho;
-            } else {
-                const VelocityEndPredict& velLeft = nodes[pos.x-1][pos.y].get<VelocityEndPredict>();
-                const DensityEndPredict& denLeft = nodes[pos.x-1][pos.y].get<DensityEndPredict>();
-                horizontalLeft = velLeft.x;
-                verticalLeft = velLeft.y;
-                densityLeft = denLeft.rho;
-            }
+            const std::size_t node = pos.x*NodesY + pos.y;
+            const Neighbours nb = gather_neighbours(stencil, velocityEndPredictNb, densityEndPredictNb, node);
 
             // Find first Runge Kutta functions
-            function.u = u_function(velocity.x, horizontalRight, horizontalLeft, horizontalUp, 
-            horizontalDown, velocity.y, density.rho, densityRight, densityLeft);
+            function.u = u_function(velocity.x, nb.horizontal[RIGHT], nb.horizontal[LEFT], nb.horizontal[UP], 
+            nb.horizontal[DOWN], velocity.y, density.rho, nb.density[RIGHT], nb.density[LEFT]);
 
-            function.v = v_function(velocity.y, verticalRight, verticalLeft, verticalUp, 
-            verticalDown, velocity.x, density.rho, densityUp, densityDown);
+            function.v = v_function(velocity.y, nb.vertical[RIGHT], nb.vertical[LEFT], nb.vertical[UP], 
+            nb.vertical[DOWN], velocity.x, density.rho, nb.density[UP], nb.density[DOWN]);
 
-            function.rho = rho_function(densityRight, densityLeft, densityUp, densityDown, 
-            verticalUp, verticalDown, horizontalRight, horizontalLeft);
+            function.rho = rho_function(nb.density[RIGHT], nb.density[LEFT], nb.density[UP], nb.density[DOWN], 
+            nb.vertical[UP], nb.vertical[DOWN], nb.horizontal[RIGHT], nb.horizontal[LEFT]);
 
-        });
+        }).add<gpecs::Fusable>();
 
     // This updates VelocityStart and DensityStart
     world.system<VelocityStart, DensityStart, FunctionsFirst, FunctionsSecond, FunctionsThird, 
                  FunctionsFourth>()
         .kind(Update)
+        .multi_threaded()
         .each([](VelocityStart& velocityStart, DensityStart& densityStart, FunctionsFirst& f1, 
                  FunctionsSecond& f2, FunctionsThird& f3, FunctionsFourth& f4){
             velocityStart.x = velocityStart.x + (TIMESTEP*(f1.u + 2*f2.u + 2*f3.u + f4.u))/6;
             velocityStart.y = velocityStart.y + (TIMESTEP*(f1.v + 2*f2.v + 2*f3.v + f4.v))/6;
             densityStart.rho = densityStart.rho + (TIMESTEP*(f1.rho +2*f2.rho + 2*f3.rho + f4.rho))/6;
-        });
+        }).add<gpecs::Fusable>();
+
+    // `--fuse auto` runs the RungeKutta_4 and Update systems as one pass over
+    // the nodes (see include/gpecs/SystemFusion.hpp); the others are split
+    // by the sync points
+    auto fusion = gpecs::fusion_from_args(world, argc, argv, {RungeKutta_1, RungeKutta_2, RungeKutta_3,
+                                                              RungeKutta_4, Update});
+
+    // Saves are formatted and written on a background thread while the
+    // next steps run
+    gpecs::SnapshotWriter writer;
+    const gpecs::SnapshotWriter::Encoder saveText = [](const gpecs::Snapshot& snap) {
+        // Prepare Save Files
+        gpecs::TextWriter MyFile_u;
+        gpecs::TextWriter MyFile_v;
+        gpecs::TextWriter MyFile_rho;
+        // Create filenames
+        std::string horizontalName="horizontal_t=" + std::to_string(snap.step*TIMESTEP) + ".txt";
+        std::string verticalName="vertical_t=" + std::to_string(snap.step*TIMESTEP) + ".txt";
+        std::string densityName="density_t=" + std::to_string(snap.step*TIMESTEP) + ".txt";
+        // Create files
+        MyFile_u.open(horizontalName);
+        MyFile_v.open(verticalName);
+        MyFile_rho.open(densityName);
+
+        // Check Save Files are open/created
+        if (!MyFile_u.is_open())
+            throw std::runtime_error("Error in creating file horizontal_velocity.txt");
+        if (!MyFile_v.is_open())
+            throw std::runtime_error("Error in creating file vertical_velocity.txt");
+        if (!MyFile_rho.is_open())
+            throw std::runtime_error("Error in creating file density.txt");
+
+        auto velocities = snap.column<VelocityStart>(0);
+        auto densities = snap.column<DensityStart>(1);
+        std::size_t i = 0;
+        for (int y = 0; y < (2*Ny + Nh); y++) {
+            for (int x = 0; x < 2*Nx; x++, i++) {
+                const VelocityStart& velocity = velocities[i];
+                const DensityStart& density = densities[i];
+                if (x == 2*Nx-1) {
+                    MyFile_u << velocity.x << "\n";
+                    MyFile_v << velocity.y << "\n";
+                    MyFile_rho << density.rho << "\n";
+                } else {
+                    MyFile_u << velocity.x << ", ";
+                    MyFile_v << velocity.y << ", ";
+                    MyFile_rho << density.rho << ", ";
+                }
+            }
+        }
+        // Close Save File
+        MyFile_u.close();
+        MyFile_v.close();
+        MyFile_rho.close();
+    };
+    const gpecs::SnapshotWriter::Encoder saveColumns = [&columns](const gpecs::Snapshot& snap) {
+        auto velocities = snap.column<VelocityStart>(0);
+        auto densities = snap.column<DensityStart>(1);
+        columns->begin_frame(snap.step, snap.step*TIMESTEP, velocities.size());
+        columns->column(velocities.data(), &VelocityStart::x);
+        columns->column(velocities.data(), &VelocityStart::y);
+        columns->column(densities.data(), &DensityStart::rho);
+        columns->end_frame();
+    };
 
     // Run through systems every time step
-    for (int t_step = 0; t_step <= NUMBERSTEPS; t_step++) {
+    for (int t_step = firstStep; t_step <= NUMBERSTEPS; t_step++) {
         if (t_step != 0) {
                 world.progress();
             }
@@ -604,58 +573,55 @@ int main(int argc, char *argv[]) {
         
         // Saves Data to a .txt file
         if (t_step%SAVESTEP == 0) {
-            // Prepare Save Files
-            std::ofstream MyFile_u;
-            std::ofstream MyFile_v;
-            std::ofstream MyFile_rho;
-            // Create filenames
-            std::string horizontalName="horizontal_t=" + std::to_string(t_step*TIMESTEP) + ".txt";
-            std::string verticalName="vertical_t=" + std::to_string(t_step*TIMESTEP) + ".txt";
-            std::string densityName="density_t=" + std::to_string(t_step*TIMESTEP) + ".txt";
-            // Create files
-            MyFile_u.open(horizontalName);
-            MyFile_v.open(verticalName);
-            MyFile_rho.open(densityName);
-
-
-            // Check Save Files are open/created
-            if (!MyFile_u.is_open())
-            {
-                std::cout<<"Error in creating file horizontal_velocity.txt"<<std::endl; 
-                return 1; 
+            // Stop at the first file that could not be created
+            if (!writer.ok()) {
+                std::cout << writer.error() << std::endl;
+                return 1;
             }
+            writer.write(t_step,
+                [&](gpecs::Snapshot& snap) {
+                    // Copy the fields row by row, in the order they are saved
+                    auto velocities = snap.column<VelocityStart>(0, 2*Nx*NodesY);
+                    auto densities = snap.column<DensityStart>(1, 2*Nx*NodesY);
+                    std::size_t i = 0;
+                    for (int y = 0; y < (2*Ny + Nh); y++) {
+                        for (int x = 0; x < 2*Nx; x++, i++) {
+                            velocities[i] = nodes[x][y].get<VelocityStart>();
+                            densities[i] = nodes[x][y].get<DensityStart>();
+                        }
+                    }
+                },
+                columns ? saveColumns : saveText);
+        }
 
-            if (!MyFile_v.is_open())
-            {
-                std::cout<<"Error in creating file vertical_velocity.txt"<<std::endl; 
-                return 1; 
+        // Saves every node for a restart
+        if (checkpoints.due(t_step)) {
+            try {
+                gpecs::Checkpoint cp(t_step);
+                cp.put("parameters", PARAMETERS);
+                gpecs::save_checkpoint(world, checkpoints.path, cp);
+            } catch (const std::exception& e) {
+                std::cout << e.what() << std::endl;
+                return 1;
             }
-
-            if (!MyFile_rho.is_open())
-            {
-                std::cout<<"Error in creating file density.txt"<<std::endl; 
-                return 1; 
+            if (gpecs::stop_requested()) {
+                std::cout << "Stopped after step " << t_step << ", saved to " << checkpoints.path << std::endl;
+                break;
             }
+        }
+    }
 
-            for (int y = 0; y < (2*Ny + Nh); y++) {
-                for (int x = 0; x < 2*Nx; x++) {
-                    const VelocityStart& velocity = nodes[x][y].get<VelocityStart>();
-                    const DensityStart& density = nodes[x][y].get<DensityStart>();
-                    if (x == 2*Nx-1) {
-                        MyFile_u << velocity.x << "\n";
-                        MyFile_v << velocity.y << "\n";
-                        MyFile_rho << density.rho << "\n";
-                    } else {
-                        MyFile_u << velocity.x << ", ";
-                        MyFile_v << velocity.y << ", ";
-                        MyFile_rho << density.rho << ", ";
-                    }
-                }
-            }
-            // Close Save File
-            MyFile_u.close();
-            MyFile_v.close();
-            MyFile_rho.close();
+    writer.flush();
+    if (!writer.ok()) {
+        std::cout << writer.error() << std::endl;
+        return 1;
+    }
+    if (columns) {
+        try {
+            columns->close();
+        } catch (const std::exception& e) {
+            std::cout << e.what() << std::endl;
+            return 1;
         }
-    }   
+    }
 }
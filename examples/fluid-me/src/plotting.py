@@ -1,4 +1,5 @@
 import os
+import sys
 import numpy as np
 import seaborn as sns
 import imageio.v3 as iio
@@ -19,13 +20,26 @@ numberOfFiles = specsData[4]
 
 delta = 1
 
+# Runs saved with --columns fluid.gcol write one column file instead of the
+# .txt files
+sys.path.append(os.path.join(rootFolder, "..", "..", "include", "gpecs"))
+import columns
+columnsLocation = os.path.join(dataFolder, "fluid.gcol")
+columnData = columns.load(columnsLocation) if os.path.exists(columnsLocation) else None
+
+def load_field(name, time):
+    if columnData is not None:
+        i = int(np.argmin(np.abs(columnData.times - time)))
+        return columnData.column(name)[i].reshape(int(boxWidth), int(boxLength))
+    location = os.path.join(dataFolder, f"{name}_t={time:.6f}.txt")
+    return np.genfromtxt(location, delimiter = ",")
+
 # Find density data for each time step and add to array
 densityData = []
 densityImages = []
 for i in range(int(numberOfFiles)-5):
     time = i * timeStep
-    location  = os.path.join(dataFolder, f"density_t={time:.6f}.txt")
-    data = np.genfromtxt(location, delimiter = ",")
+    data = load_field("density", time)
     densityData.append(data)
 
 densityMin, densityMax = np.min(densityData), np.max(densityData)
@@ -51,8 +65,7 @@ horizontalData = []
 horizontalImages = []
 for i in range(int(numberOfFiles)-5):
     time = i * timeStep
-    location  = os.path.join(dataFolder, f"horizontal_t={time:.6f}.txt")
-    data = np.genfromtxt(location, delimiter = ",")
+    data = load_field("horizontal", time)
     horizontalData.append(data)
 
 horizontalMin, horizontalMax = np.min(horizontalData), np.max(horizontalData)
@@ -78,8 +91,7 @@ verticalData = []
 verticalImages = []
 for i in range(int(numberOfFiles)-5):
     time = i * timeStep
-    location  = os.path.join(dataFolder, f"vertical_t={time:.6f}.txt")
-    data = np.genfromtxt(location, delimiter = ",")
+    data = load_field("vertical", time)
     verticalData.append(data)
     
 verticalMin, verticalMax = np.min(verticalData), np.max(verticalData)
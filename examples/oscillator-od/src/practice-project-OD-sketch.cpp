@@ -11,7 +11,7 @@ Aims:
 
 
 #include <iostream>
-#include <fstream> 
+#include <gpecs/TextWriter.hpp>
 #include <vector>
 #include <cmath>
 #include <flecs.h>
@@ -63,7 +63,7 @@ const float mass, float k_left, float k_right, float l_left, float l_right)
 int main() {
 
     // Open file for writing
-    std::ofstream MyFile; 
+    gpecs::TextWriter MyFile; 
     MyFile.open("Coupled_Oscillator_OD_Sketch.txt");
     if (!MyFile.is_open())
     {
@@ -24,14 +24,25 @@ Spline Kernel: Monaghan SPH Review article 1992
 
 #include <iostream>
 #include <flecs.h>
+#include <gpecs/BulkSpawn.hpp>
+#include <gpecs/FrameArena.hpp>
+#include <gpecs/MemoryReport.hpp>
+#include <gpecs/Multirate.hpp>
+#include <gpecs/PerfCounters.hpp>
+#include <gpecs/Profiler.hpp>
+#include <gpecs/SnapshotWriter.hpp>
+#include <gpecs/TextWriter.hpp>
+#include <gpecs/Threads.hpp>
 #include <vector>
+#include <memory_resource>
+#include <span>
 #include <random>
 #include <cmath>
 #include <thread>
 #include <chrono>
-#include <fstream> 
 #include <time.h> 
 #include <algorithm>
+#include <limits>
 
 // Initialise Components 
 struct Position { double x, y; };
@@ -41,6 +52,13 @@ struct Mass { double m; };
 struct ParticleIndex {int i; }; 
 struct Box {int k; }; 
 
+// Smallest time step limits found so far (not a component - one per worker)
+struct StepLimits {
+    double t_f = std::numeric_limits<double>::infinity();
+    double t_cx = std::numeric_limits<double>::infinity();
+    double t_cy = std::numeric_limits<double>::infinity();
+};
+
 // Constants
 int NO_PARTICLES = 20; 
 const int STEPS = 400; // Number of time steps
@@ -128,9 +146,16 @@ double spline_W(double r) {
     }
 }
 
+// The small vectors below (positions, distances, gradients, forces) are
+// allocated from `scratch`. Systems pass their thread's gpecs::FrameArena so
+// the force pass does not call malloc; each function allocates its result
+// before its temporaries, so the arena gets the temporaries straight back.
+using ScratchVec = std::pmr::vector<double>;
+
 // Function to calculate vector distance between particles 
-std::vector<double> vector_distance(std::vector<double> position_r, flecs::entity Particle_i){
-    std::vector<double> displacement; 
+ScratchVec vector_distance(const ScratchVec& position_r, flecs::entity Particle_i, std::pmr::memory_resource* scratch = std::pmr::get_default_resource()){
+    ScratchVec displacement(scratch); 
+    displacement.reserve(2);
 
     Position p_i = Particle_i.get<Position>();
 
@@ -141,19 +166,19 @@ std::vector<double> vector_distance(std::vector<double> position_r, flecs::entit
 }
 
 // Function to calculate the absolute magnitude of a vector
-double absolute_distance(std::vector<double> displacement){
+double absolute_distance(std::span<const double> displacement){
     double sum = 0; 
     for (int i = 0; i < displacement.size(); i++) { sum += displacement[i]*displacement[i]; }
     return sqrt(sum); 
 }
 
 // Function to caluclate density rho at some position
-double density(std::vector<double> position_r, std::vector<flecs::entity> Particles){
+double density(const ScratchVec& position_r, const std::vector<flecs::entity>& Particles, std::pmr::memory_resource* scratch = std::pmr::get_default_resource()){
     double Density = 0; 
 
     for (int j=0; j<Particles.size(); j++)
     {
-        std::vector<double> distance_vec = vector_distance(position_r,Particles[j]); 
+        ScratchVec distance_vec = vector_distance(position_r,Particles[j],scratch); 
         double R = absolute_distance(distance_vec);  
         Density += Particles[j].get<Mass>().m * gaussian_W(R,CONST_H); 
     }
@@ -175,15 +200,17 @@ double density_gambel(double position_r, std::vector<double> configuration, doub
 }
 
 // Gradient of Gaussian Interpolant Function
-std::vector<double> grad_gaussian_W(flecs::entity p_a, flecs::entity p_b) 
+ScratchVec grad_gaussian_W(flecs::entity p_a, flecs::entity p_b, std::pmr::memory_resource* scratch = std::pmr::get_default_resource()) 
 { 
-    std::vector<double> pos_a; 
+    ScratchVec grad(scratch); 
+    grad.reserve(2);
+    ScratchVec pos_a(scratch); 
+    pos_a.reserve(2);
     pos_a.push_back(p_a.get<Position>().x); 
     pos_a.push_back(p_a.get<Position>().y); 
 
-    std::vector<double> vec_distance = vector_distance(pos_a,p_b); 
+    ScratchVec vec_distance = vector_distance(pos_a,p_b,scratch); 
     double R = absolute_distance(vec_distance); 
-    std::vector<double> grad; 
                                                                                                                // ! Spline XXXX 
     for(int i = 0; i < vec_distance.size(); i++) { grad.push_back( - (2 / (CONST_H*CONST_H)) * vec_distance[i] * gaussian_W(R,CONST_H)); }
 
@@ -191,21 +218,23 @@ std::vector<double> grad_gaussian_W(flecs::entity p_a, flecs::entity p_b)
 } 
 
 // Gradient of Spline Interpolant Function
-std::vector<double> grad_spline_W(flecs::entity p_a, flecs::entity p_b)
+ScratchVec grad_spline_W(flecs::entity p_a, flecs::entity p_b, std::pmr::memory_resource* scratch = std::pmr::get_default_resource())
 {
+    ScratchVec grad(scratch);
+    grad.reserve(2);
+
     // Get the vector position of particle a
-    std::vector<double> pos_a; 
+    ScratchVec pos_a(scratch); 
+    pos_a.reserve(2);
     pos_a.push_back(p_a.get<Position>().x); 
     pos_a.push_back(p_a.get<Position>().y); 
 
-    std::vector<double> vec_distance = vector_distance(pos_a,p_b); 
+    ScratchVec vec_distance = vector_distance(pos_a,p_b,scratch); 
     double R = absolute_distance(vec_distance); 
 
     double q = R / CONST_H; 
     double c = SIGMA / pow(CONST_H,NO_DIMENSIONS); 
 
-    std::vector<double> grad;
-
     if( (q >= 0) && (q <= 1) )
     {
         for(int i = 0; i < vec_distance.size(); i++) 
@@ -226,15 +255,16 @@ std::vector<double> grad_spline_W(flecs::entity p_a, flecs::entity p_b)
 
 // Equations of state -- rho_i can be input into some equation of state to find pressure
 // Van der Waals equation of state to find pressure -- "A review of SPH" equation 
-double vdw_pressure(std::vector<flecs::entity> Particles, flecs::entity particle){
+double vdw_pressure(const std::vector<flecs::entity>& Particles, flecs::entity particle, std::pmr::memory_resource* scratch = std::pmr::get_default_resource()){
     
     double mass = particle.get<Mass>().m; 
 
-    std::vector<double> particle_position; 
+    ScratchVec particle_position(scratch); 
+    particle_position.reserve(2);
     particle_position.push_back(particle.get<Position>().x); 
     particle_position.push_back(particle.get<Position>().y); 
 
-    double Density = density(particle_position,Particles); 
+    double Density = density(particle_position,Particles,scratch); 
 
     double alpha_bar = ALPHA / mass; 
     double beta_bar = BETA / mass; 
@@ -244,22 +274,22 @@ double vdw_pressure(std::vector<flecs::entity> Particles, flecs::entity particle
 }
 
 // Function to calculate force on particle a due to all other particles      
-std::vector<double> force(std::vector<flecs::entity> Particles, flecs::entity Particle_a){
-    std::vector<double> Force = {0.0,0.0}; 
+ScratchVec force(const std::vector<flecs::entity>& Particles, flecs::entity Particle_a, std::pmr::memory_resource* scratch = std::pmr::get_default_resource()){
+    ScratchVec Force({0.0,0.0}, scratch); 
 
     // Particle a position
     double x_a = Particle_a.get<Position>().x; 
     double y_a = Particle_a.get<Position>().y;
-    std::vector<double> particle_a_position = {x_a,y_a};
+    ScratchVec particle_a_position({x_a,y_a}, scratch);
 
     // Particle a mass
     double m_a = Particle_a.get<Mass>().m; 
 
     // Pressure at particle a
-    double p_a = vdw_pressure(Particles, Particle_a);
+    double p_a = vdw_pressure(Particles, Particle_a, scratch);
 
     // Density at particle a
-    double rho_a = density(particle_a_position,Particles);
+    double rho_a = density(particle_a_position,Particles,scratch);
 
     for(int i = 0; i < Particles.size()-1; i++)
     {
@@ -268,26 +298,26 @@ std::vector<double> force(std::vector<flecs::entity> Particles, flecs::entity Pa
         {
             double x_b = Particles[i].get<Position>().x;
             double y_b = Particles[i].get<Position>().y;
-            std::vector<double> particle_b_position = {x_b,y_b}; 
+            ScratchVec particle_b_position({x_b,y_b}, scratch); 
 
             // Vector distance r_a - r_i --> Absolute distance R
-            std::vector<double> disp = vector_distance(particle_a_position,Particles[i]); 
+            ScratchVec disp = vector_distance(particle_a_position,Particles[i],scratch); 
             double R = absolute_distance(disp);
 
             // Particle i mass
             double m_b = Particles[i].get<Mass>().m;
 
             // Pressure at particle i
-            double p_b = vdw_pressure(Particles, Particles[i]);
+            double p_b = vdw_pressure(Particles, Particles[i], scratch);
 
             // Desnity at particle i
-            double rho_b = density(particle_b_position,Particles);
+            double rho_b = density(particle_b_position,Particles,scratch);
 
             // make into one constant
             double constant = - (m_a * m_b) * ( p_b / (pow(rho_b,2)) + p_a / (pow(rho_a,2)) ); 
 
             // Gradient of W(r_a - r_i)
-            std::vector<double> grad_W = grad_gaussian_W(Particle_a, Particles[i]); 
+            ScratchVec grad_W = grad_gaussian_W(Particle_a, Particles[i], scratch); 
 
             Force[0] += constant * grad_W[0]; 
             Force[1] += constant * grad_W[1];
@@ -316,7 +346,7 @@ int main(int argc, char* argv[]) {
     t = clock(); 
 
     // Open file for writing - Data file
-    std::ofstream MyFile;
+    gpecs::TextWriter MyFile;
     MyFile.open("/Users/oluwoledelano/ECS_Development/flecs-in-docker/Sketches/OD/smooth_particle_hydrodynamics/outputs/SPH_Dust.txt");
     if (!MyFile.is_open())
     {
@@ -326,7 +356,7 @@ int main(int argc, char* argv[]) {
     MyFile << "Particle 1 position x_1 (cm), y_1 (cm), Particle 1 velocity v_x, v_y |  x_2,y_2,v_x,v_y ; ..."<< std::endl;
 
     // Open file for writing - Specifications file
-    std::ofstream MyFile_specs; 
+    gpecs::TextWriter MyFile_specs; 
     MyFile_specs.open("/Users/oluwoledelano/ECS_Development/flecs-in-docker/Sketches/OD/smooth_particle_hydrodynamics/outputs/sph_code_specifications.txt");
     if (!MyFile_specs.is_open())
     {
@@ -340,7 +370,7 @@ int main(int argc, char* argv[]) {
     MyFile_specs.close(); 
 
     // Open file for writing - Density field file
-    std::ofstream MyFile_density;
+    gpecs::TextWriter MyFile_density;
     MyFile_density.open("/Users/oluwoledelano/ECS_Development/flecs-in-docker/Sketches/OD/smooth_particle_hydrodynamics/outputs/density_field.txt");
     if (!MyFile_density.is_open())
     {
@@ -351,7 +381,7 @@ int main(int argc, char* argv[]) {
     // /Users/oluwoledelano/ECS_Development/flecs-in-docker/Sketches/OD/smooth_particle_hydrodynamics/outputs/Gambel_Density_ParticleNo=20.txt
 
     // Open file for writing - Gambel Density field file
-    std::ofstream MyFile_gambel;
+    gpecs::TextWriter MyFile_gambel;
     std::string fileGambel="";
     std::string path = "/Users/oluwoledelano/ECS_Development/flecs-in-docker/Sketches/OD/smooth_particle_hydrodynamics/outputs/"; 
     if(NO_PARTICLES == 20) { fileGambel=path+"Gambel_Density_ParticleNo=20.txt"; }
@@ -367,13 +397,25 @@ int main(int argc, char* argv[]) {
 
     // Create the flecs world
     flecs::world world(argc,argv);
-
-    // Components of the world
-    world.component<Position>(); 
-    world.component<Velocity>(); 
-    world.component<Acceleration>(); 
-    world.component<Mass>(); 
-    world.component<Box>(); 
+    gpecs::use_threads(world, argc, argv);
+    auto profiler = gpecs::profile_from_args(world, argc, argv);
+    auto perf = gpecs::perf_from_args(world, argc, argv);
+    auto memory = gpecs::memory_from_args(world, argc, argv);
+    // Scratch memory for the force pass, per thread; `--arena -` prints how much it used
+    auto arena = gpecs::arena_from_args(world, argc, argv);
+    // The time step check and the output cost as much as a step; `--check-every K`
+    // and `--output-every K` run them on every K-th step only (steps 0, K, 2K, ...)
+    gpecs::Multirate rates(world);
+    flecs::entity check = rates.every(gpecs::rate_from_args(argc, argv, "--check-every"));
+    flecs::entity output = rates.every(gpecs::rate_from_args(argc, argv, "--output-every"));
+
+    // Components of the world, with their members so --memory can show padding
+    world.component<Position>().member("x", &Position::x).member("y", &Position::y);
+    world.component<Velocity>().member("dx", &Velocity::dx).member("dy", &Velocity::dy);
+    world.component<Acceleration>().member("ddx", &Acceleration::ddx).member("ddy", &Acceleration::ddy);
+    world.component<Mass>().member("m", &Mass::m);
+    world.component<Box>().member("k", &Box::k);
+    world.component<ParticleIndex>().member("i", &ParticleIndex::i);
 
     // Tools for picking random numbers
     std::mt19937 rng( std::random_device{}()  ) ; // Initialise a random number generator with random device (for actual use)
@@ -423,29 +465,50 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    for (int i = 0; i < NO_PARTICLES; ++i) { 
-        particles.push_back( 
-            world.entity() 
-                .set<ParticleIndex>({i}) 
-                .set<Position>({UposX(rng), UposY(rng)}) 
-                .set<Velocity>({x_velocities[i], y_velocities[i]}) 
-                .set<Acceleration>({0.0, 0.0}) 
-                .set<Mass>({PARTICLE_MASS})
-                .set<Box>({0})); 
-    } 
+    particles = gpecs::BulkSpawner<ParticleIndex, Position, Velocity, Acceleration, Mass, Box>(world)
+        .spawn(NO_PARTICLES, [&](int32_t i, ParticleIndex& index, Position& p, Velocity& v,
+                                 Acceleration& a, Mass& m, Box& b) {
+            index = {i};
+            p = {UposX(rng), UposY(rng)};
+            v = {x_velocities[i], y_velocities[i]};
+            a = {0.0, 0.0};
+            m = {PARTICLE_MASS};
+            b = {0};
+        });
 
     // Note: Systems run in order they are coded in
 
-    // Write to file
-    world.system<Position, Velocity>()
+    // Write to file - stays single threaded so the particles are copied
+    // one at a time, in the same order every step. The copies are formatted
+    // and written on a background thread while the step carries on.
+    gpecs::SnapshotWriter writer(4);
+    world.system<const Position, const Velocity>()
         .kind(flecs::PreUpdate)
-        .each([&](Position& p, Velocity &v){
-            MyFile << p.x << "," << p.y << "," << v.dx << "," << v.dy << "|" ;
+        .tick_source(output)
+        .run([&](flecs::iter& it){
+            gpecs::Snapshot& snap = writer.acquire(it.world().get_info()->frame_count_total);
+            while (it.next()) {
+                auto p = it.field<const Position>(0);
+                auto v = it.field<const Velocity>(1);
+                for (auto row : it) {
+                    snap.append(0, &p[row], 1);
+                    snap.append(1, &v[row], 1);
+                }
+            }
+            writer.submit(snap, [&MyFile](const gpecs::Snapshot& snap){
+                auto p = snap.column<Position>(0);
+                auto v = snap.column<Velocity>(1);
+                for (std::size_t i = 0; i < p.size(); ++i) {
+                    MyFile << p[i].x << "," << p[i].y << "," << v[i].dx << "," << v[i].dy << "|" ;
+                }
+                MyFile<<std::endl; // End the line of particles written this step
+            });
         });
 
     // Check for collision
     world.system<Position, Velocity, Acceleration, Box>()
         .kind(flecs::PreUpdate)
+        .multi_threaded()
         .each([&](Position& p, Velocity& v, Acceleration& a, Box& b){
 
             int cx = int(std::floor(p.x)); // Round down to nearest integer
@@ -467,55 +530,63 @@ int main(int argc, char* argv[]) {
         });
 
     // Check that time step isn't too large
-    world.system<>()
-        .kind(flecs::PreUpdate)
-        .each([&](){
+    // Each worker finds the smallest limits over its own particles, then a
+    // single threaded system takes the minimum over the workers and reports
+    gpecs::PerWorker<StepLimits> limits(world);
 
-            double dt = 0;
+    world.system<Velocity, ParticleIndex>()
+        .kind(flecs::PreUpdate)
+        .tick_source(check)
+        .multi_threaded()
+        .each([&](flecs::iter& it, size_t, Velocity& v, ParticleIndex& index){
+            StepLimits& limit = limits.local(it);
 
             // Particle acceleration constraint | finding min( h / sqrt(F_i) )
-            double t_f = 0;
-            for(int i = 0; i < particles.size(); i++){
-                std::vector<double> Force = force(particles, particles[i]);
-                double abs_force = absolute_distance(Force); // Function to calculate |r| can be used similarly for F
-                double t1 = CONST_H / sqrt(abs_force); 
-                
-                if (i == 0) { t_f = t1; }
-                else if(t1<t_f) { t_f = t1; }
-            }
+            ScratchVec Force = force(particles, particles[index.i], arena->local());
+            double abs_force = absolute_distance(Force); // Function to calculate |r| can be used similarly for F
+            limit.t_f = std::min(limit.t_f, CONST_H / sqrt(abs_force));
 
             // CFL condition in the x and y directions
-            double t_cx = 0;
-            double t_cy = 0;
-            for(int i = 0; i < particles.size(); i++){
-                double t2 = ( COURANT_NO * CONST_H ) / abs(particles[i].get<Velocity>().dx) ; 
-                if (i == 0) { t_cx = t2; }
-                else if(t2<t_cx) { t_cx = t2; }
-            }
-            for(int i = 0; i < particles.size(); i++){
-                double t2 = ( COURANT_NO * CONST_H ) / abs(particles[i].get<Velocity>().dy) ; 
-                if (i == 0) { t_cy = t2; }
-                else if(t2<t_cy) { t_cy = t2; }
-            }
+            limit.t_cx = std::min(limit.t_cx, ( COURANT_NO * CONST_H ) / abs(v.dx));
+            limit.t_cy = std::min(limit.t_cy, ( COURANT_NO * CONST_H ) / abs(v.dy));
+        });
+
+    world.system<>()
+        .kind(flecs::PreUpdate)
+        .tick_source(check)
+        .run([&](flecs::iter&){
+
+            StepLimits limit;
+            limits.merge([&](StepLimits& worker){
+                limit.t_f = std::min(limit.t_f, worker.t_f);
+                limit.t_cx = std::min(limit.t_cx, worker.t_cx);
+                limit.t_cy = std::min(limit.t_cy, worker.t_cy);
+            });
 
             // Find the minimum value of all these constraints
-            double t_c = std::min(t_cx,t_cy); 
+            double t_c = std::min(limit.t_cx,limit.t_cy); 
 
-            dt = 0.3 * std::min(t_f,t_c); 
+            double dt = 0.3 * std::min(limit.t_f,t_c); 
 
             if(DT > dt) { std::cout<<"ERROR: Time step too large. Decrease by "<<(DT-dt)<<std::endl; }
         });
 
     // Update Acceleration
     world.system<Position, Velocity, Acceleration, Mass, ParticleIndex>()
+        .multi_threaded()
         .each([&](Position& p, Velocity& v, Acceleration& a, Mass& m, ParticleIndex& index){
-            std::vector<double> Force = force(particles, particles[index.i]);
+            ScratchVec Force = force(particles, particles[index.i], arena->local());
             a.ddx = Force[0] / m.m;
             a.ddy = Force[1] / m.m; 
         });
 
+    // The force pass reads every particle's position, so it has to finish on
+    // every worker before any positions move
+    gpecs::sync_point(world);
+
     // Update velocity
     world.system<Velocity, Acceleration>()
+        .multi_threaded()
         .each([&](Velocity& v, Acceleration& a){
             v.dx += a.ddx * DT;
             v.dy += a.ddy * DT;
@@ -523,6 +594,7 @@ int main(int argc, char* argv[]) {
 
     // Update position
     world.system<Position, Velocity>()
+        .multi_threaded()
         .each([&](Position& p, Velocity& v){
             p.x  += v.dx * DT;
             p.y  += v.dy * DT;
@@ -573,9 +645,9 @@ int main(int argc, char* argv[]) {
         std::cout<<i<<std::endl; 
 
         world.progress();
-        MyFile<<std::endl; // End the line started in the write to file system
 
-        // Calculate density grid at each time step
+        // Calculate density grid at each output step
+        if (!rates.ticked(output)) { continue; }
         density_matrix = {{}}; 
         for(int i = GY; i >= 0; i--)
         {
@@ -590,6 +662,7 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    writer.flush();
     MyFile.close(); 
 
     t = clock() - t; 
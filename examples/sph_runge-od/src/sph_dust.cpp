@@ -19,14 +19,27 @@ Spline Kernel: Monaghan SPH Review article 1992
 
 #include <iostream>
 #include <flecs.h>
+#include <gpecs/BulkSpawn.hpp>
+#include <gpecs/Driver.hpp>
+#include <gpecs/EventQueue.hpp>
+#include <gpecs/FrameArena.hpp>
+#include <gpecs/MemoryReport.hpp>
+#include <gpecs/Multirate.hpp>
+#include <gpecs/PerfCounters.hpp>
+#include <gpecs/Profiler.hpp>
+#include <gpecs/SnapshotWriter.hpp>
+#include <gpecs/TextWriter.hpp>
+#include <gpecs/Threads.hpp>
 #include <vector>
+#include <memory_resource>
+#include <span>
 #include <random>
 #include <cmath>
 #include <thread>
 #include <chrono>
-#include <fstream> 
 #include <time.h> 
 #include <algorithm>
+#include <limits>
 
 // Initialise Components 
 // Position component, plus start position at some time t_n
@@ -48,6 +61,14 @@ struct AccelerationK3 { double ddx, ddy; };
 struct Mass { double m; };
 struct ParticleIndex {int i; }; 
 struct Box {int k; }; 
+struct BoxCrossing {int from, to; }; 
+
+// Smallest time step limits found so far (not a component - one per worker)
+struct StepLimits {
+    double t_f = std::numeric_limits<double>::infinity();
+    double t_cx = std::numeric_limits<double>::infinity();
+    double t_cy = std::numeric_limits<double>::infinity();
+};
 
 // Walls of the box ----
 static constexpr double GX = 5;
@@ -154,9 +175,16 @@ double density_gambel(double position_r, std::vector<double> configuration, doub
     return Density; 
 }
 
+// The small vectors below (positions, distances, gradients, forces) are
+// allocated from `scratch`. Systems pass their thread's gpecs::FrameArena so
+// the force pass does not call malloc; each function allocates its result
+// before its temporaries, so the arena gets the temporaries straight back.
+using ScratchVec = std::pmr::vector<double>;
+
 // Function to calculate vector distance between particles 
-std::vector<double> vector_distance(std::vector<double> position_r, flecs::entity Particle_i){
-    std::vector<double> displacement; 
+ScratchVec vector_distance(const ScratchVec& position_r, flecs::entity Particle_i, std::pmr::memory_resource* scratch = std::pmr::get_default_resource()){
+    ScratchVec displacement(scratch); 
+    displacement.reserve(2);
 
     Position p_i = Particle_i.get<Position>();
 
@@ -167,19 +195,19 @@ std::vector<double> vector_distance(std::vector<double> position_r, flecs::entit
 }
 
 // Function to calculate the absolute magnitude of a vector
-double absolute_distance(std::vector<double> displacement){
+double absolute_distance(std::span<const double> displacement){
     double sum = 0; 
     for (int i = 0; i < displacement.size(); i++) { sum += displacement[i]*displacement[i]; }
     return sqrt(sum); 
 }
 
 // Function to caluclate density rho at some position
-double density(std::vector<double> position_r, std::vector<flecs::entity> Particles){
+double density(const ScratchVec& position_r, const std::vector<flecs::entity>& Particles, std::pmr::memory_resource* scratch = std::pmr::get_default_resource()){
     double Density = 0; 
 
     for (int j=0; j<Particles.size(); j++)
     {
-        std::vector<double> distance_vec = vector_distance(position_r,Particles[j]); 
+        ScratchVec distance_vec = vector_distance(position_r,Particles[j],scratch); 
         double R = absolute_distance(distance_vec);  
         Density += Particles[j].get<Mass>().m * gaussian_W(R,CONST_H); 
     }
@@ -188,15 +216,17 @@ double density(std::vector<double> position_r, std::vector<flecs::entity> Partic
 }
 
 // Gradient of Gaussian Interpolant Function
-std::vector<double> grad_gaussian_W(flecs::entity p_a, flecs::entity p_b) 
+ScratchVec grad_gaussian_W(flecs::entity p_a, flecs::entity p_b, std::pmr::memory_resource* scratch = std::pmr::get_default_resource()) 
 { 
-    std::vector<double> pos_a; 
+    ScratchVec grad(scratch); 
+    grad.reserve(2);
+    ScratchVec pos_a(scratch); 
+    pos_a.reserve(2);
     pos_a.push_back(p_a.get<Position>().x); 
     pos_a.push_back(p_a.get<Position>().y); 
 
-    std::vector<double> vec_distance = vector_distance(pos_a,p_b); 
+    ScratchVec vec_distance = vector_distance(pos_a,p_b,scratch); 
     double R = absolute_distance(vec_distance); 
-    std::vector<double> grad; 
                                                                                                                // ! Spline XXXX 
     for(int i = 0; i < vec_distance.size(); i++) { grad.push_back( - (2 / (CONST_H*CONST_H)) * vec_distance[i] * gaussian_W(R,CONST_H)); }
 
@@ -204,21 +234,23 @@ std::vector<double> grad_gaussian_W(flecs::entity p_a, flecs::entity p_b)
 } 
 
 // Gradient of Spline Interpolant Function
-std::vector<double> grad_spline_W(flecs::entity p_a, flecs::entity p_b)
+ScratchVec grad_spline_W(flecs::entity p_a, flecs::entity p_b, std::pmr::memory_resource* scratch = std::pmr::get_default_resource())
 {
+    ScratchVec grad(scratch);
+    grad.reserve(2);
+
     // Get the vector position of particle a
-    std::vector<double> pos_a; 
+    ScratchVec pos_a(scratch); 
+    pos_a.reserve(2);
     pos_a.push_back(p_a.get<Position>().x); 
     pos_a.push_back(p_a.get<Position>().y); 
 
-    std::vector<double> vec_distance = vector_distance(pos_a,p_b); 
+    ScratchVec vec_distance = vector_distance(pos_a,p_b,scratch); 
     double R = absolute_distance(vec_distance); 
 
     double q = R / CONST_H; 
     double c = SIGMA / pow(CONST_H,NO_DIMENSIONS); 
 
-    std::vector<double> grad;
-
     if( (q >= 0) && (q <= 1) )
     {
         for(int i = 0; i < vec_distance.size(); i++) 
@@ -239,15 +271,16 @@ std::vector<double> grad_spline_W(flecs::entity p_a, flecs::entity p_b)
 
 // Equations of state -- rho_i can be input into some equation of state to find pressure
 // Van der Waals equation of state to find pressure -- "A review of SPH" equation 
-double vdw_pressure(std::vector<flecs::entity> Particles, flecs::entity particle){
+double vdw_pressure(const std::vector<flecs::entity>& Particles, flecs::entity particle, std::pmr::memory_resource* scratch = std::pmr::get_default_resource()){
     
     double mass = particle.get<Mass>().m; 
 
-    std::vector<double> particle_position; 
+    ScratchVec particle_position(scratch); 
+    particle_position.reserve(2);
     particle_position.push_back(particle.get<Position>().x); 
     particle_position.push_back(particle.get<Position>().y); 
 
-    double Density = density(particle_position,Particles); 
+    double Density = density(particle_position,Particles,scratch); 
 
     double alpha_bar = ALPHA / mass; 
     double beta_bar = BETA / mass; 
@@ -257,22 +290,22 @@ double vdw_pressure(std::vector<flecs::entity> Particles, flecs::entity particle
 }
 
 // Function to calculate force on particle a due to all other particles      
-std::vector<double> force(std::vector<flecs::entity> Particles, flecs::entity Particle_a){
-    std::vector<double> Force = {0.0,0.0}; 
+ScratchVec force(const std::vector<flecs::entity>& Particles, flecs::entity Particle_a, std::pmr::memory_resource* scratch = std::pmr::get_default_resource()){
+    ScratchVec Force({0.0,0.0}, scratch); 
 
     // Particle a position
     double x_a = Particle_a.get<Position>().x; 
     double y_a = Particle_a.get<Position>().y;
-    std::vector<double> particle_a_position = {x_a,y_a};
+    ScratchVec particle_a_position({x_a,y_a}, scratch);
 
     // Particle a mass
     double m_a = Particle_a.get<Mass>().m; 
 
     // Pressure at particle a
-    double p_a = vdw_pressure(Particles, Particle_a);
+    double p_a = vdw_pressure(Particles, Particle_a, scratch);
 
     // Density at particle a
-    double rho_a = density(particle_a_position,Particles);
+    double rho_a = density(particle_a_position,Particles,scratch);
 
     for(int i = 0; i < Particles.size()-1; i++)
     {
@@ -281,26 +314,26 @@ std::vector<double> force(std::vector<flecs::entity> Particles, flecs::entity Pa
         {
             double x_b = Particles[i].get<Position>().x;
             double y_b = Particles[i].get<Position>().y;
-            std::vector<double> particle_b_position = {x_b,y_b}; 
+            ScratchVec particle_b_position({x_b,y_b}, scratch); 
 
             // Vector distance r_a - r_i --> Absolute distance R
-            std::vector<double> disp = vector_distance(particle_a_position,Particles[i]); 
+            ScratchVec disp = vector_distance(particle_a_position,Particles[i],scratch); 
             double R = absolute_distance(disp);
 
             // Particle i mass
             double m_b = Particles[i].get<Mass>().m;
 
             // Pressure at particle i
-            double p_b = vdw_pressure(Particles, Particles[i]);
+            double p_b = vdw_pressure(Particles, Particles[i], scratch);
 
             // Desnity at particle i
-            double rho_b = density(particle_b_position,Particles);
+            double rho_b = density(particle_b_position,Particles,scratch);
 
             // make into one constant
             double constant = - (m_a * m_b) * ( p_b / (pow(rho_b,2)) + p_a / (pow(rho_a,2)) ); 
 
             // Gradient of W(r_a - r_i)
-            std::vector<double> grad_W = grad_gaussian_W(Particle_a, Particles[i]); 
+            ScratchVec grad_W = grad_gaussian_W(Particle_a, Particles[i], scratch); 
 
             Force[0] += constant * grad_W[0]; 
             Force[1] += constant * grad_W[1];
@@ -310,6 +343,49 @@ std::vector<double> force(std::vector<flecs::entity> Particles, flecs::entity Pa
     return Force; 
 }
 
+// density() from copies of the particles' positions and masses, so it can
+// run while the next step changes them
+double density(std::vector<double> position_r, const std::vector<Position>& positions, const std::vector<double>& masses){
+    double Density = 0; 
+
+    for (std::size_t j=0; j<positions.size(); j++)
+    {
+        std::vector<double> distance_vec = {position_r[0] - positions[j].x, position_r[1] - positions[j].y}; 
+        double R = absolute_distance(distance_vec);  
+        Density += masses[j] * gaussian_W(R,CONST_H); 
+    }
+
+    return Density; 
+}
+
+// Calculate the density grid of this step and write it out. The particles
+// are copied on the main thread; the grid is worked out on the driver's
+// background thread while the next step runs (see include/gpecs/Driver.hpp)
+gpecs::Task density_grid(gpecs::Driver& driver, gpecs::Strand strand,
+                         const std::vector<flecs::entity>& particles, gpecs::TextWriter& MyFile_density)
+{
+    std::vector<Position> positions; 
+    std::vector<double> masses; 
+    for(int j = 0; j < particles.size(); j++)
+    {
+        positions.push_back(particles[j].get<Position>()); 
+        masses.push_back(particles[j].get<Mass>().m); 
+    }
+
+    co_await driver.on(strand); 
+
+    std::vector<std::vector<double>> density_matrix(GY+1); 
+    for(int i = GY; i >= 0; i--)
+    {
+        for(int j = 0; j < (GX+GX2)+1; j++)
+        {
+            density_matrix[GY-i].push_back(density({double(j),double(i)},positions,masses)); 
+            if(j < (GX+GX2)) { MyFile_density<<density_matrix[GY-i][j]<<","; }
+            else { MyFile_density<<density_matrix[GY-i][j]<<std::endl; } 
+        } 
+    }
+}
+
 // Function to print elements of a matrix - useful for debugging
 void print_matrix(std::vector<std::vector<double>> matrix)
 {
@@ -329,7 +405,7 @@ int main(int argc, char* argv[]) {
     t = clock(); 
 
     // Open file for writing - Data file
-    std::ofstream MyFile;
+    gpecs::TextWriter MyFile;
     MyFile.open("/Users/oluwoledelano/ECS_Development/flecs-in-docker/Sketches/OD/SPH_Runge/outputs/SPH_Runge_Dust.txt");
     if (!MyFile.is_open())
     {
@@ -339,7 +415,7 @@ int main(int argc, char* argv[]) {
     MyFile << "Particle 1 position x_1 (cm), y_1 (cm), Particle 1 velocity v_x, v_y, Particle 1 Density |  x_2,y_2,v_x,v_y,rho_2 ; ..."<< std::endl;
 
     // Open file for writing - Specifications file
-    std::ofstream MyFile_specs; 
+    gpecs::TextWriter MyFile_specs; 
     MyFile_specs.open("/Users/oluwoledelano/ECS_Development/flecs-in-docker/Sketches/OD/SPH_Runge/outputs/SPH_Runge_specifications.txt");
     if (!MyFile_specs.is_open())
     {
@@ -353,7 +429,7 @@ int main(int argc, char* argv[]) {
     MyFile_specs.close(); 
 
     // Open file for writing - Density field file
-    std::ofstream MyFile_density;
+    gpecs::TextWriter MyFile_density;
     MyFile_density.open("/Users/oluwoledelano/ECS_Development/flecs-in-docker/Sketches/OD/SPH_Runge/outputs/density_field.txt");
     if (!MyFile_density.is_open())
     {
@@ -362,7 +438,7 @@ int main(int argc, char* argv[]) {
     }
 
     // Open file for writing - Gambel Density field file
-    std::ofstream MyFile_gambel;
+    gpecs::TextWriter MyFile_gambel;
     std::string fileGambel="";
     std::string path = "/Users/oluwoledelano/ECS_Development/flecs-in-docker/Sketches/OD/SPH_Runge/outputs/"; 
     if(NO_GAMBEL_PARTICLES == 20) { fileGambel=path+"Gambel_Density_ParticleNo=20.txt"; }
@@ -379,7 +455,7 @@ int main(int argc, char* argv[]) {
     }
 
     // Open file for writing - Particle number density file
-    std::ofstream MyFile_NoDensity;
+    gpecs::TextWriter MyFile_NoDensity;
     std::string fileNoDensity="";
     if(NO_PARTICLES == 20) { fileNoDensity=path+"Particle_Number_Density_No=20.txt"; }
     else if(NO_PARTICLES == 50) { fileNoDensity=path+"Particle_Number_Density_No=50.txt"; }
@@ -394,22 +470,38 @@ int main(int argc, char* argv[]) {
 
     // Create the flecs world
     flecs::world world(argc,argv);
-
-    // Components of the world
-    world.component<Position>(); 
-    world.component<StartPosition>(); 
-    world.component<Velocity>(); 
-    world.component<StartVelocity>();
-    world.component<VelocityK1>();
-    world.component<VelocityK2>(); 
-    world.component<VelocityK3>();
-    world.component<Acceleration>(); 
-    world.component<StartAcceleration>();
-    world.component<AccelerationK1>();
-    world.component<AccelerationK2>();
-    world.component<AccelerationK3>();
-    world.component<Mass>(); 
-    world.component<Box>(); 
+    gpecs::use_threads(world, argc, argv);
+    auto profiler = gpecs::profile_from_args(world, argc, argv);
+    auto perf = gpecs::perf_from_args(world, argc, argv);
+    auto memory = gpecs::memory_from_args(world, argc, argv);
+    // Scratch memory for the force pass, per thread; `--arena -` prints how much it used
+    auto arena = gpecs::arena_from_args(world, argc, argv);
+    // The time step check and the output cost as much as a step; `--check-every K`
+    // and `--output-every K` run them on every K-th step only (steps 0, K, 2K, ...)
+    gpecs::Multirate rates(world);
+    flecs::entity check = rates.every(gpecs::rate_from_args(argc, argv, "--check-every"));
+    flecs::entity output = rates.every(gpecs::rate_from_args(argc, argv, "--output-every"));
+    // Runs the density grid of each step in the background; `--timeline -`
+    // prints how much of it overlapped with the steps
+    auto driver = gpecs::driver_from_args(argc, argv);
+    gpecs::Strand density_strand = driver->strand("density grid");
+
+    // Components of the world, with their members so --memory can show padding
+    world.component<Position>().member("x", &Position::x).member("y", &Position::y);
+    world.component<StartPosition>().member("x", &StartPosition::x).member("y", &StartPosition::y);
+    world.component<Velocity>().member("dx", &Velocity::dx).member("dy", &Velocity::dy);
+    world.component<StartVelocity>().member("dx", &StartVelocity::dx).member("dy", &StartVelocity::dy);
+    world.component<VelocityK1>().member("dx", &VelocityK1::dx).member("dy", &VelocityK1::dy);
+    world.component<VelocityK2>().member("dx", &VelocityK2::dx).member("dy", &VelocityK2::dy);
+    world.component<VelocityK3>().member("dx", &VelocityK3::dx).member("dy", &VelocityK3::dy);
+    world.component<Acceleration>().member("ddx", &Acceleration::ddx).member("ddy", &Acceleration::ddy);
+    world.component<StartAcceleration>().member("ddx", &StartAcceleration::ddx).member("ddy", &StartAcceleration::ddy);
+    world.component<AccelerationK1>().member("ddx", &AccelerationK1::ddx).member("ddy", &AccelerationK1::ddy);
+    world.component<AccelerationK2>().member("ddx", &AccelerationK2::ddx).member("ddy", &AccelerationK2::ddy);
+    world.component<AccelerationK3>().member("ddx", &AccelerationK3::ddx).member("ddy", &AccelerationK3::ddy);
+    world.component<Mass>().member("m", &Mass::m);
+    world.component<Box>().member("k", &Box::k);
+    world.component<ParticleIndex>().member("i", &ParticleIndex::i);
 
     // Tools for picking random numbers
     std::mt19937 rng( std::random_device{}()  ) ; // Initialise a random number generator with random device (for actual use)
@@ -434,10 +526,6 @@ int main(int argc, char* argv[]) {
     std::vector<double> y_velocities; 
     y_velocities.reserve(NO_PARTICLES);
 
-    // Create density matrix
-    std::vector<std::vector<double>> density_matrix;
-    density_matrix.reserve(GY*(GX+GX2)); 
-
     double v_x = Uvel(rng);
     double v_y = Uvel(rng); 
     int j = 0; 
@@ -459,39 +547,75 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    for (int i = 0; i < NO_PARTICLES; ++i) { 
-        particles.push_back( 
-            world.entity() 
-                .set<ParticleIndex>({i}) 
-                .set<Position>({UposX(rng), UposY(rng)}) 
-                .set<StartPosition>({0.0, 0.0})  
-                .set<Velocity>({x_velocities[i], y_velocities[i]})
-                .set<StartVelocity>({0.0, 0.0})  
-                .set<VelocityK1>({0.0, 0.0})
-                .set<VelocityK2>({0.0, 0.0})
-                .set<VelocityK3>({0.0, 0.0})
-                .set<Acceleration>({0.0, 0.0})
-                .set<StartAcceleration>({0.0, 0.0})  
-                .set<AccelerationK1>({0.0, 0.0})
-                .set<AccelerationK2>({0.0, 0.0})
-                .set<AccelerationK3>({0.0, 0.0})
-                .set<Mass>({PARTICLE_MASS})
-                .set<Box>({1})); 
-    } 
+    particles = gpecs::BulkSpawner<ParticleIndex, Position, StartPosition, Velocity, StartVelocity,
+                                   VelocityK1, VelocityK2, VelocityK3, Acceleration, StartAcceleration,
+                                   AccelerationK1, AccelerationK2, AccelerationK3, Mass, Box>(world)
+        .spawn(NO_PARTICLES, [&](int32_t i, ParticleIndex& index, Position& p, StartPosition& pStart,
+                                 Velocity& v, StartVelocity& vStart, VelocityK1& velk1, VelocityK2& velk2,
+                                 VelocityK3& velk3, Acceleration& a, StartAcceleration& aStart,
+                                 AccelerationK1& acck1, AccelerationK2& acck2, AccelerationK3& acck3,
+                                 Mass& m, Box& b) {
+            index = {i};
+            p = {UposX(rng), UposY(rng)};
+            pStart = {0.0, 0.0};
+            v = {x_velocities[i], y_velocities[i]};
+            vStart = {0.0, 0.0};
+            velk1 = {0.0, 0.0};
+            velk2 = {0.0, 0.0};
+            velk3 = {0.0, 0.0};
+            a = {0.0, 0.0};
+            aStart = {0.0, 0.0};
+            acck1 = {0.0, 0.0};
+            acck2 = {0.0, 0.0};
+            acck3 = {0.0, 0.0};
+            m = {PARTICLE_MASS};
+            b = {1};
+        });
 
     // Note: Systems run in order they are coded in
 
-    // Write to file
-    world.system<Position, Velocity>()
+    // Write to file - stays single threaded so the particles are copied
+    // one at a time, in the same order every step. The copies are formatted
+    // and written on a background thread while the step carries on.
+    gpecs::SnapshotWriter writer(4);
+    world.system<const Position, const Velocity>()
         .kind(flecs::PreUpdate)
-        .each([&](Position& p, Velocity &v){
-            MyFile << p.x << "," << p.y << "," << v.dx << "," << v.dy << "," << density({p.x,p.y},particles) << "|" ;
+        .tick_source(output)
+        .run([&](flecs::iter& it){
+            gpecs::Snapshot& snap = writer.acquire(it.world().get_info()->frame_count_total);
+            while (it.next()) {
+                auto p = it.field<const Position>(0);
+                auto v = it.field<const Velocity>(1);
+                for (auto row : it) {
+                    snap.append(0, &p[row], 1);
+                    snap.append(1, &v[row], 1);
+                    const double rho = density(ScratchVec({p[row].x, p[row].y}, arena->local()), particles, arena->local());
+                    snap.append(2, &rho, 1);
+                }
+            }
+            writer.submit(snap, [&MyFile](const gpecs::Snapshot& snap){
+                auto p = snap.column<Position>(0);
+                auto v = snap.column<Velocity>(1);
+                auto rho = snap.column<double>(2);
+                for (std::size_t i = 0; i < p.size(); ++i) {
+                    MyFile << p[i].x << "," << p[i].y << "," << v[i].dx << "," << v[i].dy << "," << rho[i] << "|" ;
+                }
+                MyFile<<std::endl; // End the line of particles written this step
+            });
         });
 
     // Check for collision
+    // A particle that goes through the slit posts a BoxCrossing, and the
+    // number of particles in each box is updated from them at the end of the
+    // step, so the main loop no longer has to look at every particle
+    gpecs::EventQueue<BoxCrossing> crossings(world);
+    int box_count[2] = {0, 0};
+    for(int i = 0; i < particles.size(); i++) { box_count[particles[i].get<Box>().k] += 1; }
+
     world.system<Position, Velocity, Acceleration, Box>()
         .kind(flecs::PreUpdate)
-        .each([&](Position& p, Velocity& v, Acceleration& a, Box& b){
+        .multi_threaded()
+        .each([&](flecs::iter& it, size_t row, Position& p, Velocity& v, Acceleration& a, Box& b){
 
             int cx = int(std::floor(p.x)); // Round down to nearest integer
             int upx = int(std::ceil(p.x)); 
@@ -508,45 +632,55 @@ int main(int argc, char* argv[]) {
             else if (b.k == 1 && !( (p.y > (GY/2 - SLIT_WIDTH/2)) && (p.y < (GY/2 + SLIT_WIDTH/2)) ) )
             { if ( (upx <= GX) )  { v.dx = -v.dx; } }// a.ddx = -a.ddx;} }
             else 
-            { if (p.x > GX) {b.k = 1; } else {b.k = 0; }}
+            {
+                int k = (p.x > GX) ? 1 : 0;
+                if (k != b.k) { crossings.emit(it, row, {b.k, k}); b.k = k; }
+            }
         });
 
+    crossings.drain(world, flecs::PostUpdate, [&](const BoxCrossing& c){
+        box_count[c.from] -= 1;
+        box_count[c.to] += 1;
+    });
+
     // Check that time step isn't too large
-    world.system<>()
-        .kind(flecs::PreUpdate)
-        .each([&](){
+    // Each worker finds the smallest limits over its own particles, then a
+    // single threaded system takes the minimum over the workers and reports
+    gpecs::PerWorker<StepLimits> limits(world);
 
-            double dt = 0;
+    world.system<Velocity, ParticleIndex>()
+        .kind(flecs::PreUpdate)
+        .tick_source(check)
+        .multi_threaded()
+        .each([&](flecs::iter& it, size_t, Velocity& v, ParticleIndex& index){
+            StepLimits& limit = limits.local(it);
 
             // Particle acceleration constraint | finding min( h / sqrt(F_i) )
-            double t_f = 0;
-            for(int i = 0; i < particles.size(); i++){
-                std::vector<double> Force = force(particles, particles[i]);
-                double abs_force = absolute_distance(Force); // Function to calculate |r| can be used similarly for F
-                double t1 = CONST_H / sqrt(abs_force); 
-                
-                if (i == 0) { t_f = t1; }
-                else if(t1<t_f) { t_f = t1; }
-            }
+            ScratchVec Force = force(particles, particles[index.i], arena->local());
+            double abs_force = absolute_distance(Force); // Function to calculate |r| can be used similarly for F
+            limit.t_f = std::min(limit.t_f, CONST_H / sqrt(abs_force));
 
             // CFL condition in the x and y directions
-            double t_cx = 0;
-            double t_cy = 0;
-            for(int i = 0; i < particles.size(); i++){
-                double t2 = ( COURANT_NO * CONST_H ) / abs(particles[i].get<Velocity>().dx) ; 
-                if (i == 0) { t_cx = t2; }
-                else if(t2<t_cx) { t_cx = t2; }
-            }
-            for(int i = 0; i < particles.size(); i++){
-                double t2 = ( COURANT_NO * CONST_H ) / abs(particles[i].get<Velocity>().dy) ; 
-                if (i == 0) { t_cy = t2; }
-                else if(t2<t_cy) { t_cy = t2; }
-            }
+            limit.t_cx = std::min(limit.t_cx, ( COURANT_NO * CONST_H ) / abs(v.dx));
+            limit.t_cy = std::min(limit.t_cy, ( COURANT_NO * CONST_H ) / abs(v.dy));
+        });
+
+    world.system<>()
+        .kind(flecs::PreUpdate)
+        .tick_source(check)
+        .run([&](flecs::iter&){
+
+            StepLimits limit;
+            limits.merge([&](StepLimits& worker){
+                limit.t_f = std::min(limit.t_f, worker.t_f);
+                limit.t_cx = std::min(limit.t_cx, worker.t_cx);
+                limit.t_cy = std::min(limit.t_cy, worker.t_cy);
+            });
 
             // Find the minimum value of all these constraints
-            double t_c = std::min(t_cx,t_cy); 
+            double t_c = std::min(limit.t_cx,limit.t_cy); 
 
-            dt = 0.3 * std::min(t_f,t_c); 
+            double dt = 0.3 * std::min(limit.t_f,t_c); 
 
             if(DT > dt) { std::cout<<"ERROR: Time step too large. Decrease by "<<(DT-dt)<<std::endl; }
         });
@@ -554,6 +688,7 @@ int main(int argc, char* argv[]) {
     // RK1: Half predict Velocity, Position. Guess components at time t_{n+1/2}
     world.system<Position, StartPosition, Velocity, StartVelocity, Acceleration, StartAcceleration,
                 VelocityK1, VelocityK2, VelocityK3, AccelerationK1, AccelerationK2, AccelerationK3>()
+        .multi_threaded()
         .each([&](Position& p, StartPosition& pStart, Velocity& v, StartVelocity& vStart, Acceleration& a, StartAcceleration& aStart,
                 VelocityK1& velk1, VelocityK2& velk2, VelocityK3& velk3, AccelerationK1& acck1, AccelerationK2& acck2, AccelerationK3& acck3)
         {
@@ -578,11 +713,17 @@ int main(int argc, char* argv[]) {
             velk1.dy = v.dy;
         });
 
+    // The force passes below read every particle's position, and the stages
+    // between them move positions, so every stage has to finish on every
+    // worker before the next one starts
+    gpecs::sync_point(world);
+
     // RK1: Half predict acceleration - calculate a(t_{n+1/2}) based on the p,v just predicted
     world.system<Acceleration, Mass, ParticleIndex, AccelerationK1>()
+        .multi_threaded()
         .each([&](Acceleration& a,Mass& m, ParticleIndex& index, AccelerationK1& acck1)
         {
-            std::vector<double> Force = force(particles, particles[index.i]);
+            ScratchVec Force = force(particles, particles[index.i], arena->local());
 
             a.ddx = Force[0] / m.m;
             a.ddy = Force[1] / m.m; 
@@ -592,8 +733,11 @@ int main(int argc, char* argv[]) {
             acck1.ddy = a.ddy;             
         });
 
+    gpecs::sync_point(world);
+
     // RK2: Half correct position and velocity
     world.system<Position, StartPosition, Velocity, StartVelocity, Acceleration, StartAcceleration, VelocityK2>()
+        .multi_threaded()
         .each([&](Position& p, StartPosition& pStart, Velocity& v, StartVelocity& vStart, Acceleration& a, StartAcceleration& aStart, VelocityK2& velk2)
         {
             // Half correct position 
@@ -609,11 +753,14 @@ int main(int argc, char* argv[]) {
             velk2.dy = v.dy;
         });
     
+    gpecs::sync_point(world);
+
     // RK2: Half correct acceleration - correct a(t_{n+1/2}) based on the p,v just predicted
     world.system<Acceleration, Mass, ParticleIndex, AccelerationK2>()
+        .multi_threaded()
         .each([&](Acceleration& a,Mass& m, ParticleIndex& index, AccelerationK2& acck2)
         {
-            std::vector<double> Force = force(particles, particles[index.i]);
+            ScratchVec Force = force(particles, particles[index.i], arena->local());
 
             a.ddx = Force[0] / m.m;
             a.ddy = Force[1] / m.m; 
@@ -623,8 +770,11 @@ int main(int argc, char* argv[]) {
             acck2.ddy = a.ddy;             
         });
     
+    gpecs::sync_point(world);
+
     // RK3: Full predict position, velocity
     world.system<Position, StartPosition, Velocity, StartVelocity, Acceleration, StartAcceleration, VelocityK3>()
+        .multi_threaded()
         .each([&](Position& p, StartPosition& pStart, Velocity& v, StartVelocity& vStart, Acceleration& a, StartAcceleration& aStart, VelocityK3& velk3)
         {
             // Full predict position 
@@ -640,11 +790,14 @@ int main(int argc, char* argv[]) {
             velk3.dy = v.dy;
         });
 
+    gpecs::sync_point(world);
+
     // RK3: Full predict acceleration - predict a(t_{n+1) based on the p,v just predicted
     world.system<Acceleration, Mass, ParticleIndex, AccelerationK3>()
+        .multi_threaded()
         .each([&](Acceleration& a,Mass& m, ParticleIndex& index, AccelerationK3& acck3)
         {
-            std::vector<double> Force = force(particles, particles[index.i]);
+            ScratchVec Force = force(particles, particles[index.i], arena->local());
 
             a.ddx = Force[0] / m.m;
             a.ddy = Force[1] / m.m; 
@@ -654,9 +807,12 @@ int main(int argc, char* argv[]) {
             acck3.ddy = a.ddy;             
         });
     
+    gpecs::sync_point(world);
+
     // RK4: End correct position, velocity - final answer
     world.system<Position, StartPosition, Velocity, StartVelocity, Acceleration, StartAcceleration,
                 VelocityK1, VelocityK2, VelocityK3, AccelerationK1, AccelerationK2, AccelerationK3>()
+        .multi_threaded()
         .each([&](Position& p, StartPosition& pStart, Velocity& v, StartVelocity& vStart, Acceleration& a, StartAcceleration& aStart,
                     VelocityK1& velk1, VelocityK2& velk2, VelocityK3& velk3, AccelerationK1& acck1, AccelerationK2& acck2, AccelerationK3& acck3)
         {
@@ -670,10 +826,13 @@ int main(int argc, char* argv[]) {
             v.dy = vStart.dy + (DT/6) * ( acck1.ddy + 2*acck2.ddy + 2*acck3.ddy + a.ddy ) ;
         });
     
+    gpecs::sync_point(world);
+
     // RK4: End correct acceleration (Final answer)
     world.system<Position, Velocity, Acceleration, Mass, ParticleIndex>()
+        .multi_threaded()
         .each([&](Position& p, Velocity& v, Acceleration& a, Mass& m, ParticleIndex& index){
-            std::vector<double> Force = force(particles, particles[index.i]);
+            ScratchVec Force = force(particles, particles[index.i], arena->local());
 
             a.ddx = Force[0] / m.m;
             a.ddy = Force[1] / m.m; 
@@ -721,33 +880,19 @@ int main(int argc, char* argv[]) {
         // Print current step
         std::cout<<i<<std::endl; 
 
-        world.progress();
-        MyFile<<std::endl; // End the line started in the write to file system
+        driver->progress(world);
 
-        // Calculate density grid at each time step
-        density_matrix = {{}}; 
-        for(int i = GY; i >= 0; i--)
-        {
-            for(int j = 0; j < (GX+GX2)+1; j++)
-            {
-                density_matrix[GY-i].push_back(density({double(j),double(i)},particles)); 
-                if(j < (GX+GX2)) { MyFile_density<<density_matrix[GY-i][j]<<","; }
-                else { MyFile_density<<density_matrix[GY-i][j]<<std::endl; } 
-            } 
+        // Calculate density grid at each output step
+        if (rates.ticked(output)) {
+            driver->spawn(i, density_grid(*driver, density_strand, particles, MyFile_density));
         }
 
-        // Calculate the number of particles per box at each step
-        int box1 = 0; 
-        int box2 = 0; 
-        for(int i = 0; i < particles.size(); i++)
-        {
-            if(particles[i].get<Box>().k == 0){box1 += 1;}
-            else if(particles[i].get<Box>().k == 1){box2 += 1;}
-            else{std::cout<<"What the hell is happening"<<std::endl;}
-        }
-        MyFile_NoDensity<<box1<<","<<box2<<std::endl; 
+        // Number of particles per box at each step
+        MyFile_NoDensity<<box_count[0]<<","<<box_count[1]<<std::endl; 
     }
 
+    driver->flush();
+    writer.flush();
     MyFile.close(); 
 
     t = clock() - t; 
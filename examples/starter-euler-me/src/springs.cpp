@@ -13,11 +13,12 @@ Entity types:
  - Particle
 */
 #include <iostream>
-#include <fstream> 
 #include <vector>
 #include <cmath>
 #include <flecs.h>
 #include <systems.h>
+#include <gpecs/TextWriter.hpp>
+#include <gpecs/Threads.hpp>
 
 double l = 1; // natural spring length
 double k = 4*M_PI*M_PI; // spring constant in N m-2
@@ -70,7 +71,7 @@ const float mass, float k_left, float k_right, float l_left, float l_right)
 
 int main(int argc, char* argv[]) {
 
-    std::ofstream MyFile; 
+    gpecs::TextWriter MyFile; 
     MyFile.open("Coupled_Oscillators.txt");
     if (!MyFile.is_open())
     {
@@ -85,6 +86,7 @@ int main(int argc, char* argv[]) {
     const std::vector<double> l_list {l, l, l}; // Natural Spring Lengths
     
     flecs::world world(argc, argv);
+    gpecs::use_threads(world, argc, argv);
 
     // Creates Phases which tell the program in which order to run the systems
 
@@ -126,6 +128,7 @@ int main(int argc, char* argv[]) {
     world.system<Position, Velocity>()
         .with<BulkTag>()
         .kind(position_phase)
+        .multi_threaded()
         .each([&](Position& pos, Velocity& vel){
             pos.x += vel.x*time_step;
         });
@@ -133,12 +136,18 @@ int main(int argc, char* argv[]) {
     world.system<Velocity, Acceleration>()
         .with<BulkTag>()
         .kind(velocity_phase)
+        .multi_threaded()
         .each([&](Velocity& vel, Acceleration& acc){
             vel.x += acc.x*time_step;
         });
     
+    // The accelerations read the neighbouring nodes' positions, so every
+    // worker has to have finished moving its nodes first
+    gpecs::sync_point(world, acceleration_phase);
+
     world.system<Index, Position, Acceleration, Mass>()
         .kind(acceleration_phase)
+        .multi_threaded()
         .each([&](Index& ind, Position& pos, Acceleration& acc, Mass& mass){
             double p_left;
             double p_right;
@@ -14,11 +14,15 @@ Entity types:
 */
 #include <ccenergy/EnergyTracker.hpp>
 #include <iostream>
-#include <fstream> 
 #include <vector>
+#include <optional>
+#include <string>
 #include <cmath>
 #include <flecs.h>
 #include <systems.h>
+#include <gpecs/StaticPipeline.hpp>
+#include <gpecs/TextWriter.hpp>
+#include <gpecs/Threads.hpp>
 
 double l = 1; // natural spring length
 double k = 4*M_PI*M_PI; // spring constant in N m-2
@@ -77,7 +81,7 @@ const float mass, float k_left, float k_right, float l_left, float l_right)
 
 int main(int argc, char* argv[]) {
 
-    std::ofstream MyFile; 
+    gpecs::TextWriter MyFile; 
     MyFile.open("Coupled_Oscillators.txt");
     if (!MyFile.is_open())
     {
@@ -92,6 +96,10 @@ int main(int argc, char* argv[]) {
     const std::vector<double> l_list {l, l, l}; // Natural Spring Lengths
     
     flecs::world world(argc, argv);
+    gpecs::use_threads(world, argc, argv);
+    std::string pipeline_option;
+    const bool static_pipeline = gpecs::take_option(argc, argv, "--pipeline", pipeline_option)
+                                 && pipeline_option == "static";
 
     // Create the energy tracker
     ccenergy::EnergyTracker energy_tracker {{ .label = "OnUpdate",
@@ -172,26 +180,17 @@ int main(int argc, char* argv[]) {
             );
     }
 
-    world.system<>()
-        .kind(EnergyStart)
-        .each([&]() {
+    auto energy_start = [&]() {
             energy_tracker.start();
-        });
+        };
     
-    world.system<PositionStart, PositionHalfPredict, VelocityStart, VelocityHalfPredict,
-                 AccelerationStart>()
-        .with<BulkTag>()
-        .kind(RK1)
-        .each([&](PositionStart& posStart, PositionHalfPredict& posHalf, VelocityStart& velStart, 
+    auto rk1 = [&](PositionStart& posStart, PositionHalfPredict& posHalf, VelocityStart& velStart, 
         VelocityHalfPredict& velHalf, AccelerationStart& accStart){
             posHalf.x = posStart.x + ((time_step/2)*velStart.x);
             velHalf.x = velStart.x + ((time_step/2)*accStart.x);
-        });
+        };
 
-    world.system<Index, PositionHalfPredict, AccelerationHalfPredict, Mass>()
-        .with<BulkTag>()
-        .kind(A1)
-        .each([&](Index& ind, PositionHalfPredict& pos, AccelerationHalfPredict& acc, Mass& mass){
+    auto accel1 = [&](Index& ind, PositionHalfPredict& pos, AccelerationHalfPredict& acc, Mass& mass){
             double p_left;
             double p_right;
             if (ind.i == 0) {
@@ -210,23 +209,16 @@ int main(int argc, char* argv[]) {
             }
         acc.x = acceleration(pos.x, p_left, p_right, mass.M, k_list[ind.i], 
                                     k_list[ind.i+1], l_list[ind.i], l_list[ind.i+1]);
-        });
+        };
 
-    world.system<PositionStart, PositionHalfCorrect, VelocityStart, 
-                 VelocityHalfPredict, VelocityHalfCorrect, AccelerationHalfPredict>()
-        .with<BulkTag>()
-        .kind(RK2)
-        .each([&](PositionStart& posStart, PositionHalfCorrect& posCorr,  VelocityStart& velStart, 
+    auto rk2 = [&](PositionStart& posStart, PositionHalfCorrect& posCorr,  VelocityStart& velStart, 
         VelocityHalfPredict& velPred, VelocityHalfCorrect& velCorr, 
         AccelerationHalfPredict& accPred){
             posCorr.x = posStart.x + ((time_step/2)*velPred.x);
             velCorr.x = velStart.x + ((time_step/2)*accPred.x);
-        });
+        };
 
-    world.system<Index, PositionHalfCorrect, AccelerationHalfCorrect, Mass>()
-        .with<BulkTag>()
-        .kind(A2)
-        .each([&](Index& ind, PositionHalfCorrect& pos, AccelerationHalfCorrect& acc, Mass& mass){
+    auto accel2 = [&](Index& ind, PositionHalfCorrect& pos, AccelerationHalfCorrect& acc, Mass& mass){
             double p_left;
             double p_right;
             if (ind.i == 0) {
@@ -245,22 +237,15 @@ int main(int argc, char* argv[]) {
             }
         acc.x = acceleration(pos.x, p_left, p_right, mass.M, k_list[ind.i], 
                                     k_list[ind.i+1], l_list[ind.i], l_list[ind.i+1]);
-        });
+        };
 
-    world.system<PositionStart, PositionEndPredict, VelocityStart, VelocityHalfCorrect, 
-                 VelocityEndPredict, AccelerationHalfCorrect>()
-        .with<BulkTag>()
-        .kind(RK3)
-        .each([&](PositionStart& posStart, PositionEndPredict& posEnd, VelocityStart& velStart, 
+    auto rk3 = [&](PositionStart& posStart, PositionEndPredict& posEnd, VelocityStart& velStart, 
         VelocityHalfCorrect& velHalf, VelocityEndPredict& velEnd, AccelerationHalfCorrect& accHalf){
             posEnd.x = posStart.x + ((time_step/2)*velHalf.x);
             velEnd.x = velStart.x + ((time_step/2)*accHalf.x);
-        });
+        };
 
-    world.system<Index, PositionEndPredict, AccelerationEndPredict, Mass>()
-        .with<BulkTag>()
-        .kind(A3)
-        .each([&](Index& ind, PositionEndPredict& pos, AccelerationEndPredict& acc, Mass& mass){
+    auto accel3 = [&](Index& ind, PositionEndPredict& pos, AccelerationEndPredict& acc, Mass& mass){
             double p_left;
             double p_right;
             if (ind.i == 0) {
@@ -279,24 +264,17 @@ int main(int argc, char* argv[]) {
             }
         acc.x = acceleration(pos.x, p_left, p_right, mass.M, k_list[ind.i], 
                                     k_list[ind.i+1], l_list[ind.i], l_list[ind.i+1]);
-        });
+        };
 
-    world.system<PositionStart, VelocityStart, VelocityHalfPredict, VelocityHalfCorrect, 
-                 VelocityEndPredict, AccelerationStart, AccelerationHalfPredict, 
-                 AccelerationHalfCorrect, AccelerationEndPredict>()
-        .with<BulkTag>()
-        .kind(RK_Update)
-        .each([&](PositionStart& pos, VelocityStart& velStart, VelocityHalfPredict& velPred, 
+    auto rk_update = [&](PositionStart& pos, VelocityStart& velStart, VelocityHalfPredict& velPred, 
         VelocityHalfCorrect& velCorr, VelocityEndPredict& velEnd, AccelerationStart& accStart, 
         AccelerationHalfPredict& accPred, AccelerationHalfCorrect& accCorr, 
         AccelerationEndPredict& accEnd){
             pos.x += ((time_step/6)*(velStart.x+2*velPred.x+2*velCorr.x+velEnd.x));
             velStart.x += ((time_step/6)*(accStart.x+2*accPred.x+2*accCorr.x+accEnd.x));
-        });
+        };
 
-    world.system<Index, PositionStart, AccelerationStart, Mass>()
-        .kind(A_Update)
-        .each([&](Index& ind, PositionStart& pos, AccelerationStart& acc, Mass& mass){
+    auto accel_update = [&](Index& ind, PositionStart& pos, AccelerationStart& acc, Mass& mass){
             double p_left;
             double p_right;
             if (ind.i == 0) {
@@ -315,16 +293,108 @@ int main(int argc, char* argv[]) {
             }
         acc.x = acceleration(pos.x, p_left, p_right, mass.M, k_list[ind.i], 
                                     k_list[ind.i+1], l_list[ind.i], l_list[ind.i+1]);
-        });
+        };
     
-     world.system<>()
-        .kind(EnergyEnd)
-        .each([&]() {
+    auto energy_end = [&]() {
             auto r = energy_tracker.stop();
-        });
-    
+        };
+
+    // With `--pipeline static` the same functions run as a
+    // gpecs::StaticPipeline instead of as flecs systems: for 2 particles
+    // flecs' scheduling takes most of each step (see
+    // include/gpecs/StaticPipeline.hpp). The first step only works out the
+    // accelerations, as the other systems wait for the BulkTag.
+    auto first_pipeline = [&]() {
+        return gpecs::StaticPipeline(world,
+            gpecs::stage(energy_start),
+            gpecs::stage<Index, PositionStart, AccelerationStart, Mass>(accel_update),
+            gpecs::stage(energy_end));
+    };
+    auto step_pipeline = [&]() {
+        return gpecs::StaticPipeline(world,
+            gpecs::stage(energy_start),
+            gpecs::stage<PositionStart, PositionHalfPredict, VelocityStart, VelocityHalfPredict,
+                         AccelerationStart>(rk1),
+            gpecs::stage<Index, PositionHalfPredict, AccelerationHalfPredict, Mass>(accel1),
+            gpecs::stage<PositionStart, PositionHalfCorrect, VelocityStart,
+                         VelocityHalfPredict, VelocityHalfCorrect, AccelerationHalfPredict>(rk2),
+            gpecs::stage<Index, PositionHalfCorrect, AccelerationHalfCorrect, Mass>(accel2),
+            gpecs::stage<PositionStart, PositionEndPredict, VelocityStart, VelocityHalfCorrect,
+                         VelocityEndPredict, AccelerationHalfCorrect>(rk3),
+            gpecs::stage<Index, PositionEndPredict, AccelerationEndPredict, Mass>(accel3),
+            gpecs::stage<PositionStart, VelocityStart, VelocityHalfPredict, VelocityHalfCorrect,
+                         VelocityEndPredict, AccelerationStart, AccelerationHalfPredict,
+                         AccelerationHalfCorrect, AccelerationEndPredict>(rk_update),
+            gpecs::stage<Index, PositionStart, AccelerationStart, Mass>(accel_update),
+            gpecs::stage(energy_end));
+    };
+    std::optional<decltype(first_pipeline())> first_step;
+    std::optional<decltype(step_pipeline())> step;
+    if (static_pipeline) {
+        first_step.emplace(first_pipeline());
+        step.emplace(step_pipeline());
+    } else {
+        // The acceleration phases read the neighbouring nodes' positions from
+        // the phase before, so with --threads every worker has to finish that
+        // phase first
+        gpecs::sync_point(world, A1);
+        gpecs::sync_point(world, A2);
+        gpecs::sync_point(world, A3);
+        gpecs::sync_point(world, A_Update);
+
+        world.system<>()
+            .kind(EnergyStart)
+            .each(energy_start);
+        world.system<PositionStart, PositionHalfPredict, VelocityStart, VelocityHalfPredict,
+                     AccelerationStart>()
+            .with<BulkTag>()
+            .kind(RK1)
+            .multi_threaded()
+            .each(rk1);
+        world.system<Index, PositionHalfPredict, AccelerationHalfPredict, Mass>()
+            .with<BulkTag>()
+            .kind(A1)
+            .multi_threaded()
+            .each(accel1);
+        world.system<PositionStart, PositionHalfCorrect, VelocityStart,
+                     VelocityHalfPredict, VelocityHalfCorrect, AccelerationHalfPredict>()
+            .with<BulkTag>()
+            .kind(RK2)
+            .multi_threaded()
+            .each(rk2);
+        world.system<Index, PositionHalfCorrect, AccelerationHalfCorrect, Mass>()
+            .with<BulkTag>()
+            .kind(A2)
+            .multi_threaded()
+            .each(accel2);
+        world.system<PositionStart, PositionEndPredict, VelocityStart, VelocityHalfCorrect,
+                     VelocityEndPredict, AccelerationHalfCorrect>()
+            .with<BulkTag>()
+            .kind(RK3)
+            .multi_threaded()
+            .each(rk3);
+        world.system<Index, PositionEndPredict, AccelerationEndPredict, Mass>()
+            .with<BulkTag>()
+            .kind(A3)
+            .multi_threaded()
+            .each(accel3);
+        world.system<PositionStart, VelocityStart, VelocityHalfPredict, VelocityHalfCorrect,
+                     VelocityEndPredict, AccelerationStart, AccelerationHalfPredict,
+                     AccelerationHalfCorrect, AccelerationEndPredict>()
+            .with<BulkTag>()
+            .kind(RK_Update)
+            .multi_threaded()
+            .each(rk_update);
+        world.system<Index, PositionStart, AccelerationStart, Mass>()
+            .kind(A_Update)
+            .multi_threaded()
+            .each(accel_update);
+        world.system<>()
+            .kind(EnergyEnd)
+            .each(energy_end);
+    }
     
-    world.progress();
+    if (static_pipeline) { first_step->progress(); } else { world.progress(); }
     const PositionStart& p1 = nodes[0].get<PositionStart>();
     const PositionStart& p2 = nodes[1].get<PositionStart>();
     const VelocityStart& v1 = nodes[0].get<VelocityStart>();
@@ -340,7 +410,7 @@ int main(int argc, char* argv[]) {
 
     // Run the system
     for (int i = 1; i <= run_time; i++) {
-        world.progress();
+        if (static_pipeline) { step->progress(); } else { world.progress(); }
         std::cout << i << "\n";
         std::cout << "----\n";
 
@@ -5,7 +5,7 @@ solved analytically.
 
 #include <iostream>
 #include <vector>
-#include <fstream> 
+#include <gpecs/TextWriter.hpp>
 #include <flecs.h>
 #include <systems.h>
 #include <cmath>
@@ -49,7 +49,7 @@ double east_function(double left, double centre, double right)
 
 int main(int argc, char* argv[]) {
     // Prepare Save File
-    std::ofstream MyFile;
+    gpecs::TextWriter MyFile;
     MyFile.open("starter_fluid.txt");
     if (!MyFile.is_open())
     {
@@ -5,7 +5,7 @@ solved analytically.
 
 #include <iostream>
 #include <vector>
-#include <fstream> 
+#include <gpecs/TextWriter.hpp>
 #include <cmath>
 #include "classes.hpp"
 
@@ -24,7 +24,7 @@ double END = 1;
 
 int main() {
     // Prepare Save File
-    std::ofstream MyFile;
+    gpecs::TextWriter MyFile;
     MyFile.open("starter_fluid.txt");
     if (!MyFile.is_open())
     {
@@ -5,7 +5,7 @@ solved analytically.
 
 #include <iostream>
 #include <vector>
-#include <fstream> 
+#include <gpecs/TextWriter.hpp>
 #include <cmath>
 
 const double L = 1;   // Length
@@ -108,7 +108,7 @@ int main() {
     std::vector<double> phi_steady;
 
     // Prepare Save File
-    std::ofstream MyFile;
+    gpecs::TextWriter MyFile;
     MyFile.open("starter_fluid.txt");
     if (!MyFile.is_open())
     {
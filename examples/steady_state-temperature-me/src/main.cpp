@@ -5,7 +5,7 @@ solved analytically.
 
 #include <iostream>
 #include <vector>
-#include <fstream> 
+#include <gpecs/TextWriter.hpp>
 #include <cmath>
 
 const double L = 0.01;          // Length
@@ -103,7 +103,7 @@ int main() {
     std::vector<double> phi_steady;
 
     // Prepare Save File
-    std::ofstream MyFile;
+    gpecs::TextWriter MyFile;
     MyFile.open("temperature.txt");
     if (!MyFile.is_open())
     {
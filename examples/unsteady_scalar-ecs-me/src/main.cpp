@@ -4,42 +4,56 @@ system which begins out of equilibrium
 */
 
 #include <custom_phases_no_builtin.h>
+#include <gpecs/Args.hpp>
+#include <gpecs/DoubleBuffer.hpp>
+#include <gpecs/GridField.hpp>
+#include <gpecs/MemoryReport.hpp>
+#include <gpecs/Profiler.hpp>
+#include <gpecs/SnapshotWriter.hpp>
+#include <gpecs/Sweep.hpp>
+#include <gpecs/TextWriter.hpp>
 #include <iostream>
-#include <fstream> 
+#include <stdexcept>
+#include <string>
 #include <vector>
 
 // Number of nodes in x-axis. Also equal to the length in unit of node distance
 const double L = 1; // Length (m)
 const int N = 501; // Number of nodes
-const int PE = 50; // Peclet Number
+const int PE = 50; // Peclet Number (--sweep-pe runs a list of them instead)
 const double RHO = 2; // Density (kg m-3)
 const double U = 5; // Speed (m s-1)
 
-// Calculates Diffusivity
-double GAMMA = (RHO * U * L) / PE;
-
 // Sets time parameters
 double TIME = 0.5; //(s)
-int STEPS = TIME * 2 * static_cast<int>((2 * GAMMA * (N-1) * (N-1) )/ RHO);
+
+// Values that follow from the Peclet number. A sweep runs several Peclet
+// numbers at once, so they are handed to the systems instead of being globals.
+struct Parameters {
+    double gamma; // Diffusivity
+    int steps;
+
+    explicit Parameters(double pe)
+        : gamma((RHO * U * L) / pe),
+          steps(TIME * 2 * static_cast<int>((2 * gamma * (N-1) * (N-1) )/ RHO)) { }
+};
 
 // Boundary Conditions
 double Start = 0;
 double End = 1;
 
-// Position Components
-struct Position {double x; };
-struct Index {int ind; };
-
-// Field components
-struct Phi_start { double i; };
-struct Phihalf_predict { double i; };
-struct Phihalf_correct { double i; };
-struct Phi_end_predict { double i; };
-struct Phi_end_correct { double i; };
+// Grid of nodes. Node 0 and node N-1 hold the boundary conditions and live
+// in the halo, so the interior runs over the N-2 middle nodes.
+using Field = gpecs::GridField1D<double>;
+using Flip = gpecs::BufferFlip;
 
-// Component Tags
-struct Middle_Tag {};
-struct End_Tag {};
+struct ScalarGrid {
+    Field x;                // Node position
+    gpecs::DoubleBuffered<Field> phi; // phi_start is current, phi_end_correct is next
+    Field phihalf_predict;
+    Field phihalf_correct;
+    Field phi_end_predict;
+};
 
 double linear_function(double x, double A, double B)
 {
@@ -48,19 +62,20 @@ double linear_function(double x, double A, double B)
     return y;
 }
 
-double fluid_function(double phi_left, double phi, double phi_right, 
+double fluid_function(double gamma, double phi_left, double phi, double phi_right, 
     double x_left, double x, double x_right)
 {
     double f;
     f = - U*((phi_right - phi_left)/(x_right - x_left)) 
-    + ((GAMMA/RHO) * (phi_right - 2 * phi + phi_left)) / ((x_right - x) * (x - x_left));
+    + ((gamma/RHO) * (phi_right - 2 * phi + phi_left)) / ((x_right - x) * (x - x_left));
     return f;
 }
 
-int main(int argc, char *argv[]) {
+// Runs one simulation in `world`, writing every step to `path`
+int simulate(flecs::world& world, const Parameters p, const std::string& path, bool printSteps) {
     // Prepare Save File
-    std::ofstream MyFile;
-    MyFile.open("1D_dynamic_fluid.txt");
+    gpecs::TextWriter MyFile;
+    MyFile.open(path);
 
     // Check Save File is open/created
     if (!MyFile.is_open())
@@ -68,9 +83,6 @@ int main(int argc, char *argv[]) {
         std::cout<<"Error in creating file"<<std::endl; 
         return 1; 
     }
-    // Create World
-    flecs::world world(argc, argv);
-
     // Creates Phases which tell the program in which order to run the systems
     flecs::entity RungeKutta_1 = world.entity()
         .add(flecs::Phase); // This Phase calculates phihalf_predict
@@ -88,164 +100,109 @@ int main(int argc, char *argv[]) {
         .depends_on(RungeKutta_3);
 
     flecs::entity Update = world.entity()
-        .add(flecs::Phase) // This phase replaces phi_start with phi_end_correct
+        .add(flecs::Phase) // This phase makes phi_end_correct the new phi_start
         .depends_on(RungeKutta_4);
     
 
     // Create components inside the world
-    world.component<Middle_Tag>();
-    world.component<End_Tag>();
-
-    world.component<Position>();
-
-    world.component<Phi_start>();
-    world.component<Phihalf_predict>();
-    world.component<Phihalf_correct>();
-    world.component<Phi_end_predict>();
-    world.component<Phi_end_correct>();
-
-    std::vector<flecs::entity> nodes; // place to store nodes
-    nodes.reserve(N); // Create the space
-    
-    // Create left boundary Node
-    nodes.push_back(
-            world.entity()
-                .add<End_Tag>() 
-                .set<Position>({0})
-                .set<Index>({0})
-                .set<Phi_start>({Start})
-                .set<Phihalf_predict>({Start})
-                .set<Phihalf_correct>({Start})
-                .set<Phi_end_predict>({Start})
-            );
-    
-    // Create non-boundary Nodes
-    for (int index = 1; index < N-1; ++index) {
-        double phi_initial;
-        phi_initial = linear_function(index*L/(N-1), Start, End);
-        nodes.push_back(
-            world.entity()
-                .add<Middle_Tag>() 
-                .set<Position>({index*L/(N-1)})
-                .set<Index>({index})
-                .set<Phi_start>({phi_initial})
-                .set<Phihalf_predict>({0})
-                .set<Phihalf_correct>({0})
-                .set<Phi_end_predict>({0})
-                .set<Phi_end_correct>({0})
-            );
+    world.component<ScalarGrid>().add(flecs::Singleton);
+
+    // The Update phase makes phi_end_correct the new phi_start by swapping
+    // the two slots of phi
+    gpecs::flip_buffers(world, Update);
+
+    // Create the grid: interior nodes 1..N-2, boundary nodes in the halo
+    const int interior = N - 2;
+    ScalarGrid grid {
+        .x = Field(interior),
+        .phihalf_predict = Field(interior),
+        .phihalf_correct = Field(interior),
+        .phi_end_predict = Field(interior),
+    };
+    for (int index = 0; index < N; ++index) {
+        grid.x[index - 1] = index*L/(N-1);
     }
+    Field phi_start(interior);
+    for (int i = 0; i < interior; ++i) {
+        phi_start[i] = linear_function(grid.x[i], Start, End);
+    }
+    phi_start.fill_halo(Start, End);
+    grid.phi = gpecs::DoubleBuffered<Field>(phi_start);
+    grid.phihalf_predict.fill_halo(Start, End);
+    grid.phihalf_correct.fill_halo(Start, End);
+    grid.phi_end_predict.fill_halo(Start, End);
+    world.set<ScalarGrid>(std::move(grid));
 
-    // Create Right Boundary Nodes
-    nodes.push_back(
-            world.entity()
-                .add<End_Tag>() 
-                .set<Position>({L})
-                .set<Index>({N-1})
-                .set<Phi_start>({End})
-                .set<Phihalf_predict>({End})
-                .set<Phihalf_correct>({End})
-                .set<Phi_end_predict>({End})
-            );
-    
     // This system finds and updates phihalf_predict
-    world.system<Position, Index, Phi_start, Phihalf_predict>()
-        .with<Middle_Tag>()
+    world.system<ScalarGrid, const Flip>()
         .kind(RungeKutta_1)
-        .each([&](Position& pos, Index& index, Phi_start& start, Phihalf_predict& half){
-            const Phi_start& startMinus = nodes[index.ind - 1].get<Phi_start>();
-            const Phi_start& startPlus = nodes[index.ind + 1].get<Phi_start>();
-
-            const Position& posMinus = nodes[index.ind - 1].get<Position>();
-            const Position& posPlus = nodes[index.ind + 1].get<Position>();
-
-            double function = fluid_function(startMinus.i, start.i, startPlus.i, 
-                posMinus.x, pos.x, posPlus.x);
-            half.i = start.i + (TIME*function)/(2*STEPS);
+        .each([p](ScalarGrid& g, const Flip& flip){
+            auto x = g.x.view();
+            auto start = g.phi.current(flip).view();
+            auto half = g.phihalf_predict.view();
+            for (int i = 0; i < x.n; ++i) {
+                double function = fluid_function(p.gamma, start[i-1], start[i], start[i+1],
+                    x[i-1], x[i], x[i+1]);
+                half[i] = start[i] + (TIME*function)/(2*p.steps);
+            }
         });
-    
+
     // This system finds and updates phihalf_correct
-    world.system<Position, Index, Phi_start, Phihalf_predict, Phihalf_correct>()
-        .with<Middle_Tag>()
+    world.system<ScalarGrid, const Flip>()
         .kind(RungeKutta_2)
-        .each([&](Position& pos, Index& index, Phi_start& start, 
-            Phihalf_predict& predictor, Phihalf_correct& corrector){
-
-            const Phihalf_predict& predictorMinus = nodes[index.ind - 1].get<Phihalf_predict>();
-            const Phihalf_predict& predictorPlus = nodes[index.ind + 1].get<Phihalf_predict>();
-
-            const Position& posMinus = nodes[index.ind - 1].get<Position>();
-            const Position& posPlus = nodes[index.ind + 1].get<Position>();
-
-            double function = fluid_function(predictorMinus.i, predictor.i, predictorPlus.i, 
-                posMinus.x, pos.x, posPlus.x);
-            
-            corrector.i = start.i + (TIME*function)/(2*STEPS);
+        .each([p](ScalarGrid& g, const Flip& flip){
+            auto x = g.x.view();
+            auto start = g.phi.current(flip).view();
+            auto predictor = g.phihalf_predict.view();
+            auto corrector = g.phihalf_correct.view();
+            for (int i = 0; i < x.n; ++i) {
+                double function = fluid_function(p.gamma, predictor[i-1], predictor[i], predictor[i+1],
+                    x[i-1], x[i], x[i+1]);
+                corrector[i] = start[i] + (TIME*function)/(2*p.steps);
+            }
         });
-    
+
     // This system finds and updates phi_end_predict
-    world.system<Position, Index, Phi_start, Phihalf_correct, Phi_end_predict>()
-        .with<Middle_Tag>()
+    world.system<ScalarGrid, const Flip>()
         .kind(RungeKutta_3)
-        .each([&](Position& pos, Index& index, Phi_start& start, 
-            Phihalf_correct& half, Phi_end_predict& end){
-
-            const Phihalf_correct& halfMinus = nodes[index.ind - 1].get<Phihalf_correct>();
-            const Phihalf_correct& halfPlus = nodes[index.ind + 1].get<Phihalf_correct>();
-
-            const Position& posMinus = nodes[index.ind - 1].get<Position>();
-            const Position& posPlus = nodes[index.ind + 1].get<Position>();
-
-            double function = fluid_function(halfMinus.i, half.i, halfPlus.i, 
-                posMinus.x, pos.x, posPlus.x);
-            
-            end.i = start.i + (TIME*function)/(2*STEPS);
+        .each([p](ScalarGrid& g, const Flip& flip){
+            auto x = g.x.view();
+            auto start = g.phi.current(flip).view();
+            auto half = g.phihalf_correct.view();
+            auto end = g.phi_end_predict.view();
+            for (int i = 0; i < x.n; ++i) {
+                double function = fluid_function(p.gamma, half[i-1], half[i], half[i+1],
+                    x[i-1], x[i], x[i+1]);
+                end[i] = start[i] + (TIME*function)/(2*p.steps);
+            }
         });
 
     // This system finds and updates phi_end_correct
-    world.system<Position, Index, Phi_start, Phihalf_predict, Phihalf_correct, Phi_end_predict, Phi_end_correct>()
-        .with<Middle_Tag>()
+    world.system<ScalarGrid, const Flip>()
         .kind(RungeKutta_4)
-        .each([&](Position& pos, Index& index, Phi_start& start, Phihalf_predict& halfPred,
-            Phihalf_correct& halfCorr, Phi_end_predict& endPred, Phi_end_correct& endCorr){
-            
-            const Phi_start& startMinus = nodes[index.ind - 1].get<Phi_start>();
-            const Phi_start& startPlus = nodes[index.ind + 1].get<Phi_start>();
-
-            const Phihalf_predict& halfPredMinus = nodes[index.ind - 1].get<Phihalf_predict>();
-            const Phihalf_predict& halfPredPlus = nodes[index.ind + 1].get<Phihalf_predict>();
-            
-            const Phihalf_correct& halfCorrMinus = nodes[index.ind - 1].get<Phihalf_correct>();
-            const Phihalf_correct& halfCorrPlus = nodes[index.ind + 1].get<Phihalf_correct>();
-
-            const Phi_end_predict& endPredMinus = nodes[index.ind - 1].get<Phi_end_predict>();
-            const Phi_end_predict& endPredPlus = nodes[index.ind + 1].get<Phi_end_predict>();
-
-            const Position& posMinus = nodes[index.ind - 1].get<Position>();
-            const Position& posPlus = nodes[index.ind + 1].get<Position>();
-
-            double functionStart = fluid_function(startMinus.i, start.i, startPlus.i, 
-                posMinus.x, pos.x, posPlus.x);
-
-            double functionHalfPred = fluid_function(halfPredMinus.i, halfPred.i, halfPredPlus.i, 
-                posMinus.x, pos.x, posPlus.x);
-            
-            double functionHalfCorr = fluid_function(halfCorrMinus.i, halfCorr.i, halfCorrPlus.i, 
-                posMinus.x, pos.x, posPlus.x);
-            
-            double functionEndPred = fluid_function(endPredMinus.i, endPred.i, endPredPlus.i, 
-                posMinus.x, pos.x, posPlus.x);
-            
-            endCorr.i = start.i + (TIME*(functionStart + 2*functionHalfPred + 2*functionHalfCorr 
-                + functionEndPred))/(6*STEPS);
-        });
-
-    // This updates phi_start by replacing it with phi_end_correct
-    world.system<Phi_start, Phi_end_correct>()
-        .with<Middle_Tag>()
-        .kind(Update)
-        .each([](Phi_start& initial, Phi_end_correct& updated){
-            initial.i = updated.i;
+        .each([p](ScalarGrid& g, const Flip& flip){
+            auto x = g.x.view();
+            auto start = g.phi.current(flip).view();
+            auto halfPred = g.phihalf_predict.view();
+            auto halfCorr = g.phihalf_correct.view();
+            auto endPred = g.phi_end_predict.view();
+            auto endCorr = g.phi.next(flip).view();
+            for (int i = 0; i < x.n; ++i) {
+                double functionStart = fluid_function(p.gamma, start[i-1], start[i], start[i+1],
+                    x[i-1], x[i], x[i+1]);
+
+                double functionHalfPred = fluid_function(p.gamma, halfPred[i-1], halfPred[i], halfPred[i+1],
+                    x[i-1], x[i], x[i+1]);
+
+                double functionHalfCorr = fluid_function(p.gamma, halfCorr[i-1], halfCorr[i], halfCorr[i+1],
+                    x[i-1], x[i], x[i+1]);
+
+                double functionEndPred = fluid_function(p.gamma, endPred[i-1], endPred[i], endPred[i+1],
+                    x[i-1], x[i], x[i+1]);
+
+                endCorr[i] = start[i] + (TIME*(functionStart + 2*functionHalfPred + 2*functionHalfCorr
+                    + functionEndPred))/(6*p.steps);
+            }
         });
 
     // Set .txt file headers
@@ -258,22 +215,73 @@ int main(int argc, char *argv[]) {
         }
     }
     
+    // Rows are formatted and written on a background thread while the next
+    // steps run
+    gpecs::SnapshotWriter writer(8);
+
     // Run through systems every time step
-    for (int t_step = 0; t_step <= STEPS; ++t_step) {
+    for (int t_step = 0; t_step <= p.steps; ++t_step) {
         if (t_step != 0) {
                 world.progress();
             }
-        std::cout << t_step << "\n";
-        // Saves Data to a .txt file
-        MyFile << static_cast<double>(t_step*TIME)/STEPS << ", ";
-        for (int index = 0; index < N-1; ++index) {
-            const Phi_start& phi = nodes[index].get<Phi_start>();
-            MyFile << phi.i << ", ";
+        if (printSteps) {
+            std::cout << t_step << "\n";
         }
-        const Phi_start& phi = nodes[N-1].get<Phi_start>();
-        MyFile << phi.i << "\n";
+        // Saves Data to a .txt file
+        writer.write(t_step,
+            [&](gpecs::Snapshot& snap) {
+                const Field& phi = world.get<ScalarGrid>().phi.current(world.get<Flip>());
+                auto row = snap.column<double>(0, N);
+                for (int index = -1; index < N-1; ++index) {
+                    row[index + 1] = phi[index];
+                }
+            },
+            [&MyFile, p](const gpecs::Snapshot& snap) {
+                auto row = snap.column<double>(0);
+                MyFile << static_cast<double>(snap.step*TIME)/p.steps << ", ";
+                for (int index = 0; index < N-1; ++index) {
+                    MyFile << row[index] << ", ";
+                }
+                MyFile << row[N-1] << "\n";
+            });
     }
 
     // Close Save File
+    writer.flush();
     MyFile.close();
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    // `--sweep-pe 10,50,100` runs every Peclet number in the list, as many
+    // at once as there are cores, each writing to sweep/Pe=<value>/ (see
+    // include/gpecs/Sweep.hpp)
+    std::string peclets;
+    if (gpecs::take_option(argc, argv, "--sweep-pe", peclets)) {
+        try {
+            gpecs::ParameterGrid grid;
+            grid.add("Pe", gpecs::ParameterGrid::parse(peclets));
+            gpecs::Sweep sweep(grid, "sweep");
+            const auto results = sweep.run([](flecs::world& world, const gpecs::SweepRun& run) {
+                const std::string path = run.file("1D_dynamic_fluid.txt");
+                if (simulate(world, Parameters(run["Pe"]), path, false) != 0) {
+                    throw std::runtime_error("Error in creating file " + path);
+                }
+            });
+            for (const auto& result : results) {
+                std::cout << result.run.name << ": " << (result.ok ? "ok" : result.error)
+                          << ", " << result.seconds << " s" << std::endl;
+            }
+            return sweep.report(results) == 0 ? 0 : 1;
+        } catch (const std::exception& e) {
+            std::cout << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    // Create World
+    flecs::world world(argc, argv);
+    auto profiler = gpecs::profile_from_args(world, argc, argv);
+    auto memory = gpecs::memory_from_args(world, argc, argv);
+    return simulate(world, Parameters(PE), "1D_dynamic_fluid.txt", true);
 }
@@ -0,0 +1,48 @@
+//
+// (c) 2026 University of Manchester
+// You may use this under the terms of the Apache 2 License
+//
+//
+// This file implements the command line handling shared by the gpecs
+// helpers (--threads, --profile, ...).
+//
+// Each helper takes its own option out of argv, so a sketch that reads
+// positional arguments (asteroids_knn reads K from argv[1]) sees the same
+// argv with or without the extra options:
+//
+//     std::string path;
+//     if (gpecs::take_option(argc, argv, "--profile", path)) { ... }
+//
+// Both `--name VALUE` and `--name=VALUE` are accepted. If an option is given
+// more than once the last value wins.
+//
+
+#pragma once
+
+#include <cstring>
+#include <string>
+
+namespace gpecs {
+    // Removes every `name VALUE` / `name=VALUE` from argv. Returns true and
+    // sets value if the option was present.
+    inline bool take_option(int & argc, char *argv[], const char *name, std::string & value) {
+        const std::size_t len = std::strlen(name);
+        bool found = false;
+        int out = 1;
+        for (int in = 1; in < argc; ++in) {
+            if (std::strcmp(argv[in], name) == 0 && in + 1 < argc) {
+                value = argv[++in];
+                found = true;
+            } else if (std::strncmp(argv[in], name, len) == 0 && argv[in][len] == '=') {
+                value = argv[in] + len + 1;
+                found = true;
+            } else {
+                argv[out++] = argv[in];
+            }
+        }
+        argc = out;
+        argv[argc] = nullptr;
+        return found;
+    }
+
+}                               // namespace gpecs
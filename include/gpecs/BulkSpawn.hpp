@@ -0,0 +1,127 @@
+//
+// (c) 2026 University of Manchester
+// You may use this under the terms of the Apache 2 License
+//
+//
+// This file implements bulk creation of entities that all share the same set
+// of components - the usual shape of an initial population of particles,
+// grid nodes or agents.
+//
+// Building a population with
+//
+//     world.entity().set<Position>({..}).set<Velocity>({..}).set<Mass>({..})
+//
+// moves every entity through a new archetype table on each set<>(), so N
+// entities with C components cost N*C table moves. The BulkSpawner instead
+// creates all N entities directly in their final table with one
+// ecs_bulk_init() call and then hands the fill callback references straight
+// into the table columns:
+//
+//     auto asteroids = gpecs::BulkSpawner<Position, Velocity, Mass>(world)
+//         .add<AsteroidTag>()
+//         .spawn(N, [&](int32_t i, Position& p, Velocity& v, Mass& m) {
+//             p = {UposX(rng), UposY(rng)};
+//             v = {Uvel(rng), Uvel(rng)};
+//             m = {Umass(rng)};
+//         });
+//
+// The callback is called in order i = 0..N-1, so sketches that draw initial
+// conditions from a random number generator get the same sequence as before.
+// The returned vector holds the entities in the same order.
+//
+// Limitations:
+//
+// * Must be called outside of a system (the world must not be deferred).
+// * Components are default constructed and then assigned by the callback, so
+//   no OnSet observers fire. None of our sketches use them; if one does, call
+//   entity.modified<T>() afterwards.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include <flecs.h>
+
+namespace gpecs {
+    template <typename... Components>
+    class BulkSpawner {
+        static_assert(sizeof...(Components) >= 1, "spawn with at least one component");
+        static_assert((!std::is_empty_v<Components> && ...), "tags go in add<T>(), not the component list");
+      public:
+        explicit BulkSpawner(flecs::world & world) : world_(world) {
+            (ids_.push_back(world_.id<Components>()), ...);
+        }
+
+        // Add a tag (or any other id without data) to every spawned entity
+        template <typename T>
+        BulkSpawner & add() {
+            ids_.push_back(world_.id<T>());
+            return *this;
+        }
+
+        BulkSpawner & add(flecs::id_t id) {
+            ids_.push_back(id);
+            return *this;
+        }
+
+        // Spawn count entities with default constructed components
+        std::vector < flecs::entity > spawn(int32_t count) {
+            return spawn(count, [](int32_t, Components &...) { });
+        }
+
+        // Spawn count entities, calling fill(i, components...) for each
+        template <typename Func>
+        std::vector < flecs::entity > spawn(int32_t count, Func && fill) {
+            ecs_assert(!world_.is_deferred(), ECS_INVALID_OPERATION, "bulk spawn inside a system");
+            ecs_assert(ids_.size() <= FLECS_ID_DESC_MAX, ECS_INVALID_PARAMETER, "too many ids for bulk spawn");
+
+            std::vector < flecs::entity > entities;
+            if (count <= 0)
+                return entities;
+
+            ecs_bulk_desc_t desc = {};
+            desc.count = count;
+            for (std::size_t i = 0; i < ids_.size(); ++i)
+                desc.ids[i] = ids_[i];
+
+            // ecs_bulk_init() returns a pointer into flecs internals, so take
+            // a copy before anything else can create entities.
+            const ecs_entity_t *created = ecs_bulk_init(world_, &desc);
+            entities.reserve(count);
+            for (int32_t i = 0; i < count; ++i)
+                entities.push_back(flecs::entity(world_, created[i]));
+
+            // All entities were appended to the same table as contiguous rows
+            ecs_table_t *table = ecs_get_table(world_, entities.front());
+            ecs_record_t *first = ecs_record_find(world_, entities.front());
+            int32_t row = ECS_RECORD_TO_ROW(first->row);
+            ecs_assert(ecs_get_table(world_, entities.back()) == table, ECS_INTERNAL_ERROR, NULL);
+            ecs_assert(ECS_RECORD_TO_ROW(ecs_record_find(world_, entities.back())->row) == row + count - 1,
+                       ECS_INTERNAL_ERROR, NULL);
+
+            std::tuple < Components*... > columns {
+                column<Components>(table, row)...
+            };
+            for (int32_t i = 0; i < count; ++i)
+                std::apply([&](auto *... col) { fill(i, col[i]...); }, columns);
+
+            return entities;
+        }
+
+      private:
+        template <typename T>
+        T* column(ecs_table_t *table, int32_t row) {
+            int32_t index = ecs_table_get_column_index(world_, table, world_.id<T>());
+            ecs_assert(index != -1, ECS_INTERNAL_ERROR, "spawned table is missing column");
+            return static_cast<T*>(ecs_table_get_column(table, index, row));
+        }
+
+        flecs::world & world_;
+        std::vector < flecs::id_t > ids_;
+    };
+
+}                               // namespace gpecs
@@ -0,0 +1,455 @@
+//
+// (c) 2026 University of Manchester
+// You may use this under the terms of the Apache 2 License
+//
+//
+// This file implements binary checkpoints of a world, so a long run that
+// dies can carry on from its last checkpoint instead of from step zero.
+//
+// A checkpoint holds every data entity's components as raw column dumps, one
+// per table, plus the step counter and any values the program adds (random
+// number generator state, the simulation parameters). Restoring is a
+// bulk insert per table and one read per column straight into the table's
+// memory - nothing is parsed:
+//
+//     auto checkpoints = gpecs::checkpoint_from_args(argc, argv);
+//     ...register components and systems as usual...
+//
+//     int64_t first = 0;
+//     if (checkpoints.restarting()) {
+//         gpecs::Checkpoint cp = gpecs::load_checkpoint(world, checkpoints.restart);
+//         cp.get("rng", rng);
+//         first = cp.step + 1;
+//     } else {
+//         ...create the entities...
+//     }
+//
+//     for (int64_t step = first; step <= STEPS; ++step) {
+//         world.progress();
+//         if (checkpoints.due(step)) {
+//             gpecs::Checkpoint cp(step);
+//             cp.put("rng", rng);
+//             gpecs::save_checkpoint(world, checkpoints.path, cp);
+//             if (gpecs::stop_requested())
+//                 break;
+//         }
+//     }
+//
+// Command line - `--checkpoint PATH` writes PATH every `--checkpoint-every K`
+// steps and when the process gets SIGTERM (the step in progress finishes
+// first); `--restart PATH` loads one. A checkpoint is written to PATH.part
+// and renamed over PATH, so a job killed while writing keeps the last one.
+//
+// What is saved - entities whose components all belong to the program.
+// Named entities and everything flecs itself creates (components, systems,
+// phases, pipelines, modules) are the program's setup and are created again
+// by it before the restore; so are singletons, which live on component
+// entities. Components are identified by name, so every component and tag in
+// the checkpoint must be registered (world.component<T>()) before
+// load_checkpoint(). Entities keep their ids, so entity handles stored in
+// the program's own vectors or in components stay valid.
+//
+// Limitations:
+//
+// * Components must be plain data (no constructor, destructor or copy
+//   hooks); save_checkpoint() throws for one that is not.
+// * A pair's target must be a named entity or a flecs builtin.
+// * The file is in the machine's byte order and only meant for the same
+//   build of the same program.
+// * Restored entities get no OnAdd/OnSet observers, as for BulkSpawner.
+//
+// Layout - little endian, read front to back:
+//
+//   header        "GPECSCKP", u32 version, u32 values, u32 tables,
+//                 i64 step, i64 world frame count, f64 world time
+//   values        u32 name length, name, u64 bytes, bytes
+//   tables        u32 ids, then each id as u64 flags and the names of its
+//                 entity and pair target ("" if not a pair), each as u32
+//                 length + text; u64 rows, u64 entity ids[rows]; then for each column in
+//                 table order u64 bytes per value, the column's rows values
+//   trailer       "GPECSEND"
+//
+
+#pragma once
+
+#include <bit>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+
+#include <unistd.h>
+
+#include <flecs.h>
+#include <gpecs/Args.hpp>
+#include <gpecs/WorldTables.hpp>
+
+namespace gpecs {
+    static_assert(std::endian::native == std::endian::little, "checkpoints are written in the machine's byte order");
+
+    // The step a checkpoint was taken at and the values saved beside the world
+    class Checkpoint {
+      public:
+        Checkpoint() = default;
+        explicit Checkpoint(int64_t step) : step(step) { }
+
+        int64_t step {0};
+
+        // Saves a plain value (a struct of parameters, a std::mt19937, ...)
+        template <typename T>
+        void put(const std::string & name, const T & value) {
+            static_assert(std::is_trivially_copyable_v<T>, "checkpoint values are plain data");
+            std::vector < std::byte > &bytes = values_[name];
+            bytes.resize(sizeof(T));
+            std::memcpy(bytes.data(), &value, sizeof(T));
+        }
+
+        // Reads back a value saved with put(); false if there is none
+        template <typename T>
+        bool get(const std::string & name, T & value) const {
+            static_assert(std::is_trivially_copyable_v<T>, "checkpoint values are plain data");
+            auto found = values_.find(name);
+            if (found == values_.end())
+                return false;
+            if (found->second.size() != sizeof(T))
+                throw std::runtime_error("gpecs checkpoint: value " + name + " has a different size");
+            std::memcpy(&value, found->second.data(), sizeof(T));
+            return true;
+        }
+
+        bool has(const std::string & name) const { return values_.count(name) != 0; }
+
+        // True if `name` was saved and holds the same bytes as `value`, for
+        // checking a restart uses the parameters the run started with
+        template <typename T>
+        bool same(const std::string & name, const T & value) const {
+            static_assert(std::is_trivially_copyable_v<T>, "checkpoint values are plain data");
+            auto found = values_.find(name);
+            return found != values_.end() && found->second.size() == sizeof(T) &&
+                std::memcmp(found->second.data(), &value, sizeof(T)) == 0;
+        }
+
+        const std::map < std::string, std::vector < std::byte > > &values() const { return values_; }
+
+      private:
+        friend Checkpoint load_checkpoint(flecs::world & world, const std::string & path);
+
+        std::map < std::string, std::vector < std::byte > > values_;
+    };
+
+    namespace checkpoint {
+        constexpr uint32_t VERSION = 1;
+        constexpr char MAGIC[8] = { 'G', 'P', 'E', 'C', 'S', 'C', 'K', 'P' };
+        constexpr char END[8] = { 'G', 'P', 'E', 'C', 'S', 'E', 'N', 'D' };
+
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t values;
+            uint32_t tables;
+            uint32_t reserved;
+            int64_t step;
+            int64_t frames;
+            double time;
+        };
+
+        inline volatile std::sig_atomic_t stop_signal = 0;
+
+        inline void on_stop_signal(int) { stop_signal = 1; }
+
+        // Whether the entities of `table` are data to save. Throws for a
+        // table that holds data but cannot be saved.
+        inline bool saved(const ecs_world_t *world, const ecs_table_t *table) {
+            if (ecs_table_count(table) == 0 || flecs_table(world, table))
+                return false;
+            const ecs_type_t *type = ecs_table_get_type(table);
+            for (int32_t i = 0; i < type->count; ++i) {
+                const ecs_id_t id = type->array[i];
+                if (!ECS_IS_PAIR(id))
+                    continue;
+                const ecs_entity_t second = ecs_pair_second(world, id);
+                if (!flecs_builtin(world, second) && !ecs_get_name(world, second))
+                    throw std::runtime_error("gpecs checkpoint: pair target of an unnamed entity cannot be saved");
+            }
+            return true;
+        }
+
+        class File {
+          public:
+            File(const std::string & path, const char *mode) : path_(path), file_(std::fopen(path.c_str(), mode)) {
+                if (!file_)
+                    throw std::runtime_error("gpecs checkpoint: cannot open " + path);
+            }
+
+            ~File() {
+                if (file_)
+                    std::fclose(file_);
+            }
+
+            File(const File &) = delete;
+            File & operator=(const File &) = delete;
+
+            void put(const void *data, std::size_t bytes) {
+                if (bytes && std::fwrite(data, 1, bytes, file_) != bytes)
+                    throw std::runtime_error("gpecs checkpoint: cannot write " + path_);
+            }
+
+            void get(void *data, std::size_t bytes) {
+                if (bytes && std::fread(data, 1, bytes, file_) != bytes)
+                    throw std::runtime_error("gpecs checkpoint: " + path_ + " is truncated");
+            }
+
+            template <typename T>
+            void put(const T & value) { put(&value, sizeof(T)); }
+
+            template <typename T>
+            T get() {
+                T value;
+                get(&value, sizeof(T));
+                return value;
+            }
+
+            void put_string(const std::string & text) {
+                put(static_cast<uint32_t>(text.size()));
+                put(text.data(), text.size());
+            }
+
+            std::string get_string() {
+                std::string text(get < uint32_t > (), '\0');
+                get(text.data(), text.size());
+                return text;
+            }
+
+            // Writes out and closes; fsync() so the rename that follows
+            // cannot leave an empty file behind after a crash
+            void close() {
+                std::FILE *file = file_;
+                file_ = nullptr;
+                const bool ok = std::fflush(file) == 0 && ::fsync(fileno(file)) == 0;
+                if (std::fclose(file) != 0 || !ok)
+                    throw std::runtime_error("gpecs checkpoint: cannot write " + path_);
+            }
+
+          private:
+            std::string path_;
+            std::FILE *file_;
+        };
+
+        // An entity by its symbol (the C++ type name of a component), or by
+        // its path if it has none
+        inline std::string entity_name(const ecs_world_t *world, ecs_entity_t e) {
+            if (const char *symbol = ecs_get_symbol(world, e))
+                return symbol;
+            char *path = ecs_get_path_w_sep(world, 0, e, ".", nullptr);
+            std::string name = path ? path : "";
+            ecs_os_free(path);
+            return name;
+        }
+
+        inline ecs_entity_t find_entity(const ecs_world_t *world, const std::string & name) {
+            const ecs_entity_t e = ecs_lookup_symbol(world, name.c_str(), true, false);
+            if (!e)
+                throw std::runtime_error("gpecs checkpoint: " + name + " is not registered in this world");
+            return e;
+        }
+
+        inline void put_id(File & out, const ecs_world_t *world, ecs_id_t id) {
+            out.put(static_cast<uint64_t>(id & ECS_ID_FLAGS_MASK));
+            if (ECS_IS_PAIR(id)) {
+                out.put_string(entity_name(world, ecs_pair_first(world, id)));
+                out.put_string(entity_name(world, ecs_pair_second(world, id)));
+            } else {
+                out.put_string(entity_name(world, id & ECS_COMPONENT_MASK));
+                out.put_string("");
+            }
+        }
+
+        inline ecs_id_t get_id(File & in, const ecs_world_t *world) {
+            const uint64_t flags = in.get < uint64_t > ();
+            const ecs_entity_t first = find_entity(world, in.get_string());
+            const std::string second = in.get_string();
+            if (ECS_IS_PAIR(flags))
+                return ecs_pair(first, find_entity(world, second));
+            return first | flags;
+        }
+    }                           // namespace checkpoint
+
+    // Writes the world's data entities and `cp` to `path`. Call between
+    // world.progress() calls; throws std::runtime_error on failure, leaving
+    // any earlier checkpoint at `path` as it was.
+    inline void save_checkpoint(const flecs::world & world, const std::string & path, const Checkpoint & cp) {
+        const ecs_world_t *w = world.c_ptr();
+
+        // The tables that hold data entities, in the order they were first used
+        std::vector < ecs_table_t * > tables;
+        std::unordered_set < ecs_table_t * > seen;
+        const ecs_entities_t entities = ecs_get_entities(w);
+        ecs_table_t *last = nullptr;
+        for (int32_t i = 0; i < entities.alive_count; ++i) {
+            ecs_table_t *table = ecs_get_table(w, entities.ids[i]);
+            if (!table || table == last)
+                continue;
+            last = table;
+            if (seen.insert(table).second && checkpoint::saved(w, table))
+                tables.push_back(table);
+        }
+
+        const std::string part = path + ".part";
+        {
+            checkpoint::File out(part, "wb");
+            checkpoint::Header header {};
+            std::memcpy(header.magic, checkpoint::MAGIC, sizeof(header.magic));
+            header.version = checkpoint::VERSION;
+            header.values = static_cast<uint32_t>(cp.values().size());
+            header.tables = static_cast<uint32_t>(tables.size());
+            header.step = cp.step;
+            header.frames = ecs_get_world_info(w)->frame_count_total;
+            header.time = ecs_get_world_info(w)->world_time_total;
+            out.put(header);
+
+          for (const auto &[name, bytes] : cp.values()) {
+                out.put_string(name);
+                out.put(static_cast<uint64_t>(bytes.size()));
+                out.put(bytes.data(), bytes.size());
+            }
+
+          for (ecs_table_t * table : tables) {
+                const ecs_type_t *type = ecs_table_get_type(table);
+                out.put(static_cast<uint32_t>(type->count));
+                for (int32_t i = 0; i < type->count; ++i)
+                    checkpoint::put_id(out, w, type->array[i]);
+
+                const uint64_t rows = static_cast<uint64_t>(ecs_table_count(table));
+                out.put(rows);
+                out.put(ecs_table_entities(table), rows * sizeof(ecs_entity_t));
+
+                for (int32_t c = 0; c < ecs_table_column_count(table); ++c) {
+                    const ecs_id_t id = type->array[ecs_table_column_to_type_index(table, c)];
+                    const ecs_type_info_t *info = ecs_get_type_info(w, id);
+                    if (info && (info->hooks.copy || info->hooks.move || info->hooks.dtor))
+                        throw std::runtime_error("gpecs checkpoint: component " + checkpoint::entity_name(w, id) +
+                                                 " is not plain data");
+                    const uint64_t size = ecs_table_get_column_size(table, c);
+                    out.put(size);
+                    out.put(ecs_table_get_column(table, c, 0), rows * size);
+                }
+            }
+
+            out.put(checkpoint::END);
+            out.close();
+        }
+        if (std::rename(part.c_str(), path.c_str()) != 0)
+            throw std::runtime_error("gpecs checkpoint: cannot replace " + path);
+    }
+
+    // Creates the entities saved in `path` in `world`, which must not hold
+    // entities with the same ids, and sets the world's frame count and time
+    // to those at the checkpoint. Returns the step and saved values; throws
+    // std::runtime_error if the file cannot be used with this world.
+    inline Checkpoint load_checkpoint(flecs::world & world, const std::string & path) {
+        ecs_world_t *w = world.c_ptr();
+        ecs_assert(!world.is_deferred(), ECS_INVALID_OPERATION, "checkpoint restored inside a system");
+
+        checkpoint::File in(path, "rb");
+        const auto header = in.get < checkpoint::Header > ();
+        if (std::memcmp(header.magic, checkpoint::MAGIC, sizeof(header.magic)) != 0)
+            throw std::runtime_error("gpecs checkpoint: " + path + " is not a checkpoint");
+        if (header.version != checkpoint::VERSION)
+            throw std::runtime_error("gpecs checkpoint: " + path + " has an unknown version");
+
+        Checkpoint cp(header.step);
+        for (uint32_t v = 0; v < header.values; ++v) {
+            std::string name = in.get_string();
+            std::vector < std::byte > &bytes = cp.values_[name];
+            bytes.resize(in.get < uint64_t > ());
+            in.get(bytes.data(), bytes.size());
+        }
+
+        std::vector < ecs_entity_t > ids;
+        for (uint32_t t = 0; t < header.tables; ++t) {
+            // Find (or create) the table from the component names
+            ecs_table_t *table = nullptr;
+            const uint32_t count = in.get < uint32_t > ();
+            for (uint32_t i = 0; i < count; ++i)
+                table = ecs_table_add_id(w, table, checkpoint::get_id(in, w));
+
+            ids.resize(in.get < uint64_t > ());
+            in.get(ids.data(), ids.size() * sizeof(ecs_entity_t));
+            if (ids.empty())
+                continue;
+            for (ecs_entity_t e : ids)
+                if (ecs_is_alive(w, e))
+                    throw std::runtime_error("gpecs checkpoint: entity " + std::to_string(e) +
+                                             " already exists in this world");
+
+            ecs_bulk_desc_t desc = {};
+            desc.entities = ids.data();
+            desc.count = static_cast<int32_t>(ids.size());
+            desc.table = table;
+            ecs_bulk_init(w, &desc);
+
+            // The new entities are the last rows of the table
+            const int32_t row = ECS_RECORD_TO_ROW(ecs_record_find(w, ids.front())->row);
+            for (int32_t c = 0; c < ecs_table_column_count(table); ++c) {
+                const uint64_t size = in.get < uint64_t > ();
+                if (size != ecs_table_get_column_size(table, c))
+                    throw std::runtime_error("gpecs checkpoint: a component in " + path + " has changed size");
+                in.get(ecs_table_get_column(table, c, row), ids.size() * size);
+            }
+        }
+
+        char end[sizeof(checkpoint::END)];
+        in.get(end, sizeof(end));
+        if (std::memcmp(end, checkpoint::END, sizeof(end)) != 0)
+            throw std::runtime_error("gpecs checkpoint: " + path + " is damaged");
+
+        // flecs has no setter for these; they are plain counters it adds to
+        ecs_world_info_t *info = const_cast<ecs_world_info_t*>(ecs_get_world_info(w));
+        info->frame_count_total = header.frames;
+        info->world_time_total = header.time;
+        info->world_time_total_raw = header.time;
+        return cp;
+    }
+
+    // Whether a stop signal (SIGTERM) has arrived since
+    // checkpoint_from_args() installed the handler
+    inline bool stop_requested() { return checkpoint::stop_signal != 0; }
+
+    struct CheckpointOptions {
+        std::string path;       // --checkpoint, "" for none
+        int64_t every {0};      // --checkpoint-every, 0 for only on SIGTERM
+        std::string restart;    // --restart, "" to start from the beginning
+
+        bool restarting() const { return !restart.empty(); }
+
+        // True if a checkpoint should be written after `step`
+        bool due(int64_t step) const {
+            return !path.empty() && ((every > 0 && step % every == 0) || stop_requested());
+        }
+    };
+
+    // Reads `--checkpoint PATH`, `--checkpoint-every K` and `--restart PATH`.
+    // With --checkpoint, SIGTERM no longer kills the process: it sets
+    // stop_requested() for the step loop to write a checkpoint and stop.
+    inline CheckpointOptions checkpoint_from_args(int & argc, char *argv[]) {
+        CheckpointOptions options;
+        std::string every;
+        take_option(argc, argv, "--checkpoint", options.path);
+        take_option(argc, argv, "--restart", options.restart);
+        if (take_option(argc, argv, "--checkpoint-every", every))
+            options.every = std::strtoll(every.c_str(), nullptr, 10);
+        if (!options.path.empty())
+            std::signal(SIGTERM, checkpoint::on_stop_signal);
+        return options;
+    }
+
+}                               // namespace gpecs
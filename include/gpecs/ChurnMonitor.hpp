@@ -0,0 +1,335 @@
+//
+// (c) 2026 University of Manchester
+// You may use this under the terms of the Apache 2 License
+//
+//
+// This file implements a monitor for archetype churn: structural changes
+// (adding or removing a component or tag) made by each system.
+//
+// flecs stores entities with the same set of components together in a
+// table. Adding or removing anything, even an empty tag, moves the entity
+// to another table and copies every component it has. The 2D random walk
+// sketch adds one of nine boundary tags to every walker each step and the
+// move system removes it again; the Markov chain does remove<state1>() /
+// set<state2>() on every transition. Both pay for a table move where a
+// field in a component would do.
+//
+// Inside a system these changes are only queued; flecs applies them at the
+// next merge, after the systems in between have run. The monitor marks the
+// start and end of each system's commands in the queue and, while the
+// merge applies them, counts per system and frame:
+//
+//   moves    entities moved to another table (created entities included)
+//   adds     components and tags added
+//   removes  components and tags removed
+//   bytes    component data copied by the moves
+//   merge    time spent applying the system's commands
+//
+// and compares the merge time to the time spent in the system itself:
+//
+//     gpecs churn: 10000 frames
+//       moves/fr   adds/fr  rem/fr  KB/fr  run us/fr  merge us/fr  system
+//           2.00      2.00    2.00   0.03       0.41         2.95  #570 {Position} <- churn dominates
+//           ...
+//
+// Systems whose merge time is more than `dominates` times their run time
+// are flagged: that is where keeping the state in a field (or in a separate
+// entity) pays off.
+//
+// Enabling it from the command line - `--churn PATH` also writes one CSV
+// row per system per frame with any structural change, `--churn -` prints
+// only the summary. The option is removed from argv (see Args.hpp):
+//
+//     flecs::world world(argc, argv);
+//     auto churn = gpecs::churn_from_args(world, argc, argv);
+//
+// Notes:
+//
+// * flecs applies all of an entity's queued changes in one move, at the
+//   point of the first command queued for it. If two systems change the
+//   same entity in one frame the move is counted against the first.
+// * Changes made outside systems (setting up the world, or between
+//   world.progress() calls) are reported as "outside systems".
+// * The monitor observes every add and remove in the world and queues two
+//   events per system run, so leave it off for timing runs.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <flecs.h>
+
+#include <gpecs/Args.hpp>
+#include <gpecs/SystemHooks.hpp>
+
+namespace gpecs {
+    struct ChurnOptions {
+        std::string path;       // Per-frame rows (CSV), "" for none
+        bool summary {true};    // Print the summary when the monitor is destroyed
+        double dominates {1.0}; // Flag systems whose merge time exceeds this times their run time
+    };
+
+    // Structural changes attributed to one system
+    struct ChurnCounts {
+        int64_t moves {0};
+        int64_t adds {0};
+        int64_t removes {0};
+        int64_t bytes {0};
+        double merge {0};       // seconds
+
+        bool any() const { return moves || adds || removes; }
+
+        void add(const ChurnCounts & other) {
+            moves += other.moves;
+            adds += other.adds;
+            removes += other.removes;
+            bytes += other.bytes;
+            merge += other.merge;
+        }
+    };
+
+    // What ChurnMonitor keeps for each system
+    struct ChurnSystem {
+        struct alignas(64) Slot {
+            double run {0};     // seconds in the system, this worker
+        };
+
+        std::vector < Slot > workers;
+        ChurnCounts total;
+        ChurnCounts frame;
+        double run {0};         // seconds in the system, all workers, all frames
+
+        double frame_run() const {
+            double r = 0;
+          for (const Slot & slot : workers)
+                r += slot.run;
+            return r;
+        }
+    };
+
+    class ChurnMonitor : public SystemHooks < ChurnMonitor, ChurnSystem > {
+        friend class SystemHooks < ChurnMonitor, ChurnSystem >;
+
+      public:
+        explicit ChurnMonitor(flecs::world & world, ChurnOptions options = {})
+            : SystemHooks(world), options_(std::move(options)) {
+            if (!options_.path.empty()) {
+                out_.open(options_.path);
+                if (!out_.is_open())
+                    std::cerr << "gpecs churn: cannot open " << options_.path << std::endl;
+                else
+                    out_ << "frame,phase,system,moves,adds,removes,bytes,run_us,merge_us\n";
+            }
+
+            // Registered here, not from a worker thread on first use
+            world_.component<Mark>();
+            marker_ = world_.entity();
+            marker_.observe<Mark>([this](Mark & mark) { enter(mark.system); });
+
+            // `*` sees components and tags, `(*, *)` sees pairs
+            for (flecs::id_t id : { flecs::id_t(flecs::Wildcard), ecs_pair(flecs::Wildcard, flecs::Wildcard) }) {
+                observers_.push_back(world_.observer()
+                    .with(id)
+                    .event(flecs::OnAdd)
+                    .event(flecs::OnRemove)
+                    .each([this](flecs::iter & it, size_t row) { changed(it, row); }));
+            }
+            start();
+        }
+
+        ~ChurnMonitor() {
+            stop();
+          for (flecs::observer & o : observers_)
+                if (o.is_alive())
+                    o.destruct();
+            if (marker_.is_alive())
+                marker_.destruct();
+            if (options_.summary && frames_ > 0)
+                std::cout << report() << std::flush;
+        }
+
+        // Summary over every frame so far, most merge time first
+        std::string report() const;
+
+      private:
+        using clock = std::chrono::steady_clock;
+
+        // Queued around each system run; `system` is 0 after the run
+        struct Mark {
+            flecs::entity_t system;
+        };
+
+        void hooked(Hooked & h) {
+            h.data.workers.resize(std::max(1, world_.get_stage_count()));
+        }
+
+        void around(Hooked & h, ecs_iter_t * it) {
+            const int32_t stage = ecs_stage_get_id(it->world);
+            flecs::entity marker(it->world, marker_.id());
+            marker.enqueue<Mark>({ h.system });
+            const clock::time_point start = clock::now();
+            h.call(it);
+            if (stage >= 0 && stage < static_cast<int32_t>(h.data.workers.size()))
+                h.data.workers[stage].run += std::chrono::duration<double>(clock::now() - start).count();
+            marker.enqueue<Mark>({ 0 });
+        }
+
+        // A Mark is being applied: changes from here on belong to `system`
+        void enter(flecs::entity_t system) {
+            const clock::time_point now = clock::now();
+            if (current_ != &outside_)
+                current_->merge += std::chrono::duration<double>(now - entered_).count();
+            entered_ = now;
+            current_ = &outside_;
+            if (system) {
+                auto it = hooked_.find(system);
+                if (it != hooked_.end())
+                    current_ = &it->second->data.frame;
+            }
+            last_ = {};
+        }
+
+        void changed(flecs::iter & it, size_t row) {
+            if (it.entity(row) == marker_)
+                return;
+            ChurnCounts & counts = *current_;
+            const bool added = it.event() == flecs::OnAdd;
+            (added ? counts.adds : counts.removes)++;
+
+            // One move fires an event per id added and removed; count it once
+            ecs_table_t *from = added ? it.other_table().get_table() : it.table().get_table();
+            ecs_table_t *to = added ? it.table().get_table() : it.other_table().get_table();
+            const Move move { it.entity(row).id(), from, to };
+            if (!to || move == last_)
+                return;
+            last_ = move;
+            ++counts.moves;
+            counts.bytes += copied(from, to);
+        }
+
+        // Bytes of component data an entity takes along from one table to another
+        int64_t copied(ecs_table_t * from, ecs_table_t * to) {
+            if (!from)
+                return 0;
+            auto [it, inserted] = copied_.try_emplace({ from, to }, 0);
+            if (inserted) {
+                const ecs_type_t *type = ecs_table_get_type(from);
+                for (int32_t i = 0; i < type->count; ++i) {
+                    const int32_t column = ecs_table_get_column_index(world_, from, type->array[i]);
+                    if (column >= 0 && ecs_table_get_type_index(world_, to, type->array[i]) >= 0)
+                        it->second += static_cast<int64_t>(ecs_table_get_column_size(from, column));
+                }
+            }
+            return it->second;
+        }
+
+        void end_frame() {
+            enter(0);
+          for (auto & [id, h] : hooked_) {
+                ChurnSystem & s = h->data;
+                const double run = s.frame_run();
+                if (out_.is_open() && s.frame.any())
+                    write_row(h->phase, h->label, s.frame, run);
+                s.total.add(s.frame);
+                s.run += run;
+                s.frame = {};
+                for (auto & slot : s.workers)
+                    slot.run = 0;
+                const std::size_t workers = std::max(1, world_.get_stage_count());
+                if (s.workers.size() < workers)
+                    s.workers.resize(workers);
+            }
+            if (out_.is_open() && outside_.any())
+                write_row("-", "outside systems", outside_, 0);
+            outside_total_.add(outside_);
+            outside_ = {};
+        }
+
+        void write_row(const std::string & phase, const std::string & system, const ChurnCounts & c, double run) {
+            char buf[64];
+            std::snprintf(buf, sizeof(buf), "%.3f,%.3f", 1e6 * run, 1e6 * c.merge);
+            out_ << frames_ << ',' << csv(phase) << ',' << csv(system) << ',' << c.moves << ',' << c.adds << ','
+                 << c.removes << ',' << c.bytes << ',' << buf << '\n';
+        }
+
+        static std::string csv(const std::string & s) {
+            if (s.find_first_of(",\"") == std::string::npos)
+                return s;
+            std::string r = "\"";
+          for (char c : s)
+                r += (c == '"') ? std::string("\"\"") : std::string(1, c);
+            return r + "\"";
+        }
+
+        struct Move {
+            flecs::entity_t entity {0};
+            ecs_table_t *from {nullptr};
+            ecs_table_t *to {nullptr};
+            bool operator==(const Move &) const = default;
+        };
+
+        ChurnOptions options_;
+        std::ofstream out_;
+        flecs::entity marker_;
+        std::vector < flecs::observer > observers_;
+        std::map < std::pair < ecs_table_t *, ecs_table_t * >, int64_t > copied_;
+
+        ChurnCounts outside_;
+        ChurnCounts *current_ {&outside_};
+        clock::time_point entered_;
+        Move last_;
+        ChurnCounts outside_total_;
+    };
+
+    inline std::string ChurnMonitor::report() const {
+        std::vector < const Hooked * > order;
+      for (auto & [id, h] : hooked_)
+            if (h->data.total.any())
+                order.push_back(h.get());
+        std::sort(order.begin(), order.end(),
+                  [](auto *a, auto *b) { return a->data.total.merge > b->data.total.merge; });
+
+        std::string r;
+        char line[512];
+        const double frames = static_cast<double>(std::max < int64_t > (1, frames_));
+        std::snprintf(line, sizeof(line), "gpecs churn: %lld frames\n", static_cast<long long>(frames_));
+        r += line;
+        r += "   moves/fr    adds/fr     rem/fr     KB/fr  run us/fr  merge us/fr  system\n";
+        auto row = [&](const ChurnCounts & c, double run, const std::string & name, bool flag) {
+            std::snprintf(line, sizeof(line), "%11.2f %10.2f %10.2f %9.2f %10.2f %12.2f  %s%s\n", c.moves / frames,
+                          c.adds / frames, c.removes / frames, c.bytes / frames / 1024.0, 1e6 * run / frames,
+                          1e6 * c.merge / frames, name.c_str(), flag ? " <- churn dominates" : "");
+            r += line;
+        };
+      for (const Hooked *h : order) {
+            const ChurnSystem & s = h->data;
+            row(s.total, s.run, h->phase + " / " + h->label, s.total.merge > options_.dominates * s.run);
+        }
+        if (outside_total_.any())
+            row(outside_total_, 0, "outside systems", false);
+        return r;
+    }
+
+    // Creates a monitor if `--churn PATH` was given (`-` for the summary
+    // only), otherwise returns an empty pointer
+    inline std::unique_ptr < ChurnMonitor > churn_from_args(flecs::world & world, int & argc, char *argv[]) {
+        std::string path;
+        if (!take_option(argc, argv, "--churn", path))
+            return nullptr;
+        ChurnOptions options;
+        options.path = (path == "-") ? "" : path;
+        return std::make_unique < ChurnMonitor > (world, options);
+    }
+
+}                               // namespace gpecs
@@ -0,0 +1,487 @@
+//
+// (c) 2026 University of Manchester
+// You may use this under the terms of the Apache 2 License
+//
+//
+// This file implements a columnar binary format for simulation output, with
+// a writer and a zero-copy (mmap) reader. include/gpecs/columns.py loads the
+// same files into NumPy arrays with np.memmap.
+//
+// The examples write comma separated text that the plotting scripts then
+// parse back: up to three times the bytes of the doubles, rounded to six
+// digits, with most of the time going in formatting and parsing. A column
+// file holds the doubles as they are, one array per component field, so
+// writing and loading run at disk speed:
+//
+//     gpecs::ColumnWriter out("fluid.gcol", {
+//         gpecs::column_spec<double>("u"),
+//         gpecs::column_spec<double>("v"),
+//         gpecs::column_spec<double>("rho"),
+//     });
+//
+//     out.begin_frame(t_step, t_step * TIMESTEP, nodes);  // one per save
+//     out.column(velocities.data(), &VelocityStart::x);    // a field of each
+//     out.column(velocities.data(), &VelocityStart::y);    // component
+//     out.column(densities.data());                        // or a plain array
+//     out.end_frame();
+//
+// Columns are written in schema order, all with `rows` values per frame.
+// The frames and the index are finished by close() (or the destructor); a
+// file cut short by a crash can still be read up to its last whole frame.
+//
+// A run restarted from a checkpoint (Checkpoint.hpp) carries on the file of
+// the run it continues instead of starting a new one: given the first step
+// it will write, the writer keeps the frames before that step, drops any
+// after it, and appends from there.
+//
+//     gpecs::ColumnWriter out("fluid.gcol", schema, cp.step + 1);
+//
+//     gpecs::ColumnReader in("fluid.gcol");
+//     for (std::size_t f = 0; f < in.frames().size(); ++f) {
+//         // a view into the mapping
+//         std::span<const double> rho = in.column<double>(f, "rho");
+//         ...
+//     }
+//
+// And from Python:
+//
+//     import columns
+//     data = columns.load("fluid.gcol")
+//     rho = data.column("rho")        # (frames, rows) view of the file
+//     data.frames[3]["step"]
+//
+// Layout - little endian, every block starts on a 64 byte boundary so the
+// arrays can be used in place:
+//
+//   file header   64 bytes   "GPECSCOL", u32 version, u32 columns,
+//                            u64 offset of the first frame
+//   columns       64 bytes   char name[48], char dtype[8] (NumPy, e.g. "<f8"),
+//                 each       u64 bytes per value
+//   frames        64 bytes   "GPECSFRM", i64 step, f64 time, u64 rows,
+//                 each       u64 bytes to the next frame;
+//                            then each column's rows values, padded to 64 bytes
+//   index         32 bytes   i64 step, f64 time, u64 rows, u64 frame offset
+//                 per frame
+//   trailer       32 bytes   "GPECSIDX", u64 offset of the index, u64 frames
+//
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace gpecs {
+    static_assert(std::endian::native == std::endian::little, "column files are written in the machine's byte order");
+
+    // One column of a column file
+    struct ColumnSpec {
+        std::string name;       // up to 47 characters
+        std::string dtype;      // NumPy type string, e.g. "<f8"
+        uint64_t size {0};      // bytes per value
+    };
+
+    namespace columns {
+        constexpr std::size_t ALIGN = 64;
+        constexpr uint32_t VERSION = 1;
+        constexpr char FILE_MAGIC[8] = { 'G', 'P', 'E', 'C', 'S', 'C', 'O', 'L' };
+        constexpr char FRAME_MAGIC[8] = { 'G', 'P', 'E', 'C', 'S', 'F', 'R', 'M' };
+        constexpr char INDEX_MAGIC[8] = { 'G', 'P', 'E', 'C', 'S', 'I', 'D', 'X' };
+
+        struct FileHeader {
+            char magic[8];
+            uint32_t version;
+            uint32_t columns;
+            uint64_t data_offset;
+            char reserved[40];
+        };
+
+        struct ColumnHeader {
+            char name[48];
+            char dtype[8];
+            uint64_t size;
+        };
+
+        struct FrameHeader {
+            char magic[8];
+            int64_t step;
+            double time;
+            uint64_t rows;
+            uint64_t bytes;
+            char reserved[24];
+        };
+
+        struct IndexEntry {
+            int64_t step;
+            double time;
+            uint64_t rows;
+            uint64_t offset;
+        };
+
+        struct Trailer {
+            char magic[8];
+            uint64_t index_offset;
+            uint64_t frames;
+            uint64_t reserved;
+        };
+
+        static_assert(sizeof(FileHeader) == ALIGN && sizeof(ColumnHeader) == ALIGN && sizeof(FrameHeader) == ALIGN);
+
+        inline uint64_t padded(uint64_t bytes) { return (bytes + ALIGN - 1) / ALIGN * ALIGN; }
+
+        template <typename T>
+        constexpr const char *dtype_of() {
+            if constexpr (std::is_same_v<T, double>)
+                return "<f8";
+            else if constexpr (std::is_same_v<T, float>)
+                return "<f4";
+            else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+                return sizeof(T) == 1 ? "|i1" : sizeof(T) == 2 ? "<i2" : sizeof(T) == 4 ? "<i4" : "<i8";
+            else if constexpr (std::is_integral_v<T>)
+                return sizeof(T) == 1 ? "|u1" : sizeof(T) == 2 ? "<u2" : sizeof(T) == 4 ? "<u4" : "<u8";
+            else
+                static_assert(!sizeof(T), "column values are integers or floating point");
+        }
+    }                           // namespace columns
+
+    template <typename T>
+    ColumnSpec column_spec(std::string name) {
+        return { std::move(name), columns::dtype_of<T>(), sizeof(T) };
+    }
+
+    class ColumnWriter {
+      public:
+        // Creates (or truncates) `path`; throws std::runtime_error if it cannot
+        ColumnWriter(const std::string & path, std::vector < ColumnSpec > schema)
+            : path_(path), schema_(std::move(schema)) {
+            create();
+        }
+
+        // Reopens `path` to carry on from `first_step`: keeps its frames for
+        // the steps before it and writes after them, or creates the file if
+        // there is none. Throws std::runtime_error if it has other columns.
+        ColumnWriter(const std::string & path, std::vector < ColumnSpec > schema, int64_t first_step);
+
+        ~ColumnWriter() {
+            try {
+                close();
+            } catch (const std::exception &) {
+                // Nothing to report to from a destructor; call close() to see it
+            }
+        }
+
+        ColumnWriter(const ColumnWriter &) = delete;
+        ColumnWriter & operator=(const ColumnWriter &) = delete;
+
+        // Starts a frame of `rows` values per column
+        void begin_frame(int64_t step, double time, uint64_t rows) {
+            if (in_frame_)
+                throw std::runtime_error("gpecs columns: begin_frame() before end_frame() in " + path_);
+            columns::FrameHeader header {};
+            std::memcpy(header.magic, columns::FRAME_MAGIC, sizeof(header.magic));
+            header.step = step;
+            header.time = time;
+            header.rows = rows;
+            header.bytes = sizeof(header);
+          for (const ColumnSpec & spec : schema_)
+                header.bytes += columns::padded(rows * spec.size);
+            index_.push_back({ step, time, rows, offset_ });
+            put(&header, sizeof(header));
+            in_frame_ = true;
+            next_column_ = 0;
+        }
+
+        // The next column, `rows` values
+        template <typename T>
+        void column(const T * values) {
+            const ColumnSpec & spec = next < T > ();
+            const uint64_t bytes = index_.back().rows * spec.size;
+            put(values, bytes);
+            pad(bytes);
+        }
+
+        // The next column, taken from one field of an array of `rows` structs
+        template <typename S, typename T>
+        void column(const S * rows, T S::*field) {
+            const ColumnSpec & spec = next < T > ();
+            const uint64_t count = index_.back().rows;
+            T buffer[512];
+            for (uint64_t done = 0; done < count;) {
+                const uint64_t n = std::min < uint64_t > (count - done, std::size(buffer));
+                for (uint64_t i = 0; i < n; ++i)
+                    buffer[i] = rows[done + i].*field;
+                put(buffer, n * sizeof(T));
+                done += n;
+            }
+            pad(count * spec.size);
+        }
+
+        void end_frame() {
+            if (!in_frame_ || next_column_ != schema_.size())
+                throw std::runtime_error("gpecs columns: frame is missing columns in " + path_);
+            in_frame_ = false;
+        }
+
+        // Writes the index and closes the file; throws if anything failed
+        void close() {
+            if (!file_)
+                return;
+            std::FILE *file = file_;
+            if (!in_frame_) {
+                const uint64_t index_offset = offset_;
+                put(index_.data(), index_.size() * sizeof(columns::IndexEntry));
+                columns::Trailer trailer {};
+                std::memcpy(trailer.magic, columns::INDEX_MAGIC, sizeof(trailer.magic));
+                trailer.index_offset = index_offset;
+                trailer.frames = index_.size();
+                put(&trailer, sizeof(trailer));
+            }
+            file_ = nullptr;
+            if (std::fclose(file) != 0 || in_frame_)
+                throw std::runtime_error("gpecs columns: could not finish " + path_);
+        }
+
+        const std::vector < ColumnSpec > &schema() const { return schema_; }
+        std::size_t frames() const { return index_.size(); }
+
+      private:
+        // Writes the file and column headers to a new file
+        void create() {
+          for (const ColumnSpec & spec : schema_)
+                if (spec.name.size() >= sizeof(columns::ColumnHeader::name) ||
+                    spec.dtype.size() > sizeof(columns::ColumnHeader::dtype))
+                    throw std::runtime_error("gpecs columns: column name too long: " + spec.name);
+            file_ = std::fopen(path_.c_str(), "wb");
+            if (!file_)
+                throw std::runtime_error("gpecs columns: cannot create " + path_);
+
+            try {
+                columns::FileHeader header {};
+                std::memcpy(header.magic, columns::FILE_MAGIC, sizeof(header.magic));
+                header.version = columns::VERSION;
+                header.columns = static_cast<uint32_t>(schema_.size());
+                header.data_offset = sizeof(header) + schema_.size() * sizeof(columns::ColumnHeader);
+                put(&header, sizeof(header));
+              for (const ColumnSpec & spec : schema_) {
+                    columns::ColumnHeader column {};
+                    std::memcpy(column.name, spec.name.data(), spec.name.size());
+                    std::memcpy(column.dtype, spec.dtype.data(), spec.dtype.size());
+                    column.size = spec.size;
+                    put(&column, sizeof(column));
+                }
+            } catch (...) {
+                std::fclose(file_);
+                file_ = nullptr;
+                throw;
+            }
+        }
+
+        template <typename T>
+        const ColumnSpec & next() {
+            if (!in_frame_ || next_column_ >= schema_.size())
+                throw std::runtime_error("gpecs columns: column written outside a frame in " + path_);
+            const ColumnSpec & spec = schema_[next_column_++];
+            if (spec.dtype != columns::dtype_of<T>())
+                throw std::runtime_error("gpecs columns: column " + spec.name + " is " + spec.dtype);
+            return spec;
+        }
+
+        void put(const void *data, uint64_t bytes) {
+            if (bytes && std::fwrite(data, 1, bytes, file_) != bytes)
+                throw std::runtime_error("gpecs columns: cannot write " + path_);
+            offset_ += bytes;
+        }
+
+        void pad(uint64_t bytes) {
+            static const char zeros[columns::ALIGN] = {};
+            put(zeros, columns::padded(bytes) - bytes);
+        }
+
+        std::string path_;
+        std::vector < ColumnSpec > schema_;
+        std::FILE *file_ {nullptr};
+        uint64_t offset_ {0};
+        std::vector < columns::IndexEntry > index_;
+        bool in_frame_ {false};
+        std::size_t next_column_ {0};
+    };
+
+    class ColumnReader {
+      public:
+        struct Frame {
+            int64_t step;
+            double time;
+            uint64_t rows;
+            uint64_t offset;    // of the frame header in the file
+        };
+
+        // Maps `path` read only; throws std::runtime_error if it is not a column file
+        explicit ColumnReader(const std::string & path) : path_(path) {
+            const int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                throw std::runtime_error("gpecs columns: cannot open " + path);
+            struct stat st {};
+            if (::fstat(fd, &st) == 0)
+                size_ = static_cast<uint64_t>(st.st_size);
+            if (size_ >= sizeof(columns::FileHeader)) {
+                void *data = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+                if (data != MAP_FAILED)
+                    data_ = static_cast<const std::byte*>(data);
+            }
+            ::close(fd);
+            if (!data_)
+                throw std::runtime_error("gpecs columns: cannot map " + path);
+            try {
+                read_schema();
+                read_index();
+            } catch (...) {
+                ::munmap(const_cast<std::byte*>(data_), size_);
+                throw;
+            }
+        }
+
+        ~ColumnReader() {
+            ::munmap(const_cast<std::byte*>(data_), size_);
+        }
+
+        ColumnReader(const ColumnReader &) = delete;
+        ColumnReader & operator=(const ColumnReader &) = delete;
+
+        const std::vector < ColumnSpec > &schema() const { return schema_; }
+        const std::vector < Frame > &frames() const { return frames_; }
+
+        // False if the writer did not finish (the frames are those found whole)
+        bool complete() const { return complete_; }
+
+        // Position of the column called `name`; throws if there is none
+        std::size_t column_index(std::string_view name) const {
+            for (std::size_t c = 0; c < schema_.size(); ++c)
+                if (schema_[c].name == name)
+                    return c;
+            throw std::runtime_error("gpecs columns: no column " + std::string(name) + " in " + path_);
+        }
+
+        // Values of one column in one frame, pointing into the mapped file
+        template <typename T>
+        std::span < const T > column(std::size_t frame, std::size_t column) const {
+            const ColumnSpec & spec = schema_.at(column);
+            if (spec.dtype != columns::dtype_of<T>())
+                throw std::runtime_error("gpecs columns: column " + spec.name + " is " + spec.dtype);
+            const Frame & f = frames_.at(frame);
+            uint64_t offset = f.offset + sizeof(columns::FrameHeader);
+            for (std::size_t c = 0; c < column; ++c)
+                offset += columns::padded(f.rows * schema_[c].size);
+            return { reinterpret_cast<const T*>(data_ + offset), f.rows };
+        }
+
+        template <typename T>
+        std::span < const T > column(std::size_t frame, std::string_view name) const {
+            return column < T > (frame, column_index(name));
+        }
+
+      private:
+        template <typename T>
+        const T & at(uint64_t offset) const {
+            if (offset + sizeof(T) > size_)
+                throw std::runtime_error("gpecs columns: " + path_ + " is truncated");
+            return *reinterpret_cast<const T*>(data_ + offset);
+        }
+
+        void read_schema() {
+            const auto & header = at < columns::FileHeader > (0);
+            if (std::memcmp(header.magic, columns::FILE_MAGIC, sizeof(header.magic)) != 0)
+                throw std::runtime_error("gpecs columns: " + path_ + " is not a column file");
+            if (header.version != columns::VERSION)
+                throw std::runtime_error("gpecs columns: " + path_ + " has an unknown version");
+            for (uint32_t c = 0; c < header.columns; ++c) {
+                const auto & column = at < columns::ColumnHeader > (sizeof(header) + c * sizeof(columns::ColumnHeader));
+                schema_.push_back({ std::string(column.name, strnlen(column.name, sizeof(column.name))),
+                                    std::string(column.dtype, strnlen(column.dtype, sizeof(column.dtype))),
+                                    column.size });
+            }
+            data_offset_ = header.data_offset;
+        }
+
+        void read_index() {
+            if (size_ >= data_offset_ + sizeof(columns::Trailer)) {
+                const auto & trailer = at < columns::Trailer > (size_ - sizeof(columns::Trailer));
+                if (std::memcmp(trailer.magic, columns::INDEX_MAGIC, sizeof(trailer.magic)) == 0) {
+                    for (uint64_t i = 0; i < trailer.frames; ++i) {
+                        const auto & entry = at < columns::IndexEntry > (trailer.index_offset + i * sizeof(columns::IndexEntry));
+                        frames_.push_back({ entry.step, entry.time, entry.rows, entry.offset });
+                    }
+                    complete_ = true;
+                    return;
+                }
+            }
+            // No index: walk the frames that were written in full
+            uint64_t offset = data_offset_;
+            while (offset + sizeof(columns::FrameHeader) <= size_) {
+                const auto & header = at < columns::FrameHeader > (offset);
+                if (std::memcmp(header.magic, columns::FRAME_MAGIC, sizeof(header.magic)) != 0 ||
+                    offset + header.bytes > size_)
+                    break;
+                frames_.push_back({ header.step, header.time, header.rows, offset });
+                offset += header.bytes;
+            }
+        }
+
+        std::string path_;
+        const std::byte *data_ {nullptr};
+        uint64_t size_ {0};
+        uint64_t data_offset_ {0};
+        std::vector < ColumnSpec > schema_;
+        std::vector < Frame > frames_;
+        bool complete_ {false};
+    };
+
+    inline ColumnWriter::ColumnWriter(const std::string & path, std::vector < ColumnSpec > schema, int64_t first_step)
+        : path_(path), schema_(std::move(schema)) {
+        if (::access(path.c_str(), F_OK) != 0) {
+            create();
+            return;
+        }
+        uint64_t end = sizeof(columns::FileHeader) + schema_.size() * sizeof(columns::ColumnHeader);
+        {
+            const ColumnReader in(path);
+            bool same = in.schema().size() == schema_.size();
+            for (std::size_t c = 0; same && c < schema_.size(); ++c)
+                same = in.schema()[c].name == schema_[c].name && in.schema()[c].dtype == schema_[c].dtype &&
+                       in.schema()[c].size == schema_[c].size;
+            if (!same)
+                throw std::runtime_error("gpecs columns: " + path + " has other columns than this run writes");
+          for (const ColumnReader::Frame & frame : in.frames()) {
+                if (frame.step >= first_step)
+                    break;
+                index_.push_back({ frame.step, frame.time, frame.rows, frame.offset });
+                end = frame.offset + sizeof(columns::FrameHeader);
+              for (const ColumnSpec & spec : schema_)
+                    end += columns::padded(frame.rows * spec.size);
+            }
+        }
+        // Cut off the index and the frames from the first step on
+        if (::truncate(path.c_str(), static_cast<off_t>(end)) != 0)
+            throw std::runtime_error("gpecs columns: cannot cut " + path + " back to step " + std::to_string(first_step));
+        file_ = std::fopen(path.c_str(), "ab");
+        if (!file_)
+            throw std::runtime_error("gpecs columns: cannot open " + path);
+        offset_ = end;
+    }
+
+}                               // namespace gpecs
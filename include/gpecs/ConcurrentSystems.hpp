@@ -0,0 +1,520 @@
+//
+// (c) 2026 University of Manchester
+// You may use this under the terms of the Apache 2 License
+//
+//
+// This file implements running independent systems at the same time, one
+// per worker, with the order kept only between systems that touch the same
+// data.
+//
+// flecs runs systems one after the other; --threads splits each system's
+// entities between the workers, which does nothing for a system with few
+// entities. 2DrandomWalk has nine such systems, one per wall and corner
+// tag, chained in nine phases although no walker is on two walls at once.
+// ConcurrentSystems takes the systems of a list of phases and runs them on
+// the world's workers, each system whole on one worker:
+//
+//     gpecs::use_threads(world, argc, argv);
+//     ...phases and systems...
+//     gpecs::ConcurrentSystems moves(world, {findTagPhase, leftWallMove, upWallMove, ...});
+//
+// The phases are listed in pipeline order and should follow one another in
+// the pipeline. Their systems keep their declared order where it matters:
+// a system waits for an earlier one if they conflict, that is one writes a
+// component the other reads or writes, on tables both match. Components of
+// other entities (singletons, .up() terms, .write<T>() declarations) are
+// taken to be on every table. A system with no terms might touch anything
+// and waits for everything before it, as everything after it waits for it.
+//
+// The access comes from each system's query: T& is read and written,
+// const T& read, .with<Tag>() neither, .write<T>() and .read<T>() as they
+// say. A system that adds or removes components through its entity should
+// declare it with .write<T>(); flecs wants the same for its own merges.
+//
+// How - every listed system is made multi-threaded and its run callback
+// replaced, so flecs calls it on every worker. flecs still merges commands
+// where its pipeline says, e.g. between a system with .write<Tag>() and a
+// later one with .with<Tag>(); the list is cut into segments at those
+// merges, worked out from the queries the same way flecs does. The first
+// system of a segment to be called runs the whole segment: the first
+// worker to get there finds the tables every system matches, draws the
+// conflicts, and gives each system, in order, to the least busy (by
+// entities) of the workers no earlier than those of the systems it waits
+// for. Each worker then runs its systems in order, waiting where needed,
+// and the later systems of the segment do nothing when flecs calls them.
+//
+// Notes:
+//
+// * Commands (add, remove, set through an entity) go to the queue of the
+//   worker that ran the system; flecs merges the queues in worker order
+//   at the end of the segment. Systems that conflict are never on a later
+//   worker than the systems they wait for, so their commands merge in the
+//   declared order.
+// * Without --threads nothing changes: the systems run on the main thread
+//   in the declared order, as before.
+// * Systems listed here run whole on one worker even if marked
+//   .multi_threaded(); put systems with many entities outside the list.
+//   Immediate systems and systems with a rate or interval are left as
+//   they are and end a segment.
+// * The segments start from a merge at the first listed system. A
+//   multi-threaded system just before the list that writes something the
+//   list reads (.write<T>() again) would make flecs merge inside the first
+//   segment; put a gpecs::sync_point() in front of the list if so.
+// * The profiler and flecs' system time put a segment's time on the system
+//   that ran it.
+// * Systems are changed when the object is built and restored when it is
+//   destroyed, which must happen before the world is. Create it after
+//   use_threads() and the systems.
+// * report() shows the last frame's plan: each segment's workers, their
+//   systems and what they waited for.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <flecs.h>
+
+#include <gpecs/Profiler.hpp>
+
+namespace gpecs {
+    namespace concurrent {
+        // What a system does with one component
+        struct Access {
+            ecs_id_t id;
+            bool write;
+            bool rows;          // on the entities it iterates; false for anywhere
+        };
+
+        inline std::vector < Access > accesses(const ecs_query_t * q) {
+            std::vector < Access > result;
+            for (int8_t t = 0; t < q->term_count; ++t) {
+                const ecs_term_t & term = q->terms[t];
+                const int8_t f = term.field_index;
+                const bool read = q->read_fields & (1u << f);
+                const bool write = q->write_fields & (1u << f);
+                if (!read && !write)
+                    continue;
+                const bool rows = ecs_term_match_this(&term) && !(term.src.id & EcsUp);
+                result.push_back(Access { term.id, write, rows });
+            }
+            return result;
+        }
+
+        // Both sorted
+        inline bool overlap(const std::vector < const ecs_table_t * > &a,
+                            const std::vector < const ecs_table_t * > &b) {
+            auto i = a.begin();
+            auto j = b.begin();
+            while (i != a.end() && j != b.end()) {
+                if (*i == *j)
+                    return true;
+                if (*i < *j)
+                    ++i;
+                else
+                    ++j;
+            }
+            return false;
+        }
+
+        // Ids written to the stage since the last merge, as flecs' pipeline
+        // keeps them; wildcards match both ways, which can only add merges
+        struct Staged {
+            std::vector < ecs_id_t > ids;
+
+            bool has(ecs_id_t id) const {
+              for (ecs_id_t s : ids)
+                    if (s == id || ecs_id_match(id, s) || ecs_id_match(s, id))
+                        return true;
+                return false;
+            }
+        };
+
+        // flecs_pipeline_check_term(): whether the term needs a merge first,
+        // recording what it writes to the stage
+        inline bool needs_merge(const ecs_term_t & term, bool active, Staged & staged) {
+            if (term.inout == EcsInOutFilter)
+                return false;
+            bool from_any = ecs_term_match_0(&term);
+            const bool from_this = ecs_term_match_this(&term);
+            const bool shared = !from_any && (!from_this || !(term.src.id & EcsSelf));
+            const bool written = staged.has(term.id);
+            if (from_this && written)
+                return true;
+            int16_t inout = term.inout;
+            if (inout == EcsInOutDefault) {
+                if (from_any)
+                    return false;
+                inout = shared ? EcsIn : EcsInOut;
+            }
+            if (term.oper == EcsNot && inout == EcsOut)
+                from_any = true;
+            if (!from_any)
+                return false;
+            if (active && (inout == EcsOut || inout == EcsInOut))
+                staged.ids.push_back(term.id);
+            return written && (inout == EcsIn || inout == EcsInOut);
+        }
+
+        // flecs_pipeline_check_terms(): $this terms first
+        inline bool needs_merge(const ecs_query_t * q, bool active, Staged & staged) {
+            bool merge = false;
+            for (int8_t t = 0; t < q->term_count; ++t)
+                if (ecs_term_match_this(&q->terms[t]))
+                    merge = needs_merge(q->terms[t], active, staged) || merge;
+            for (int8_t t = 0; t < q->term_count; ++t)
+                if (!ecs_term_match_this(&q->terms[t]))
+                    merge = needs_merge(q->terms[t], active, staged) || merge;
+            return merge;
+        }
+    }                           // namespace concurrent
+
+    class ConcurrentSystems {
+      public:
+        ConcurrentSystems(flecs::world & world, std::initializer_list < flecs::entity > phases)
+            : world_(world) {
+          for (const flecs::entity & phase : phases) {
+                std::vector < flecs::entity_t > systems;
+                ecs_iter_t it = ecs_each_id(world_, EcsSystem);
+                while (ecs_each_next(&it))
+                    for (int i = 0; i < it.count; ++i)
+                        if (ecs_has_pair(world_, it.entities[i], EcsDependsOn, phase.id()))
+                            systems.push_back(it.entities[i]);
+                std::sort(systems.begin(), systems.end());
+              for (flecs::entity_t system : systems) {
+                    ecs_system_t *s = const_cast<ecs_system_t*>(ecs_system_get(world_, system));
+                    Member member;
+                    member.system = system;
+                    member.data = s;
+                    member.access = concurrent::accesses(s->query);
+                    member.barrier = s->query->field_count == 0;
+                    member.owned = !s->immediate && !s->tick_source;
+                    members_.push_back(std::move(member));
+                }
+            }
+            done_ = std::make_unique < std::atomic < int64_t >[] > (members_.size());
+            for (std::size_t i = 0; i < members_.size(); ++i)
+                done_[i].store(-1);
+            lanes_ = std::max(1, world_.get_stage_count());
+            if (members_.size() < 2 || lanes_ == 1) {
+                lanes_ = 1;
+                return;
+            }
+            passes_.assign(lanes_, 0);
+
+            hooks_ = std::make_unique < Hook[] > (members_.size());
+            for (std::size_t i = 0; i < members_.size(); ++i) {
+                Member & m = members_[i];
+                if (!m.owned)
+                    continue;
+                hooks_[i] = Hook { this, i };
+                m.run = m.data->run;
+                m.run_ctx = m.data->run_ctx;
+                m.run_ctx_free = m.data->run_ctx_free;
+                m.multi_threaded = m.data->multi_threaded;
+                m.data->run = &ConcurrentSystems::drive;
+                m.data->run_ctx = &hooks_[i];
+                m.data->run_ctx_free = nullptr;
+                m.data->multi_threaded = true;
+            }
+            rebuild();
+        }
+
+        ConcurrentSystems(const ConcurrentSystems &) = delete;
+        ConcurrentSystems & operator=(const ConcurrentSystems &) = delete;
+
+        ~ConcurrentSystems() {
+            if (!hooks_)
+                return;
+          for (std::size_t i = 0; i < members_.size(); ++i) {
+                Member & m = members_[i];
+                if (!m.owned || !ecs_is_alive(world_, m.system) || ecs_system_get(world_, m.system) != m.data ||
+                    m.data->run_ctx != &hooks_[i])
+                    continue;
+                m.data->run = m.run;
+                m.data->run_ctx = m.run_ctx;
+                m.data->run_ctx_free = m.run_ctx_free;
+                m.data->multi_threaded = m.multi_threaded;
+            }
+            rebuild();
+        }
+
+        std::size_t size() const { return members_.size(); }
+        int workers() const { return lanes_; }
+
+        // The last frame's plan, segment by segment and worker by worker
+        std::string report() const {
+            std::lock_guard < std::mutex > lock(planning_);
+            std::string r;
+            char line[512];
+            std::snprintf(line, sizeof(line), "gpecs concurrent: %zu systems on %d worker%s\n",
+                          members_.size(), lanes_, lanes_ == 1 ? "" : "s");
+            r += line;
+            if (!hooks_)
+                return r + "  all in the declared order\n";
+            for (std::size_t begin = 0; begin < members_.size();) {
+                std::size_t end = begin;
+                while (end < members_.size() && members_[end].segment == members_[begin].segment)
+                    ++end;
+                std::snprintf(line, sizeof(line), "  segment %d:\n", members_[begin].segment);
+                r += line;
+                for (int lane = 0; lane < lanes_; ++lane) {
+                    for (std::size_t i = begin; i < end; ++i) {
+                        const Member & m = members_[i];
+                        if (!m.scheduled || m.lane != lane)
+                            continue;
+                        std::string after;
+                      for (std::size_t j : m.after)
+                            after += (after.empty() ? " after " : ", ") + std::to_string(j);
+                        std::snprintf(line, sizeof(line), "    worker %d: %zu %s, %lld entities%s\n", lane, i,
+                                      system_label(world_, m.system).c_str(), static_cast<long long>(m.rows),
+                                      after.c_str());
+                        r += line;
+                    }
+                }
+              for (std::size_t i = begin; i < end; ++i) {
+                    if (members_[i].scheduled)
+                        continue;
+                    std::snprintf(line, sizeof(line), "    not run here: %zu %s\n", i,
+                                  system_label(world_, members_[i].system).c_str());
+                    r += line;
+                }
+                begin = end;
+            }
+            return r;
+        }
+
+      private:
+        struct Hook {
+            ConcurrentSystems *self;
+            std::size_t index;
+        };
+
+        struct Member {
+            flecs::entity_t system {0};
+            ecs_system_t *data {nullptr};
+            std::vector < concurrent::Access > access;
+            bool barrier {false};
+            bool owned {false};         // run through this object
+            // The system's own
+            ecs_run_action_t run {nullptr};
+            void *run_ctx {nullptr};
+            ecs_ctx_free_t run_ctx_free {nullptr};
+            bool multi_threaded {false};
+            // This frame's plan
+            int segment {0};
+            bool scheduled {false};
+            std::vector < const ecs_table_t * > tables;
+            int64_t rows {0};
+            int lane {0};
+            std::vector < std::size_t > after;  // earlier members it conflicts with
+        };
+
+        // flecs rebuilds its pipeline when the systems it matches change
+        void rebuild() {
+          for (const Member & m : members_) {
+                if (ecs_is_alive(world_, m.system) && !ecs_has_id(world_, m.system, EcsDisabled)) {
+                    ecs_enable(world_, m.system, false);
+                    ecs_enable(world_, m.system, true);
+                    return;
+                }
+            }
+        }
+
+        static void drive(ecs_iter_t * it) {
+            const Hook *hook = static_cast<const Hook*>(it->run_ctx);
+            ecs_world_t *stage = it->world;
+            const ecs_ftime_t delta_time = it->delta_time;
+            ecs_iter_fini(it);
+            hook->self->run(stage, hook->index, delta_time);
+        }
+
+        void run(ecs_world_t * stage, std::size_t i, ecs_ftime_t delta_time) {
+            const int lane = ecs_stage_get_id(stage);
+            const int64_t frame = ecs_get_world_info(world_)->frame_count_total;
+            std::size_t begin, end;
+            {
+                std::lock_guard < std::mutex > lock(planning_);
+                if (frame != frame_ || i >= end_) {
+                    // The first system called after a merge
+                    segment(i);
+                    frame_ = frame;
+                    driver_ = i;
+                    plan(stage);
+                } else if (i != driver_) {
+                    return;     // ran with its segment
+                }
+                begin = begin_;
+                end = end_;
+            }
+            const int64_t pass = ++passes_[lane] * lanes_;
+            // Systems before the segment in the same merge may still run
+            arrived_.fetch_add(1, std::memory_order_acq_rel);
+            while (arrived_.load(std::memory_order_acquire) < pass)
+                std::this_thread::yield();
+            for (std::size_t k = begin; k < end; ++k) {
+                const Member & m = members_[k];
+                if (!m.scheduled || m.lane != lane)
+                    continue;
+              for (std::size_t j : m.after)
+                    while (done_[j].load(std::memory_order_acquire) != frame)
+                        std::this_thread::yield();
+                run_member(stage, m, delta_time);
+                done_[k].store(frame, std::memory_order_release);
+            }
+            // ...and systems after it
+            finished_.fetch_add(1, std::memory_order_acq_rel);
+            while (finished_.load(std::memory_order_acquire) < pass)
+                std::this_thread::yield();
+        }
+
+        // What flecs_run_system() would have done
+        static void run_member(ecs_world_t * stage, const Member & m, ecs_ftime_t delta_time) {
+            const ecs_system_t *s = m.data;
+            ecs_iter_t it = ecs_query_iter(stage, s->query);
+            it.system = m.system;
+            it.delta_time = delta_time;
+            it.delta_system_time = delta_time;
+            it.param = s->ctx;
+            it.ctx = s->ctx;
+            it.callback_ctx = s->callback_ctx;
+            it.run_ctx = m.run_ctx;
+            it.callback = s->action;
+            if (m.run) {
+                m.run(&it);
+                if (s->query->flags & EcsQueryMatchNothing)
+                    ecs_iter_fini(&it);
+            } else if (s->query->term_count) {
+                while (ecs_query_next(&it))
+                    s->action(&it);
+            } else {
+                s->action(&it);
+                ecs_iter_fini(&it);
+            }
+        }
+
+        // Cuts the list where flecs merges, as its pipeline does with the
+        // systems as they are now, and sets the bounds of i's segment
+        void segment(std::size_t i) {
+            concurrent::Staged staged;
+            bool first = true;
+            bool multi_threaded = false;
+            bool immediate = false;
+            int current = 0;
+            for (std::size_t k = 0; k < members_.size(); ++k) {
+                Member & m = members_[k];
+                m.scheduled = false;
+                if (ecs_has_id(world_, m.system, EcsDisabled)) {
+                    m.segment = current;
+                    continue;
+                }
+                const bool active = !ecs_has_id(world_, m.system, EcsEmpty);
+                bool merge = concurrent::needs_merge(m.data->query, active, staged);
+                if (active) {
+                    if (first) {
+                        multi_threaded = m.data->multi_threaded;
+                        immediate = m.data->immediate;
+                        first = false;
+                    }
+                    merge = merge || m.data->multi_threaded != multi_threaded || m.data->immediate != immediate;
+                    multi_threaded = m.data->multi_threaded;
+                    immediate = m.data->immediate;
+                }
+                if (immediate)
+                    merge = true;
+                if (merge) {
+                    staged.ids.clear();
+                    if (active)
+                        concurrent::needs_merge(m.data->query, true, staged);
+                }
+                // Systems left to flecs stand alone
+                if (k > 0 && (merge || !m.owned || !members_[k - 1].owned))
+                    ++current;
+                m.segment = current;
+                m.scheduled = m.owned && active;
+            }
+            begin_ = i;
+            while (begin_ > 0 && members_[begin_ - 1].segment == members_[i].segment)
+                --begin_;
+            end_ = i;
+            while (end_ < members_.size() && members_[end_].segment == members_[i].segment)
+                ++end_;
+        }
+
+        bool conflict(const Member & a, const Member & b) const {
+            if (a.barrier || b.barrier)
+                return true;
+          for (const concurrent::Access & x : a.access) {
+              for (const concurrent::Access & y : b.access) {
+                    if (!(x.write || y.write))
+                        continue;
+                    if (!ecs_id_match(x.id, y.id) && !ecs_id_match(y.id, x.id))
+                        continue;
+                    if (!x.rows || !y.rows || concurrent::overlap(a.tables, b.tables))
+                        return true;
+                }
+            }
+            return false;
+        }
+
+        // Spreads the current segment over the workers
+        void plan(ecs_world_t * stage) {
+            for (std::size_t k = begin_; k < end_; ++k) {
+                Member & m = members_[k];
+                m.tables.clear();
+                m.rows = 0;
+                m.after.clear();
+                if (!m.scheduled)
+                    continue;
+                ecs_iter_t it = ecs_query_iter(stage, m.data->query);
+                while (ecs_query_next(&it)) {
+                    m.tables.push_back(it.table);
+                    m.rows += it.count;
+                }
+                std::sort(m.tables.begin(), m.tables.end());
+                m.tables.erase(std::unique(m.tables.begin(), m.tables.end()), m.tables.end());
+            }
+            std::vector < int64_t > load(lanes_, 0);
+            for (std::size_t k = begin_; k < end_; ++k) {
+                Member & m = members_[k];
+                if (!m.scheduled)
+                    continue;
+                int first = 0;
+                for (std::size_t j = begin_; j < k; ++j) {
+                    if (members_[j].scheduled && conflict(members_[j], m)) {
+                        m.after.push_back(j);
+                        first = std::max(first, members_[j].lane);
+                    }
+                }
+                m.lane = static_cast<int>(std::min_element(load.begin() + first, load.end()) - load.begin());
+                load[m.lane] += m.rows + 1;
+            }
+        }
+
+        flecs::world & world_;
+        std::vector < Member > members_;
+        std::unique_ptr < Hook[] > hooks_;
+        std::unique_ptr < std::atomic < int64_t >[] > done_;  // frame each member last finished
+        int lanes_ {1};
+        // The segment being run
+        mutable std::mutex planning_;
+        int64_t frame_ {-1};
+        std::size_t begin_ {0};
+        std::size_t end_ {0};
+        std::size_t driver_ {0};
+        // Barriers around each segment
+        std::vector < int64_t > passes_;        // segments each worker has entered
+        std::atomic < int64_t > arrived_ {0};
+        std::atomic < int64_t > finished_ {0};
+    };
+
+}                               // namespace gpecs
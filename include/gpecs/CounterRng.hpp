@@ -0,0 +1,211 @@
+//
+// (c) 2026 University of Manchester
+// You may use this under the terms of the Apache 2 License
+//
+//
+// This file implements a counter-based random number generator for
+// stochastic systems.
+//
+// The sketches draw their random numbers from a std::mt19937, either built
+// afresh (with a std::random_device) on every call, which is slow, or
+// shared between systems, which gives a different sequence for every
+// thread count and races once the systems run on several threads.
+//
+// A counter-based generator (Philox4x32-10, Salmon et al., SC'11) has no
+// state to share: the numbers are a pure function of a key and a counter.
+// Here the key is the run's seed and the entity, and the counter is the
+// step and a stream number, so each entity gets its own numbers for each
+// step whichever thread runs it, and a run is reproducible with any number
+// of threads:
+//
+//     world.system<Person>().multi_threaded()
+//         .each([](flecs::iter& it, size_t row, Person& p) {
+//             gpecs::CounterRng rng(seed, it.entity(row), gpecs::step_of(it));
+//             if (rng.uniform() < p_move) ...
+//             double tau = rng.exponential(rate);
+//         });
+//
+// Use a different stream for each independent use within a step (e.g. one
+// system deciding to move and another deciding to infect), otherwise the
+// two see the same numbers.
+//
+// Batches - uniform_batch(), exponential_batch() and normal_batch() give
+// one number per entity for a whole array of entities, e.g. it.entities()
+// in a .run() system. They are written lane by lane so the compiler can
+// vectorise them, and give the same numbers as the first draw of the
+// CounterRng for each entity.
+//
+// Numbers:
+//
+// * uniform() is in the open interval (0, 1), with 53 random bits, so it is
+//   safe to take its log.
+// * exponential(rate) is -log(u) / rate.
+// * normal() uses Box-Muller, giving two numbers per pair of uniforms; the
+//   second is kept for the next call.
+// * Each CounterRng gives 2^32 blocks of four 32 bit words before it wraps.
+//
+
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include <flecs.h>
+
+namespace gpecs {
+    namespace philox {
+        constexpr uint32_t M0 = 0xD2511F53u;
+        constexpr uint32_t M1 = 0xCD9E8D57u;
+        constexpr uint32_t W0 = 0x9E3779B9u;
+        constexpr uint32_t W1 = 0xBB67AE85u;
+
+        using Block = std::array < uint32_t, 4 >;
+
+        // Philox4x32 with 10 rounds
+        inline Block block(Block c, uint32_t k0, uint32_t k1) {
+            for (int round = 0; round < 10; ++round) {
+                const uint64_t p0 = uint64_t(M0) * c[0];
+                const uint64_t p1 = uint64_t(M1) * c[2];
+                c = { uint32_t(p1 >> 32) ^ c[1] ^ k0, uint32_t(p1), uint32_t(p0 >> 32) ^ c[3] ^ k1, uint32_t(p0) };
+                k0 += W0;
+                k1 += W1;
+            }
+            return c;
+        }
+
+        // Spreads the seed's bits so nearby seeds give unrelated keys
+        inline uint64_t mix(uint64_t x) {
+            x += 0x9E3779B97F4A7C15ull;
+            x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+            x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+            return x ^ (x >> 31);
+        }
+
+        // Two 32 bit words to a double in (0, 1)
+        inline double unit(uint32_t hi, uint32_t lo) {
+            const uint64_t bits = (uint64_t(hi) << 32 | lo) >> 11;
+            return (double(bits) + 0.5) * 0x1p-53;
+        }
+    }                           // namespace philox
+
+    class CounterRng {
+      public:
+        CounterRng(uint64_t seed, flecs::entity_t entity, uint64_t step, uint32_t stream = 0)
+            : key_(philox::mix(seed) ^ entity),
+              counter_ { 0, stream, uint32_t(step), uint32_t(step >> 32) } { }
+
+        // Next 32 random bits
+        uint32_t bits() {
+            if (used_ == 4)
+                refill();
+            return block_[used_++];
+        }
+
+        double uniform() {
+            const uint32_t hi = bits();
+            return philox::unit(hi, bits());
+        }
+
+        double exponential(double rate) { return -std::log(uniform()) / rate; }
+
+        double normal() {
+            if (has_spare_) {
+                has_spare_ = false;
+                return spare_;
+            }
+            const double r = std::sqrt(-2.0 * std::log(uniform()));
+            const double theta = 2.0 * M_PI * uniform();
+            spare_ = r * std::sin(theta);
+            has_spare_ = true;
+            return r * std::cos(theta);
+        }
+
+      private:
+        void refill() {
+            block_ = philox::block(counter_, uint32_t(key_), uint32_t(key_ >> 32));
+            ++counter_[0];
+            used_ = 0;
+        }
+
+        uint64_t key_;
+        philox::Block counter_;
+        philox::Block block_ {};
+        int used_ {4};
+        double spare_ {0};
+        bool has_spare_ {false};
+    };
+
+    // The step to key a CounterRng with from inside a system: the number of
+    // frames the world has run
+    inline uint64_t step_of(const flecs::iter & it) {
+        return static_cast<uint64_t>(ecs_get_world_info(it.world())->frame_count_total);
+    }
+
+    namespace philox {
+        // First block for each of `n` entities, lanes side by side so the
+        // rounds vectorise; calls out(i, block) for each entity
+        template <typename Out>
+        inline void first_blocks(uint64_t seed, uint64_t step, uint32_t stream, const flecs::entity_t * entities,
+                                 std::size_t n, Out && out) {
+            constexpr std::size_t lanes = 8;
+            const uint64_t mixed = mix(seed);
+            for (std::size_t base = 0; base < n; base += lanes) {
+                const std::size_t width = (n - base < lanes) ? n - base : lanes;
+                uint32_t c0[lanes], c1[lanes], c2[lanes], c3[lanes], k0[lanes], k1[lanes];
+                for (std::size_t l = 0; l < lanes; ++l) {
+                    const uint64_t key = mixed ^ entities[base + (l < width ? l : 0)];
+                    c0[l] = 0;
+                    c1[l] = stream;
+                    c2[l] = uint32_t(step);
+                    c3[l] = uint32_t(step >> 32);
+                    k0[l] = uint32_t(key);
+                    k1[l] = uint32_t(key >> 32);
+                }
+                for (int round = 0; round < 10; ++round) {
+                    for (std::size_t l = 0; l < lanes; ++l) {
+                        const uint64_t p0 = uint64_t(M0) * c0[l];
+                        const uint64_t p1 = uint64_t(M1) * c2[l];
+                        const uint32_t n0 = uint32_t(p1 >> 32) ^ c1[l] ^ k0[l];
+                        const uint32_t n2 = uint32_t(p0 >> 32) ^ c3[l] ^ k1[l];
+                        c1[l] = uint32_t(p1);
+                        c3[l] = uint32_t(p0);
+                        c0[l] = n0;
+                        c2[l] = n2;
+                        k0[l] += W0;
+                        k1[l] += W1;
+                    }
+                }
+                for (std::size_t l = 0; l < width; ++l)
+                    out(base + l, Block { c0[l], c1[l], c2[l], c3[l] });
+            }
+        }
+    }                           // namespace philox
+
+    // out[i] = CounterRng(seed, entities[i], step, stream).uniform()
+    inline void uniform_batch(uint64_t seed, uint64_t step, uint32_t stream, const flecs::entity_t * entities,
+                              std::size_t n, double *out) {
+        philox::first_blocks(seed, step, stream, entities, n, [out](std::size_t i, const philox::Block & b) {
+            out[i] = philox::unit(b[0], b[1]);
+        });
+    }
+
+    // out[i] = CounterRng(seed, entities[i], step, stream).exponential(rate)
+    inline void exponential_batch(uint64_t seed, uint64_t step, uint32_t stream, const flecs::entity_t * entities,
+                                  std::size_t n, double rate, double *out) {
+        uniform_batch(seed, step, stream, entities, n, out);
+        for (std::size_t i = 0; i < n; ++i)
+            out[i] = -std::log(out[i]) / rate;
+    }
+
+    // out[i] = CounterRng(seed, entities[i], step, stream).normal()
+    inline void normal_batch(uint64_t seed, uint64_t step, uint32_t stream, const flecs::entity_t * entities,
+                             std::size_t n, double *out) {
+        philox::first_blocks(seed, step, stream, entities, n, [out](std::size_t i, const philox::Block & b) {
+            const double r = std::sqrt(-2.0 * std::log(philox::unit(b[0], b[1])));
+            out[i] = r * std::cos(2.0 * M_PI * philox::unit(b[2], b[3]));
+        });
+    }
+
+}                               // namespace gpecs
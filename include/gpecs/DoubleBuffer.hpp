@@ -0,0 +1,77 @@
+//
+// (c) 2026 University of Manchester
+// You may use this under the terms of the Apache 2 License
+//
+//
+// This file implements ping-pong (double buffered) storage for values that a
+// time stepping scheme reads at step n and writes at step n+1.
+//
+// Without it, a sketch keeps separate "start" and "end" components and runs
+// a whole extra phase at the end of each step just to copy end into start.
+// With it, both values live in one DoubleBuffered<T> and a single world-wide
+// BufferFlip index says which slot is "current". Systems read current() and
+// write next(); at the end of the step flipping the index swaps the roles,
+// so the copy pass (and its memory traffic) disappears.
+//
+// DoubleBuffered<T> works as a per-entity component, or as a member of a
+// singleton holding whole grid fields (see GridField.hpp):
+//
+//     struct Grid { gpecs::DoubleBuffered<gpecs::GridField1D<double>> phi; };
+//
+// Setup - register the index and a system that flips it in the last phase:
+//
+//     gpecs::flip_buffers(world, Update);
+//
+// Use inside a system (BufferFlip is a singleton, so it can be a term):
+//
+//     world.system<Grid, const gpecs::BufferFlip>()
+//         .kind(RungeKutta_4)
+//         .each([](Grid& g, const gpecs::BufferFlip& flip) {
+//             auto now = g.phi.current(flip).view();
+//             auto then = g.phi.next(flip).view();
+//             ...
+//         });
+//
+// Every system in the step sees the same index, so there is no risk of one
+// system seeing the flipped roles part way through a step.
+//
+
+#pragma once
+
+#include <flecs.h>
+
+namespace gpecs {
+    // Which of the two slots currently holds the value at the start of the step
+    struct BufferFlip {
+        unsigned current {0};
+        unsigned next() const { return current ^ 1u; }
+    };
+
+    template <typename T>
+    struct DoubleBuffered {
+        T slot[2];
+
+        DoubleBuffered() = default;
+        // Both slots start out holding the same value
+        explicit DoubleBuffered(const T & initial) : slot { initial, initial } { }
+
+        T & current(const BufferFlip & flip) { return slot[flip.current]; }
+        const T & current(const BufferFlip & flip) const { return slot[flip.current]; }
+        T & next(const BufferFlip & flip) { return slot[flip.next()]; }
+        const T & next(const BufferFlip & flip) const { return slot[flip.next()]; }
+    };
+
+    // Registers the BufferFlip singleton and a system in `phase` which swaps
+    // the current and next slots of every DoubleBuffered value once per frame.
+    // `phase` should be the last phase of the step.
+    inline flecs::system flip_buffers(flecs::world & world, flecs::entity_t phase) {
+        world.component<BufferFlip>().add(flecs::Singleton);
+        world.set<BufferFlip>({});
+        return world.system<BufferFlip>()
+            .kind(phase)
+            .each([](BufferFlip & flip) {
+                flip.current = flip.next();
+            });
+    }
+
+}                               // namespace gpecs
@@ -0,0 +1,469 @@
+//
+// (c) 2026 University of Manchester
+// You may use this under the terms of the Apache 2 License
+//
+//
+// This file implements a step loop driver that runs output, diagnostics and
+// analysis as C++20 coroutines on a few background threads, so they overlap
+// with the next steps' world.progress().
+//
+// The examples' main loops do everything in turn: progress(), then write the
+// files, then work out the density grid, then the next step. With Driver a
+// piece of that work is a coroutine returning gpecs::Task. Its first part
+// runs on the main thread and copies what it needs out of the world; then
+// it moves to a strand with co_await and the rest runs in the background:
+//
+//     gpecs::Task density_grid(gpecs::Driver& driver, gpecs::Strand strand,
+//                              const std::vector<flecs::entity>& particles, gpecs::TextWriter& out) {
+//         std::vector<Position> p;                     // main thread, between steps
+//         for (flecs::entity e : particles) p.push_back(e.get<Position>());
+//         co_await driver.on(strand);                  // background from here on
+//         ... rasterise from p and write it to out ...
+//     }
+//
+//     auto driver = gpecs::driver_from_args(argc, argv);
+//     gpecs::Strand grid = driver->strand("density grid");
+//     for (int i = 0; i < STEPS; ++i) {
+//         driver->progress(world);
+//         driver->spawn(i, density_grid(*driver, grid, particles, MyFile_density));
+//     }
+//     driver->flush();
+//
+// Strands - the pieces of work sent to one strand run one at a time, in the
+// order they were sent, so they can share a file or an accumulator without
+// a lock. Different strands run at the same time when there is more than
+// one thread. A task can move from strand to strand with further co_awaits.
+//
+// Back-pressure - at most `depth` tasks are in flight. spawn() waits for the
+// oldest ones to finish when the background falls behind, rather than let
+// copies of the world pile up; waited() says for how long in total.
+//
+// Timeline - the driver records when the main thread was in progress(),
+// when each strand was busy and when spawn() waited. `--timeline -` prints
+// a summary at the end with how much of the background work overlapped
+// with computing, and `--timeline PATH` also writes every span to PATH as
+// CSV. `--io-threads N` and `--io-depth N` set the threads and depth (1 and
+// 2 by default). The options are removed from argv (see Args.hpp).
+//
+// Notes:
+//   - Once a task has moved to a strand it must not touch the world: the
+//     next step is running. Copy everything it needs before the first
+//     co_await.
+//   - Parameters a task takes by reference must outlive it; flush() (and
+//     the destructor) wait until every task has finished.
+//   - A task reports a failure by throwing. The first message is kept, as
+//     for SnapshotWriter; check ok() after flush().
+//   - Each span is a few tens of bytes, kept until the driver is destroyed.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <flecs.h>
+
+#include <gpecs/Args.hpp>
+
+namespace gpecs {
+    class Driver;
+
+    // A queue of background work that runs one piece at a time, in order
+    struct Strand {
+        std::size_t index;
+    };
+
+    // The return type of a coroutine the driver runs. It does nothing until
+    // it is given to Driver::spawn().
+    class Task {
+      public:
+        struct promise_type {
+            Driver *driver {nullptr};
+            int64_t step {0};
+
+            Task get_return_object() {
+                return Task(std::coroutine_handle < promise_type >::from_promise(*this));
+            }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+
+            // Frees the coroutine and tells the driver it has finished
+            struct Done {
+                bool await_ready() noexcept { return false; }
+                void await_suspend(std::coroutine_handle < promise_type > handle) noexcept;
+                void await_resume() noexcept { }
+            };
+            Done final_suspend() noexcept { return {}; }
+
+            void return_void() { }
+            void unhandled_exception();
+        };
+
+        Task(Task && other) noexcept : handle_(std::exchange(other.handle_, {})) { }
+        Task(const Task &) = delete;
+        Task & operator=(const Task &) = delete;
+        ~Task() {
+            if (handle_)
+                handle_.destroy();
+        }
+
+      private:
+        friend class Driver;
+        explicit Task(std::coroutine_handle < promise_type > handle) : handle_(handle) { }
+
+        std::coroutine_handle < promise_type > handle_;
+    };
+
+    struct DriverOptions {
+        int threads {1};        // Background threads
+        int depth {2};          // Tasks in flight before spawn() waits
+        std::string timeline;   // Every span as CSV, "" for none
+        bool summary {false};   // Print the summary when the driver is destroyed
+    };
+
+    class Driver {
+      public:
+        explicit Driver(DriverOptions options = {})
+            : options_(std::move(options)), origin_(clock::now()) {
+            options_.threads = std::max(1, options_.threads);
+            options_.depth = std::max(1, options_.depth);
+            for (int t = 0; t < options_.threads; ++t)
+                threads_.emplace_back([this, t] { work(t); });
+        }
+
+        Driver(const Driver &) = delete;
+        Driver & operator=(const Driver &) = delete;
+
+        ~Driver() {
+            flush();
+            {
+                std::lock_guard < std::mutex > lock(mutex_);
+                stopping_ = true;
+            }
+            ready_cv_.notify_all();
+          for (std::thread & thread : threads_)
+                thread.join();
+            if (!options_.timeline.empty() && options_.timeline != "-")
+                write_timeline(options_.timeline);
+            if (options_.summary && steps_ > 0)
+                std::cout << report() << std::flush;
+        }
+
+        // A new strand; `name` labels it in the timeline
+        Strand strand(const std::string & name) {
+            std::lock_guard < std::mutex > lock(mutex_);
+            strands_.push_back({ name, {}, false, 0 });
+            return { strands_.size() - 1 };
+        }
+
+        // world.progress(), timed as computing
+        bool progress(flecs::world & world, ecs_ftime_t dt = 0) {
+            const double start = now();
+            const bool more = world.progress(dt);
+            const double end = now();
+            std::lock_guard < std::mutex > lock(mutex_);
+            spans_.push_back({ Span::COMPUTE, 0, steps_, -1, start, end });
+            ++steps_;
+            return more;
+        }
+
+        // Runs `task` on this thread up to its first co_await, once fewer
+        // than `depth` tasks are in flight
+        void spawn(int64_t step, Task task) {
+            std::unique_lock < std::mutex > lock(mutex_);
+            if (in_flight_ >= options_.depth) {
+                const double start = now();
+                done_cv_.wait(lock, [this] { return in_flight_ < options_.depth; });
+                const double end = now();
+                spans_.push_back({ Span::WAIT, 0, step, -1, start, end });
+                waited_ += end - start;
+                ++waits_;
+            }
+            ++in_flight_;
+            ++tasks_;
+            lock.unlock();
+            std::coroutine_handle < Task::promise_type > handle = std::exchange(task.handle_, {});
+            handle.promise().driver = this;
+            handle.promise().step = step;
+            handle.resume();
+        }
+
+        // co_await driver.on(strand) carries on on that strand
+        struct Resume {
+            Driver *driver;
+            std::size_t strand;
+
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle < Task::promise_type > handle) {
+                driver->enqueue(strand, handle);
+            }
+            void await_resume() const noexcept { }
+        };
+        Resume on(Strand strand) { return { this, strand.index }; }
+
+        // Waits until every task spawned so far has finished
+        void flush() {
+            std::unique_lock < std::mutex > lock(mutex_);
+            done_cv_.wait(lock, [this] { return in_flight_ == 0; });
+        }
+
+        bool ok() const {
+            std::lock_guard < std::mutex > lock(mutex_);
+            return error_.empty();
+        }
+
+        std::string error() const {
+            std::lock_guard < std::mutex > lock(mutex_);
+            return error_;
+        }
+
+        // Seconds spawn() has waited for the background to catch up
+        double waited() const {
+            std::lock_guard < std::mutex > lock(mutex_);
+            return waited_;
+        }
+
+        // The share of the background time so far (0 to 1) during which the
+        // main thread was in progress()
+        double overlapped() const {
+            std::lock_guard < std::mutex > lock(mutex_);
+            const Totals totals = sum();
+            double busy = 0, overlapped = 0;
+            for (std::size_t s = 0; s < strands_.size(); ++s) {
+                busy += totals.busy[s];
+                overlapped += totals.overlapped[s];
+            }
+            return busy > 0 ? overlapped / busy : 0.0;
+        }
+
+        // Computing and background time so far, and how much of the
+        // background time the main thread spent in progress()
+        std::string report() const {
+            std::lock_guard < std::mutex > lock(mutex_);
+            const Totals totals = sum();
+            double busy = 0, overlapped = 0;
+            for (std::size_t s = 0; s < strands_.size(); ++s) {
+                busy += totals.busy[s];
+                overlapped += totals.overlapped[s];
+            }
+
+            std::string r;
+            char line[512];
+            std::snprintf(line, sizeof(line), "gpecs driver: %lld steps, %.3f s wall, %.3f s computing, "
+                          "%d thread(s), %d task(s) in flight at most\n",
+                          (long long)steps_, totals.wall, totals.computing, options_.threads, options_.depth);
+            r += line;
+            std::snprintf(line, sizeof(line), "  background %.3f s, %.3f s (%.1f%%) of it overlapped with computing\n",
+                          busy, overlapped, busy > 0 ? 100.0 * overlapped / busy : 0.0);
+            r += line;
+            r += "   busy s  overlapped  pieces  strand\n";
+            for (std::size_t s = 0; s < strands_.size(); ++s) {
+                std::snprintf(line, sizeof(line), "  %7.3f      %5.1f%%  %6lld  %s\n", totals.busy[s],
+                              totals.busy[s] > 0 ? 100.0 * totals.overlapped[s] / totals.busy[s] : 0.0,
+                              (long long)strands_[s].pieces, strands_[s].name.c_str());
+                r += line;
+            }
+            std::snprintf(line, sizeof(line), "  back-pressure: waited %.3f s at %lld of %lld spawns\n",
+                          waited_, (long long)waits_, (long long)tasks_);
+            r += line;
+            return r;
+        }
+
+      private:
+        using clock = std::chrono::steady_clock;
+        using Handle = std::coroutine_handle < Task::promise_type >;
+        friend struct Task::promise_type;
+        friend struct Task::promise_type::Done;
+
+        struct Span {
+            enum Kind { COMPUTE, BACKGROUND, WAIT } kind;
+            std::size_t strand;
+            int64_t step;
+            int thread;
+            double start, end;
+        };
+
+        struct Lane {
+            std::string name;
+            std::deque < Handle > queue;
+            bool busy;
+            int64_t pieces;
+        };
+
+        struct Totals {
+            double wall {0}, computing {0};
+            std::vector < double > busy, overlapped;    // per strand
+        };
+
+        // Sums the spans; call with the mutex held
+        Totals sum() const {
+            Totals totals { 0, 0, std::vector < double >(strands_.size(), 0.0),
+                            std::vector < double >(strands_.size(), 0.0) };
+            std::vector < const Span * > compute;
+            double first = spans_.empty() ? 0.0 : spans_.front().start, last = first;
+          for (const Span & span : spans_) {
+                if (span.kind == Span::COMPUTE) {
+                    compute.push_back(&span);
+                    totals.computing += span.end - span.start;
+                }
+                first = std::min(first, span.start);
+                last = std::max(last, span.end);
+            }
+            totals.wall = last - first;
+          for (const Span & span : spans_) {
+                if (span.kind != Span::BACKGROUND)
+                    continue;
+                totals.busy[span.strand] += span.end - span.start;
+                // Compute spans are in time order, one after the other
+                auto at = std::lower_bound(compute.begin(), compute.end(), span.start,
+                                           [](const Span *c, double t) { return c->end <= t; });
+                for (; at != compute.end() && (*at)->start < span.end; ++at)
+                    totals.overlapped[span.strand] += std::min(span.end, (*at)->end) - std::max(span.start, (*at)->start);
+            }
+            return totals;
+        }
+
+        double now() const {
+            return std::chrono::duration < double >(clock::now() - origin_).count();
+        }
+
+        void enqueue(std::size_t strand, Handle handle) {
+            {
+                std::lock_guard < std::mutex > lock(mutex_);
+                Lane & lane = strands_[strand];
+                lane.queue.push_back(handle);
+                // A busy strand is put back on the ready list when it is done
+                if (!lane.busy && lane.queue.size() == 1)
+                    ready_.push_back(strand);
+            }
+            ready_cv_.notify_one();
+        }
+
+        void work(int thread) {
+            std::unique_lock < std::mutex > lock(mutex_);
+            for (;;) {
+                ready_cv_.wait(lock, [this] { return stopping_ || !ready_.empty(); });
+                if (ready_.empty())
+                    return;
+                const std::size_t strand = ready_.front();
+                ready_.pop_front();
+                Lane & lane = strands_[strand];
+                const Handle handle = lane.queue.front();
+                lane.queue.pop_front();
+                lane.busy = true;
+                // The coroutine may finish, and be freed, inside resume()
+                const int64_t step = handle.promise().step;
+                lock.unlock();
+
+                const double start = now();
+                handle.resume();
+                const double end = now();
+
+                lock.lock();
+                lane.busy = false;
+                ++lane.pieces;
+                if (!lane.queue.empty()) {
+                    ready_.push_back(strand);
+                    ready_cv_.notify_one();
+                }
+                spans_.push_back({ Span::BACKGROUND, strand, step, thread, start, end });
+            }
+        }
+
+        void finished() {
+            {
+                std::lock_guard < std::mutex > lock(mutex_);
+                --in_flight_;
+            }
+            done_cv_.notify_all();
+        }
+
+        void failed(std::exception_ptr error) {
+            std::string message = "unknown error";
+            try {
+                std::rethrow_exception(error);
+            } catch (const std::exception & e) {
+                message = e.what();
+            } catch (...) {
+            }
+            std::lock_guard < std::mutex > lock(mutex_);
+            if (error_.empty())
+                error_ = "gpecs driver: " + message;
+        }
+
+        void write_timeline(const std::string & path) const {
+            std::ofstream out(path);
+            if (!out.is_open()) {
+                std::cerr << "gpecs driver: cannot open " << path << std::endl;
+                return;
+            }
+            out << "kind,name,step,thread,start_s,end_s\n";
+            static const char *kinds[] = { "compute", "background", "wait" };
+          for (const Span & span : spans_) {
+                out << kinds[span.kind] << ","
+                    << (span.kind == Span::BACKGROUND ? strands_[span.strand].name : std::string()) << ","
+                    << span.step << "," << span.thread << "," << span.start << "," << span.end << "\n";
+            }
+        }
+
+        DriverOptions options_;
+        clock::time_point origin_;
+        mutable std::mutex mutex_;
+        std::condition_variable ready_cv_;
+        std::condition_variable done_cv_;
+        std::deque < Lane > strands_;
+        std::deque < std::size_t > ready_;
+        std::vector < Span > spans_;
+        std::vector < std::thread > threads_;
+        int in_flight_ {0};
+        int64_t steps_ {0};
+        int64_t tasks_ {0};
+        int64_t waits_ {0};
+        double waited_ {0};
+        bool stopping_ {false};
+        std::string error_;
+    };
+
+    inline void Task::promise_type::Done::await_suspend(std::coroutine_handle < promise_type > handle) noexcept {
+        Driver *driver = handle.promise().driver;
+        handle.destroy();
+        driver->finished();
+    }
+
+    inline void Task::promise_type::unhandled_exception() {
+        driver->failed(std::current_exception());
+    }
+
+    // A driver with the `--io-threads`, `--io-depth` and `--timeline` options
+    // of the command line; the summary is printed only with `--timeline`
+    inline std::unique_ptr < Driver > driver_from_args(int & argc, char *argv[]) {
+        DriverOptions options;
+        std::string value;
+        if (take_option(argc, argv, "--io-threads", value))
+            options.threads = std::atoi(value.c_str());
+        if (take_option(argc, argv, "--io-depth", value))
+            options.depth = std::atoi(value.c_str());
+        if (take_option(argc, argv, "--timeline", value)) {
+            options.timeline = value;
+            options.summary = true;
+        }
+        return std::make_unique < Driver > (options);
+    }
+
+}                               // namespace gpecs
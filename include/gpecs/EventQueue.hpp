@@ -0,0 +1,159 @@
+//
+// (c) 2026 University of Manchester
+// You may use this under the terms of the Apache 2 License
+//
+//
+// This file implements a queue that multi-threaded systems post events to
+// (a state change, a particle crossing into another box, a collision) so the
+// side effects they have beyond their own entity are applied later, on one
+// thread and in the same order whatever the thread count.
+//
+// A system that updates a captured counter or another entity from inside
+// .each() races once it is marked .multi_threaded(), and even single
+// threaded the result depends on the order flecs happens to visit entities
+// in. Instead, the system posts an event, and a single threaded system
+// after it applies them:
+//
+//     struct Transition { int from, to; };
+//     gpecs::EventQueue<Transition> transitions(world);   // after use_threads()
+//
+//     world.system<State>().multi_threaded()
+//         .each([&](flecs::iter& it, size_t row, State& s) {
+//             ...
+//             transitions.emit(it, row, {s.s, next});
+//             s.s = next;
+//         });
+//     transitions.drain(world, flecs::PostUpdate, [&](const Transition& t) {
+//         population[t.from] -= 1;
+//         population[t.to] += 1;
+//     });
+//
+// emit() takes the row so the event is keyed by that entity; pass a
+// flecs::entity instead to key it by another one (the entity a collision is
+// with, say). drain() registers the single threaded system; apply() does
+// the same from anywhere no system is running, e.g. between progress()
+// calls. The function given either takes the event, or the key and the
+// event:
+//
+//     transitions.apply([&](flecs::entity_t person, const Transition& t) { ... });
+//
+// Notes:
+//   - Every worker has its own buffer, padded to a cache line, and emit()
+//     only appends to the caller's one: no locks and no atomics. flecs waits
+//     for all workers before a single threaded system runs, which is what
+//     makes it safe for drain()'s system to read them.
+//   - Events are applied by frame, then by the system that emitted them (in
+//     the order the systems were created), then by key, then in the order
+//     one entity emitted them. flecs gives an entity to exactly one worker
+//     each time a system runs, so that order does not depend on the number
+//     of threads, and neither does anything apply() computes from it.
+//   - That is not the order flecs visits the entities in, which is table by
+//     table. A sketch whose systems read a counter that the same pass
+//     changes (the serial Markov chain's noI) sees the counts as they were
+//     at the start of the pass instead; read the counts in a system, and
+//     update them in the drain, to get that on purpose.
+//   - Applying the events empties the buffers but keeps their memory, so
+//     after the first few frames emit() does not allocate.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include <flecs.h>
+
+namespace gpecs {
+    template <typename Event>
+    class EventQueue {
+      public:
+        // Create after the world's threads have been set
+        explicit EventQueue(flecs::world & world)
+            : buffers_(std::max(1, world.get_stage_count())) { }
+
+        // Posts `event` for the entity of `row`; call from inside a system
+        void emit(flecs::iter & it, std::size_t row, const Event & event) {
+            post(it, it.entity(row), event);
+        }
+
+        // Posts `event` keyed by `key`, which need not be the entity iterated
+        void emit(flecs::iter & it, flecs::entity key, const Event & event) {
+            post(it, key, event);
+        }
+
+        // Calls `func` with every event posted since the last apply(), in the
+        // order described above, then empties the queue. Returns the count.
+        template <typename Func>
+        std::size_t apply(Func && func) {
+            order_.clear();
+          for (Buffer & buffer : buffers_)
+              for (const Entry & entry : buffer.entries)
+                    order_.push_back(&entry);
+            // Entries with the same frame, system and key all come from one
+            // worker's buffer, already in the order they were posted
+            std::stable_sort(order_.begin(), order_.end(), [](const Entry *a, const Entry *b) {
+                if (a->frame != b->frame) return a->frame < b->frame;
+                if (a->system != b->system) return a->system < b->system;
+                return a->key < b->key;
+            });
+          for (const Entry *entry : order_) {
+                if constexpr (std::is_invocable_v < Func &, flecs::entity_t, const Event & >)
+                    func(entry->key, entry->event);
+                else
+                    func(entry->event);
+            }
+          for (Buffer & buffer : buffers_)
+                buffer.entries.clear();
+            return order_.size();
+        }
+
+        // Registers a single threaded system in `phase` that applies the
+        // events with `func` once per frame. Put `phase` after the systems
+        // that emit them.
+        template <typename Func>
+        flecs::system drain(flecs::world & world, flecs::entity_t phase, Func && func) {
+            return world.system<>()
+                .kind(phase)
+                .run([this, func](flecs::iter &) {
+                    apply(func);
+                });
+        }
+
+        // Events posted and not yet applied
+        std::size_t pending() const {
+            std::size_t count = 0;
+          for (const Buffer & buffer : buffers_)
+                count += buffer.entries.size();
+            return count;
+        }
+
+        int workers() const { return static_cast<int>(buffers_.size()); }
+
+      private:
+        struct Entry {
+            int64_t frame;
+            flecs::entity_t system;
+            flecs::entity_t key;
+            Event event;
+        };
+
+        struct alignas(64) Buffer {
+            std::vector < Entry > entries;
+        };
+
+        void post(flecs::iter & it, flecs::entity_t key, const Event & event) {
+            const int32_t stage = it.world().get_stage_id();
+            ecs_assert(stage >= 0 && stage < workers(), ECS_INVALID_OPERATION,
+                       "EventQueue created before the world's threads were set");
+            buffers_[stage].entries.push_back({ it.world().get_info()->frame_count_total,
+                                                it.system().id(), key, event });
+        }
+
+        std::vector < Buffer > buffers_;
+        std::vector < const Entry * > order_;
+    };
+
+}                               // namespace gpecs
@@ -0,0 +1,392 @@
+//
+// (c) 2026 University of Manchester
+// You may use this under the terms of the Apache 2 License
+//
+//
+// This file implements a scratch arena per worker thread, reset at the end
+// of every frame, for the short-lived vectors systems build per entity.
+//
+// asteroids_knn's gravity system builds two vectors of candidates for every
+// asteroid, and the SPH sketches' force() returns a fresh std::vector<double>
+// for every distance, gradient and position it works out: millions of
+// malloc() and free() calls per frame, from every worker at once. A
+// FrameArena hands each thread a std::pmr::memory_resource that allocates by
+// moving a pointer along a block it already has:
+//
+//     auto arena = gpecs::arena_from_args(world, argc, argv);   // after use_threads()
+//
+//     world.system<const Position, Accel>().multi_threaded()
+//         .each([&](const Position& p, Accel& a) {
+//             std::pmr::vector<int> candidates(arena->local());
+//             candidates.reserve(40);
+//             ...
+//         });
+//
+// local() is the calling thread's arena; everything allocated from it is
+// given back at the end of the frame, when the arena starts again from the
+// beginning of its block. Memory freed in the reverse order it was
+// allocated - a local vector going out of scope at the end of each loop
+// iteration - is given back at once, so a loop of short-lived vectors does
+// not grow the arena.
+//
+// A frame that needs more than the block holds gets more blocks from the
+// heap; at the end of that frame they are replaced by one block large
+// enough for all of it. After the first few frames systems allocate
+// nothing from the heap at all. `--arena -` prints how much each worker
+// used at most in a frame (its high-water mark) and how many blocks it
+// took from the heap, and `--arena PATH` also writes the high-water mark of
+// every worker and frame to PATH as CSV. The options are removed from argv
+// (see Args.hpp).
+//
+// Notes:
+//   - The arenas are per thread, not per flecs stage: a worker running rows
+//     it stole from another (WorkStealing.hpp) allocates from its own.
+//   - Memory from local() is valid until the end of the frame it was
+//     allocated in, or, outside a frame, until the end of the next one. Do
+//     not keep anything allocated from it past that, in a component or a
+//     captured variable.
+//   - A vector that grows past its capacity leaves its old storage as a
+//     hole, given back with the vector itself; one that outlives what was
+//     allocated after it keeps its holes until the end of the frame.
+//     reserve() what is known.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <flecs.h>
+#include <gpecs/Args.hpp>
+
+namespace gpecs {
+    struct FrameArenaOptions {
+        std::size_t block = 64 * 1024;  // bytes of each thread's first block
+        std::string path;               // per frame CSV; "" none
+        bool summary = false;           // print the summary on destruction
+    };
+
+    namespace frame_arena {
+        // A bump allocator over a list of blocks from the heap
+        class Bump final : public std::pmr::memory_resource {
+          public:
+            explicit Bump(std::size_t block) : block_(block) {
+                holes_.reserve(HOLES);
+            }
+
+            ~Bump() override {
+              for (const Block & b : blocks_)
+                    ::operator delete(b.data, std::align_val_t { alignof(std::max_align_t) });
+            }
+
+            Bump(const Bump &) = delete;
+            Bump & operator=(const Bump &) = delete;
+
+            // Starts again from the first block, merging the blocks used this
+            // frame into one if there was more than one
+            void reset() {
+                if (blocks_.size() > 1) {
+                    std::size_t total = 0;
+                  for (const Block & b : blocks_) {
+                        total += b.size;
+                        ::operator delete(b.data, std::align_val_t { alignof(std::max_align_t) });
+                    }
+                    blocks_.clear();
+                    add_block(total);
+                }
+                current_ = 0;
+                top_ = 0;
+                latest_ = NONE;
+                holes_.clear();
+                spilled_ = 0;
+                peak_ = 0;
+            }
+
+            std::size_t peak() const { return peak_; }
+            int64_t heap_blocks() const { return heap_blocks_; }
+            std::size_t capacity() const {
+                std::size_t total = 0;
+              for (const Block & b : blocks_)
+                    total += b.size;
+                return total;
+            }
+
+          private:
+            static constexpr std::size_t NONE = ~std::size_t {0};
+            static constexpr std::size_t HOLES = 32;
+
+            struct Block {
+                std::byte *data;
+                std::size_t size;
+            };
+
+            struct Hole {
+                std::size_t start, end;
+            };
+
+            void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+                for (;;) {
+                    if (current_ < blocks_.size()) {
+                        const Block & b = blocks_[current_];
+                        const uintptr_t base = reinterpret_cast<uintptr_t>(b.data);
+                        const std::size_t start = ((base + top_ + alignment - 1) & ~(uintptr_t(alignment) - 1)) - base;
+                        if (start + bytes <= b.size) {
+                            before_ = top_;
+                            latest_ = start;
+                            top_ = start + bytes;
+                            peak_ = std::max(peak_, spilled_ + top_);
+                            return b.data + start;
+                        }
+                        spilled_ += top_;
+                        holes_.clear();
+                        if (current_ + 1 < blocks_.size()) {
+                            ++current_;
+                            top_ = 0;
+                            latest_ = NONE;
+                            continue;
+                        }
+                    }
+                    const std::size_t last = blocks_.empty() ? 0 : blocks_.back().size;
+                    add_block(std::max({ block_, 2 * last, bytes + alignment }));
+                    current_ = blocks_.size() - 1;
+                    top_ = 0;
+                    latest_ = NONE;
+                    holes_.clear();
+                }
+            }
+
+            // Memory at the top of the current block (the latest allocation,
+            // with its padding, or whatever ends at the top) is given back at
+            // once. Memory below it - the old storage of a vector that grew -
+            // is remembered as a hole, and given back when the top comes
+            // down to it.
+            void do_deallocate(void *p, std::size_t bytes, std::size_t) override {
+                if (current_ >= blocks_.size())
+                    return;
+                std::byte *data = blocks_[current_].data;
+                std::byte *ptr = static_cast<std::byte*>(p);
+                if (ptr < data || ptr + bytes > data + top_)
+                    return;             // an earlier block's
+                const std::size_t start = static_cast<std::size_t>(ptr - data);
+                if (latest_ != NONE && start == latest_) {
+                    rewind(before_);
+                } else if (start + bytes == top_) {
+                    rewind(start);
+                } else if (holes_.size() < HOLES) {
+                    holes_.push_back({ start, start + bytes });
+                }
+            }
+
+            void rewind(std::size_t top) {
+                top_ = top;
+                latest_ = NONE;
+                for (std::size_t h = 0; h < holes_.size();) {
+                    if (holes_[h].end >= top_) {
+                        top_ = std::min(top_, holes_[h].start);
+                        holes_.erase(holes_.begin() + static_cast<std::ptrdiff_t>(h));
+                        h = 0;
+                    } else {
+                        ++h;
+                    }
+                }
+            }
+
+            bool do_is_equal(const std::pmr::memory_resource & other) const noexcept override {
+                return this == &other;
+            }
+
+            void add_block(std::size_t size) {
+                auto *data = static_cast<std::byte*>(::operator new(size, std::align_val_t { alignof(std::max_align_t) }));
+                blocks_.push_back({ data, size });
+                ++heap_blocks_;
+            }
+
+            std::size_t block_;
+            std::vector < Block > blocks_;
+            std::vector < Hole > holes_;    // freed below the top
+            std::size_t current_ {0};       // block allocations come from
+            std::size_t top_ {0};           // bytes used of it
+            std::size_t latest_ {NONE};     // where the latest allocation starts
+            std::size_t before_ {0};        // top_ before it, with its padding
+            std::size_t spilled_ {0};       // bytes used of the blocks before current_
+            std::size_t peak_ {0};          // most in use at once this frame
+            int64_t heap_blocks_ {0};
+        };
+    }                           // namespace frame_arena
+
+    class FrameArena {
+      public:
+        explicit FrameArena(flecs::world & world, FrameArenaOptions options = {})
+            : world_(world), options_(std::move(options)), id_(next_id()) {
+            if (!options_.path.empty()) {
+                out_.open(options_.path);
+                if (!out_.is_open())
+                    std::cerr << "gpecs arena: cannot open " << options_.path << std::endl;
+                else
+                    out_ << "frame,worker,peak_bytes,capacity_bytes,heap_blocks\n";
+            }
+            // Runs early in each frame and asks to be called back once every
+            // system of the frame has finished
+            hook_ = world_.system<>()
+                .kind(flecs::OnLoad)
+                .run([this](flecs::iter &) {
+                    ecs_run_post_frame(world_, &FrameArena::end_of_frame, this);
+                });
+        }
+
+        FrameArena(const FrameArena &) = delete;
+        FrameArena & operator=(const FrameArena &) = delete;
+
+        ~FrameArena() {
+            if (hook_.is_alive())
+                hook_.destruct();
+            if (options_.summary)
+                std::cout << report() << std::flush;
+        }
+
+        // The calling thread's arena
+        std::pmr::memory_resource *local() {
+            thread_local Cache cache;
+            if (cache.arena != id_)
+                cache = { id_, &claim() };
+            return &cache.worker->bump;
+        }
+
+        // Gives back everything allocated so far; done at the end of every
+        // frame, call it only when no system is running
+        void reset() {
+            std::lock_guard < std::mutex > lock(mutex_);
+            const int64_t frame = frames_++;
+            for (std::size_t w = 0; w < workers_.size(); ++w) {
+                Worker & worker = *workers_[w];
+                worker.high_water = std::max(worker.high_water, worker.bump.peak());
+                if (out_.is_open())
+                    out_ << frame << "," << w << "," << worker.bump.peak() << ","
+                         << worker.bump.capacity() << "," << worker.bump.heap_blocks() << "\n";
+                if (worker.bump.heap_blocks() > worker.heap_blocks_seen) {
+                    worker.heap_blocks_seen = worker.bump.heap_blocks();
+                    worker.last_heap_frame = frame;
+                }
+                worker.bump.reset();
+            }
+        }
+
+        // The most any thread used in one frame
+        std::size_t high_water() const {
+            std::lock_guard < std::mutex > lock(mutex_);
+            std::size_t most = 0;
+          for (const auto & worker : workers_)
+                most = std::max(most, worker->high_water);
+            return most;
+        }
+
+        // Blocks taken from the heap, by every thread, since the start
+        int64_t heap_blocks() const {
+            std::lock_guard < std::mutex > lock(mutex_);
+            int64_t total = 0;
+          for (const auto & worker : workers_)
+                total += worker->bump.heap_blocks();
+            return total;
+        }
+
+        int workers() const {
+            std::lock_guard < std::mutex > lock(mutex_);
+            return static_cast<int>(workers_.size());
+        }
+
+        int64_t frames() const { return frames_; }
+
+        std::string report() const {
+            std::lock_guard < std::mutex > lock(mutex_);
+            char line[160];
+            std::snprintf(line, sizeof line, "gpecs arena: %lld frames, %zu threads\n",
+                          static_cast<long long>(frames_), workers_.size());
+            std::string r = line;
+            r += "   high water kB  capacity kB  heap blocks  last from heap  thread\n";
+            for (std::size_t w = 0; w < workers_.size(); ++w) {
+                const Worker & worker = *workers_[w];
+                const std::string last = worker.last_heap_frame < 0 ? "-"
+                                         : "frame " + std::to_string(worker.last_heap_frame);
+                std::snprintf(line, sizeof line, "  %14.1f %12.1f %12lld %15s  %zu\n",
+                              worker.high_water / 1024.0, worker.bump.capacity() / 1024.0,
+                              static_cast<long long>(worker.bump.heap_blocks()), last.c_str(), w);
+                r += line;
+            }
+            return r;
+        }
+
+      private:
+        struct alignas(64) Worker {
+            explicit Worker(std::size_t block) : bump(block) { }
+            frame_arena::Bump bump;
+            std::size_t high_water {0};
+            int64_t heap_blocks_seen {0};
+            int64_t last_heap_frame {-1};
+        };
+
+        struct Cache {
+            uint64_t arena {0};
+            Worker *worker {nullptr};
+        };
+
+        // Arenas are told apart by a number rather than their address, which
+        // a later one may reuse
+        static uint64_t next_id() {
+            static std::atomic < uint64_t > next {1};
+            return next.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // The calling thread's worker, made the first time it asks
+        Worker & claim() {
+            std::lock_guard < std::mutex > lock(mutex_);
+            auto found = threads_.find(std::this_thread::get_id());
+            if (found != threads_.end())
+                return *workers_[found->second];
+            workers_.push_back(std::make_unique < Worker > (options_.block));
+            threads_.emplace(std::this_thread::get_id(), workers_.size() - 1);
+            return *workers_.back();
+        }
+
+        static void end_of_frame(ecs_world_t *, void *ctx) {
+            static_cast<FrameArena*>(ctx)->reset();
+        }
+
+        flecs::world & world_;
+        FrameArenaOptions options_;
+        uint64_t id_;
+        flecs::system hook_;
+        std::ofstream out_;
+        mutable std::mutex mutex_;
+        std::vector < std::unique_ptr < Worker > > workers_;
+        std::map < std::thread::id, std::size_t > threads_;
+        int64_t frames_ {0};
+    };
+
+    // `--arena PATH` writes every frame's high-water marks to PATH and prints
+    // the summary on exit, `--arena -` only prints it
+    inline std::unique_ptr < FrameArena > arena_from_args(flecs::world & world, int & argc, char *argv[]) {
+        FrameArenaOptions options;
+        std::string value;
+        if (take_option(argc, argv, "--arena", value)) {
+            options.summary = true;
+            if (value != "-")
+                options.path = value;
+        }
+        return std::make_unique < FrameArena > (world, options);
+    }
+
+}                               // namespace gpecs
@@ -0,0 +1,243 @@
+//
+// (c) 2026 University of Manchester
+// You may use this under the terms of the Apache 2 License
+//
+//
+// This file implements dense storage for fields that live on a structured
+// grid (finite difference / finite volume style sketches).
+//
+// The sketches originally created one flecs entity per grid node and reached
+// neighbours through `nodes[x][y+1].get<T>()`. That works, but every stencil
+// access is a record lookup plus a type-erased fetch. Here each field is
+// instead one contiguous, 64-byte aligned array (so several fields make a
+// structure-of-arrays), padded with a halo of ghost cells on every side.
+//
+// The intended usage is that a sketch bundles its fields into a struct, stores
+// that struct as a flecs singleton and lets its systems run plain loops over
+// the views:
+//
+//     struct Fluid {
+//         gpecs::GridField2D<double> u, v, rho;
+//     };
+//
+//     world.component<Fluid>().add(flecs::Singleton);
+//     world.set<Fluid>({ {NX, NY}, {NX, NY}, {NX, NY} });
+//
+//     world.system<Fluid>()
+//         .kind(flecs::OnUpdate)
+//         .each([](Fluid& f) {
+//             auto u = f.u.view();
+//             for (int y = 0; y < u.ny; ++y)
+//                 for (int x = 0; x < u.nx; ++x)
+//                     ... u(x+1, y) - u(x-1, y) ...
+//         });
+//
+// Indexing is (x, y) with x contiguous in memory. Interior cells run from
+// 0 to n-1; halo cells run from -halo to -1 and from n to n+halo-1. Rows are
+// padded so that every row (including halo rows) starts on an aligned
+// boundary, so `stride` is generally larger than `nx + 2*halo`.
+//
+// Filling the halo is left to the sketch since it encodes the boundary
+// conditions (Dirichlet, reflecting wall, periodic, ...). The helpers
+// `fill_halo()` and `copy_periodic_halo()` cover the simple cases.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+namespace gpecs {
+    // Alignment for the start of every field and every row. One cache line,
+    // and wide enough for any of the vector extensions we are likely to see.
+    constexpr std::size_t GRID_ALIGNMENT = 64;
+
+    // Round a row length (in elements) up so that rows stay aligned
+    constexpr std::ptrdiff_t aligned_stride(std::ptrdiff_t count, std::size_t elem_size) {
+        const std::ptrdiff_t per_line = std::max<std::ptrdiff_t>(1, GRID_ALIGNMENT / elem_size);
+        if (GRID_ALIGNMENT % elem_size != 0)
+            return count;
+        return ((count + per_line - 1) / per_line) * per_line;
+    }
+
+    struct AlignedFree {
+        void operator()(void *p) const { std::free(p); }
+    };
+
+    // Aligned, uninitialised-on-allocation buffer of trivially copyable values
+    template <typename T>
+    class AlignedBuffer {
+        static_assert(std::is_trivially_copyable_v<T>, "grid fields hold plain data");
+      public:
+        AlignedBuffer() = default;
+        explicit AlignedBuffer(std::size_t count) : size_(count) {
+            if (count == 0)
+                return;
+            std::size_t bytes = ((count * sizeof(T) + GRID_ALIGNMENT - 1) / GRID_ALIGNMENT) * GRID_ALIGNMENT;
+            void *p = std::aligned_alloc(GRID_ALIGNMENT, bytes);
+            if (!p)
+                throw std::bad_alloc();
+            data_.reset(static_cast<T*>(p));
+        }
+        AlignedBuffer(const AlignedBuffer & other) : AlignedBuffer(other.size_) {
+            std::copy(other.begin(), other.end(), begin());
+        }
+        AlignedBuffer & operator=(const AlignedBuffer & other) {
+            if (this != &other) {
+                AlignedBuffer tmp(other);
+                *this = std::move(tmp);
+            }
+            return *this;
+        }
+        AlignedBuffer(AlignedBuffer &&) noexcept = default;
+        AlignedBuffer & operator=(AlignedBuffer &&) noexcept = default;
+
+        T* data() { return data_.get(); }
+        const T* data() const { return data_.get(); }
+        std::size_t size() const { return size_; }
+        T* begin() { return data(); }
+        T* end() { return data() + size_; }
+        const T* begin() const { return data(); }
+        const T* end() const { return data() + size_; }
+      private:
+        std::unique_ptr<T, AlignedFree> data_;
+        std::size_t size_ {0};
+    };
+
+    // Non-owning view of a 1D field. Valid indices are [-halo, n+halo).
+    template <typename T>
+    struct GridView1D {
+        T *origin {nullptr};    // Points at interior cell 0
+        int n {0};
+        int halo {0};
+
+        T & operator[](int i) const { return origin[i]; }
+        T* begin() const { return origin; }
+        T* end() const { return origin + n; }
+    };
+
+    // Non-owning strided view of a 2D field. Valid indices are
+    // [-halo, nx+halo) x [-halo, ny+halo).
+    template <typename T>
+    struct GridView2D {
+        T *origin {nullptr};    // Points at interior cell (0, 0)
+        std::ptrdiff_t stride {0};
+        int nx {0};
+        int ny {0};
+        int halo {0};
+
+        T & operator()(int x, int y) const { return origin[y * stride + x]; }
+        T* row(int y) const { return origin + y * stride; }
+    };
+
+    template <typename T>
+    class GridField1D {
+      public:
+        GridField1D() = default;
+        GridField1D(int n, int halo = 1, T init = T {})
+            : n_(n), halo_(halo), storage_(static_cast<std::size_t>(n + 2 * halo)) {
+            fill(init);
+        }
+
+        int n() const { return n_; }
+        int halo() const { return halo_; }
+
+        T & operator[](int i) { return origin()[i]; }
+        const T & operator[](int i) const { return origin()[i]; }
+
+        GridView1D<T> view() { return { origin(), n_, halo_ }; }
+        GridView1D<const T> view() const { return { origin(), n_, halo_ }; }
+
+        void fill(T value) { std::fill(storage_.begin(), storage_.end(), value); }
+
+        // Set the ghost cells on each end to a fixed value (Dirichlet boundary)
+        void fill_halo(T low, T high) {
+            for (int h = 1; h <= halo_; ++h) {
+                origin()[-h] = low;
+                origin()[n_ - 1 + h] = high;
+            }
+        }
+
+        void copy_periodic_halo() {
+            for (int h = 1; h <= halo_; ++h) {
+                origin()[-h] = origin()[n_ - h];
+                origin()[n_ - 1 + h] = origin()[h - 1];
+            }
+        }
+
+        T* data() { return storage_.data(); }
+        const T* data() const { return storage_.data(); }
+      private:
+        T* origin() { return storage_.data() + halo_; }
+        const T* origin() const { return storage_.data() + halo_; }
+
+        int n_ {0};
+        int halo_ {0};
+        AlignedBuffer<T> storage_;
+    };
+
+    template <typename T>
+    class GridField2D {
+      public:
+        GridField2D() = default;
+        GridField2D(int nx, int ny, int halo = 1, T init = T {})
+            : nx_(nx), ny_(ny), halo_(halo),
+              stride_(aligned_stride(nx + 2 * halo, sizeof(T))),
+              storage_(static_cast<std::size_t>(stride_ * (ny + 2 * halo))) {
+            fill(init);
+        }
+
+        int nx() const { return nx_; }
+        int ny() const { return ny_; }
+        int halo() const { return halo_; }
+        std::ptrdiff_t stride() const { return stride_; }
+
+        T & operator()(int x, int y) { return origin()[y * stride_ + x]; }
+        const T & operator()(int x, int y) const { return origin()[y * stride_ + x]; }
+
+        GridView2D<T> view() { return { origin(), stride_, nx_, ny_, halo_ }; }
+        GridView2D<const T> view() const { return { origin(), stride_, nx_, ny_, halo_ }; }
+
+        void fill(T value) { std::fill(storage_.begin(), storage_.end(), value); }
+
+        // Set every ghost cell to a fixed value (Dirichlet boundary)
+        void fill_halo(T value) {
+            for (int y = -halo_; y < ny_ + halo_; ++y) {
+                for (int x = -halo_; x < nx_ + halo_; ++x) {
+                    if (x < 0 || x >= nx_ || y < 0 || y >= ny_)
+                        (*this)(x, y) = value;
+                }
+            }
+        }
+
+        void copy_periodic_halo() {
+            for (int y = 0; y < ny_; ++y) {
+                for (int h = 1; h <= halo_; ++h) {
+                    (*this)(-h, y) = (*this)(nx_ - h, y);
+                    (*this)(nx_ - 1 + h, y) = (*this)(h - 1, y);
+                }
+            }
+            for (int h = 1; h <= halo_; ++h) {
+                std::copy_n(&(*this)(-halo_, ny_ - h), nx_ + 2 * halo_, &(*this)(-halo_, -h));
+                std::copy_n(&(*this)(-halo_, h - 1), nx_ + 2 * halo_, &(*this)(-halo_, ny_ - 1 + h));
+            }
+        }
+
+        T* data() { return storage_.data(); }
+        const T* data() const { return storage_.data(); }
+      private:
+        T* origin() { return storage_.data() + halo_ * stride_ + halo_; }
+        const T* origin() const { return storage_.data() + halo_ * stride_ + halo_; }
+
+        int nx_ {0};
+        int ny_ {0};
+        int halo_ {0};
+        std::ptrdiff_t stride_ {0};
+        AlignedBuffer<T> storage_;
+    };
+
+}                               // namespace gpecs
@@ -0,0 +1,394 @@
+//
+// (c) 2026 University of Manchester
+// You may use this under the terms of the Apache 2 License
+//
+//
+// This file implements a report of what a world's component layout costs
+// in memory, table by table, and of the memory each system reads and writes
+// per frame.
+//
+// sph_runge-od gives every particle 15 components and fluid-me gives every
+// node 13; how much each of them costs, and how much of it every system
+// touches each step, decides how large a run fits and how fast it goes.
+// The report walks every table that holds the program's entities:
+//
+//     gpecs memory: 9 tables, 20000 entities, 7.03 MB resident, 2.87 MB unused capacity
+//       table 1: 2 entities, capacity 2, 208 B/entity, 0.000 MB
+//         {Position, VelocityStart, ..., LowerWall, LeftWall, FunctionsFirst, ...}
+//            bytes  align  padding  column
+//                8      4        0  Position
+//               16      8        0  VelocityStart
+//              ...
+//                8      8        0  (entity id)
+//       table 5: 19248 entities, capacity 32768, 208 B/entity, 6.816 MB
+//         {Position, VelocityStart, ..., FunctionsFourth}
+//         columns as table 1
+//       ...
+//       systems, estimated kB per frame from their queries:
+//          entities    read kB  written kB  system
+//             20000     1600.0      1600.0  RungeKutta_1 / #20574 {Position, VelocityStart, ...}
+//             ...
+//                       9280.0      9280.0  total
+//       flecs' own tables: 137 tables, 0.056 MB
+//
+// Enabling it from the command line - `--memory PATH` writes the report to
+// PATH after the first frame, `--memory -` prints it, both via
+//
+//     auto memory = gpecs::memory_from_args(world, argc, argv);
+//
+// which returns an empty pointer when the option is absent. The report is
+// taken after the first frame so that the entities are spawned and every
+// system has matched its tables; memory_report(world) gives it at any
+// other time.
+//
+// Notes:
+//
+// * Resident bytes are each table's allocated rows (its capacity) times
+//   the bytes per entity: the component columns, tags take none, plus the
+//   entity id column. Unused capacity is the part allocated beyond the
+//   rows in use. flecs' entity index (about 16 bytes per entity) is not
+//   counted.
+// * Padding is the bytes of a component beyond its members. C++ gives no
+//   way to list a struct's members, so it is known ("?" otherwise) only for
+//   components described to flecs' reflection, e.g.
+//   world.component<Position>().member("x", &Position::x).member("y", &Position::y).
+//   fluid-me, the SPH sketches and asteroids_knn describe theirs;
+//   unsteady_scalar's grid singleton holds vectors and shows "?".
+// * Traffic is what a system's query fields amount to for the tables it
+//   matches now: entities times component size for each field, counted as
+//   read for const (in) fields, written for out fields and both for the
+//   rest, and once per table for a field matched on another entity
+//   (singletons, parents). A system that reads only some of a component's
+//   bytes, or reads other entities' components through lookups, is not
+//   seen as such; the figures are the traffic of one pass over the data.
+//   Systems with no fields (sync points, hooks) are left out.
+//   Systems fused into one pass (gpecs::SystemFusion) are one line that
+//   counts each column once, read and/or written as any of them does.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <flecs.h>
+
+#include <gpecs/Args.hpp>
+#include <gpecs/Profiler.hpp>
+#include <gpecs/WorldTables.hpp>
+
+namespace gpecs {
+    struct ColumnFootprint {
+        std::string name;               // component, or "(entity id)"
+        int32_t size {0};
+        int32_t alignment {0};
+        int32_t padding {-1};           // -1 if the members are not known
+    };
+
+    struct TableFootprint {
+        std::string type;               // the table's components and tags
+        int32_t entities {0};
+        int32_t capacity {0};
+        std::vector < ColumnFootprint > columns;
+        int64_t bytes_per_entity {0};
+        int64_t resident {0};           // capacity * bytes_per_entity
+    };
+
+    struct SystemTraffic {
+        std::string label;              // "phase / system"
+        int64_t entities {0};
+        int64_t read {0};               // bytes per frame
+        int64_t written {0};
+    };
+
+    struct MemoryFootprint {
+        std::vector < TableFootprint > tables;
+        std::vector < SystemTraffic > systems;
+        int32_t flecs_tables {0};       // flecs' own tables
+        int64_t flecs_resident {0};
+
+        int64_t entities() const {
+            int64_t n = 0;
+          for (const TableFootprint & t : tables)
+                n += t.entities;
+            return n;
+        }
+
+        int64_t resident() const {
+            int64_t n = 0;
+          for (const TableFootprint & t : tables)
+                n += t.resident;
+            return n;
+        }
+
+        int64_t unused() const {
+            int64_t n = 0;
+          for (const TableFootprint & t : tables)
+                n += static_cast<int64_t>(t.capacity - t.entities) * t.bytes_per_entity;
+            return n;
+        }
+    };
+
+    namespace memory {
+        // True for a system that runs in another's pass (SystemFusion.hpp)
+        inline bool fused(const ecs_world_t *world, ecs_entity_t system) {
+            const ecs_entity_t relation = ecs_lookup(world, "gpecs.Fused");
+            return relation && ecs_count_id(world, ecs_pair(relation, system)) > 0;
+        }
+
+        // Bytes of `component` beyond its members, -1 if flecs does not know them
+        inline int32_t padding(const ecs_world_t *world, ecs_id_t component, int32_t size) {
+            if (ECS_IS_PAIR(component))
+                return -1;
+            const EcsStruct *s = ecs_get(world, component, EcsStruct);
+            if (!s)
+                return -1;
+            int64_t members = 0;
+            const ecs_member_t *m = ecs_vec_first_t(&s->members, ecs_member_t);
+            for (int32_t i = 0; i < ecs_vec_count(&s->members); ++i) {
+                const ecs_type_info_t *ti = ecs_get_type_info(world, m[i].type);
+                if (!ti)
+                    return -1;
+                members += static_cast<int64_t>(ti->size) * std::max(1, m[i].count);
+            }
+            return static_cast<int32_t>(size - members);
+        }
+
+        inline TableFootprint table(const ecs_world_t *world, const ecs_table_t *table) {
+            TableFootprint t;
+            char *type = ecs_table_str(world, table);
+            t.type = type ? type : "";
+            ecs_os_free(type);
+            t.entities = ecs_table_count(table);
+            t.capacity = ecs_table_size(table);
+            const ecs_type_t *ids = ecs_table_get_type(table);
+            for (int32_t c = 0; c < ecs_table_column_count(table); ++c) {
+                const ecs_id_t id = ids->array[ecs_table_column_to_type_index(table, c)];
+                const ecs_type_info_t *ti = ecs_get_type_info(world, id);
+                ColumnFootprint column;
+                char *name = ecs_id_str(world, id);
+                column.name = name ? name : "";
+                ecs_os_free(name);
+                column.size = static_cast<int32_t>(ecs_table_get_column_size(table, c));
+                column.alignment = ti ? ti->alignment : 0;
+                column.padding = padding(world, id, column.size);
+                t.columns.push_back(column);
+            }
+            t.columns.push_back({ "(entity id)", static_cast<int32_t>(sizeof(ecs_entity_t)),
+                                  static_cast<int32_t>(alignof(ecs_entity_t)), 0 });
+          for (const ColumnFootprint & column : t.columns)
+                t.bytes_per_entity += column.size;
+            t.resident = static_cast<int64_t>(t.capacity) * t.bytes_per_entity;
+            return t;
+        }
+
+        inline bool same_columns(const TableFootprint & a, const TableFootprint & b) {
+            return std::equal(a.columns.begin(), a.columns.end(), b.columns.begin(), b.columns.end(),
+                              [](const ColumnFootprint & x, const ColumnFootprint & y) {
+                                  return x.name == y.name && x.size == y.size;
+                              });
+        }
+
+        // Bytes read and written by one pass of `system` over what it matches
+        inline SystemTraffic traffic(const ecs_world_t *world, flecs::entity_t system) {
+            SystemTraffic s;
+            s.label = entity_label(world, ecs_get_target(world, system, EcsDependsOn, 0)) + " / "
+                    + system_label(world, system);
+            std::vector < flecs::entity_t > pass = fused_systems(world, system);
+            pass.insert(pass.begin(), system);
+
+            // Each column a pass touches, by table; a fused pass reads and
+            // writes it once for all of its systems
+            struct Touch {
+                const ecs_table_t *table;
+                ecs_id_t id;
+                bool self;
+                int64_t bytes;
+                bool read;
+                bool written;
+            };
+            std::vector < Touch > touched;
+          for (flecs::entity_t member : pass) {
+                const ecs_query_t *q = ecs_system_get(world, member)->query;
+                ecs_iter_t it = ecs_query_iter(world, q);
+                while (ecs_query_next(&it)) {
+                    if (member == system)
+                        s.entities += it.count;
+                    for (int8_t f = 0; f < q->field_count; ++f) {
+                        if (!ecs_field_is_set(&it, f))
+                            continue;
+                        const bool self = ecs_field_is_self(&it, f);
+                        const Touch touch { it.table, ecs_field_id(&it, f), self, (self ? it.count : 1) * it.sizes[f],
+                                            (q->read_fields & (1u << f)) != 0, (q->write_fields & (1u << f)) != 0 };
+                        auto same = pass.size() == 1 ? touched.end() :
+                            std::find_if(touched.begin(), touched.end(), [&](const Touch & t) {
+                                return t.table == touch.table && t.id == touch.id && t.self == touch.self;
+                            });
+                        if (same == touched.end()) {
+                            touched.push_back(touch);
+                        } else {
+                            same->read = same->read || touch.read;
+                            same->written = same->written || touch.written;
+                        }
+                    }
+                }
+            }
+          for (const Touch & t : touched) {
+                if (t.read)
+                    s.read += t.bytes;
+                if (t.written)
+                    s.written += t.bytes;
+            }
+            return s;
+        }
+    }                           // namespace memory
+
+    // Tables and systems of `world` as they are now. Call between frames.
+    inline MemoryFootprint memory_footprint(const flecs::world & world) {
+        const ecs_world_t *w = world.c_ptr();
+        MemoryFootprint footprint;
+
+        // Every table that holds an entity, in the order they were first used
+        std::unordered_set < const ecs_table_t * > seen;
+        const ecs_entities_t entities = ecs_get_entities(w);
+        for (int32_t i = 0; i < entities.alive_count; ++i) {
+            const ecs_table_t *table = ecs_get_table(w, entities.ids[i]);
+            if (!table || !seen.insert(table).second)
+                continue;
+            if (flecs_table(w, table)) {
+                ++footprint.flecs_tables;
+                footprint.flecs_resident += memory::table(w, table).resident;
+            } else {
+                footprint.tables.push_back(memory::table(w, table));
+            }
+        }
+
+        ecs_iter_t it = ecs_each_id(w, EcsSystem);
+        while (ecs_each_next(&it)) {
+            for (int i = 0; i < it.count; ++i) {
+                const ecs_system_t *sys = ecs_system_get(w, it.entities[i]);
+                if (!sys || sys->query->field_count == 0 || flecs_builtin(w, it.entities[i]) ||
+                    memory::fused(w, it.entities[i]))
+                    continue;
+                footprint.systems.push_back(memory::traffic(w, it.entities[i]));
+            }
+        }
+        return footprint;
+    }
+
+    // The footprint as text, as shown at the top of this file
+    inline std::string memory_report(const MemoryFootprint & footprint) {
+        std::string r;
+        char line[512];
+        auto mb = [](int64_t bytes) { return bytes / 1e6; };
+        std::snprintf(line, sizeof(line), "gpecs memory: %zu table%s, %lld entities, %.2f MB resident, %.2f MB unused capacity\n",
+                      footprint.tables.size(), footprint.tables.size() == 1 ? "" : "s",
+                      static_cast<long long>(footprint.entities()), mb(footprint.resident()), mb(footprint.unused()));
+        r += line;
+        for (std::size_t i = 0; i < footprint.tables.size(); ++i) {
+            const TableFootprint & t = footprint.tables[i];
+            std::snprintf(line, sizeof(line), "  table %zu: %d entities, capacity %d, %lld B/entity, %.3f MB\n",
+                          i + 1, t.entities, t.capacity, static_cast<long long>(t.bytes_per_entity), mb(t.resident));
+            r += line;
+            r += "    {" + t.type + "}\n";
+            // Tables that differ only in tags have the same columns
+            std::size_t same = 0;
+            while (same < i && !memory::same_columns(footprint.tables[same], t))
+                ++same;
+            if (same < i) {
+                r += "    columns as table " + std::to_string(same + 1) + "\n";
+                continue;
+            }
+            r += "       bytes  align  padding  column\n";
+          for (const ColumnFootprint & c : t.columns) {
+                const std::string padding = c.padding < 0 ? "?" : std::to_string(c.padding);
+                std::snprintf(line, sizeof(line), "    %8d  %5d  %7s  %s\n", c.size, c.alignment, padding.c_str(),
+                              c.name.c_str());
+                r += line;
+            }
+        }
+        r += "  systems, estimated kB per frame from their queries:\n";
+        r += "     entities    read kB  written kB  system\n";
+        int64_t read = 0, written = 0;
+      for (const SystemTraffic & s : footprint.systems) {
+            std::snprintf(line, sizeof(line), "    %9lld  %9.1f  %10.1f  %s\n", static_cast<long long>(s.entities),
+                          s.read / 1e3, s.written / 1e3, s.label.c_str());
+            r += line;
+            read += s.read;
+            written += s.written;
+        }
+        std::snprintf(line, sizeof(line), "    %9s  %9.1f  %10.1f  total\n", "", read / 1e3, written / 1e3);
+        r += line;
+        std::snprintf(line, sizeof(line), "  flecs' own tables: %d tables, %.3f MB\n", footprint.flecs_tables,
+                      mb(footprint.flecs_resident));
+        r += line;
+        return r;
+    }
+
+    inline std::string memory_report(const flecs::world & world) {
+        return memory_report(memory_footprint(world));
+    }
+
+    // Writes the report once, after the first frame
+    class MemoryReporter {
+      public:
+        // `path` "" prints the report to standard output
+        explicit MemoryReporter(flecs::world & world, std::string path = "")
+            : world_(world), path_(std::move(path)) {
+            hook_ = world_.system<>()
+                .kind(flecs::OnLoad)
+                .run([this](flecs::iter &) {
+                    if (!done_)
+                        ecs_run_post_frame(world_, &MemoryReporter::end_of_frame, this);
+                });
+        }
+
+        MemoryReporter(const MemoryReporter &) = delete;
+        MemoryReporter & operator=(const MemoryReporter &) = delete;
+
+        ~MemoryReporter() {
+            if (hook_.is_alive())
+                hook_.destruct();
+        }
+
+      private:
+        static void end_of_frame(ecs_world_t *, void *ctx) {
+            static_cast<MemoryReporter*>(ctx)->write();
+        }
+
+        void write() {
+            done_ = true;
+            const std::string report = memory_report(world_);
+            if (path_.empty()) {
+                std::cout << report << std::flush;
+                return;
+            }
+            std::ofstream out(path_);
+            out << report;
+            if (!out)
+                std::cerr << "gpecs memory: cannot write " << path_ << std::endl;
+        }
+
+        flecs::world & world_;
+        std::string path_;
+        flecs::system hook_;
+        bool done_ {false};
+    };
+
+    // Creates a MemoryReporter if `--memory PATH` was given (`-` to print
+    // the report), otherwise returns an empty pointer
+    inline std::unique_ptr < MemoryReporter > memory_from_args(flecs::world & world, int & argc, char *argv[]) {
+        std::string path;
+        if (!take_option(argc, argv, "--memory", path))
+            return nullptr;
+        return std::make_unique < MemoryReporter > (world, path == "-" ? "" : path);
+    }
+
+}                               // namespace gpecs
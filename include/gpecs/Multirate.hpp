@@ -0,0 +1,161 @@
+//
+// (c) 2026 University of Manchester
+// You may use this under the terms of the Apache 2 License
+//
+//
+// This file implements multirate scheduling: systems that run every k
+// steps, every so many seconds, only when asked, or several times a step.
+//
+// Not everything needs to run every step. The SPH sketches check the time
+// step by working out the force on every particle, only to print a warning,
+// and write every particle's density to a file; both cost as much as the
+// step itself. gpecs::Multirate hands out flecs tick sources, so those
+// systems run every k steps and cost 1/k of what they did:
+//
+//     gpecs::Multirate rates(world);
+//     flecs::entity check = rates.every(10);      // steps 0, 10, 20, ...
+//
+//     world.system<Velocity, ParticleIndex>()
+//         .kind(flecs::PreUpdate)
+//         .tick_source(check)
+//         .multi_threaded()
+//         .each(...);                              // limits per worker
+//     world.system<>()
+//         .kind(flecs::PreUpdate)
+//         .tick_source(check)
+//         .run(...);                               // merges and reports
+//
+// Step alignment - a step is one world.progress(), numbered by the world's
+// frame_count_total from 0. every(k, offset) runs on the steps where
+// step % k == offset, however many steps ran before it was created, and
+// every(k, offset) returns the same tick source each time, so systems that
+// work together (one per worker, then one merging their results) always
+// run on the same steps. every(1) is no tick source at all: the system
+// runs every step exactly as before.
+//
+// The loop around progress() can follow a tick source too. ticked() says
+// whether it fired in the step just run:
+//
+//     world.progress();
+//     if (rates.ticked(output)) { ... write the density grid ... }
+//
+// Other rates:
+//   - interval(seconds) is flecs' own .interval() timer: it fires in the
+//     first step by which that much time has passed, and carries the
+//     remainder over, so it follows the time and not the step count.
+//   - on_demand() fires in the step after request() and not again until
+//     the next request(). request() may be called from inside a system.
+//   - subcycle(phase, n, system) runs a system n times a step, each with
+//     1/n of the step's delta_time. Create the system with .kind(0) so the
+//     pipeline does not run it as well.
+//
+// `--check-every K`-style options can be read with rate_from_args(), which
+// removes them from argv (see Args.hpp) and defaults to 1.
+//
+// Notes:
+//   - A system with a tick source keeps its place in the phase; on the
+//     steps it does not run flecs skips it before building an iterator, so
+//     it costs next to nothing.
+//   - A sub-cycled system runs single threaded, on the thread that runs
+//     the phase, even if it was made .multi_threaded(). Its component
+//     writes are seen by the next cycle; adding or removing components
+//     takes effect at the end of the phase, as for any other system.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <utility>
+
+#include <flecs.h>
+#include <gpecs/Args.hpp>
+
+namespace gpecs {
+    class Multirate {
+      public:
+        explicit Multirate(flecs::world & world) : world_(world) { }
+
+        // A tick source for the steps where step % k == offset
+        flecs::entity every(int32_t k, int32_t offset = 0) {
+            ecs_assert(k > 0 && offset >= 0 && offset < k, ECS_INVALID_PARAMETER,
+                       "every(k, offset) needs 0 <= offset < k");
+            if (k == 1)
+                return flecs::entity();
+            auto found = every_.find({ k, offset });
+            if (found != every_.end())
+                return found->second;
+
+            // flecs' rate filter fires when its count, incremented at the
+            // start of every step, reaches a multiple of k. Start the count
+            // so that happens on the right steps.
+            const int64_t step = world_.get_info()->frame_count_total;
+            const int32_t count = static_cast<int32_t>(((step - offset - 1) % k + k) % k);
+            flecs::entity source = world_.entity()
+                .set<flecs::RateFilter>({ 0, k, count, 0 });
+            every_.emplace(std::make_pair(k, offset), source);
+            return source;
+        }
+
+        // A tick source that fires once every `seconds` of world time
+        flecs::entity interval(double seconds) {
+            return flecs::entity(world_, ecs_set_interval(world_.c_ptr(), 0, static_cast<ecs_ftime_t>(seconds)));
+        }
+
+        // A tick source that only fires in the step after request()
+        flecs::entity on_demand() {
+            flecs::entity source(world_, ecs_set_timeout(world_.c_ptr(), 0, 0));
+            ecs_stop_timer(world_.c_ptr(), source);
+            return source;
+        }
+
+        // Fires `source` (from on_demand()) in the next step
+        void request(flecs::entity source) {
+            ecs_set_timeout(world_.c_ptr(), source, 0);
+        }
+
+        // The same from inside a system
+        void request(flecs::iter & it, flecs::entity source) {
+            ecs_set_timeout(it.world().c_ptr(), source, 0);
+        }
+
+        // Whether `source` fired in the step just run (or is running)
+        bool ticked(flecs::entity source) const {
+            if (!source)
+                return true;
+            const EcsTickSource *tick = ecs_get(world_.c_ptr(), source, EcsTickSource);
+            return tick && tick->tick;
+        }
+
+        // Registers a system in `phase` that runs `system` n times a step
+        flecs::system subcycle(flecs::entity_t phase, int32_t n, flecs::system system) {
+            ecs_assert(n > 0, ECS_INVALID_PARAMETER, "subcycle() needs n > 0");
+            const flecs::entity_t id = system.id();
+            return world_.system<>()
+                .kind(phase)
+                .run([id, n](flecs::iter & it) {
+                    const ecs_ftime_t dt = static_cast<ecs_ftime_t>(it.delta_time()) / static_cast<ecs_ftime_t>(n);
+                    for (int32_t cycle = 0; cycle < n; ++cycle)
+                        ecs_run(it.world().c_ptr(), id, dt, nullptr);
+                });
+        }
+
+      private:
+        flecs::world & world_;
+        std::map < std::pair < int32_t, int32_t >, flecs::entity > every_;
+    };
+
+    // Reads `--name K` (a rate of every K steps) from the command line; the
+    // option is removed from argv
+    inline int32_t rate_from_args(int & argc, char *argv[], const char *name, int32_t fallback = 1) {
+        std::string value;
+        if (!take_option(argc, argv, name, value))
+            return fallback;
+        const int32_t k = static_cast<int32_t>(std::atoi(value.c_str()));
+        return k > 0 ? k : fallback;
+    }
+
+}                               // namespace gpecs
@@ -0,0 +1,397 @@
+//
+// (c) 2026 University of Manchester
+// You may use this under the terms of the Apache 2 License
+//
+//
+// This file implements hardware performance counters per system, read with
+// Linux perf_event_open.
+//
+// Wall time (Profiler.hpp) says which systems are slow; the counters say
+// why. A system streaming Position/Velocity arrays retires several
+// instructions per cycle and misses the last level cache (LLC) rarely per
+// entity. A stencil chasing entity.get<>() lookups stalls on cache and TLB
+// misses and runs well below one instruction per cycle. Putting IPC next
+// to misses per entity gives a rough roofline view of every system.
+//
+// Every thread that runs systems (the main thread and each --threads worker)
+// opens one group of counters - cycles, instructions, LLC misses, branch
+// misses and data TLB misses - the first time it runs a system. The group
+// is read before and after each system run and the difference is added to
+// that system's totals for that worker. At the end of each frame the number
+// of entities each system matched is added up, giving misses per entity. A
+// summary is printed when the counters go out of scope:
+//
+//     gpecs perf: 400 frames, user space counts, 4 workers
+//       Mcycles   share     IPC   LLC/ent   br/ent  dTLB/ent  entities  system
+//        3121.9   71.4%    0.62     4.180    0.512     1.905      1250  OnUpdate / #612 {Acceleration, ...}
+//        ...
+//
+// Enabling it from the command line - `--perf PATH` also writes one CSV row
+// per system and worker to PATH, `--perf -` prints only the summary. The
+// option is removed from argv (see Args.hpp):
+//
+//     flecs::world world(argc, argv);
+//     gpecs::use_threads(world, argc, argv);
+//     auto perf = gpecs::perf_from_args(world, argc, argv);
+//
+// Create it after use_threads() and before the main loop. Systems that do
+// not exist yet are picked up at the end of the first frame they run in, so
+// their first frame is not counted.
+//
+// Notes:
+//
+// * Only user space is counted, which works with the default
+//   kernel.perf_event_paranoid of 2. If the counters cannot be opened (a
+//   higher paranoid setting, a container without the perf_event_open
+//   syscall, or a virtual machine without a PMU) a one line warning is
+//   printed and the sketch runs unmeasured. Events the CPU does not have
+//   are shown as "-".
+// * If the CPU has fewer counters than the group needs the kernel time
+//   slices the group; the counts are then scaled up by the time the group
+//   was enabled over the time it was running, as perf stat does.
+// * Each system run costs two read() system calls per worker. That is
+//   noise for systems iterating thousands of entities and dominates
+//   systems that do nothing (gpecs::sync_point()).
+// * LLC misses are the kernel's generic PERF_COUNT_HW_CACHE_MISSES, which
+//   on current x86 parts counts last level cache misses.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <flecs.h>
+
+#include <gpecs/Args.hpp>
+#include <gpecs/SystemHooks.hpp>
+
+namespace gpecs {
+    struct PerfEvent {
+        const char *name;
+        uint32_t type;
+        uint64_t config;
+    };
+
+    inline constexpr std::array < PerfEvent, 5 > perf_events {{
+        { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { "llc_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+        { "branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+        { "dtlb_misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB
+                | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    }};
+
+    // One group of counters on the calling thread. The first event that opens
+    // leads the group, so that one read() returns all of them at once.
+    class PerfGroup {
+      public:
+        static constexpr int size = static_cast<int>(perf_events.size());
+        using Counts = std::array < double, size >;
+
+        PerfGroup() { fds_.fill(-1); index_.fill(-1); }
+        PerfGroup(const PerfGroup &) = delete;
+        PerfGroup & operator=(const PerfGroup &) = delete;
+        ~PerfGroup() {
+          for (int fd : fds_)
+                if (fd >= 0)
+                    close(fd);
+        }
+
+        // Opens the events whose bit is set in `wanted`; returns the bits that
+        // opened and leaves errno from the first failure in error()
+        unsigned open(unsigned wanted) {
+            unsigned opened = 0;
+            int leader = -1;
+            for (int i = 0; i < size; ++i) {
+                if (!(wanted & (1u << i)))
+                    continue;
+                perf_event_attr attr {};
+                attr.size = sizeof(attr);
+                attr.type = perf_events[i].type;
+                attr.config = perf_events[i].config;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED
+                    | PERF_FORMAT_TOTAL_TIME_RUNNING;
+                const int fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0));
+                if (fd < 0) {
+                    if (!error_)
+                        error_ = errno;
+                    continue;
+                }
+                if (leader < 0)
+                    leader = fd;
+                index_[i] = count_++;
+                fds_[i] = fd;
+                opened |= 1u << i;
+            }
+            leader_ = leader;
+            return opened;
+        }
+
+        bool is_open() const { return leader_ >= 0; }
+        int error() const { return error_; }
+
+        // Running totals since the group was opened, scaled for time slicing
+        void read(Counts & counts) const {
+            counts.fill(0);
+            std::array < uint64_t, 3 + size > buf {};
+            if (!is_open() || ::read(leader_, buf.data(), sizeof(buf)) <= 0)
+                return;
+            const double scale = buf[2] ? double(buf[1]) / double(buf[2]) : 0.0;
+            for (int i = 0; i < size; ++i)
+                if (index_[i] >= 0 && index_[i] < int(buf[0]))
+                    counts[i] = scale * double(buf[3 + index_[i]]);
+        }
+
+      private:
+        std::array < int, size > fds_;
+        std::array < int, size > index_;
+        int count_ {0};
+        int leader_ {-1};
+        int error_ {0};
+    };
+
+    struct PerfOptions {
+        std::string path;       // One CSV row per system and worker at exit, "" for none
+        bool summary {true};    // Print the summary when the counters are destroyed
+    };
+
+    // What PerfCounters keeps for each system: counts per worker, and the
+    // entities the system matched summed over frames
+    struct PerfSystem {
+        struct Totals {
+            int64_t runs {0};
+            PerfGroup::Counts counts {};
+        };
+
+        struct alignas(64) Slot {
+            Totals totals;
+        };
+
+        std::vector < Slot > workers;
+        int64_t entities {0};
+        int64_t frames {0};
+
+        Totals sum() const {
+            Totals total;
+          for (const Slot & slot : workers) {
+                total.runs += slot.totals.runs;
+                for (int i = 0; i < PerfGroup::size; ++i)
+                    total.counts[i] += slot.totals.counts[i];
+            }
+            return total;
+        }
+
+        double entities_per_frame() const { return frames ? double(entities) / frames : 0.0; }
+    };
+
+    class PerfCounters : public SystemHooks < PerfCounters, PerfSystem > {
+        friend class SystemHooks < PerfCounters, PerfSystem >;
+
+      public:
+        explicit PerfCounters(flecs::world & world, PerfOptions options = {})
+            : SystemHooks(world), options_(std::move(options)) {
+            // Find out on this thread which events the machine has; workers
+            // open the same set
+            PerfGroup & group = thread_group(all_events);
+            events_ = group_events_;
+            if (!group.is_open()) {
+                std::cerr << "gpecs perf: hardware counters unavailable (" << std::strerror(group.error())
+                          << "); running without them" << std::endl;
+                return;
+            }
+            start();
+        }
+
+        ~PerfCounters() {
+            stop();
+            if (!options_.path.empty() && frames_ > 0)
+                write_csv();
+            if (options_.summary && frames_ > 0)
+                std::cout << report() << std::flush;
+        }
+
+        bool available() const { return events_ != 0; }
+
+        // Summary over every frame so far, most cycles first
+        std::string report() const;
+
+      private:
+        enum { Cycles, Instructions, LlcMisses, BranchMisses, DtlbMisses };
+        static constexpr unsigned all_events = (1u << PerfGroup::size) - 1;
+        static inline unsigned group_events_ {0};
+
+        static PerfGroup & thread_group(unsigned events) {
+            thread_local PerfGroup group;
+            thread_local bool opened = false;
+            if (!opened) {
+                opened = true;
+                const unsigned got = group.open(events);
+                if (events == all_events)
+                    group_events_ = got;
+            }
+            return group;
+        }
+
+        void hooked(Hooked & h);
+        void around(Hooked & h, ecs_iter_t * it);
+        void end_frame();
+
+        std::string value(int event, double v, const char *format) const {
+            if (!(events_ & (1u << event)))
+                return "-";
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), format, v);
+            return buf;
+        }
+
+        std::string ratio(int num, double n, int den, double d) const {
+            if (!(events_ & (1u << den)) || d <= 0)
+                return "-";
+            return value(num, n / d, "%.2f");
+        }
+
+        std::string per_entity(int event, const PerfGroup::Counts & counts, int64_t entities) const {
+            if (entities == 0)
+                return "-";
+            return value(event, counts[event] / double(entities), "%.3f");
+        }
+
+        void write_csv() const;
+
+        static std::string csv(const std::string & s) {
+            if (s.find_first_of(",\"") == std::string::npos)
+                return s;
+            std::string r = "\"";
+          for (char c : s)
+                r += (c == '"') ? std::string("\"\"") : std::string(1, c);
+            return r + "\"";
+        }
+
+        PerfOptions options_;
+        unsigned events_ {0};
+    };
+
+    inline std::string PerfCounters::report() const {
+        std::vector < std::pair < const Hooked *, PerfSystem::Totals > > order;
+        double cycles = 0;
+      for (auto & [id, h] : hooked_) {
+            PerfSystem::Totals t = h->data.sum();
+            if (t.runs == 0)
+                continue;
+            cycles += t.counts[Cycles];
+            order.push_back({ h.get(), t });
+        }
+        std::sort(order.begin(), order.end(),
+                  [](auto & a, auto & b) { return a.second.counts[Cycles] > b.second.counts[Cycles]; });
+
+        std::string r;
+        char line[512];
+        std::snprintf(line, sizeof(line), "gpecs perf: %lld frames, user space counts, %d workers\n",
+                      static_cast<long long>(frames_), std::max(1, world_.get_stage_count()));
+        r += line;
+        r += "   Mcycles   share     IPC   LLC/ent   br/ent  dTLB/ent  entities  system\n";
+      for (auto & [h, t] : order) {
+            const int64_t entities = h->data.entities;
+            std::snprintf(line, sizeof(line), "%10s  %5.1f%%  %6s  %8s  %7s  %8s  %8.0f  %s / %s\n",
+                          value(Cycles, t.counts[Cycles] / 1e6, "%.1f").c_str(),
+                          cycles > 0 ? 100.0 * t.counts[Cycles] / cycles : 0.0,
+                          ratio(Instructions, t.counts[Instructions], Cycles, t.counts[Cycles]).c_str(),
+                          per_entity(LlcMisses, t.counts, entities).c_str(),
+                          per_entity(BranchMisses, t.counts, entities).c_str(),
+                          per_entity(DtlbMisses, t.counts, entities).c_str(), h->data.entities_per_frame(),
+                          h->phase.c_str(), h->label.c_str());
+            r += line;
+        }
+        return r;
+    }
+
+    inline void PerfCounters::hooked(Hooked & h) {
+        h.data.workers.resize(std::max(1, world_.get_stage_count()));
+    }
+
+    inline void PerfCounters::around(Hooked & h, ecs_iter_t * it) {
+        // A worker the counters do not know about yet (threads changed this
+        // frame) runs the system unmeasured
+        const int32_t stage = ecs_stage_get_id(it->world);
+        if (stage < 0 || stage >= static_cast<int32_t>(h.data.workers.size())) {
+            h.call(it);
+            return;
+        }
+
+        PerfGroup & group = thread_group(events_);
+        PerfGroup::Counts before, after;
+        group.read(before);
+        h.call(it);
+        group.read(after);
+
+        PerfSystem::Totals & t = h.data.workers[stage].totals;
+        ++t.runs;
+        for (int i = 0; i < PerfGroup::size; ++i)
+            t.counts[i] += after[i] - before[i];
+    }
+
+    inline void PerfCounters::end_frame() {
+        const std::size_t workers = std::max(1, world_.get_stage_count());
+      for (auto & [id, h] : hooked_) {
+            if (!h->system)
+                continue;
+            if (h->data.workers.size() < workers)
+                h->data.workers.resize(workers);
+            h->data.entities += ecs_query_count(ecs_system_get(world_, id)->query).entities;
+            ++h->data.frames;
+        }
+    }
+
+    inline void PerfCounters::write_csv() const {
+        std::ofstream out(options_.path);
+        if (!out.is_open()) {
+            std::cerr << "gpecs perf: cannot open " << options_.path << std::endl;
+            return;
+        }
+        out << "phase,system,worker,runs,entities_per_frame";
+      for (const PerfEvent & e : perf_events)
+            out << ',' << e.name;
+        out << '\n';
+      for (auto & [id, h] : hooked_) {
+            for (std::size_t worker = 0; worker < h->data.workers.size(); ++worker) {
+                const PerfSystem::Totals & t = h->data.workers[worker].totals;
+                if (t.runs == 0)
+                    continue;
+                out << csv(h->phase) << ',' << csv(h->label) << ',' << worker << ',' << t.runs << ','
+                    << h->data.entities_per_frame();
+                for (int i = 0; i < PerfGroup::size; ++i)
+                    out << ',' << (events_ & (1u << i) ? value(i, t.counts[i], "%.0f") : "");
+                out << '\n';
+            }
+        }
+    }
+
+    // Creates the counters if `--perf PATH` was given (`-` for the summary
+    // only), otherwise returns an empty pointer
+    inline std::unique_ptr < PerfCounters > perf_from_args(flecs::world & world, int & argc, char *argv[]) {
+        std::string path;
+        if (!take_option(argc, argv, "--perf", path))
+            return nullptr;
+        PerfOptions options;
+        options.path = (path == "-") ? "" : path;
+        return std::make_unique < PerfCounters > (world, options);
+    }
+
+}                               // namespace gpecs
@@ -0,0 +1,368 @@
+//
+// (c) 2026 University of Manchester
+// You may use this under the terms of the Apache 2 License
+//
+//
+// This file implements a per-system profiler built on the system timing
+// that flecs keeps when its stats addon is enabled.
+//
+// For every system in the pipeline, and for every phase, it records each
+// frame the time spent, the number of entities and tables the system
+// matched. Those rows go to a CSV or JSONL file (chosen by extension) and a
+// summary is printed when the profiler goes out of scope, e.g.
+//
+//     gpecs profile: 400 frames, 3.214 ms/frame in systems, 3.371 ms/step wall
+//       total ms  share  us/frame  entities  ns/entity  system
+//        812.412  63.2%   2031.03        20  101551.48  OnUpdate / #612 {Acceleration, Mass, ParticleIndex}
+//        ...
+//
+// Enabling it from the command line - `--profile PATH` writes the per-frame
+// rows to PATH, `--profile -` prints only the summary. The option is removed
+// from argv (see Args.hpp):
+//
+//     flecs::world world(argc, argv);
+//     auto profiler = gpecs::profile_from_args(world, argc, argv);
+//
+// profile_from_args() returns an empty pointer when the option is absent, in
+// which case nothing is measured and nothing is printed. Create it before
+// the main loop; it hooks itself onto the end of every frame, so the loop
+// keeps calling world.progress() as before.
+//
+// Labels - named systems (world.system<...>("Forces")) and phases are shown
+// by name. Unnamed ones are shown by id and query, e.g.
+// `#612 {Acceleration, Mass, ParticleIndex}`, or `#640 {}` for a system
+// with no terms (the energy tracker systems and gpecs::sync_point()). Systems
+// fused into one pass by gpecs::SystemFusion are one line, `A + B`, with
+// the time of the whole pass.
+//
+// Notes:
+//
+// * "ms/step wall" is the time between the ends of consecutive frames, so it
+//   includes whatever the sketch does between world.progress() calls (file
+//   output, rendering); "ms/frame in systems" is the sum over the systems.
+// * Time is measured by flecs around each system run. Under --threads
+//   every worker adds its own time for a multi-threaded system to the same
+//   total, without synchronisation, so some of those additions are lost:
+//   the figure undercounts the time summed over the workers and is not the
+//   wall time either. Profile with one thread for exact per-system times.
+// * Counting matched entities walks each system's query once per sampled
+//   frame. For very long runs `every` samples only every Nth frame; times
+//   are still accumulated over every frame and reported per frame.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <flecs.h>
+
+#include <gpecs/Args.hpp>
+
+namespace gpecs {
+    // An entity's name, or "#id" if it has none
+    inline std::string entity_label(const ecs_world_t * world, flecs::entity_t id) {
+        if (!id)
+            return "-";
+        const char *name = ecs_get_name(world, id);
+        return name ? std::string(name) : "#" + std::to_string(id);
+    }
+
+    // Relationship from a system to each system fused into its pass (see
+    // SystemFusion.hpp)
+    struct Fused {};
+
+    // The systems fused into `id`'s pass, in the order they run
+    inline std::vector < flecs::entity_t > fused_systems(const ecs_world_t * world, flecs::entity_t id) {
+        std::vector < flecs::entity_t > fused;
+        const flecs::entity_t relation = ecs_lookup(world, "gpecs.Fused");
+        if (!relation)
+            return fused;
+        for (int32_t i = 0; flecs::entity_t target = ecs_get_target(world, id, relation, i); ++i)
+            fused.push_back(target);
+        std::sort(fused.begin(), fused.end());
+        return fused;
+    }
+
+    // A system's name, or "#id {terms}" if it has none, followed by
+    // " + ..." for the systems fused into it unless `fused` is false
+    inline std::string system_label(const ecs_world_t * world, flecs::entity_t id, bool fused = true) {
+        std::string label;
+        if (ecs_get_name(world, id)) {
+            label = entity_label(world, id);
+        } else {
+            const ecs_system_t *sys = ecs_system_get(world, id);
+            char *query = ecs_query_str(sys->query);
+            std::string terms = query ? query : "";
+            ecs_os_free(query);
+            for (std::size_t at; (at = terms.find("($this)")) != std::string::npos;)
+                terms.erase(at, 7);
+            label = "#" + std::to_string(id) + " {" + terms + "}";
+        }
+        if (fused)
+          for (flecs::entity_t member : fused_systems(world, id))
+                label += " + " + system_label(world, member, false);
+        return label;
+    }
+
+    struct ProfilerOptions {
+        std::string path;       // Per-frame rows; .jsonl/.json for JSONL, anything else CSV, "" for none
+        int every {1};          // Sample every Nth frame
+        bool summary {true};    // Print the summary when the profiler is destroyed
+    };
+
+    class Profiler {
+      public:
+        explicit Profiler(flecs::world & world, ProfilerOptions options = {})
+            : world_(world), options_(std::move(options)) {
+            options_.every = std::max(1, options_.every);
+            ecs_measure_system_time(world_, true);
+
+            if (!options_.path.empty()) {
+                out_.open(options_.path);
+                if (!out_.is_open())
+                    std::cerr << "gpecs profiler: cannot open " << options_.path << std::endl;
+                const std::string & p = options_.path;
+                jsonl_ = p.size() >= 5 && (p.ends_with(".jsonl") || p.ends_with(".json"));
+                if (out_.is_open() && !jsonl_)
+                    out_ << "frame,kind,phase,system,time_us,entities,tables\n";
+            }
+
+            // Runs early in each frame and asks to be called back once every
+            // system of the frame has finished
+            hook_ = world_.system<>()
+                .kind(flecs::OnLoad)
+                .run([this](flecs::iter &) {
+                    ecs_run_post_frame(world_, &Profiler::end_of_frame, this);
+                });
+            step_start_ = clock::now();
+        }
+
+        Profiler(const Profiler &) = delete;
+        Profiler & operator=(const Profiler &) = delete;
+
+        ~Profiler() {
+            if (hook_.is_alive())
+                hook_.destruct();
+            if (options_.summary && frames_ > 0)
+                std::cout << report() << std::flush;
+        }
+
+        // Summary over every frame so far, slowest systems first
+        std::string report() const {
+            double system_total = 0;
+          for (auto & [id, s] : systems_)
+                system_total += s.time;
+
+            std::vector < const SystemTotals * >order;
+          for (auto & [id, s] : systems_)
+                order.push_back(&s);
+            std::sort(order.begin(), order.end(), [](auto *a, auto *b) { return a->time > b->time; });
+
+            std::string r;
+            char line[512];
+            std::snprintf(line, sizeof(line), "gpecs profile: %lld frames, %.3f ms/frame in systems, %.3f ms/step wall\n",
+                          static_cast<long long>(frames_), 1e3 * system_total / frames_, 1e3 * step_time_ / frames_);
+            r += line;
+            r += "  total ms   share   us/frame  entities  ns/entity  system\n";
+          for (auto *s : order) {
+                const double entities = s->samples ? double(s->entities) / s->samples : 0.0;
+                const double per_frame = s->time / frames_;
+                std::snprintf(line, sizeof(line), "%10.3f  %5.1f%%  %9.2f  %8.0f  %9.2f  %s / %s\n",
+                              1e3 * s->time, system_total > 0 ? 100.0 * s->time / system_total : 0.0,
+                              1e6 * per_frame, entities, entities > 0 ? 1e9 * per_frame / entities : 0.0,
+                              s->phase.c_str(), s->label.c_str());
+                r += line;
+            }
+
+            // Phases in the order they run
+            std::vector < std::pair < std::string, double > > phases;
+            auto add = [&](const SystemTotals & s) {
+                auto it = std::find_if(phases.begin(), phases.end(), [&](auto & p) { return p.first == s.phase; });
+                if (it == phases.end())
+                    it = phases.insert(phases.end(), { s.phase, 0.0 });
+                return it;
+            };
+          for (flecs::entity_t id : pipeline_)
+                add(systems_.at(id));
+          for (auto & [id, s] : systems_)
+                add(s)->second += s.time;
+            r += "  per phase:\n";
+          for (auto & [phase, time] : phases) {
+                std::snprintf(line, sizeof(line), "%10.3f  %5.1f%%  %9.2f            %s\n", 1e3 * time,
+                              system_total > 0 ? 100.0 * time / system_total : 0.0, 1e6 * time / frames_,
+                              phase.c_str());
+                r += line;
+            }
+            return r;
+        }
+
+      private:
+        using clock = std::chrono::steady_clock;
+
+        struct SystemTotals {
+            std::string phase;
+            std::string label;
+            double time {0};            // seconds, over all frames
+            int64_t entities {0};       // summed over sampled frames
+            int64_t samples {0};
+        };
+
+        struct Row {
+            flecs::entity_t id;
+            double time;
+            int32_t entities;
+            int32_t tables;
+        };
+
+        static void end_of_frame(ecs_world_t *, void *ctx) {
+            static_cast<Profiler*>(ctx)->sample();
+        }
+
+        void sample() {
+            const clock::time_point now = clock::now();
+            step_time_ += std::chrono::duration<double>(now - step_start_).count();
+            step_start_ = now;
+            ++frames_;
+            ++since_sample_;
+
+            const ecs_world_info_t *info = ecs_get_world_info(world_);
+            if (info->pipeline_build_count_total != pipeline_builds_) {
+                pipeline_builds_ = info->pipeline_build_count_total;
+                load_pipeline();
+            }
+
+            const bool sampled = (frames_ % options_.every) == 0;
+            rows_.clear();
+          for (flecs::entity_t id : pipeline_) {
+                // flecs keeps the running total in single precision, so take
+                // it and reset it every frame rather than differencing it
+                ecs_system_t *sys = const_cast<ecs_system_t*>(ecs_system_get(world_, id));
+                if (!sys)
+                    continue;
+                SystemTotals & totals = systems_[id];
+                totals.time += sys->time_spent;
+                pending_[id] += sys->time_spent;
+                sys->time_spent = 0;
+
+                if (sampled) {
+                    ecs_query_count_t count = ecs_query_count(sys->query);
+                    totals.entities += count.entities;
+                    ++totals.samples;
+                    rows_.push_back({ id, pending_[id] / since_sample_, count.entities, count.tables });
+                    pending_[id] = 0;
+                }
+            }
+
+            if (sampled) {
+                if (out_.is_open())
+                    write_rows();
+                since_sample_ = 0;
+            }
+        }
+
+        void load_pipeline() {
+            pipeline_.clear();
+            ecs_pipeline_stats_t stats = {};
+            if (!ecs_pipeline_stats_get(world_, ecs_get_pipeline(world_), &stats))
+                return;
+            const ecs_entity_t *ids = ecs_vec_first_t(&stats.systems, ecs_entity_t);
+            for (int32_t i = 0; i < ecs_vec_count(&stats.systems); ++i) {
+                // Zero marks a merge point; skip our own start-of-frame hook
+                if (ids[i] == 0 || ids[i] == hook_.id())
+                    continue;
+                pipeline_.push_back(ids[i]);
+                // Labels can change with the pipeline, as systems are fused
+                SystemTotals & totals = systems_[ids[i]];
+                totals.label = system_label(world_, ids[i]);
+                totals.phase = entity_label(world_, ecs_get_target(world_, ids[i], EcsDependsOn, 0));
+            }
+            ecs_pipeline_stats_fini(&stats);
+        }
+
+        void write_rows() {
+            std::map < std::string, Row > phases;
+            std::vector < std::string > phase_order;
+          for (const Row & row : rows_) {
+                const SystemTotals & totals = systems_[row.id];
+                write_row("system", totals.phase, totals.label, row);
+                auto [it, inserted] = phases.try_emplace(totals.phase, Row { 0, 0, 0, 0 });
+                if (inserted)
+                    phase_order.push_back(totals.phase);
+                it->second.time += row.time;
+                it->second.entities += row.entities;
+                it->second.tables += row.tables;
+            }
+          for (const std::string & phase : phase_order)
+                write_row("phase", phase, "", phases[phase]);
+        }
+
+        void write_row(const char *kind, const std::string & phase, const std::string & system, const Row & row) {
+            char buf[64];
+            std::snprintf(buf, sizeof(buf), "%.3f", 1e6 * row.time);
+            if (jsonl_) {
+                out_ << "{\"frame\":" << frames_ << ",\"kind\":\"" << kind << "\",\"phase\":" << json(phase)
+                     << ",\"system\":" << json(system) << ",\"time_us\":" << buf << ",\"entities\":"
+                     << row.entities << ",\"tables\":" << row.tables << "}\n";
+            } else {
+                out_ << frames_ << ',' << kind << ',' << csv(phase) << ',' << csv(system) << ',' << buf << ','
+                     << row.entities << ',' << row.tables << '\n';
+            }
+        }
+
+        static std::string csv(const std::string & s) {
+            if (s.find_first_of(",\"") == std::string::npos)
+                return s;
+            std::string r = "\"";
+          for (char c : s)
+                r += (c == '"') ? std::string("\"\"") : std::string(1, c);
+            return r + "\"";
+        }
+
+        static std::string json(const std::string & s) {
+            std::string r = "\"";
+          for (char c : s) {
+                if (c == '"' || c == '\\')
+                    r += '\\';
+                r += c;
+            }
+            return r + "\"";
+        }
+
+        flecs::world & world_;
+        ProfilerOptions options_;
+        std::ofstream out_;
+        bool jsonl_ {false};
+        flecs::system hook_;
+
+        std::vector < flecs::entity_t > pipeline_;
+        std::map < flecs::entity_t, SystemTotals > systems_;
+        std::map < flecs::entity_t, double > pending_;
+        std::vector < Row > rows_;
+        int64_t pipeline_builds_ {-1};
+        int64_t frames_ {0};
+        int64_t since_sample_ {0};
+        double step_time_ {0};
+        clock::time_point step_start_;
+    };
+
+    // Creates a profiler if `--profile PATH` was given (`-` for the summary
+    // only), otherwise returns an empty pointer
+    inline std::unique_ptr < Profiler > profile_from_args(flecs::world & world, int & argc, char *argv[]) {
+        std::string path;
+        if (!take_option(argc, argv, "--profile", path))
+            return nullptr;
+        ProfilerOptions options;
+        options.path = (path == "-") ? "" : path;
+        return std::make_unique < Profiler > (world, options);
+    }
+
+}                               // namespace gpecs
@@ -0,0 +1,272 @@
+//
+// (c) 2026 University of Manchester
+// You may use this under the terms of the Apache 2 License
+//
+//
+// This file implements a snapshot writer that takes formatting and disk
+// writes off the simulation thread.
+//
+// The examples write their output in the step loop: fluid-me formats three
+// fields of 20000 doubles through std::ofstream every SAVESTEP, and the
+// stepping waits while it does. With SnapshotWriter the step loop only
+// copies the values it wants into a buffer; a background thread formats
+// and writes them while the next steps run:
+//
+//     gpecs::SnapshotWriter writer;      // two buffers, one writer thread
+//
+//     for (int t_step = 0; t_step <= STEPS; ++t_step) {
+//         world.progress();
+//         writer.write(t_step,
+//             [&](gpecs::Snapshot& snap) {                   // this thread
+//                 auto rho = snap.column<double>(0, nodes.size());
+//                 for (std::size_t i = 0; i < nodes.size(); ++i)
+//                     rho[i] = nodes[i].get<Density>().rho;
+//             },
+//             [](const gpecs::Snapshot& snap) {              // writer thread
+//                 std::ofstream out("density_" + std::to_string(snap.step) + ".txt");
+//                 for (double rho : snap.column<double>(0))
+//                     out << rho << "\n";
+//             });
+//     }
+//
+// The capture copies component values into the snapshot's columns, which
+// keep their memory from one use to the next, so after the first few
+// snapshots nothing is allocated. The encoder gets the filled snapshot on
+// the writer thread. Encoders run one at a time, in the order they were
+// given, so they can append to a stream they share.
+//
+// write() only waits if every buffer is still queued for writing, i.e. if
+// the disk cannot keep up; waited() says for how long in total.
+//
+// Capture from the main thread, between world.progress() calls or in a
+// single threaded system, not from a .multi_threaded() system. The encoder
+// must not touch the world: it runs while the next steps do.
+//
+// Errors - an encoder reports a failure by throwing. The first message is
+// kept and the writer carries on with the following snapshots; check ok()
+// in the step loop and after flush():
+//
+//     if (!writer.ok()) { std::cout << writer.error() << std::endl; return 1; }
+//
+// The destructor writes everything still queued before it returns.
+//
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <span>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace gpecs {
+    // One set of copied values, and the step they were copied at
+    class Snapshot {
+      public:
+        int64_t step {0};
+
+        // Column `index` resized to `count` values of T, for filling in. The
+        // values left from the snapshot's last use are unspecified.
+        template <typename T>
+        std::span < T > column(std::size_t index, std::size_t count) {
+            check < T > ();
+            std::vector < std::byte > &bytes = slot(index);
+            bytes.resize(count * sizeof(T));
+            return { reinterpret_cast<T*>(bytes.data()), count };
+        }
+
+        // Adds `count` values to the end of column `index`
+        template <typename T>
+        void append(std::size_t index, const T * values, std::size_t count) {
+            check < T > ();
+            std::vector < std::byte > &bytes = slot(index);
+            const std::size_t used = bytes.size();
+            bytes.resize(used + count * sizeof(T));
+            std::memcpy(bytes.data() + used, values, count * sizeof(T));
+        }
+
+        // Column `index` as it was filled in
+        template <typename T>
+        std::span < const T > column(std::size_t index) const {
+            check < T > ();
+            if (index >= columns_.size())
+                return {};
+            const std::vector < std::byte > &bytes = columns_[index];
+            return { reinterpret_cast<const T*>(bytes.data()), bytes.size() / sizeof(T) };
+        }
+
+        std::size_t columns() const { return columns_.size(); }
+
+        // Empties every column, keeping the memory
+        void clear() {
+          for (std::vector < std::byte > &bytes : columns_)
+                bytes.clear();
+        }
+
+      private:
+        template <typename T>
+        static constexpr void check() {
+            static_assert(std::is_trivially_copyable_v<T>, "snapshot columns hold plain values");
+            static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__, "over-aligned snapshot column type");
+        }
+
+        std::vector < std::byte > &slot(std::size_t index) {
+            if (columns_.size() <= index)
+                columns_.resize(index + 1);
+            return columns_[index];
+        }
+
+        std::vector < std::vector < std::byte > > columns_;
+    };
+
+    class SnapshotWriter {
+      public:
+        using Encoder = std::function < void (const Snapshot &) >;
+
+        // `buffers` snapshots can be queued before write() has to wait
+        explicit SnapshotWriter(std::size_t buffers = 2) : pool_(buffers < 1 ? 1 : buffers) {
+          for (Snapshot & snap : pool_)
+                free_.push_back(&snap);
+            thread_ = std::thread([this] { run(); });
+        }
+
+        ~SnapshotWriter() {
+            {
+                std::lock_guard < std::mutex > lock(mutex_);
+                stopping_ = true;
+            }
+            queued_cv_.notify_one();
+            thread_.join();
+        }
+
+        SnapshotWriter(const SnapshotWriter &) = delete;
+        SnapshotWriter & operator=(const SnapshotWriter &) = delete;
+
+        // Fills a free snapshot with capture(snapshot) on this thread and
+        // queues encode(snapshot) for the writer thread
+        template <typename Capture>
+        void write(int64_t step, Capture && capture, Encoder encode) {
+            Snapshot & snap = acquire(step);
+            capture(snap);
+            submit(snap, std::move(encode));
+        }
+
+        // The two halves of write(), for a capture that is spread over a
+        // system: a free snapshot, cleared, waiting if none is free ...
+        Snapshot & acquire(int64_t step) {
+            std::unique_lock < std::mutex > lock(mutex_);
+            if (free_.empty()) {
+                const auto start = std::chrono::steady_clock::now();
+                free_cv_.wait(lock, [this] { return !free_.empty(); });
+                waited_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+            Snapshot *snap = free_.back();
+            free_.pop_back();
+            lock.unlock();
+            snap->clear();
+            snap->step = step;
+            return *snap;
+        }
+
+        // ... and handing it to the writer thread
+        void submit(Snapshot & snap, Encoder encode) {
+            {
+                std::lock_guard < std::mutex > lock(mutex_);
+                queue_.push_back({ &snap, std::move(encode) });
+            }
+            queued_cv_.notify_one();
+        }
+
+        // Waits until everything queued so far has been written
+        void flush() {
+            std::unique_lock < std::mutex > lock(mutex_);
+            free_cv_.wait(lock, [this] { return queue_.empty() && !busy_; });
+        }
+
+        bool ok() const {
+            std::lock_guard < std::mutex > lock(mutex_);
+            return error_.empty();
+        }
+
+        // The first encoder failure, "" if none
+        std::string error() const {
+            std::lock_guard < std::mutex > lock(mutex_);
+            return error_;
+        }
+
+        // Snapshots handed to their encoder so far
+        int64_t written() const {
+            std::lock_guard < std::mutex > lock(mutex_);
+            return written_;
+        }
+
+        // Seconds write()/acquire() spent waiting for a free buffer
+        double waited() const {
+            std::lock_guard < std::mutex > lock(mutex_);
+            return waited_;
+        }
+
+      private:
+        struct Job {
+            Snapshot *snap;
+            Encoder encode;
+        };
+
+        void run() {
+            std::unique_lock < std::mutex > lock(mutex_);
+            for (;;) {
+                queued_cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+                if (queue_.empty())
+                    return;     // stopping, and everything is written
+                Job job = std::move(queue_.front());
+                queue_.pop_front();
+                busy_ = true;
+                lock.unlock();
+
+                std::string failed;
+                try {
+                    job.encode(*job.snap);
+                } catch (const std::exception & e) {
+                    failed = e.what();
+                } catch (...) {
+                    failed = "snapshot encoder failed";
+                }
+
+                lock.lock();
+                if (error_.empty())
+                    error_ = failed;
+                ++written_;
+                busy_ = false;
+                free_.push_back(job.snap);
+                free_cv_.notify_all();
+            }
+        }
+
+        std::vector < Snapshot > pool_;
+        std::vector < Snapshot * > free_;
+        std::deque < Job > queue_;
+
+        mutable std::mutex mutex_;
+        std::condition_variable queued_cv_;  // a job was queued, or stopping
+        std::condition_variable free_cv_;    // a job finished
+        bool stopping_ {false};
+        bool busy_ {false};
+        std::string error_;
+        int64_t written_ {0};
+        double waited_ {0};
+
+        std::thread thread_;    // last, so it starts after everything it uses
+    };
+
+}                               // namespace gpecs
@@ -0,0 +1,195 @@
+//
+// (c) 2026 University of Manchester
+// You may use this under the terms of the Apache 2 License
+//
+//
+// This file implements a pipeline fixed at compile time, for worlds so small
+// that flecs' scheduling costs more than the systems themselves.
+//
+// starter-runge moves 2 particles through 10 phases. Each world.progress()
+// walks the pipeline, sets up an iterator for each of the 10 systems, asks
+// the query cache for its tables and calls the system through a delegate;
+// the arithmetic for 2 particles is a few dozen instructions next to that.
+// A StaticPipeline takes the same .each() functions as a list of stages,
+// each with its components as template arguments, and runs them as plain
+// loops over the tables' columns. The stages' types are all known to the
+// compiler, so a frame is one function with the stages inlined into it:
+//
+//     auto rk1 = [&](PositionStart& posStart, PositionHalfPredict& posHalf, ...) { ... };
+//     ...
+//     gpecs::StaticPipeline pipeline(world,
+//         gpecs::stage<PositionStart, PositionHalfPredict, ...>(rk1),
+//         gpecs::stage<Index, PositionHalfPredict, AccelerationHalfPredict, Mass>(accel1),
+//         ...
+//         gpecs::stage(energy_end));             // no components: once a frame
+//
+//     for (...) {
+//         pipeline.progress();                   // instead of world.progress()
+//         ... nodes[0].get<PositionStart>() ... // the data is still the world's
+//     }
+//
+// The components stay in the world, so entities are created and read as
+// before and the functions given to stage() are the ones given to
+// world.system<...>().each(). A stage's function takes its components in
+// order, optionally after the flecs::entity. Stages run in the order they
+// are listed, each over every entity that owns its components.
+//
+// starter-runge runs its systems this way with `--pipeline static`.
+//
+// Notes:
+//   - It is single threaded and does not run flecs' own systems, timers,
+//     observers or deferred merges: a stage that adds or removes components
+//     takes effect at once, as outside a frame. Nor does it advance the
+//     world's frame count or time; stages that need them capture their own.
+//   - Each stage keeps the matching tables (a cached query it builds when
+//     bound). If tables are created or deleted, it finds them again before
+//     its next run; rows and columns are read fresh every run, so adding
+//     entities to existing tables is fine.
+//   - There are no tags or filters: a stage runs over every entity that
+//     owns its components, not ones it inherits through a prefab. Use two
+//     pipelines where a system would select with .with<Tag>().
+//   - It pays off while flecs' fixed cost per system is a large share of the
+//     frame, a few thousand entities at most; `bin/ecs_application static`
+//     in examples/benchmarks shows where the two meet.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <flecs.h>
+
+namespace gpecs {
+    // A function and the components it runs over
+    template <typename Func, typename... Components>
+    struct Stage {
+        Func func;
+    };
+
+    template <typename... Components, typename Func>
+    constexpr Stage < std::decay_t < Func >, Components... > stage(Func && func) {
+        return { std::forward < Func > (func) };
+    }
+
+    namespace static_pipeline {
+        // A stage bound to the tables of a world
+        template <typename S>
+        class Bound;
+
+        // No components: the function runs once per frame
+        template <typename Func>
+        class Bound < Stage < Func > > {
+          public:
+            Bound(flecs::world &, Stage < Func > stage) : func_(std::move(stage.func)) { }
+            void run() { func_(); }
+
+          private:
+            Func func_;
+        };
+
+        template <typename Func, typename... Components>
+        class Bound < Stage < Func, Components... > > {
+          public:
+            static constexpr std::size_t COUNT = sizeof...(Components);
+
+            Bound(flecs::world & world, Stage < Func, Components... > stage)
+                : world_(world), func_(std::move(stage.func)) {
+                auto builder = world.query_builder < Components... > ();
+                for (int32_t i = 0; i < static_cast<int32_t>(COUNT); ++i)
+                    builder.term_at(i).self();
+                query_ = builder.cached().build();
+                bind();
+            }
+
+            // Cached queries get an entity, which flecs only frees with the world
+            ~Bound() {
+                if (query_ && query_.c_ptr()->entity)
+                    query_.destruct();
+            }
+
+            Bound(const Bound &) = delete;
+            Bound & operator=(const Bound &) = delete;
+            Bound(Bound && other) noexcept
+                : world_(other.world_), func_(std::move(other.func_)), query_(std::exchange(other.query_, {})),
+                  tables_(std::move(other.tables_)), matched_(other.matched_) { }
+
+            void run() {
+                if (ecs_query_match_count(query_.c_ptr()) != matched_)
+                    bind();
+              for (const Table & table : tables_)
+                    run(table, std::index_sequence_for < Components... > {});
+            }
+
+          private:
+            struct Table {
+                ecs_table_t *table;
+                int32_t column[COUNT];
+            };
+
+            // The tables the query matches now, and where each component is
+            void bind() {
+                tables_.clear();
+                const ecs_id_t ids[COUNT] = { world_.id < std::remove_const_t < Components > > ().raw_id()... };
+                ecs_iter_t it = ecs_query_iter(world_.c_ptr(), query_.c_ptr());
+                while (ecs_query_next(&it)) {
+                    Table table { it.table, {} };
+                    for (std::size_t c = 0; c < COUNT; ++c)
+                        table.column[c] = ecs_table_get_column_index(world_.c_ptr(), it.table, ids[c]);
+                    tables_.push_back(table);
+                }
+                matched_ = ecs_query_match_count(query_.c_ptr());
+            }
+
+            template <std::size_t... I>
+            void run(const Table & table, std::index_sequence < I... >) {
+                const int32_t count = ecs_table_count(table.table);
+                if (count == 0)
+                    return;
+                std::tuple < Components *... > columns {
+                    static_cast<Components*>(ecs_table_get_column(table.table, table.column[I], 0))... };
+                if constexpr (std::is_invocable_v < Func &, flecs::entity, Components &... >) {
+                    const ecs_entity_t *entities = ecs_table_entities(table.table);
+                    for (int32_t row = 0; row < count; ++row)
+                        func_(flecs::entity(world_.c_ptr(), entities[row]), std::get < I > (columns)[row]...);
+                } else {
+                    for (int32_t row = 0; row < count; ++row)
+                        func_(std::get < I > (columns)[row]...);
+                }
+            }
+
+            flecs::world & world_;
+            Func func_;
+            flecs::query < Components... > query_;
+            std::vector < Table > tables_;
+            int32_t matched_ {0};
+        };
+    }                           // namespace static_pipeline
+
+    template <typename... Stages>
+    class StaticPipeline {
+      public:
+        // Binds each stage to the world's tables; create once the
+        // components are registered
+        explicit StaticPipeline(flecs::world & world, Stages... stages)
+            : stages_(static_pipeline::Bound < Stages > (world, std::move(stages))...) { }
+
+        // One frame: every stage in order
+        void progress() {
+            std::apply([](auto &... stage) { (stage.run(), ...); }, stages_);
+        }
+
+        static constexpr std::size_t size() { return sizeof...(Stages); }
+
+      private:
+        std::tuple < static_pipeline::Bound < Stages >... > stages_;
+    };
+
+    template <typename... Stages>
+    StaticPipeline(flecs::world &, Stages...) -> StaticPipeline < Stages... >;
+
+}                               // namespace gpecs
@@ -0,0 +1,198 @@
+//
+// (c) 2026 University of Manchester
+// You may use this under the terms of the Apache 2 License
+//
+//
+// This file implements a neighbour cache for sketches that keep one flecs
+// entity per grid node (see GridField.hpp for the alternative of moving the
+// grid out of the ECS entirely).
+//
+// A stencil system in such a sketch typically does, per node and per stage:
+//
+//     if (nodes[x][y].has<UpperWall>()) { ... mirror own value ... }
+//     else { up = nodes[x][y+1].get<Velocity>(); }
+//
+// which costs a record lookup per has<>()/get<>() plus a branch on tag
+// membership. The StencilCache resolves every (node, slot) pair once into a
+// direct pointer to the neighbour's component, so the system body becomes
+// a plain indexed load.
+//
+// Creation - the resolver returns the index of the neighbour node for each
+// slot, or StencilCache::WALL if the slot is closed (the node then sees
+// itself, and sign() returns -1 so reflecting boundaries need no branch):
+//
+//     gpecs::StencilCache<4> cache(world, flat_nodes,
+//         [&](std::size_t node, int slot) -> std::ptrdiff_t { ... });
+//
+// Getting a column (do this once, at setup - the handle stays valid):
+//
+//     auto velocity = cache.column<Velocity>();
+//
+// Using it inside a system:
+//
+//     const Velocity& up = velocity(node, UP);
+//     double v_up = cache.sign(node, UP) * up.y;
+//
+// Keeping it fresh: the cached pointers point into flecs table storage, so
+// they go stale when the archetype layout changes (entities added, deleted
+// or moved between tables). Call refresh() once per frame - e.g. from a
+// system in the first phase - and it rebuilds only if the tables holding the
+// nodes changed size or tables were created/deleted. Moving an entity while
+// leaving every table count unchanged is not detected; call rebuild() by
+// hand if a sketch does that.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <flecs.h>
+
+namespace gpecs {
+    template <int Slots>
+    class StencilCache {
+      public:
+        static constexpr std::ptrdiff_t WALL = -1;
+        using Resolver = std::function < std::ptrdiff_t (std::size_t node, int slot) >;
+
+        // Handle to the cached neighbour pointers for one component type
+        template <typename T>
+        class Column {
+          public:
+            const T & operator()(std::size_t node, int slot) const {
+                return *(*ptrs_)[node * Slots + slot];
+            }
+          private:
+            friend class StencilCache;
+            explicit Column(const std::vector < const T* > *ptrs) : ptrs_(ptrs) { }
+            const std::vector < const T* > *ptrs_;
+        };
+
+        StencilCache(flecs::world & world, std::vector < flecs::entity > nodes, Resolver resolver)
+            : world_(world), nodes_(std::move(nodes)) {
+            links_.resize(nodes_.size() * Slots);
+            signs_.resize(nodes_.size() * Slots);
+            for (std::size_t n = 0; n < nodes_.size(); ++n) {
+                for (int s = 0; s < Slots; ++s) {
+                    std::ptrdiff_t nb = resolver(n, s);
+                    links_[n * Slots + s] = (nb == WALL) ? n : static_cast<std::size_t>(nb);
+                    signs_[n * Slots + s] = (nb == WALL) ? -1.0 : 1.0;
+                }
+            }
+            snapshot();
+        }
+
+        std::size_t size() const { return nodes_.size(); }
+
+        // Index of the node the given slot resolves to (itself at a wall)
+        std::size_t neighbour(std::size_t node, int slot) const {
+            return links_[node * Slots + slot];
+        }
+
+        // +1 for a real neighbour, -1 for a wall
+        double sign(std::size_t node, int slot) const {
+            return signs_[node * Slots + slot];
+        }
+
+        template <typename T>
+        Column<T> column() {
+            flecs::id_t id = world_.id<T>();
+            auto found = columns_.find(id);
+            if (found == columns_.end()) {
+                auto entry = std::make_unique < Entry<T> > ();
+                fill(entry->ptrs, id);
+                found = columns_.emplace(id, std::move(entry)).first;
+            }
+            return Column<T>(&static_cast<Entry<T>*>(found->second.get())->ptrs);
+        }
+
+        // Rebuild if the archetype layout under the nodes changed. Returns
+        // true if a rebuild happened.
+        bool refresh() {
+            if (!stale())
+                return false;
+            rebuild();
+            return true;
+        }
+
+        void rebuild() {
+          for (auto & [id, entry] : columns_)
+                entry->refill(*this, id);
+            snapshot();
+            ++rebuild_count_;
+        }
+
+        int rebuild_count() const { return rebuild_count_; }
+
+      private:
+        struct EntryBase {
+            virtual ~ EntryBase() = default;
+            virtual void refill(StencilCache & cache, flecs::id_t id) = 0;
+        };
+
+        template <typename T>
+        struct Entry : EntryBase {
+            std::vector < const T* > ptrs;
+            void refill(StencilCache & cache, flecs::id_t id) override { cache.fill(ptrs, id); }
+        };
+
+        struct TableState {
+            ecs_table_t *table;
+            int32_t count;
+        };
+
+        template <typename T>
+        void fill(std::vector < const T* > &ptrs, flecs::id_t id) {
+            ptrs.resize(links_.size());
+            std::vector < const T* > own(nodes_.size());
+            for (std::size_t n = 0; n < nodes_.size(); ++n) {
+                own[n] = static_cast<const T*>(ecs_get_id(world_, nodes_[n], id));
+                ecs_assert(own[n] != nullptr, ECS_INVALID_PARAMETER, "stencil node is missing component");
+            }
+            for (std::size_t i = 0; i < links_.size(); ++i)
+                ptrs[i] = own[links_[i]];
+        }
+
+        void snapshot() {
+            const ecs_world_info_t *info = ecs_get_world_info(world_);
+            table_create_total_ = info->table_create_total;
+            table_delete_total_ = info->table_delete_total;
+            tables_.clear();
+            for (auto & e : nodes_) {
+                ecs_table_t *t = ecs_get_table(world_, e);
+                bool known = false;
+              for (auto & ts : tables_)
+                    known = known || (ts.table == t);
+                if (!known)
+                    tables_.push_back({ t, ecs_table_count(t) });
+            }
+        }
+
+        bool stale() const {
+            const ecs_world_info_t *info = ecs_get_world_info(world_);
+            if (info->table_create_total != table_create_total_ || info->table_delete_total != table_delete_total_)
+                return true;
+          for (auto & ts : tables_) {
+                if (ecs_table_count(ts.table) != ts.count)
+                    return true;
+            }
+            return false;
+        }
+
+        flecs::world & world_;
+        std::vector < flecs::entity > nodes_;
+        std::vector < std::size_t > links_;
+        std::vector < double > signs_;
+        std::map < flecs::id_t, std::unique_ptr < EntryBase > > columns_;
+        std::vector < TableState > tables_;
+        int64_t table_create_total_ {0};
+        int64_t table_delete_total_ {0};
+        int rebuild_count_ {0};
+    };
+
+}                               // namespace gpecs
@@ -0,0 +1,334 @@
+//
+// (c) 2026 University of Manchester
+// You may use this under the terms of the Apache 2 License
+//
+//
+// This file implements parameter sweeps run inside one process: one world
+// per point of a parameter grid, the points shared out over a pool of
+// threads.
+//
+// A study such as unsteady_scalar at several Peclet numbers used to mean
+// editing a constant, rebuilding and running the binaries one after the
+// other on one core. The runs are independent, so a Sweep runs as many at
+// once as there are cores, each in its own output directory:
+//
+//     gpecs::ParameterGrid grid;
+//     grid.add("Pe", {10, 50, 100, 200});
+//     grid.add("N", {201, 501});            // 8 runs, every combination
+//
+//     gpecs::Sweep sweep(grid, "sweep");     // sweep/Pe=10_N=201/, ...
+//     auto results = sweep.run([](flecs::world& world, const gpecs::SweepRun& run) {
+//         ...systems and entities...
+//         gpecs::TextWriter out(run.file("phi.txt"));
+//         const double pe = run["Pe"];
+//         ...
+//     });
+//     sweep.report(results);                 // sweep/sweep.csv
+//
+// The body is called once per point, on one of the pool's threads, with a
+// new world of its own, the point's values and its directory (created
+// beforehand). Worlds are created and deleted one at a time, as flecs sets
+// global (if always equal) ids while it imports its modules. The
+// body must keep all of its state in the world and in its own variables:
+// runs share the process, so globals that depend on a parameter have to
+// become values the body passes around. A run that throws is recorded as
+// failed with the message and the others carry on.
+//
+// Accounting - each result has the run's wall time and the CPU time of the
+// thread that ran it. If the package energy counters can be read
+// (/sys/class/powercap/intel-rapl:*/energy_uj, often root only) the energy
+// used over the whole sweep is shared out between the runs by CPU time;
+// otherwise joules is NaN. The counters cover the whole package, so the
+// share is an estimate, and background load on the machine is counted too.
+//
+// Notes:
+//
+// * Give the runs one thread each (no --threads); the sweep already keeps
+//   every core busy, and a run's worker threads are not in its CPU time.
+// * Run names are "name=value" joined by "_", with values written as short
+//   as they read back exactly.
+// * flecs' C++ layer numbers each component type the first time any world
+//   uses it, and keeps allocation counts, in unguarded globals. Runs that
+//   get there at the same time write the same values or, for the type
+//   numbers, ones flecs resolves by name, so the results do not change;
+//   ThreadSanitizer does report them.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <time.h>
+
+#include <flecs.h>
+#include <gpecs/TextWriter.hpp>
+
+namespace gpecs {
+    // One point of a parameter grid
+    class SweepRun {
+      public:
+        std::size_t index {0};          // position in ParameterGrid::runs()
+        std::string name;               // "Pe=10_N=201"
+        std::filesystem::path dir;      // where the run writes its files
+
+        // The value of `parameter` at this point; throws if there is none
+        double operator[](const std::string & parameter) const {
+          for (const auto &[key, value] : values)
+                if (key == parameter)
+                    return value;
+            throw std::out_of_range("gpecs sweep: no parameter " + parameter);
+        }
+
+        // Path of `file` in the run's directory
+        std::string file(const std::string & file) const { return (dir / file).string(); }
+
+        std::vector < std::pair < std::string, double > > values;
+    };
+
+    class ParameterGrid {
+      public:
+        ParameterGrid & add(std::string name, std::vector < double > values) {
+            parameters_.emplace_back(std::move(name), std::move(values));
+            return *this;
+        }
+
+        // Every combination of the values, the last parameter changing fastest
+        std::vector < SweepRun > runs(const std::filesystem::path & root) const {
+            std::vector < SweepRun > runs;
+            std::size_t count = parameters_.empty() ? 0 : 1;
+          for (const auto & parameter : parameters_)
+                count *= parameter.second.size();
+            for (std::size_t index = 0; index < count; ++index) {
+                SweepRun run;
+                run.index = index;
+                std::size_t rest = index;
+                for (std::size_t p = parameters_.size(); p-- > 0;) {
+                    const auto &[name, values] = parameters_[p];
+                    run.values.emplace_back(name, values[rest % values.size()]);
+                    rest /= values.size();
+                }
+                std::reverse(run.values.begin(), run.values.end());
+              for (const auto &[name, value] : run.values)
+                    run.name += (run.name.empty() ? "" : "_") + name + "=" + text(value);
+                run.dir = root / run.name;
+                runs.push_back(std::move(run));
+            }
+            return runs;
+        }
+
+        const std::vector < std::pair < std::string, std::vector < double > > > &parameters() const {
+            return parameters_;
+        }
+
+        // Parses "10,50,100" for add(); throws on anything that is not a number
+        static std::vector < double > parse(const std::string & list) {
+            std::vector < double > values;
+            const char *first = list.data();
+            const char *last = list.data() + list.size();
+            while (first < last) {
+                double value;
+                const auto [end, ec] = std::from_chars(first, last, value);
+                if (ec != std::errc() || (end != last && *end != ','))
+                    throw std::invalid_argument("gpecs sweep: not a list of numbers: " + list);
+                values.push_back(value);
+                first = end + 1;
+            }
+            return values;
+        }
+
+      private:
+        static std::string text(double value) {
+            char buffer[32];
+            return std::string(buffer, std::to_chars(buffer, buffer + sizeof(buffer), value).ptr);
+        }
+
+        std::vector < std::pair < std::string, std::vector < double > > > parameters_;
+    };
+
+    struct SweepResult {
+        SweepRun run;
+        bool ok {false};
+        std::string error;              // what() of the exception if !ok
+        double seconds {0};             // wall time
+        double cpu_seconds {0};         // CPU time of the thread that ran it
+        double joules {std::numeric_limits<double>::quiet_NaN()};
+    };
+
+    namespace sweep {
+        inline double thread_cpu_seconds() {
+            timespec ts {};
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+            return ts.tv_sec + ts.tv_nsec * 1e-9;
+        }
+
+        // Package energy counters, read before and after the sweep
+        class Rapl {
+          public:
+            Rapl() {
+                std::error_code ec;
+                for (const auto & entry : std::filesystem::directory_iterator("/sys/class/powercap", ec)) {
+                    const std::string name = entry.path().filename().string();
+                    // Packages are intel-rapl:N; intel-rapl:N:M are parts of them
+                    if (name.rfind("intel-rapl:", 0) != 0 || name.find(':', 11) != std::string::npos)
+                        continue;
+                    Domain domain { entry.path() / "energy_uj", 0, 0 };
+                    if (!read(entry.path() / "max_energy_range_uj", domain.range) || !read(domain.path, domain.start))
+                        continue;
+                    domains_.push_back(domain);
+                }
+            }
+
+            bool available() const { return !domains_.empty(); }
+
+            // Joules since construction, allowing for one wrap of each counter
+            double joules() const {
+                double total = 0;
+              for (const Domain & domain : domains_) {
+                    uint64_t now = 0;
+                    if (!read(domain.path, now))
+                        return std::numeric_limits<double>::quiet_NaN();
+                    total += (now >= domain.start ? now - domain.start : now + domain.range - domain.start) * 1e-6;
+                }
+                return total;
+            }
+
+          private:
+            struct Domain {
+                std::filesystem::path path;
+                uint64_t range;
+                uint64_t start;
+            };
+
+            static bool read(const std::filesystem::path & path, uint64_t & value) {
+                std::ifstream in(path);
+                return static_cast<bool>(in >> value);
+            }
+
+            std::vector < Domain > domains_;
+        };
+    }                           // namespace sweep
+
+    class Sweep {
+      public:
+        // Runs go in root/<run name>; threads 0 means one per core
+        explicit Sweep(ParameterGrid grid, std::filesystem::path root = "sweep", unsigned threads = 0)
+            : grid_(std::move(grid)), root_(std::move(root)),
+              threads_(threads ? threads : std::max(1u, std::thread::hardware_concurrency())) { }
+
+        // Calls body(world, run) for every point of the grid, each with a new
+        // world, and returns the results in grid order
+        template <typename Body>
+        std::vector < SweepResult > run(Body && body) {
+            std::vector < SweepRun > runs = grid_.runs(root_);
+            std::vector < SweepResult > results(runs.size());
+          for (SweepRun & run : runs)
+                std::filesystem::create_directories(run.dir);
+
+            sweep::Rapl rapl;
+            std::atomic < std::size_t > next {0};
+            std::mutex creating;   // worlds are created and deleted one at a time
+            auto worker = [&] {
+                for (std::size_t i; (i = next.fetch_add(1)) < runs.size();) {
+                    SweepResult & result = results[i];
+                    result.run = runs[i];
+                    const auto start = std::chrono::steady_clock::now();
+                    const double cpu = sweep::thread_cpu_seconds();
+                    std::unique_ptr < flecs::world > world;
+                    {
+                        std::lock_guard < std::mutex > lock(creating);
+                        world = std::make_unique < flecs::world > ();
+                    }
+                    try {
+                        body(*world, static_cast<const SweepRun &>(result.run));
+                        result.ok = true;
+                    } catch (const std::exception & e) {
+                        result.error = e.what();
+                    } catch (...) {
+                        result.error = "sweep run failed";
+                    }
+                    {
+                        std::lock_guard < std::mutex > lock(creating);
+                        world.reset();
+                    }
+                    result.cpu_seconds = sweep::thread_cpu_seconds() - cpu;
+                    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                }
+            };
+
+            std::vector < std::thread > pool;
+            const std::size_t threads = std::min < std::size_t > (threads_, runs.size());
+            for (std::size_t t = 1; t < threads; ++t)
+                pool.emplace_back(worker);
+            worker();
+          for (std::thread & thread : pool)
+                thread.join();
+
+            // Share the energy out by CPU time
+            if (rapl.available()) {
+                const double joules = rapl.joules();
+                double cpu = 0;
+              for (const SweepResult & result : results)
+                    cpu += result.cpu_seconds;
+              for (SweepResult & result : results)
+                    result.joules = cpu > 0 ? joules * result.cpu_seconds / cpu : 0;
+            }
+            return results;
+        }
+
+        // Writes one CSV row per run to root/sweep.csv (or `path`) and returns
+        // the number of runs that failed
+        std::size_t report(const std::vector < SweepResult > &results, std::string path = "") const {
+            if (path.empty())
+                path = (root_ / "sweep.csv").string();
+            TextWriter out(path);
+            out.precision(TextWriter::SHORTEST);
+            out << "run";
+          for (const auto & parameter : grid_.parameters())
+                out << "," << parameter.first;
+            out << ",seconds,cpu_seconds,joules,status\n";
+            std::size_t failed = 0;
+          for (const SweepResult & result : results) {
+                out << result.run.name;
+              for (const auto & value : result.run.values)
+                    out << "," << value.second;
+                out << "," << result.seconds << "," << result.cpu_seconds << ",";
+                if (!std::isnan(result.joules))
+                    out << result.joules;
+                std::string status = result.ok ? "ok" : result.error;
+                std::replace(status.begin(), status.end(), ',', ';');
+                std::replace(status.begin(), status.end(), '\n', ' ');
+                out << "," << status << "\n";
+                failed += !result.ok;
+            }
+            if (!out.close())
+                throw std::runtime_error("gpecs sweep: cannot write " + path);
+            return failed;
+        }
+
+        const std::filesystem::path & root() const { return root_; }
+        unsigned threads() const { return threads_; }
+
+      private:
+        ParameterGrid grid_;
+        std::filesystem::path root_;
+        unsigned threads_;
+    };
+
+}                               // namespace gpecs
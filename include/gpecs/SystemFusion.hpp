@@ -0,0 +1,412 @@
+//
+// (c) 2026 University of Manchester
+// You may use this under the terms of the Apache 2 License
+//
+//
+// This file implements fusing consecutive systems that iterate the same
+// entities into one pass, a chunk of rows at a time.
+//
+// The Runge-Kutta sketches run several systems back to back over the same
+// entities, and each one streams the columns it uses through the cache
+// again; fluid-me's RungeKutta_4 system writes FunctionsFourth and the
+// Update system reads it straight back, with VelocityStart, DensityStart
+// and the other stages' functions. SystemFusion looks at the systems of a
+// list of phases in pipeline order and fuses runs of consecutive systems
+// that can be: the first system of a run then does the whole run, chunk by
+// chunk, so a chunk's columns are still in cache for the next system:
+//
+//     gpecs::use_threads(world, argc, argv);
+//     world.system<...>().kind(RungeKutta_4).each(...).add<gpecs::Fusable>();
+//     world.system<...>().kind(Update).each(...).add<gpecs::Fusable>();
+//     gpecs::SystemFusion fusion(world, {RungeKutta_1, ..., Update});
+//
+// or, with `--fuse auto` (or `--fuse ROWS` for a chunk size) on the
+// command line, through fusion_from_args(), which prints the decisions.
+// The option is removed from argv (see Args.hpp).
+//
+// flecs builds .each() and .run() systems alike, around a run callback,
+// and only an .each() can be run a chunk at a time, so systems say they
+// are one with the gpecs::Fusable tag (C systems with a plain callback
+// need not). A system joins the run of the one before it when both
+// * are tagged, have terms, and are neither immediate nor on a rate or
+//   interval,
+// * are both multi-threaded or both not,
+// * write only their own entities' components: terms on singletons,
+//   parents (.up()) or nothing (.write<T>()) must only be read, and not be
+//   written by the other systems of the run, and
+// * flecs would not merge commands between them (see ConcurrentSystems).
+// A system with no terms, such as gpecs::sync_point(), ends a run.
+//
+// What it cannot see is a system that reads other entities' components
+// through captured entities or caches, like fluid-me's neighbour stencil.
+// Fusing is only correct if no system reads, on other entities, what an
+// earlier system of its run writes - the same place --threads needs a
+// sync_point(), which ends a run. The tag and the list of phases are the
+// opt-in.
+//
+// Notes:
+//
+// * Each chunk is a range of one table's rows, sized so the run's columns
+//   for it take about 128 KiB (ROWS from --fuse overrides). Under --threads
+//   each worker takes chunks of its own slice of the first system's tables.
+//   A later system's tables that the first does not match are done after
+//   the chunks, split between the workers as flecs does.
+// * The later systems of a run are disabled in the pipeline and recorded
+//   as (gpecs::Fused, system) on the first, so the profiler shows the run
+//   as one line, `A + B`, with the time of the whole pass, and the memory
+//   report counts each column the run touches once.
+// * Systems are changed when the object is built and restored when it is
+//   destroyed, which must happen before the world is. Create it after
+//   use_threads() and the systems.
+// * report() lists every system with its run, or why it starts one.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <initializer_list>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <flecs.h>
+
+#include <gpecs/Args.hpp>
+#include <gpecs/ConcurrentSystems.hpp>
+#include <gpecs/Profiler.hpp>
+
+namespace gpecs {
+    // Tag for a system whose callback can be run over part of its entities
+    // at a time, as .each() can (see above)
+    struct Fusable {};
+
+    namespace fusion {
+        // Columns of one chunk of a run
+        constexpr int64_t CHUNK_BYTES = 128 * 1024;
+
+        // A term on the entities the system iterates
+        inline bool own(const ecs_term_t & term) {
+            return ecs_term_match_this(&term) && !(term.src.id & EcsUp);
+        }
+
+        inline bool writes(const ecs_query_t * q, const ecs_term_t & term) {
+            return (q->write_fields & (1u << term.field_index)) || term.inout == EcsOut || term.inout == EcsInOut;
+        }
+
+        // Why a system cannot be fused at all, or nullptr
+        inline const char *unfusable(const ecs_system_t * s, bool tagged) {
+            const ecs_query_t *q = s->query;
+            if (q->field_count == 0)
+                return "no terms";
+            if (s->immediate)
+                return "immediate";
+            if (s->tick_source)
+                return "on a rate or interval";
+            if (s->run && !tagged)
+                return "not tagged gpecs::Fusable";
+            bool rows = false;
+            for (int8_t t = 0; t < q->term_count; ++t) {
+                if (own(q->terms[t]))
+                    rows = true;
+                else if (writes(q, q->terms[t]))
+                    return "writes outside its own entities";
+            }
+            return rows ? nullptr : "no terms on its own entities";
+        }
+
+        // Whether b reads, outside its own entities, what a writes, or the
+        // other way round
+        inline bool shared_write(const ecs_query_t * a, const ecs_query_t * b) {
+            for (int8_t i = 0; i < a->term_count; ++i) {
+                for (int8_t j = 0; j < b->term_count; ++j) {
+                    const ecs_term_t & x = a->terms[i];
+                    const ecs_term_t & y = b->terms[j];
+                    if (own(x) && own(y))
+                        continue;
+                    if (!ecs_id_match(x.id, y.id) && !ecs_id_match(y.id, x.id))
+                        continue;
+                    if (writes(a, x) || writes(b, y))
+                        return true;
+                }
+            }
+            return false;
+        }
+    }                           // namespace fusion
+
+    class SystemFusion {
+      public:
+        // chunk_rows = 0 sizes chunks from the columns of each run
+        SystemFusion(flecs::world & world, std::initializer_list < flecs::entity > phases, int32_t chunk_rows = 0)
+            : world_(world) {
+          for (const flecs::entity & phase : phases) {
+                std::vector < flecs::entity_t > systems;
+                ecs_iter_t it = ecs_each_id(world_, EcsSystem);
+                while (ecs_each_next(&it))
+                    for (int i = 0; i < it.count; ++i)
+                        if (ecs_has_pair(world_, it.entities[i], EcsDependsOn, phase.id()) &&
+                            !ecs_has_id(world_, it.entities[i], EcsDisabled))
+                            systems.push_back(it.entities[i]);
+                std::sort(systems.begin(), systems.end());
+              for (flecs::entity_t system : systems)
+                    listed_.push_back({ system, "" });
+            }
+            decide();
+            fused_ = world_.component<Fused>();
+          for (Group & g : groups_) {
+                g.chunk = chunk(g);
+                if (chunk_rows > 0)
+                    g.chunk = chunk_rows;
+                ecs_system_t *s = g.members[0].data;
+                s->run = &SystemFusion::fused;
+                s->run_ctx = &g;
+                s->run_ctx_free = nullptr;
+                for (std::size_t i = 1; i < g.members.size(); ++i) {
+                    ecs_add_pair(world_, g.members[0].system, fused_, g.members[i].system);
+                    ecs_enable(world_, g.members[i].system, false);
+                }
+            }
+        }
+
+        SystemFusion(const SystemFusion &) = delete;
+        SystemFusion & operator=(const SystemFusion &) = delete;
+
+        ~SystemFusion() {
+          for (Group & g : groups_) {
+                Member & lead = g.members[0];
+                if (!ecs_is_alive(world_, lead.system))
+                    continue;
+                if (ecs_system_get(world_, lead.system) == lead.data && lead.data->run_ctx == &g) {
+                    lead.data->run = lead.run;
+                    lead.data->run_ctx = lead.run_ctx;
+                    lead.data->run_ctx_free = lead.run_ctx_free;
+                }
+                for (std::size_t i = 1; i < g.members.size(); ++i) {
+                    ecs_remove_pair(world_, lead.system, fused_, g.members[i].system);
+                    if (ecs_is_alive(world_, g.members[i].system))
+                        ecs_enable(world_, g.members[i].system, true);
+                }
+            }
+        }
+
+        // Runs of two or more systems made into one pass
+        std::size_t runs() const { return groups_.size(); }
+
+        std::string report() const {
+            std::size_t fused = 0;
+          for (const Group & g : groups_)
+                fused += g.members.size();
+            std::string r;
+            char line[512];
+            std::snprintf(line, sizeof(line), "gpecs fusion: %zu of %zu systems fused into %zu pass%s\n", fused,
+                          listed_.size(), groups_.size(), groups_.size() == 1 ? "" : "es");
+            r += line;
+          for (const Listed & l : listed_) {
+                const std::string label = entity_label(world_, ecs_get_target(world_, l.system, EcsDependsOn, 0))
+                                        + " / " + system_label(world_, l.system, false);
+                if (l.group >= 0) {
+                    const Group & g = groups_[l.group];
+                    if (g.members[0].system == l.system)
+                        std::snprintf(line, sizeof(line), "  pass %d (%d rows a chunk, %lld B/row):\n", l.group + 1,
+                                      g.chunk, static_cast<long long>(g.row_bytes));
+                    else
+                        line[0] = '\0';
+                    r += line;
+                    r += "    " + label + "\n";
+                } else {
+                    r += "  " + label + ": " + l.reason + "\n";
+                }
+            }
+            return r;
+        }
+
+      private:
+        struct Member {
+            flecs::entity_t system {0};
+            ecs_system_t *data {nullptr};
+            // The system's own
+            ecs_run_action_t run {nullptr};
+            void *run_ctx {nullptr};
+            ecs_ctx_free_t run_ctx_free {nullptr};
+        };
+
+        struct Group {
+            std::vector < Member > members;
+            bool multi_threaded {false};
+            int32_t chunk {0};
+            int64_t row_bytes {0};
+        };
+
+        struct Listed {
+            flecs::entity_t system;
+            std::string reason;         // why it starts a new run
+            int group {-1};
+        };
+
+        // Cuts the listed systems into runs
+        void decide() {
+            concurrent::Staged staged;
+            bool first = true;
+            bool multi_threaded = false;
+            bool immediate = false;
+            std::vector < Member > run;
+            std::vector < std::size_t > in_run;
+            auto close = [&]() {
+                if (run.size() > 1) {
+                    for (std::size_t k : in_run)
+                        listed_[k].group = static_cast<int>(groups_.size());
+                    groups_.push_back(Group { run, run[0].data->multi_threaded, 0, 0 });
+                }
+                run.clear();
+                in_run.clear();
+            };
+            for (std::size_t k = 0; k < listed_.size(); ++k) {
+                Listed & l = listed_[k];
+                ecs_system_t *s = const_cast<ecs_system_t*>(ecs_system_get(world_, l.system));
+
+                // Where flecs merges, as in ConcurrentSystems
+                bool merge = concurrent::needs_merge(s->query, true, staged);
+                if (first) {
+                    multi_threaded = s->multi_threaded;
+                    immediate = s->immediate;
+                    first = false;
+                }
+                const bool threading = s->multi_threaded != multi_threaded;
+                merge = merge || threading || s->immediate != immediate;
+                multi_threaded = s->multi_threaded;
+                immediate = s->immediate;
+                if (immediate)
+                    merge = true;
+                if (merge) {
+                    staged.ids.clear();
+                    concurrent::needs_merge(s->query, true, staged);
+                }
+
+                if (const char *why = fusion::unfusable(s, world_.entity(l.system).has<Fusable>())) {
+                    close();
+                    l.reason = why;
+                    continue;
+                }
+                const char *why = nullptr;
+                if (run.empty())
+                    why = k == 0 ? "first listed" : "the one before cannot be fused";
+                else if (threading)
+                    why = "multi-threaded and the one before not, or the other way round";
+                else if (merge)
+                    why = "flecs merges commands before it";
+                else
+                  for (const Member & m : run)
+                        if (fusion::shared_write(m.data->query, s->query))
+                            why = "shares a component outside its own entities with the run";
+                if (why) {
+                    close();
+                    l.reason = why;
+                }
+                run.push_back(Member { l.system, s, s->run, s->run_ctx, s->run_ctx_free });
+                in_run.push_back(k);
+            }
+            close();
+        }
+
+        // Rows whose columns, over the whole run, take CHUNK_BYTES
+        int32_t chunk(Group & g) const {
+            std::vector < ecs_id_t > ids;
+          for (const Member & m : g.members) {
+                const ecs_query_t *q = m.data->query;
+                for (int8_t t = 0; t < q->term_count; ++t)
+                    if (fusion::own(q->terms[t]))
+                        ids.push_back(q->terms[t].id);
+            }
+            std::sort(ids.begin(), ids.end());
+            ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+            g.row_bytes = 0;
+          for (ecs_id_t id : ids) {
+                const ecs_type_info_t *ti = ecs_get_type_info(world_, id);
+                g.row_bytes += ti ? ti->size : 0;
+            }
+            const int64_t rows = g.row_bytes ? fusion::CHUNK_BYTES / g.row_bytes : 65536;
+            return static_cast<int32_t>(std::clamp<int64_t>(rows, 64, 65536));
+        }
+
+        // One system over one range of one table
+        static void run_range(ecs_world_t * stage, const Member & m, const ecs_table_range_t & range,
+                              ecs_ftime_t delta_time, ecs_ftime_t delta_system_time) {
+            const ecs_system_t *s = m.data;
+            ecs_iter_t it = ecs_query_iter(stage, s->query);
+            ecs_iter_set_var_as_range(&it, 0, &range);
+            it.system = m.system;
+            it.delta_time = delta_time;
+            it.delta_system_time = delta_system_time;
+            it.param = s->ctx;
+            it.ctx = s->ctx;
+            it.callback_ctx = s->callback_ctx;
+            it.run_ctx = m.run_ctx;
+            it.callback = s->action;
+            if (m.run) {
+                m.run(&it);
+            } else {
+                while (ecs_query_next(&it))
+                    s->action(&it);
+            }
+        }
+
+        // The first system's run callback: the whole run over its slice
+        static void fused(ecs_iter_t * it) {
+            const Group & g = *static_cast<const Group*>(it->run_ctx);
+            ecs_world_t *stage = it->world;
+            const ecs_ftime_t delta_time = it->delta_time;
+            const ecs_ftime_t delta_system_time = it->delta_system_time;
+
+            while (ecs_iter_next(it)) {
+                for (int32_t done = 0; done < it->count; done += g.chunk) {
+                    const ecs_table_range_t range { it->table, it->offset + done, std::min(g.chunk, it->count - done) };
+                  for (const Member & m : g.members)
+                        run_range(stage, m, range, delta_time, delta_system_time);
+                }
+            }
+
+            // Tables of the later systems that the first does not match
+            std::vector < const ecs_table_t * > tables;
+            ecs_iter_t lit = ecs_query_iter(stage, g.members[0].data->query);
+            while (ecs_query_next(&lit))
+                tables.push_back(lit.table);
+            std::sort(tables.begin(), tables.end());
+            const int32_t workers = ecs_get_stage_count(stage);
+            const int32_t worker = ecs_stage_get_id(stage);
+            for (std::size_t i = 1; i < g.members.size(); ++i) {
+                const Member & m = g.members[i];
+                ecs_iter_t qit = ecs_query_iter(stage, m.data->query);
+                ecs_iter_t wit;
+                ecs_iter_t *mit = &qit;
+                if (g.multi_threaded && workers > 1) {
+                    wit = ecs_worker_iter(&qit, worker, workers);
+                    mit = &wit;
+                }
+                while (ecs_iter_next(mit))
+                    if (!std::binary_search(tables.begin(), tables.end(), mit->table))
+                        run_range(stage, m, { mit->table, mit->offset, mit->count }, delta_time, delta_system_time);
+            }
+        }
+
+        flecs::world & world_;
+        std::vector < Listed > listed_;
+        std::vector < Group > groups_;
+        flecs::entity_t fused_ {0};
+    };
+
+    // Fuses the systems of `phases` if `--fuse auto` or `--fuse ROWS` was
+    // given, printing the decisions; otherwise returns an empty pointer
+    inline std::unique_ptr < SystemFusion > fusion_from_args(flecs::world & world, int & argc, char *argv[],
+                                                             std::initializer_list < flecs::entity > phases) {
+        std::string rows;
+        if (!take_option(argc, argv, "--fuse", rows))
+            return nullptr;
+        auto fusion = std::make_unique < SystemFusion > (world, phases, rows == "auto" ? 0 : std::atoi(rows.c_str()));
+        std::cout << fusion->report() << std::flush;
+        return fusion;
+    }
+
+}                               // namespace gpecs
@@ -0,0 +1,167 @@
+//
+// (c) 2026 University of Manchester
+// You may use this under the terms of the Apache 2 License
+//
+//
+// This file implements the plumbing shared by the diagnostics that need to
+// run code around every system run (PerfCounters.hpp, ChurnMonitor.hpp).
+//
+// flecs calls a system through its run callback; SystemHooks swaps that
+// callback for its own, which calls the derived class's around() on the
+// thread and stage the system is running on. around() does its measuring
+// and calls Hooked::call() to run the system as flecs would have:
+//
+//     class Counter : public gpecs::SystemHooks<Counter, int64_t> {
+//         friend class gpecs::SystemHooks<Counter, int64_t>;
+//       public:
+//         explicit Counter(flecs::world& world) : SystemHooks(world) { start(); }
+//       private:
+//         void hooked(Hooked&) { }                  // a system was hooked
+//         void around(Hooked& h, ecs_iter_t* it) {  // every run, every worker
+//             h.call(it);
+//             ++h.data;   // races under --threads; see PerfCounters
+//         }
+//         void end_frame() { }                      // world not readonly here
+//     };
+//
+// start() hooks every system that exists, and adds a system that at the
+// end of each frame hooks any added since and calls end_frame(). The
+// original callbacks are restored when the object is destroyed, which must
+// happen before the world is.
+//
+// Systems are hooked while no frame is running, so a system added after
+// start() misses the first frame it runs in.
+//
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include <flecs.h>
+
+#include <gpecs/Profiler.hpp>
+
+namespace gpecs {
+    template <typename Derived, typename Data>
+    class SystemHooks {
+      public:
+        // A system whose run callback has been replaced; the original callback
+        // and its context are kept here and put back by stop()
+        struct Hooked {
+            Derived *self;
+            flecs::entity_t system;
+            std::string phase;
+            std::string label;
+            ecs_run_action_t run;
+            void *run_ctx;
+            ecs_ctx_free_t run_ctx_free;
+            Data data {};
+
+            // What flecs does for a system: its run callback if it has one
+            // (every C++ .each() or .run() system), otherwise its callback per result
+            void call(ecs_iter_t * it) const {
+                if (run) {
+                    run(it);
+                } else {
+                    while (ecs_iter_next(it))
+                        it->callback(it);
+                }
+            }
+        };
+
+        SystemHooks(const SystemHooks &) = delete;
+        SystemHooks & operator=(const SystemHooks &) = delete;
+
+      protected:
+        explicit SystemHooks(flecs::world & world) : world_(world) { }
+        ~SystemHooks() { stop(); }
+
+        void start() {
+            frame_hook_ = world_.system<>()
+                .kind(flecs::OnLoad)
+                .run([this](flecs::iter &) {
+                    ecs_run_post_frame(world_, &SystemHooks::end_of_frame, this);
+                });
+            hook_systems();
+        }
+
+        void stop() {
+            if (frame_hook_.id() && frame_hook_.is_alive())
+                frame_hook_.destruct();
+            frame_hook_ = flecs::system();
+          for (auto & [id, h] : hooked_)
+                unhook(*h);
+        }
+
+        flecs::world & world_;
+        std::map < flecs::entity_t, std::unique_ptr < Hooked > > hooked_;
+        int64_t frames_ {0};
+
+      private:
+        static void run_hooked(ecs_iter_t * it) {
+            Hooked *h = static_cast<Hooked*>(it->run_ctx);
+            it->run_ctx = h->run_ctx;
+            h->self->around(*h, it);
+        }
+
+        // Called by flecs when a hooked system is deleted
+        static void free_hooked(void *ctx) {
+            Hooked *h = static_cast<Hooked*>(ctx);
+            if (h->run_ctx_free)
+                h->run_ctx_free(h->run_ctx);
+            h->system = 0;
+        }
+
+        static void end_of_frame(ecs_world_t *, void *ctx) {
+            SystemHooks *self = static_cast<SystemHooks*>(ctx);
+            ++self->frames_;
+            const ecs_world_info_t *info = ecs_get_world_info(self->world_);
+            if (info->pipeline_build_count_total != self->pipeline_builds_) {
+                self->pipeline_builds_ = info->pipeline_build_count_total;
+                self->hook_systems();
+            }
+            static_cast<Derived*>(self)->end_frame();
+        }
+
+        void hook_systems() {
+            ecs_iter_t it = ecs_each_id(world_, EcsSystem);
+            while (ecs_each_next(&it)) {
+                for (int i = 0; i < it.count; ++i) {
+                    const flecs::entity_t id = it.entities[i];
+                    if (id == frame_hook_.id() || hooked_.count(id))
+                        continue;
+                    ecs_system_t *sys = const_cast<ecs_system_t*>(ecs_system_get(world_, id));
+                    if (!sys)
+                        continue;
+                    auto h = std::make_unique < Hooked > (Hooked {
+                        static_cast<Derived*>(this), id,
+                        entity_label(world_, ecs_get_target(world_, id, EcsDependsOn, 0)),
+                        system_label(world_, id), sys->run, sys->run_ctx, sys->run_ctx_free });
+                    sys->run = &SystemHooks::run_hooked;
+                    sys->run_ctx = h.get();
+                    sys->run_ctx_free = &SystemHooks::free_hooked;
+                    static_cast<Derived*>(this)->hooked(*h);
+                    hooked_[id] = std::move(h);
+                }
+            }
+        }
+
+        void unhook(Hooked & h) {
+            if (!h.system || !ecs_is_alive(world_, h.system))
+                return;
+            ecs_system_t *sys = const_cast<ecs_system_t*>(ecs_system_get(world_, h.system));
+            if (!sys || sys->run_ctx != &h)
+                return;
+            sys->run = h.run;
+            sys->run_ctx = h.run_ctx;
+            sys->run_ctx_free = h.run_ctx_free;
+            h.system = 0;
+        }
+
+        flecs::system frame_hook_;
+        int64_t pipeline_builds_ {-1};
+    };
+
+}                               // namespace gpecs
@@ -0,0 +1,179 @@
+//
+// (c) 2026 University of Manchester
+// You may use this under the terms of the Apache 2 License
+//
+//
+// This file implements a buffered text writer for the examples' CSV output.
+//
+// std::ofstream formats every double through the stream's locale and
+// facets and hands small pieces to its buffer. TextWriter formats with
+// std::to_chars straight into a large buffer of its own and writes that to
+// the file in one write() call when it fills. It takes the part of the
+// std::ofstream interface the examples use, so switching is a change of
+// type:
+//
+//     gpecs::TextWriter MyFile;
+//     MyFile.open("1D_dynamic_fluid.txt");
+//     if (!MyFile.is_open()) { ... }
+//     MyFile << t << ", " << phi[i] << "\n";
+//     MyFile.close();
+//
+// Numbers - by default a double is written as std::ofstream writes it, with
+// 6 significant digits (printf's %g), so the files do not change. With
+// precision(gpecs::TextWriter::SHORTEST) it is written with the fewest
+// digits that read back to the same double. Integers are written in full.
+//
+// std::endl writes a newline and writes the buffer out, as it does for a
+// stream; "\n" only adds a newline to the buffer.
+//
+// Errors - good() is false once a write to the file has failed; close()
+// returns good(). The destructor closes the file.
+//
+
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace gpecs {
+    class TextWriter {
+      public:
+        // Precision for the shortest digits that round trip
+        static constexpr int SHORTEST = -1;
+
+        explicit TextWriter(std::size_t buffer = 1 << 20)
+            : capacity_(buffer < 256 ? 256 : buffer), buffer_(new char[capacity_]) { }
+
+        explicit TextWriter(const std::string & path, std::size_t buffer = 1 << 20) : TextWriter(buffer) {
+            open(path);
+        }
+
+        ~TextWriter() { close(); }
+
+        TextWriter(const TextWriter &) = delete;
+        TextWriter & operator=(const TextWriter &) = delete;
+
+        // Creates (or truncates) `path`
+        void open(const std::string & path) {
+            close();
+            fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            good_ = fd_ >= 0;
+        }
+
+        bool is_open() const { return fd_ >= 0; }
+        bool good() const { return good_; }
+
+        // Writes out the buffer and closes the file; false if any write failed
+        bool close() {
+            if (fd_ < 0)
+                return good_;
+            flush();
+            if (::close(fd_) != 0)
+                good_ = false;
+            fd_ = -1;
+            return good_;
+        }
+
+        // Significant digits for doubles, or SHORTEST
+        void precision(int digits) { precision_ = digits; }
+        int precision() const { return precision_; }
+
+        // Writes the buffer to the file
+        void flush() {
+            direct(buffer_.get(), used_);
+            used_ = 0;
+        }
+
+        TextWriter & operator<<(double value) {
+            char *out = room(MAX_NUMBER);
+            const std::to_chars_result r = (precision_ == SHORTEST)
+                ? std::to_chars(out, out + MAX_NUMBER, value)
+                : std::to_chars(out, out + MAX_NUMBER, value, std::chars_format::general, precision_);
+            used_ += static_cast<std::size_t>(r.ptr - out);
+            return *this;
+        }
+
+        TextWriter & operator<<(float value) { return *this << static_cast<double>(value); }
+
+        template <typename T>
+        requires(std::is_integral_v<T> && sizeof(T) > 1)
+        TextWriter & operator<<(T value) {
+            char *out = room(MAX_NUMBER);
+            used_ += static_cast<std::size_t>(std::to_chars(out, out + MAX_NUMBER, value).ptr - out);
+            return *this;
+        }
+
+        TextWriter & operator<<(bool value) { return *this << (value ? 1 : 0); }
+
+        TextWriter & operator<<(char c) {
+            *room(1) = c;
+            ++used_;
+            return *this;
+        }
+
+        TextWriter & operator<<(signed char c) { return *this << static_cast<char>(c); }
+        TextWriter & operator<<(unsigned char c) { return *this << static_cast<char>(c); }
+
+        TextWriter & operator<<(std::string_view text) {
+            if (text.size() > capacity_ / 2) {
+                flush();
+                direct(text.data(), text.size());
+                return *this;
+            }
+            std::memcpy(room(text.size()), text.data(), text.size());
+            used_ += text.size();
+            return *this;
+        }
+
+        TextWriter & operator<<(const char *text) { return *this << std::string_view(text); }
+        TextWriter & operator<<(const std::string & text) { return *this << std::string_view(text); }
+
+        // std::endl and std::flush
+        TextWriter & operator<<(std::ostream & (*manip)(std::ostream &)) {
+            if (manip == static_cast<std::ostream & (*)(std::ostream &)>(std::endl))
+                *this << '\n';
+            flush();
+            return *this;
+        }
+
+      private:
+        static constexpr std::size_t MAX_NUMBER = 64;
+
+        // Space for `n` more characters, writing the buffer out if needed
+        char *room(std::size_t n) {
+            if (used_ + n > capacity_)
+                flush();
+            return buffer_.get() + used_;
+        }
+
+        void direct(const char *data, std::size_t size) {
+            while (size > 0 && fd_ >= 0) {
+                const ssize_t n = ::write(fd_, data, size);
+                if (n <= 0) {
+                    good_ = false;
+                    return;
+                }
+                data += n;
+                size -= static_cast<std::size_t>(n);
+            }
+        }
+
+        std::size_t capacity_;
+        std::unique_ptr < char[] > buffer_;
+        std::size_t used_ {0};
+        int fd_ {-1};
+        bool good_ {false};
+        int precision_ {6};
+    };
+
+}                               // namespace gpecs
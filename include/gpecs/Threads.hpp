@@ -0,0 +1,420 @@
+//
+// (c) 2026 University of Manchester
+// You may use this under the terms of the Apache 2 License
+//
+//
+// This file implements the pieces a sketch needs to run its systems on all
+// cores without changing its results.
+//
+// Enabling threads - pass `--threads N` (or `--threads=N`) on the command
+// line; N = 0 means one thread per hardware core. The option is removed
+// from argv, so any positional arguments a sketch reads keep their index:
+//
+//     int main(int argc, char* argv[]) {
+//         flecs::world world(argc, argv);
+//         gpecs::use_threads(world, argc, argv);
+//
+// Without the option the world stays single threaded, exactly as before.
+//
+// Pinning - by default the OS places the worker threads and may move them,
+// between sockets too, so scaling runs vary and a worker can end up far
+// from its data. `--pin LIST` pins the main thread and every worker to a
+// CPU of LIST, worker i to the i-th (wrapping round):
+//
+//     --pin cores       one logical CPU per physical core, socket by socket
+//     --pin siblings    every logical CPU, the SMT siblings of a core together
+//     --pin 0-7,16-23   these CPUs
+//
+// Workers are pinned as they start, through flecs' OS API thread hook, so
+// pinning needs no change to a sketch beyond use_threads(). It works on
+// Linux; elsewhere the option is accepted and ignored with a warning.
+//
+// Memory placement - Linux puts a page on the NUMA node of the thread that
+// first writes it, which for component tables is the main thread that
+// spawned the entities. After spawning, place_tables() moves each table's
+// rows to the node of the worker that will iterate them (flecs splits every
+// table between the workers the same way for every multi-threaded system):
+//
+//     ...spawn...
+//     gpecs::place_tables(world);   // does nothing unless pinned on >1 node
+//
+// Tables that grow afterwards are reallocated by flecs and lose their
+// placement, so call it once the entities exist.
+//
+// Marking systems - a system that only writes to the entity it is given can
+// be marked .multi_threaded(); flecs then splits its entities between the
+// workers. Systems that write shared state (files, std::cout, captured
+// counters) stay single threaded and run on the main thread only.
+//
+// Sync points - flecs runs consecutive multi-threaded systems back to back
+// on each worker WITHOUT waiting for the other workers in between, even
+// across phases. If a system reads other entities' components (a stencil,
+// a pairwise force) then the system before it that writes them must have
+// finished everywhere first. sync_point() inserts that barrier:
+//
+//     world.system<Position, const Velocity>().multi_threaded()...  // writes Position
+//     gpecs::sync_point(world);
+//     world.system<Accel>().multi_threaded()...   // reads everyone's Position
+//
+// Reductions - a counter captured by reference and updated from a
+// multi-threaded system races. PerWorker<T> instead gives every worker its
+// own (cache line padded) copy, and a single threaded system merges them:
+//
+//     gpecs::PerWorker<Counts> moves(world);     // after use_threads()
+//
+//     world.system<State>().multi_threaded()
+//         .each([&](flecs::iter& it, size_t, State& s) {
+//             moves.local(it).infected += ...;
+//         });
+//     world.system<>()
+//         .run([&](flecs::iter&) {
+//             moves.merge([&](Counts& c) { population[1] += c.infected; });
+//         });
+//
+// merge() visits the workers in a fixed order and resets each copy. Integer
+// counts and min/max are then the same whatever the thread count. Floating
+// point sums are not, since how entities are split between workers changes
+// with the thread count; keep those per entity and add them up in a single
+// threaded system.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <flecs.h>
+
+#include <gpecs/Args.hpp>
+
+namespace gpecs {
+    // Removes `--threads N` / `--threads=N` from argv and returns N (1 if the
+    // option is absent, the hardware thread count if N is 0).
+    inline int parse_threads(int & argc, char *argv[]) {
+        std::string value;
+        if (!take_option(argc, argv, "--threads", value))
+            return 1;
+        int threads = std::atoi(value.c_str());
+        if (threads <= 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        return threads;
+    }
+
+    namespace threads {
+        struct Cpu {
+            int id;
+            int package;
+            int core;
+            int node;
+        };
+
+        inline bool read_int(const std::filesystem::path & path, int & value) {
+            std::ifstream in(path);
+            return static_cast<bool>(in >> value);
+        }
+
+        // Parses a CPU list such as "0-3,8,10-11"; empty if it is not one
+        inline std::vector < int > parse_list(const std::string & list) {
+            std::vector < int > cpus;
+            std::size_t at = 0;
+            while (at < list.size()) {
+                std::size_t end = list.find(',', at);
+                if (end == std::string::npos)
+                    end = list.size();
+                const std::string item = list.substr(at, end - at);
+                const std::size_t dash = item.find('-');
+                char *stop = nullptr;
+                const long first = std::strtol(item.c_str(), &stop, 10);
+                long last = first;
+                if (dash != std::string::npos)
+                    last = std::strtol(item.c_str() + dash + 1, &stop, 10);
+                if (item.empty() || *stop != '\0' || first < 0 || last < first)
+                    return {};
+                for (long cpu = first; cpu <= last; ++cpu)
+                    cpus.push_back(static_cast<int>(cpu));
+                at = end + 1;
+            }
+            return cpus;
+        }
+
+        // The online CPUs with their socket, core and NUMA node, from sysfs
+        inline std::vector < Cpu > topology() {
+            std::vector < Cpu > cpus;
+            const std::filesystem::path root = "/sys/devices/system/cpu";
+            std::ifstream in(root / "online");
+            std::string online;
+            if (!(in >> online))
+                return cpus;
+          for (int id : parse_list(online)) {
+                const std::filesystem::path dir = root / ("cpu" + std::to_string(id));
+                Cpu cpu { id, 0, id, 0 };
+                read_int(dir / "topology" / "physical_package_id", cpu.package);
+                read_int(dir / "topology" / "core_id", cpu.core);
+                std::error_code ec;
+              for (const auto & entry : std::filesystem::directory_iterator(dir, ec)) {
+                    const std::string name = entry.path().filename().string();
+                    if (name.size() > 4 && name.rfind("node", 0) == 0)
+                        cpu.node = std::atoi(name.c_str() + 4);
+                }
+                cpus.push_back(cpu);
+            }
+            return cpus;
+        }
+
+        // The CPUs `spec` names ("cores", "siblings" or a list), in the order
+        // the main thread and the workers take them
+        inline std::vector < int > parse_pin(const std::string & spec) {
+            if (spec != "cores" && spec != "siblings")
+                return parse_list(spec);
+            std::vector < Cpu > cpus = topology();
+            std::sort(cpus.begin(), cpus.end(), [](const Cpu & a, const Cpu & b) {
+                return std::tie(a.package, a.core, a.id) < std::tie(b.package, b.core, b.id);
+            });
+            std::vector < int > order;
+            std::set < std::pair < int, int > > cores;
+          for (const Cpu & cpu : cpus)
+                if (spec == "siblings" || cores.insert({ cpu.package, cpu.core }).second)
+                    order.push_back(cpu.id);
+            return order;
+        }
+
+        // CPU of each stage, stage i taking cpus[i % size]; empty if not pinned
+        inline std::vector < int > & pinned() {
+            static std::vector < int > cpus;
+            return cpus;
+        }
+
+        inline int cpu_of_stage(int32_t stage) {
+            const std::vector < int > & cpus = pinned();
+            return cpus[static_cast<std::size_t>(stage) % cpus.size()];
+        }
+
+        inline bool pin_this_thread(int cpu) {
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+            (void)cpu;
+            return false;
+#endif
+        }
+
+        inline ecs_os_api_thread_new_t & flecs_thread_new() {
+            static ecs_os_api_thread_new_t original = nullptr;
+            return original;
+        }
+
+        struct Start {
+            ecs_os_thread_callback_t callback;
+            void *stage;
+            int cpu;
+        };
+
+        inline void *start_pinned(void *param) {
+            const Start start = *static_cast<Start*>(param);
+            delete static_cast<Start*>(param);
+            if (!pin_this_thread(start.cpu))
+                std::cerr << "gpecs threads: cannot pin a worker to CPU " << start.cpu << std::endl;
+            return start.callback(start.stage);
+        }
+
+        // Stands in for flecs' thread_new while the workers are created; the
+        // parameter flecs passes a worker is its stage
+        inline ecs_os_thread_t new_pinned(ecs_os_thread_callback_t callback, void *stage) {
+            const int cpu = cpu_of_stage(ecs_stage_get_id(static_cast<ecs_world_t*>(stage)));
+            return flecs_thread_new()(&start_pinned, new Start { callback, stage, cpu });
+        }
+
+        // Gives the world `count` threads, each pinned to its CPU of `cpus`
+        inline void pin(flecs::world & world, int count, const std::vector < int > &cpus) {
+            pinned() = cpus;
+            if (!pin_this_thread(cpus[0])) {
+                std::cerr << "gpecs threads: cannot pin threads here, --pin ignored" << std::endl;
+                pinned().clear();
+                if (count > 1)
+                    world.set_threads(count);
+                return;
+            }
+            if (count > 1) {
+                flecs_thread_new() = ecs_os_api.thread_new_;
+                ecs_os_api.thread_new_ = &new_pinned;
+                world.set_threads(count);
+                ecs_os_api.thread_new_ = flecs_thread_new();
+            }
+        }
+    }                           // namespace threads
+
+    // Parses the options and gives the world that many worker threads,
+    // pinned to CPUs if `--pin` was given
+    inline int use_threads(flecs::world & world, int & argc, char *argv[]) {
+        int threads = parse_threads(argc, argv);
+        std::string pin;
+        if (take_option(argc, argv, "--pin", pin)) {
+            const std::vector < int > cpus = threads::parse_pin(pin);
+            if (!cpus.empty()) {
+                threads::pin(world, threads, cpus);
+                return threads;
+            }
+            std::cerr << "gpecs threads: no CPUs in --pin " << pin << ", threads not pinned" << std::endl;
+        }
+        if (threads > 1)
+            world.set_threads(threads);
+        return threads;
+    }
+
+    // Moves the pages of every table's rows to the NUMA node of the CPU whose
+    // worker iterates them, splitting each table as flecs' worker iterator
+    // does. Returns the number of pages on the right node afterwards; 0 when
+    // the threads are not pinned or the pinned CPUs are all on one node.
+    inline int64_t place_tables(const flecs::world & world) {
+#ifdef __linux__
+        if (threads::pinned().empty())
+            return 0;
+        std::vector < int > node_of;
+      for (const threads::Cpu & cpu : threads::topology()) {
+            if (static_cast<std::size_t>(cpu.id) >= node_of.size())
+                node_of.resize(cpu.id + 1, 0);
+            node_of[cpu.id] = cpu.node;
+        }
+        const int32_t stages = std::max(1, world.get_stage_count());
+        std::vector < int > stage_node(stages, 0);
+        std::set < int > nodes;
+        for (int32_t s = 0; s < stages; ++s) {
+            const int cpu = threads::cpu_of_stage(s);
+            stage_node[s] = static_cast<std::size_t>(cpu) < node_of.size() ? node_of[cpu] : 0;
+            nodes.insert(stage_node[s]);
+        }
+        if (nodes.size() < 2)
+            return 0;
+
+        const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+        std::vector < void * > pages;
+        std::vector < int > targets;
+        // Rows [first, first + count) of stage s, as in flecs' ecs_worker_next()
+        auto add = [&](const void *column, std::size_t size, int32_t rows) {
+            uintptr_t next = 0;
+            for (int32_t s = 0; s < stages; ++s) {
+                int32_t count = rows / stages, first = count * s;
+                const int32_t rest = rows - count * stages;
+                if (rest) {
+                    if (s < rest) {
+                        ++count;
+                        first += s;
+                    } else {
+                        first += rest;
+                    }
+                }
+                if (count == 0)
+                    continue;
+                const uintptr_t begin = reinterpret_cast<uintptr_t>(column) + first * size;
+                const uintptr_t end = begin + count * size;
+                for (uintptr_t p = std::max(next, begin & ~(page - 1)); p < end; p += page) {
+                    pages.push_back(reinterpret_cast<void*>(p));
+                    targets.push_back(stage_node[s]);
+                    next = p + page;
+                }
+            }
+        };
+
+        const ecs_world_t *w = world.c_ptr();
+        std::set < const ecs_table_t * > seen;
+        const ecs_entities_t entities = ecs_get_entities(w);
+        for (int32_t i = 0; i < entities.alive_count; ++i) {
+            const ecs_table_t *table = ecs_get_table(w, entities.ids[i]);
+            if (!table || !seen.insert(table).second
+                || ecs_table_has_flags(const_cast<ecs_table_t*>(table),
+                                       EcsTableHasBuiltins | EcsTableHasModule | EcsTableNotQueryable))
+                continue;
+            // Tables of less than a page (flecs' own among them) are left alone
+            const int32_t rows = ecs_table_count(table);
+            if (rows * sizeof(ecs_entity_t) < page)
+                continue;
+            for (int32_t c = 0; c < ecs_table_column_count(table); ++c)
+                add(ecs_table_get_column(table, c, 0), ecs_table_get_column_size(table, c), rows);
+            add(ecs_table_entities(table), sizeof(ecs_entity_t), rows);
+        }
+
+        if (pages.empty())
+            return 0;
+        std::vector < int > status(pages.size(), 0);
+        if (syscall(SYS_move_pages, 0, pages.size(), pages.data(), targets.data(), status.data(),
+                                     MPOL_MF_MOVE) < 0) {
+            std::cerr << "gpecs threads: could not move table memory between NUMA nodes" << std::endl;
+            return 0;
+        }
+        int64_t placed = 0;
+        for (std::size_t i = 0; i < pages.size(); ++i)
+            placed += status[i] == targets[i];
+        return placed;
+#else
+        (void)world;
+        return 0;
+#endif
+    }
+
+    // Registers a single threaded system that does nothing. Because it is not
+    // multi-threaded, flecs has to wait for every worker to finish the systems
+    // before it, which makes their writes visible to the systems after it.
+    inline flecs::system sync_point(flecs::world & world, flecs::entity_t phase = flecs::OnUpdate) {
+        return world.system<>()
+            .kind(phase)
+            .run([](flecs::iter&) { });
+    }
+
+    template <typename T>
+    class PerWorker {
+      public:
+        // Create after the world's threads have been set
+        explicit PerWorker(flecs::world & world, const T & initial = T {})
+            : initial_(initial), slots_(std::max(1, world.get_stage_count()), Slot { initial }) { }
+
+        // This worker's copy; call from inside a system
+        T & local(flecs::iter & it) { return at(it.world().get_stage_id()); }
+        T & local(flecs::entity e) { return at(e.world().get_stage_id()); }
+
+        // Visit every worker's copy in worker order, then reset it
+        template <typename Func>
+        void merge(Func && func) {
+          for (auto & slot : slots_) {
+                func(slot.value);
+                slot.value = initial_;
+            }
+        }
+
+        int workers() const { return static_cast<int>(slots_.size()); }
+
+      private:
+        struct alignas(64) Slot {
+            T value;
+        };
+
+        T & at(int32_t stage) {
+            ecs_assert(stage >= 0 && stage < workers(), ECS_INVALID_OPERATION,
+                       "PerWorker created before the world's threads were set");
+            return slots_[stage].value;
+        }
+
+        T initial_;
+        std::vector < Slot > slots_;
+    };
+
+}                               // namespace gpecs
@@ -0,0 +1,365 @@
+//
+// (c) 2026 University of Manchester
+// You may use this under the terms of the Apache 2 License
+//
+//
+// This file implements work stealing for multi-threaded systems whose
+// entities do not all cost the same.
+//
+// flecs splits every table between the workers once, in equal slices, and
+// a worker that finishes its slice waits for the others. That is right for
+// a velocity update, but the kNN force in asteroids_knn costs as much as
+// the asteroid has neighbours, and asteroids spawned one after the other
+// end up in the same slice: with a cluster in one slice, one worker does
+// most of the frame while the rest sit idle.
+//
+// WorkStealing keeps flecs' workers and their slices, but lets a worker
+// that runs out take work from the others. Build it after use_threads()
+// and hand the system's function to each() instead of to the builder:
+//
+//     gpecs::WorkStealing stealing(world);       // after use_threads()
+//
+//     world.system<const Position, Accel, const Mass>()
+//         .with<AsteroidTag>()
+//         .multi_threaded()
+//         .run(stealing.each([&](flecs::entity self, const Position& p, Accel& a, const Mass& m) {
+//             ...
+//         }));
+//
+// The function takes what an .each() function takes: an optional leading
+// flecs::entity, then a reference per component of system<...>(), in order.
+//
+// How - every worker keeps its slice in a Chase-Lev deque of row ranges.
+// The owner runs its range a chunk at a time, and whenever its deque is
+// empty it pushes the upper half of what is left onto it (lazy binary
+// splitting), so there is always something to take without splitting work
+// nobody asks for. A worker with nothing left of its own steals the oldest,
+// biggest range from another worker's deque and carries on the same way,
+// until no deque has anything left and its own rows have all been run.
+// Chunks are 1/32 of a worker's slice, at most 4096 rows, unless given.
+//
+// Notes:
+//
+// * The function may run on any worker, so it must only write to the
+//   components it is given, as for any multi-threaded system. Something
+//   that depends on the worker (PerWorker::local()) does not belong in it.
+// * Every entity is still updated by exactly one call, with the same
+//   arguments, so results do not change; only which thread makes the call.
+// * A worker returns once all of its own rows are done, even if others
+//   ran them, so the next system sees them finished as it does without
+//   stealing. Sync points are still needed for systems that read other
+//   entities.
+// * Single threaded, each() runs the rows in order and steals nothing.
+// * A worker's slice can have up to 2^28 rows, and there can be up to 256
+//   workers; beyond that each worker runs its own slice without stealing.
+// * stats() counts, per worker, the rows it ran, the chunks and the ranges
+//   it stole, since the last reset_stats().
+//
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <flecs.h>
+
+namespace gpecs {
+    namespace steal {
+        // A range of rows [begin, end) of one worker's slice, and that worker,
+        // in one word so a deque slot is a single atomic
+        constexpr int OWNER_BITS = 8;
+        constexpr int ROW_BITS = (64 - OWNER_BITS) / 2;
+        constexpr int64_t MAX_ROWS = int64_t(1) << ROW_BITS;
+
+        inline uint64_t pack(int32_t owner, int64_t begin, int64_t end) {
+            return (uint64_t(owner) << (2 * ROW_BITS)) | (uint64_t(begin) << ROW_BITS) | uint64_t(end);
+        }
+        inline int32_t owner_of(uint64_t range) { return int32_t(range >> (2 * ROW_BITS)); }
+        inline int64_t begin_of(uint64_t range) { return int64_t((range >> ROW_BITS) & (MAX_ROWS - 1)); }
+        inline int64_t end_of(uint64_t range) { return int64_t(range & (MAX_ROWS - 1)); }
+
+        // Chase and Lev's deque, with the memory orders of Le, Pop, Cohen and
+        // Zappa Nardelli (PPoPP 2013). The owner pushes and pops at the bottom,
+        // thieves take from the top. Lazy splitting only ever holds about
+        // log2(slice / chunk) ranges, so the ring does not grow.
+        class Deque {
+          public:
+            static constexpr int64_t SIZE = 64;
+
+            // Owner only; false if the ring is full
+            bool push(uint64_t range) {
+                const int64_t b = bottom_.load(std::memory_order_relaxed);
+                const int64_t t = top_.load(std::memory_order_acquire);
+                if (b - t >= SIZE)
+                    return false;
+                ring_[b & (SIZE - 1)].store(range, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+                bottom_.store(b + 1, std::memory_order_relaxed);
+                return true;
+            }
+
+            // Owner only; the newest range
+            bool pop(uint64_t & range) {
+                const int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+                bottom_.store(b, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                int64_t t = top_.load(std::memory_order_relaxed);
+                if (t > b) {
+                    bottom_.store(b + 1, std::memory_order_relaxed);
+                    return false;
+                }
+                range = ring_[b & (SIZE - 1)].load(std::memory_order_relaxed);
+                if (t < b)
+                    return true;
+                // The last range: race the thieves for it
+                const bool won = top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                              std::memory_order_relaxed);
+                bottom_.store(b + 1, std::memory_order_relaxed);
+                return won;
+            }
+
+            // Any thread; the oldest range, false if empty or another thief won
+            bool steal(uint64_t & range) {
+                int64_t t = top_.load(std::memory_order_acquire);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                const int64_t b = bottom_.load(std::memory_order_acquire);
+                if (t >= b)
+                    return false;
+                range = ring_[t & (SIZE - 1)].load(std::memory_order_relaxed);
+                return top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                    std::memory_order_relaxed);
+            }
+
+            bool empty() const {
+                return bottom_.load(std::memory_order_relaxed) <= top_.load(std::memory_order_relaxed);
+            }
+
+          private:
+            alignas(64) std::atomic < int64_t > top_ {0};
+            alignas(64) std::atomic < int64_t > bottom_ {0};
+            std::atomic < uint64_t > ring_[SIZE] {};
+        };
+
+        // The argument types of a (non-generic) lambda or function object
+        template <typename F>
+        struct arguments : arguments<decltype(&F::operator())> { };
+        template <typename C, typename R, typename... A>
+        struct arguments<R (C::*)(A...) const> { using type = std::tuple < A... >; };
+        template <typename C, typename R, typename... A>
+        struct arguments<R (C::*)(A...)> { using type = std::tuple < A... >; };
+
+        template <typename Args>
+        constexpr bool leading_entity() {
+            if constexpr (std::tuple_size_v<Args> == 0)
+                return false;
+            else
+                return std::is_same_v<std::remove_cvref_t<std::tuple_element_t<0, Args>>, flecs::entity>;
+        }
+
+        // What a worker publishes for the others to steal: runs rows
+        // [begin, end) of its slice
+        struct Job {
+            void (*run)(const void *kernel, int64_t begin, int64_t end);
+            const void *kernel;
+            int64_t chunk;
+        };
+
+        // A worker's slice of a system's entities, as a list of the table
+        // pieces flecs gave it, numbered on from each other
+        template <typename Func>
+        struct Kernel {
+            using Args = typename arguments<Func>::type;
+            static constexpr bool ENTITY = leading_entity<Args>();
+            static constexpr std::size_t FIELDS = std::tuple_size_v<Args> - ENTITY;
+
+            struct Segment {
+                int64_t first;
+                int32_t count;
+                const ecs_entity_t *entities;
+                void *fields[FIELDS ? FIELDS : 1];
+                bool self[FIELDS ? FIELDS : 1];
+            };
+
+            const Func *func;
+            ecs_world_t *world;
+            const Segment *segments;
+            std::size_t segment_count;
+
+            template <std::size_t I>
+            using Component = std::remove_reference_t<std::tuple_element_t<I + ENTITY, Args>>;
+
+            static Segment segment(const ecs_iter_t *it, int64_t first) {
+                Segment segment {first, it->count, it->entities, {}, {}};
+                fill(segment, it, std::make_index_sequence<FIELDS>());
+                return segment;
+            }
+
+            template <std::size_t... I>
+            static void fill(Segment & segment, const ecs_iter_t *it, std::index_sequence<I...>) {
+                static_assert((std::is_reference_v<std::tuple_element_t<I + ENTITY, Args>> && ...),
+                              "gpecs work stealing: components are passed by reference");
+                ((segment.fields[I] = ecs_field_w_size(it, sizeof(Component<I>), static_cast<int8_t>(I)),
+                  segment.self[I] = ecs_field_is_self(it, static_cast<int8_t>(I))), ...);
+            }
+
+            template <std::size_t I>
+            static Component<I> & field(const Segment & segment, int32_t row) {
+                Component<I> *column = static_cast<Component<I> *>(segment.fields[I]);
+                return segment.self[I] ? column[row] : column[0];
+            }
+
+            template <std::size_t... I>
+            void call(const Segment & segment, int32_t row, std::index_sequence<I...>) const {
+                if constexpr (ENTITY)
+                    (*func)(flecs::entity(world, segment.entities[row]), field<I>(segment, row)...);
+                else
+                    (*func)(field<I>(segment, row)...);
+            }
+
+            static void run(const void *kernel, int64_t begin, int64_t end) {
+                const Kernel & k = *static_cast<const Kernel *>(kernel);
+                const Segment *s = std::upper_bound(k.segments, k.segments + k.segment_count, begin,
+                    [](int64_t row, const Segment & segment) { return row < segment.first; }) - 1;
+                for (; begin < end; ++s) {
+                    const int64_t stop = std::min < int64_t > (end, s->first + s->count);
+                    for (int64_t row = begin; row < stop; ++row)
+                        k.call(*s, static_cast<int32_t>(row - s->first), std::make_index_sequence<FIELDS>());
+                    begin = stop;
+                }
+            }
+        };
+    }                           // namespace steal
+
+    struct StealStats {
+        int64_t rows {0};               // rows this worker ran
+        int64_t chunks {0};             // calls of the kernel
+        int64_t steals {0};             // ranges taken from other workers
+    };
+
+    class WorkStealing {
+      public:
+        // Create after the world's threads have been set; chunk 0 picks the
+        // chunk size from each worker's slice
+        explicit WorkStealing(const flecs::world & world, int64_t chunk = 0)
+            : workers_(std::max(1, world.get_stage_count())), chunk_(chunk),
+              slots_(std::make_unique<Worker[]>(workers_)) { }
+
+        // A .run() callback for a multi-threaded system that calls `func` for
+        // every entity, stealing between workers
+        template <typename Func>
+        auto each(Func func) {
+            return [this, func = std::move(func)](flecs::iter & it) { run(it, func); };
+        }
+
+        int workers() const { return workers_; }
+        const StealStats & stats(int worker) const { return slots_[worker].stats; }
+        void reset_stats() {
+            for (int w = 0; w < workers_; ++w)
+                slots_[w].stats = StealStats {};
+        }
+
+      private:
+        struct alignas(64) Worker {
+            steal::Deque deque;
+            std::atomic < const steal::Job *> job {nullptr};
+            std::atomic < int64_t > remaining {0};      // rows of the slice not yet run
+            StealStats stats;
+        };
+
+        template <typename Func>
+        void run(flecs::iter & it, const Func & func) {
+            using Kernel = steal::Kernel<Func>;
+            // Kept per thread so a frame does not allocate; a worker is done
+            // with its own before it runs the next system
+            static thread_local std::vector < typename Kernel::Segment > segments;
+            segments.clear();
+            int64_t rows = 0;
+            while (it.next()) {
+                segments.push_back(Kernel::segment(it.c_ptr(), rows));
+                rows += it.count();
+            }
+            const int32_t me = it.world().get_stage_id();
+            ecs_assert(me >= 0 && me < workers_, ECS_INVALID_OPERATION,
+                       "WorkStealing created before the world's threads were set");
+            const Kernel kernel {&func, it.world().c_ptr(), segments.data(), segments.size()};
+            const int64_t chunk = chunk_ ? chunk_ : std::clamp < int64_t > (rows / 32, 1, 4096);
+            if (workers_ == 1 || rows >= steal::MAX_ROWS || workers_ > (1 << steal::OWNER_BITS)) {
+                if (rows)
+                    Kernel::run(&kernel, 0, rows);
+                slots_[me].stats.rows += rows;
+                slots_[me].stats.chunks += rows > 0;
+                return;
+            }
+
+            Worker & self = slots_[me];
+            const steal::Job job {&Kernel::run, &kernel, chunk};
+            self.remaining.store(rows, std::memory_order_relaxed);
+            self.job.store(&job, std::memory_order_release);
+            uint64_t range = steal::pack(me, 0, rows);
+            bool have = rows > 0;
+            for (;;) {
+                if (have)
+                    work(me, range);
+                if ((have = self.deque.pop(range)))
+                    continue;
+                if ((have = take(me, range)))
+                    continue;
+                if (self.remaining.load(std::memory_order_acquire) == 0)
+                    break;
+                std::this_thread::yield();
+            }
+            self.job.store(nullptr, std::memory_order_relaxed);
+        }
+
+        // Runs `range` a chunk at a time, putting the upper half of what is
+        // left on this worker's deque whenever it is empty
+        void work(int32_t me, uint64_t range) {
+            Worker & self = slots_[me];
+            Worker & owner = slots_[steal::owner_of(range)];
+            // Valid until the owner's rows are all done, which needs this range
+            const steal::Job & job = *owner.job.load(std::memory_order_acquire);
+            int64_t begin = steal::begin_of(range);
+            int64_t end = steal::end_of(range);
+            while (begin < end) {
+                if (end - begin > 2 * job.chunk && self.deque.empty()) {
+                    const int64_t middle = begin + (end - begin) / 2;
+                    if (self.deque.push(steal::pack(steal::owner_of(range), middle, end)))
+                        end = middle;
+                }
+                const int64_t stop = std::min(end, begin + job.chunk);
+                job.run(job.kernel, begin, stop);
+                self.stats.rows += stop - begin;
+                self.stats.chunks += 1;
+                const int64_t done = stop - begin;
+                begin = stop;
+                // The last decrement may let the owner return: touch nothing of its after it
+                owner.remaining.fetch_sub(done, std::memory_order_acq_rel);
+            }
+        }
+
+        // Steals a range from the next worker that has one
+        bool take(int32_t me, uint64_t & range) {
+            for (int i = 1; i < workers_; ++i) {
+                const int victim = (me + i) % workers_;
+                if (slots_[victim].deque.steal(range)) {
+                    slots_[me].stats.steals += 1;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        int workers_;
+        int64_t chunk_;
+        std::unique_ptr < Worker[] > slots_;
+    };
+
+}                               // namespace gpecs
@@ -0,0 +1,60 @@
+//
+// (c) 2026 University of Manchester
+// You may use this under the terms of the Apache 2 License
+//
+//
+// This file implements telling a program's own entities and tables apart
+// from flecs' in a world.
+//
+// A world holds flecs' own entities next to the program's: its components,
+// systems, phases and modules, each in tables of their own. Code that walks
+// every table to save (Checkpoint.hpp) or measure (MemoryReport.hpp) what
+// the program stores leaves those out with:
+//
+//     if (gpecs::flecs_table(world, table))
+//         continue;
+//
+// Notes:
+//
+// * flecs' own entities are everything under the flecs module, including
+//   the builtin components, relationships and phases.
+// * A table is flecs' own if flecs flags it so (builtins, modules, prefabs,
+//   tables hidden from queries) or if it has a flecs component or tag. A
+//   pair counts only if its relationship is flecs' and, for ChildOf and IsA,
+//   which programs use for their own hierarchies, so is its target.
+//
+
+#pragma once
+
+#include <flecs.h>
+
+namespace gpecs {
+    // True for flecs' own entities: everything under the flecs module
+    inline bool flecs_builtin(const ecs_world_t *world, ecs_entity_t e) {
+      for (e = ecs_get_alive(world, e); e; e = ecs_get_parent(world, e))
+            if (e == EcsFlecs)
+                return true;
+        return false;
+    }
+
+    // True for the tables of flecs' own entities (components, systems, modules)
+    inline bool flecs_table(const ecs_world_t *world, const ecs_table_t *table) {
+        if (ecs_table_has_flags(const_cast<ecs_table_t*>(table),
+                                EcsTableHasBuiltins | EcsTableHasModule | EcsTableIsPrefab | EcsTableNotQueryable))
+            return true;
+        const ecs_type_t *type = ecs_table_get_type(table);
+        for (int32_t i = 0; i < type->count; ++i) {
+            const ecs_id_t id = type->array[i];
+            if (ECS_IS_PAIR(id)) {
+                const ecs_entity_t first = ecs_pair_first(world, id);
+                if (flecs_builtin(world, first) && ((first != EcsChildOf && first != EcsIsA)
+                                                    || flecs_builtin(world, ecs_pair_second(world, id))))
+                    return true;
+            } else if (flecs_builtin(world, id)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+}                               // namespace gpecs
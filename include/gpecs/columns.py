@@ -0,0 +1,127 @@
+"""
+Loads gpecs column files (see ColumnFile.hpp) with NumPy alone.
+
+The arrays are views of an np.memmap of the file, so nothing is read until
+it is used:
+
+    import sys
+    sys.path.append("path/to/include/gpecs")
+    import columns
+
+    data = columns.load("fluid.gcol")
+    data.names                  # ["u", "v", "rho"]
+    data.frames[0]              # {"step": 0, "time": 0.0, "rows": 20000, "offset": ...}
+    rho = data.column("rho")    # (frames, rows) array
+    u0 = data.frame(0)["u"]     # one frame's column
+
+column() is a strided view of the file when every frame has the same
+number of rows, otherwise a stacked copy.
+"""
+
+import numpy as np
+
+ALIGN = 64
+FILE_MAGIC = b"GPECSCOL"
+FRAME_MAGIC = b"GPECSFRM"
+INDEX_MAGIC = b"GPECSIDX"
+
+_FILE_HEADER = np.dtype([("magic", "S8"), ("version", "<u4"), ("columns", "<u4"),
+                         ("data_offset", "<u8"), ("reserved", "V40")])
+_COLUMN = np.dtype([("name", "S48"), ("dtype", "S8"), ("size", "<u8")])
+_FRAME_HEADER = np.dtype([("magic", "S8"), ("step", "<i8"), ("time", "<f8"), ("rows", "<u8"),
+                          ("bytes", "<u8"), ("reserved", "V24")])
+_INDEX = np.dtype([("step", "<i8"), ("time", "<f8"), ("rows", "<u8"), ("offset", "<u8")])
+_TRAILER = np.dtype([("magic", "S8"), ("index_offset", "<u8"), ("frames", "<u8"), ("reserved", "<u8")])
+
+
+def _padded(nbytes):
+    return (nbytes + ALIGN - 1) // ALIGN * ALIGN
+
+
+class ColumnFile:
+    def __init__(self, path):
+        self.path = path
+        self._map = np.memmap(path, dtype=np.uint8, mode="r")
+        header = self._record(_FILE_HEADER, 0)
+        if header["magic"] != FILE_MAGIC:
+            raise ValueError(f"{path} is not a gpecs column file")
+        if header["version"] != 1:
+            raise ValueError(f"{path} has an unknown version {header['version']}")
+        columns = self._records(_COLUMN, _FILE_HEADER.itemsize, int(header["columns"]))
+        self.names = [c["name"].decode() for c in columns]
+        self.dtypes = [np.dtype(c["dtype"].decode()) for c in columns]
+        self._data_offset = int(header["data_offset"])
+        self.complete, self.frames = self._read_index()
+
+    def _record(self, dtype, offset):
+        if offset + dtype.itemsize > len(self._map):
+            raise ValueError(f"{self.path} is truncated")
+        return self._map[offset:offset + dtype.itemsize].view(dtype)[0]
+
+    def _records(self, dtype, offset, count):
+        end = offset + count * dtype.itemsize
+        if end > len(self._map):
+            raise ValueError(f"{self.path} is truncated")
+        return self._map[offset:end].view(dtype)
+
+    def _read_index(self):
+        size = len(self._map)
+        if size >= self._data_offset + _TRAILER.itemsize:
+            trailer = self._record(_TRAILER, size - _TRAILER.itemsize)
+            if trailer["magic"] == INDEX_MAGIC:
+                index = self._records(_INDEX, int(trailer["index_offset"]), int(trailer["frames"]))
+                return True, [{name: entry[name].item() for name in _INDEX.names} for entry in index]
+        # No index: the writer did not finish, walk the whole frames
+        frames = []
+        offset = self._data_offset
+        while offset + _FRAME_HEADER.itemsize <= size:
+            header = self._record(_FRAME_HEADER, offset)
+            if header["magic"] != FRAME_MAGIC or offset + int(header["bytes"]) > size:
+                break
+            frames.append({"step": int(header["step"]), "time": float(header["time"]),
+                           "rows": int(header["rows"]), "offset": offset})
+            offset += int(header["bytes"])
+        return False, frames
+
+    def _column_offset(self, frame, column):
+        offset = frame["offset"] + _FRAME_HEADER.itemsize
+        for dtype in self.dtypes[:column]:
+            offset += _padded(frame["rows"] * dtype.itemsize)
+        return offset
+
+    def frame(self, index):
+        """Every column of one frame, by name"""
+        frame = self.frames[index]
+        result = {}
+        for c, (name, dtype) in enumerate(zip(self.names, self.dtypes)):
+            offset = self._column_offset(frame, c)
+            result[name] = np.ndarray((frame["rows"],), dtype, buffer=self._map, offset=offset)
+        return result
+
+    def column(self, name):
+        """One column across all frames, shape (frames, rows)"""
+        c = self.names.index(name)
+        dtype = self.dtypes[c]
+        if not self.frames:
+            return np.empty((0, 0), dtype)
+        rows = self.frames[0]["rows"]
+        offsets = [self._column_offset(f, c) for f in self.frames]
+        if all(f["rows"] == rows for f in self.frames) and len(set(np.diff(offsets).tolist())) <= 1:
+            stride = offsets[1] - offsets[0] if len(offsets) > 1 else rows * dtype.itemsize
+            array = np.ndarray((len(self.frames), rows), dtype, buffer=self._map, offset=offsets[0],
+                               strides=(stride, dtype.itemsize))
+            array.flags.writeable = False
+            return array
+        return np.stack([self.frame(i)[name] for i in range(len(self.frames))])
+
+    @property
+    def steps(self):
+        return np.array([f["step"] for f in self.frames], dtype=np.int64)
+
+    @property
+    def times(self):
+        return np.array([f["time"] for f in self.frames], dtype=np.float64)
+
+
+def load(path):
+    return ColumnFile(path)